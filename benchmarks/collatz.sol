@@ -0,0 +1,31 @@
+/**
+ * @file collatz.sol
+ * Unpredictable loop trip counts on 64-bit integers.
+ */
+
+pub module collatz;
+
+fn steps(start : i64) : i32 {
+    n : i64 = start;
+    count : i32 = 0;
+    for n != 1 {
+        if n % 2 == 0 {
+            n = n / 2;
+        } else {
+            n = 3 * n + 1;
+        }
+        count += 1;
+    }
+    return count;
+}
+
+pub fn main() : i32 {
+    longest : i32 = 0;
+    for i : i64 = 1; i < 100000; i += 1 {
+        s : i32 = steps(i);
+        if s > longest {
+            longest = s;
+        }
+    }
+    return longest;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file dot.sol
+ * Dot products of generated integer vectors, a counted loop the optimizer vectorizes.
+ */
+
+pub module dot;
+
+fn dot(n : i32, a : i32, b : i32, c : i32, d : i32) : i32 {
+    sum : i32 = 0;
+    for i : i32 = 0; i < n; i += 1 {
+        sum += (a * i + b) * (c * i + d);
+    }
+    return sum;
+}
+
+pub fn main() : i32 {
+    total : i32 = 0;
+    for row : i32 = 0; row < 1000; row += 1 {
+        total += dot(20001, row, 7, 3, row - 11);
+    }
+    return total;
+}
@@ -0,0 +1,17 @@
+/**
+ * @file fib.sol
+ * Call-heavy: naive recursive Fibonacci.
+ */
+
+pub module fib;
+
+fn fib(n : i32) : i32 {
+    if n < 2 {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+pub fn main() : i32 {
+    return fib(30);
+}
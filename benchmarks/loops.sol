@@ -0,0 +1,20 @@
+/**
+ * @file loops.sol
+ * Branchy integer arithmetic in nested loops.
+ */
+
+pub module loops;
+
+pub fn main() : i32 {
+    total : i32 = 0;
+    for i : i32 = 0; i < 3000; i += 1 {
+        for j : i32 = 0; j < 1000; j += 1 {
+            if (i + j) % 3 == 0 {
+                total += i * j;
+            } else {
+                total -= j;
+            }
+        }
+    }
+    return total;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file mandelbrot.sol
+ * Floating point: counts the points of a grid inside the Mandelbrot set.
+ */
+
+pub module mandelbrot;
+
+fn escapes(cr : f64, ci : f64) : bool {
+    zr : f64 = 0;
+    zi : f64 = 0;
+    for i : i32 = 0; i < 200; i += 1 {
+        t : f64 = zr * zr - zi * zi + cr;
+        zi = 2 * zr * zi + ci;
+        zr = t;
+        if zr * zr + zi * zi > 4 {
+            return 1 > 0;
+        }
+    }
+    return 0 > 1;
+}
+
+pub fn main() : i32 {
+    inside : i32 = 0;
+    for y : i32 = 0; y < 200; y += 1 {
+        for x : i32 = 0; x < 300; x += 1 {
+            cr : f64 = 0;
+            ci : f64 = 0;
+            for k : i32 = 0; k < x; k += 1 {
+                cr += 0.01;
+            }
+            for k : i32 = 0; k < y; k += 1 {
+                ci += 0.01;
+            }
+            if !escapes(cr - 2, ci - 1) {
+                inside += 1;
+            }
+        }
+    }
+    return inside;
+}
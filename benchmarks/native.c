@@ -0,0 +1,19 @@
+/**
+ * @file native.c
+ * Times the main function of a Solara object whose main symbol was renamed to solara_main.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+int solara_main(void);
+
+int main(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const int result = solara_main();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("main() returned %d (native, %g ms)\n", result, ms);
+    return 0;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file primes.sol
+ * Division-heavy: counts primes by trial division.
+ */
+
+pub module primes;
+
+pub fn is_prime(n : i32) : bool {
+    if n < 2 {
+        return n > 2;
+    }
+    for d : i32 = 2; d * d <= n; d += 1 {
+        if n % d == 0 {
+            return d > n;
+        }
+    }
+    return n > 1;
+}
+
+pub fn main() : i32 {
+    count : i32 = 0;
+    for n : i32 = 0; n < 300000; n += 1 {
+        if is_prime(n) {
+            count += 1;
+        }
+    }
+    return count;
+}
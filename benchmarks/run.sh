@@ -0,0 +1,24 @@
+#!/bin/sh
+# Runs every benchmark on the bytecode machine, with tiering, on the tree-walking evaluator, through the JIT
+# once more through the JIT with loop vectorization off, and, when a C compiler is found, as native code linked
+# against a small timing driver.
+# Exits with 1 if any run failed.
+# usage: benchmarks/run.sh [path/to/solara] [optimization level flag]
+
+SOLARA="${1:-build/solara}"
+LEVEL="${2:--O2}"
+DIR="$(dirname "$0")"
+TMP="${TMPDIR:-/tmp}/solara-bench.$$"
+STATUS=0
+
+for program in "$DIR"/*.sol; do
+    echo "$(basename "$program")"
+    "$SOLARA" -s "$program" "$LEVEL" --run --tiered --run-tree --jit -o "$TMP.o" > "$TMP.out" 2>&1 || STATUS=1
+    grep -E "main\(\)|error" "$TMP.out"
+    "$SOLARA" -s "$program" "$LEVEL" --no-vectorize --jit | grep -E "main\(\)" | sed "s/(jit,/(jit without vectorization,/"
+    if command -v cc >/dev/null && objcopy --redefine-sym main=solara_main "$TMP.o" "$TMP.r.o" 2>/dev/null; then
+        cc -O2 "$DIR/native.c" "$TMP.r.o" -o "$TMP.bin" && "$TMP.bin"
+    fi
+done
+rm -f "$TMP.o" "$TMP.r.o" "$TMP.bin" "$TMP.out"
+exit $STATUS
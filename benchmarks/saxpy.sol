@@ -0,0 +1,24 @@
+/**
+ * @file saxpy.sol
+ * Sums of a * x + y over generated integer vectors, a counted loop the optimizer vectorizes.
+ */
+
+pub module saxpy;
+
+fn saxpy(n : i32, a : i32, offset : i32) : i32 {
+    sum : i32 = 0;
+    for i : i32 = 0; i < n; i += 1 {
+        x : i32 = i * 3 + offset;
+        y : i32 = i - offset;
+        sum += a * x + y;
+    }
+    return sum;
+}
+
+pub fn main() : i32 {
+    total : i32 = 0;
+    for row : i32 = 0; row < 1000; row += 1 {
+        total += saxpy(20003, row, row * 5);
+    }
+    return total;
+}
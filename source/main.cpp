@@ -6,10 +6,13 @@
  */
 
 #include "solara/solara.h"
+#include "solara/server.h"
 
 int main(int argc, char* argv[]) {
     solara::CompilerSettings settings;
     solara::parse_settings(argc, argv, settings);
-    solara::init(settings);
-    return 0;
+    if (settings.client_) {
+        return solara::run_client(argc, argv, settings);
+    }
+    return solara::init(settings) ? 0 : 1;
 }
\ No newline at end of file
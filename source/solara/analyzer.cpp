@@ -0,0 +1,158 @@
+/**
+ * @file analyzer.cpp
+ */
+
+#include "analyzer.h"
+#include "resolver.h"
+#include "typechecker.h"
+#include "syntaxwalk.h"
+#include "evaluator.h"
+
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Per-thread analysis state, reused for every body the thread picks up.
+     */
+    struct AnalysisWorker {
+        Resolver resolver_;
+        TypeChecker checker_;
+
+        /** The checker's findings on a body, kept only if resolving it found no errors. */
+        DiagnosticList checker_diagnostics_;
+
+        AnalysisWorker(CompilerContext* ctx, const SymbolTable* module_scope)
+            : resolver_(ctx, nullptr, module_scope)
+            , checker_(ctx, nullptr)
+        {}
+    };
+
+    /** Collects the constants declared in a body, in source order. */
+    struct ConstantCollector {
+        std::vector<VarDeclNode*> constants_;
+
+        void leave(VarDeclNode* node) {
+            if (node->const_) {
+                constants_.push_back(node);
+            }
+        }
+    };
+
+    SemanticAnalyzer::SemanticAnalyzer(CompilerContext* ctx)
+        : module_resolver_(ctx, &diagnostics_)
+    {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    void SemanticAnalyzer::analyze(ModuleDeclNode* module) {
+        if (!module) {
+            return;
+        }
+        declare(module);
+        check_bodies(module);
+    }
+
+    void SemanticAnalyzer::declare(ModuleDeclNode* module) {
+        module_resolver_.declare_module(module);
+
+        TypeChecker module_checker(ctx_, &diagnostics_);
+        module_checker.check_signatures(module);
+    }
+
+    void SemanticAnalyzer::check_bodies(ModuleDeclNode* module) {
+        std::vector<FunctionDeclNode*> functions;
+        std::vector<VarDeclNode*> constants;
+        functions.reserve(module->decls_.size());
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                functions.push_back(function);
+            } else if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                constants.push_back(constant);
+            }
+        }
+
+        // module-level initializers are few and short, so they are analyzed here before the bodies
+        const u32 errors = diagnostics_.get_error_count();
+        for (VarDeclNode* constant : constants) {
+            module_resolver_.resolve_constant(constant);
+        }
+        if (diagnostics_.get_error_count() == errors) {
+            TypeChecker module_checker(ctx_, &diagnostics_);
+            for (VarDeclNode* constant : constants) {
+                module_checker.check_constant(constant);
+            }
+        }
+
+        // worker states are built up front; from here on the shared tables are only read
+        ThreadPool& pool = ctx_->thread_pool_;
+        std::vector<std::unique_ptr<AnalysisWorker>> workers;
+        workers.reserve(pool.get_thread_count());
+        for (u32 i = 0; i < pool.get_thread_count(); i++) {
+            workers.push_back(std::make_unique<AnalysisWorker>(ctx_, &module_resolver_.get_symbols()));
+        }
+
+        std::vector<DiagnosticList> function_diagnostics(functions.size());
+        pool.parallel_for(functions.size(), [&](const u64 index, const u32 worker) {
+            AnalysisWorker* state = workers[worker].get();
+            DiagnosticList* diagnostics = &function_diagnostics[index];
+
+            // one walk resolves and checks each body, the checker typing a node right after it is resolved
+            FunctionDeclNode* function = functions[index];
+            state->checker_diagnostics_.clear();
+            state->resolver_.set_diagnostics(diagnostics);
+            state->checker_.set_diagnostics(&state->checker_diagnostics_);
+            state->resolver_.begin_function(function);
+            state->checker_.begin_function(function);
+            if (function->body_) {
+                FusedSyntaxWalk<Resolver, TypeChecker> walk(state->resolver_, state->checker_);
+                walk.walk_children(function->body_);
+            }
+            state->checker_.end_function();
+            state->resolver_.end_function();
+            if (diagnostics->get_error_count() == 0) {
+                diagnostics->append(state->checker_diagnostics_);
+            }
+        });
+
+        for (const DiagnosticList& diagnostics : function_diagnostics) {
+            diagnostics_.append(diagnostics);
+        }
+    }
+
+    void SemanticAnalyzer::evaluate_constants(ModuleDeclNode* module) {
+        ConstantCollector collector;
+        FusedSyntaxWalk<ConstantCollector> walk(collector);
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                collector.constants_.push_back(constant);
+            } else if (auto function = syntax_node_cast<FunctionDeclNode>(decl); function && function->body_) {
+                walk.walk_children(function->body_);
+            }
+        }
+        if (collector.constants_.empty()) {
+            return;
+        }
+
+        // one evaluator for the module, so calls made by one constant are reused by the next
+        TreeEvaluator evaluator(ctx_);
+        evaluator.set_limits(ctx_->settings_.const_steps_, ctx_->settings_.const_memory_);
+        for (VarDeclNode* constant : collector.constants_) {
+            // a constant that failed while another one read it has already been reported with that one
+            if (!constant->evaluated_ && !constant->failed_ && !evaluator.evaluate_constant(constant)) {
+                std::ostringstream ss;
+                ss << "cannot evaluate constant '" << ctx_->string_table_.get_string(constant->name_id_)
+                   << "' while compiling: " << evaluator.get_error();
+                diagnostics_.report(ERROR, constant->span_, ss.str());
+            }
+        }
+    }
+
+    DiagnosticList& SemanticAnalyzer::get_diagnostics() {
+        return diagnostics_;
+    }
+
+} /* solara */
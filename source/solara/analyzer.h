@@ -0,0 +1,51 @@
+/**
+ * @file analyzer.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+#include "diagnostics.h"
+#include "resolver.h"
+
+namespace solara {
+
+    /**
+     * Runs the semantic phases over a parsed module.
+     * Module-level declarations are resolved and typed first on the calling thread. Function bodies are then
+     * independent of each other and are analyzed across the context's thread pool against a read-only view of
+     * the module scope. Each body writes to its own diagnostic list, and the lists are merged in declaration
+     * order, so the output is identical for any number of threads.
+     * The two halves can also run as separate steps: once a module is declared, its interface is complete and
+     * the bodies of the modules importing it can be checked, while its own bodies may still be pending.
+     * Module-level constants are typed with the signatures and their initializers are checked before the bodies.
+     */
+    class SemanticAnalyzer {
+    public:
+        SemanticAnalyzer(CompilerContext* ctx);
+
+        void analyze(ModuleDeclNode* module);
+
+        /** Declares the module scope and types every function signature. */
+        void declare(ModuleDeclNode* module);
+
+        /** Checks the function bodies of a declared module, whose imports must be declared too. */
+        void check_bodies(ModuleDeclNode* module);
+
+        /**
+         * Computes the value of every constant of a checked module, at module level and in bodies, reporting
+         * those that cannot be evaluated. The functions of its imports that the constants call must be checked,
+         * with their own constants evaluated and their interface declarations bound to their definitions.
+         */
+        void evaluate_constants(ModuleDeclNode* module);
+        DiagnosticList& get_diagnostics();
+
+    private:
+        CompilerContext* ctx_;
+        DiagnosticList diagnostics_;
+        Resolver module_resolver_;
+    };
+
+} /* solara */
@@ -3,75 +3,338 @@
  */
 
 #include "ast.h"
+#include "lexer.h"
 
 #include <iostream>
 
 namespace solara {
 
-    static void print_null_node(std::ostream& out, const u32 depth) {
-        for (u32 i = 0; i < depth; i++) {
-            out << "..";
+    /** Prints each child one level deeper. Lines end with '\n' rather than std::endl, so nothing is flushed per node. */
+    class SyntaxChildPrinter : public SyntaxChildVisitor {
+    public:
+        SyntaxChildPrinter(CompilerContext* ctx, std::ostream& out, const u32 depth)
+            : ctx_(ctx)
+            , out_(out)
+            , depth_(depth)
+        {}
+
+        virtual void visit(SyntaxNodeHandle child) override {
+            if (child) {
+                child->print(ctx_, out_, depth_);
+                return;
+            }
+            for (u32 i = 0; i < depth_; i++) {
+                out_ << "..";
+            }
+            out_ << "NULL\n";
+        }
+
+    private:
+        CompilerContext* ctx_;
+        std::ostream& out_;
+        u32 depth_;
+    };
+
+    const char* binary_operation_name(const BinaryOperation op) {
+        switch (op) {
+            case BinaryOperation::ADD: return "+";
+            case BinaryOperation::SUB: return "-";
+            case BinaryOperation::MUL: return "*";
+            case BinaryOperation::DIV: return "/";
+            case BinaryOperation::MOD: return "%";
+            case BinaryOperation::EQ: return "==";
+            case BinaryOperation::NEQ: return "!=";
+            case BinaryOperation::LT: return "<";
+            case BinaryOperation::GT: return ">";
+            case BinaryOperation::LE: return "<=";
+            case BinaryOperation::GE: return ">=";
+            case BinaryOperation::AND: return "&&";
+            case BinaryOperation::OR: return "||";
+            case BinaryOperation::ASSIGN: return "=";
+            case BinaryOperation::ADD_ASSIGN: return "+=";
+            case BinaryOperation::SUB_ASSIGN: return "-=";
+            case BinaryOperation::MUL_ASSIGN: return "*=";
+            case BinaryOperation::DIV_ASSIGN: return "/=";
+            case BinaryOperation::MOD_ASSIGN: return "%=";
+            default: return "?";
+        }
+    }
+
+    const char* unary_operation_name(const UnaryOperation op) {
+        switch (op) {
+            case UnaryOperation::INC: return "++";
+            case UnaryOperation::DEC: return "--";
+            case UnaryOperation::NEG: return "-";
+            case UnaryOperation::NOT: return "!";
+            default: return "?";
+        }
+    }
+
+    /** Keeps the node that follows the header as aligned as the resource's own allocations. */
+    struct SyntaxNodeHeader {
+        alignas(std::max_align_t) std::pmr::memory_resource* resource_;
+        u64 size_;
+    };
+
+    void* SyntaxNode::operator new(std::size_t size, std::pmr::memory_resource* resource) {
+        void* block = resource->allocate(sizeof(SyntaxNodeHeader) + size, alignof(SyntaxNodeHeader));
+        SyntaxNodeHeader* header = new (block) SyntaxNodeHeader{ resource, size };
+        return header + 1;
+    }
+
+    void* SyntaxNode::operator new(std::size_t size) {
+        return operator new(size, std::pmr::new_delete_resource());
+    }
+
+    void SyntaxNode::operator delete(void* node, std::pmr::memory_resource*) {
+        operator delete(node);
+    }
+
+    void SyntaxNode::operator delete(void* node) {
+        if (node == nullptr) {
+            return;
         }
-        out << "NULL" << std::endl;
+        SyntaxNodeHeader* header = static_cast<SyntaxNodeHeader*>(node) - 1;
+        header->resource_->deallocate(header, sizeof(SyntaxNodeHeader) + header->size_, alignof(SyntaxNodeHeader));
     }
 
-    void SyntaxNode::dump() {
-        dump(std::cout);
+    void SyntaxNode::dump(CompilerContext* ctx) {
+        dump(ctx, std::cout);
     }
 
-    void SyntaxNode::dump(std::ostream& out) {
-        print(out, 0);
+    void SyntaxNode::dump(CompilerContext* ctx, std::ostream& out) {
+        print(ctx, out, 0);
     }
 
-    void SyntaxNode::print(std::ostream& out, const u32 depth) {
+    void SyntaxNode::print(CompilerContext* ctx, std::ostream& out, const u32 depth) {
         for (u32 i = 0; i < depth; i++) {
             out << "..";
         }
         out << get_name();
-        print_spec(out, depth);
-        out << std::endl;
-        print_children(out, depth + 1);
+        print_spec(ctx, out, depth);
+        if (type_id_ != TypeTable::INVALID) {
+            out << " : " << ctx->type_table_.get_name(type_id_);
+        }
+        out << '\n';
+        SyntaxChildPrinter printer(ctx, out, depth + 1);
+        visit_children(printer);
     }
 
-    void SyntaxNode::print_spec(std::ostream& out, const u32 depth) {
+    void SyntaxNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
         out << "<>";
     }
 
-    void SyntaxNode::print_children(std::ostream& out, const u32 depth) {
+    void SyntaxNode::visit_children(SyntaxChildVisitor& visitor) {
         // stub
     }
 
-    void ModuleDeclNode::print_children(std::ostream& out, const u32 depth) {
-        // stub
+    ModuleDeclNode::~ModuleDeclNode() {
+        for (ImportDeclNode* import : imports_) {
+            delete import;
+        }
+        for (SyntaxNodeHandle decl : decls_) {
+            delete decl;
+        }
     }
 
-    void CompoundStmtNode::print_children(std::ostream& out, const u32 depth) {
-        // stub
+    void ModuleDeclNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << (pub_ ? "pub " : "") << ctx->string_table_.get_string(name_id_) << ">";
     }
 
-    void BinaryExprNode::print_children(std::ostream& out, const u32 depth) {
-        if (left_) {
-            left_->print(out, depth);
-        } else {
-            print_null_node(out, depth);
+    void ModuleDeclNode::visit_children(SyntaxChildVisitor& visitor) {
+        for (ImportDeclNode* import : imports_) {
+            visitor.visit(import);
         }
-        if (right_) {
-            right_->print(out, depth);
-        } else {
-            print_null_node(out, depth);
+        for (SyntaxNodeHandle decl : decls_) {
+            visitor.visit(decl);
+        }
+    }
+
+    void ImportDeclNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << ctx->string_table_.get_string(name_id_) << ">";
+    }
+
+    ParamDeclNode::~ParamDeclNode() {
+        delete type_;
+    }
+
+    void ParamDeclNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << ctx->string_table_.get_string(name_id_) << ">";
+    }
+
+    void ParamDeclNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(type_);
+    }
+
+    FunctionDeclNode::~FunctionDeclNode() {
+        for (ParamDeclNode* param : params_) {
+            delete param;
+        }
+        delete return_type_;
+        delete body_;
+    }
+
+    void FunctionDeclNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << (pub_ ? "pub " : "") << ctx->string_table_.get_string(name_id_) << ">";
+    }
+
+    void FunctionDeclNode::visit_children(SyntaxChildVisitor& visitor) {
+        for (ParamDeclNode* param : params_) {
+            visitor.visit(param);
+        }
+        if (return_type_) {
+            visitor.visit(return_type_);
+        }
+        if (body_) {
+            visitor.visit(body_);
+        }
+    }
+
+    VarDeclNode::~VarDeclNode() {
+        delete type_;
+        delete init_;
+    }
+
+    void VarDeclNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << (const_ ? "const " : "") << ctx->string_table_.get_string(name_id_) << ">";
+    }
+
+    void VarDeclNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(type_);
+        if (init_) {
+            visitor.visit(init_);
         }
     }
 
-    void UnaryExprNode::print_children(std::ostream& out, const u32 depth) {
+    CompoundStmtNode::~CompoundStmtNode() {
+        for (SyntaxNodeHandle stmt : stmts_) {
+            delete stmt;
+        }
+    }
+
+    void CompoundStmtNode::visit_children(SyntaxChildVisitor& visitor) {
+        for (SyntaxNodeHandle stmt : stmts_) {
+            visitor.visit(stmt);
+        }
+    }
+
+    ExprStmtNode::~ExprStmtNode() {
+        delete expr_;
+    }
+
+    void ExprStmtNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(expr_);
+    }
+
+    ReturnStmtNode::~ReturnStmtNode() {
+        delete expr_;
+    }
+
+    void ReturnStmtNode::visit_children(SyntaxChildVisitor& visitor) {
         if (expr_) {
-            expr_->print(out, depth);
+            visitor.visit(expr_);
+        }
+    }
+
+    IfStmtNode::~IfStmtNode() {
+        delete cond_;
+        delete then_;
+        delete else_;
+    }
+
+    void IfStmtNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(cond_);
+        visitor.visit(then_);
+        if (else_) {
+            visitor.visit(else_);
+        }
+    }
+
+    ForStmtNode::~ForStmtNode() {
+        delete init_;
+        delete cond_;
+        delete post_;
+        delete body_;
+    }
+
+    void ForStmtNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(init_);
+        visitor.visit(cond_);
+        visitor.visit(post_);
+        visitor.visit(body_);
+    }
+
+    BinaryExprNode::~BinaryExprNode() {
+        delete left_;
+        delete right_;
+    }
+
+    void BinaryExprNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << binary_operation_name(op_) << ">";
+    }
+
+    void BinaryExprNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(left_);
+        visitor.visit(right_);
+    }
+
+    UnaryExprNode::~UnaryExprNode() {
+        delete expr_;
+    }
+
+    void UnaryExprNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << unary_operation_name(op_) << ">";
+    }
+
+    void UnaryExprNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(expr_);
+    }
+
+    std::string_view LiteralExprNode::get_string_value() {
+        if (!has_escapes_) {
+            return text_;
+        }
+        if (!decoded_valid_) {
+            decoded_ = decode_string_escapes(text_);
+            decoded_valid_ = true;
+        }
+        return decoded_;
+    }
+
+    void LiteralExprNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << token_name(literal_type_) << " ";
+        if (literal_type_ == TokenType::LIT_STRING) {
+            out << '"' << text_ << '"';
         } else {
-            print_null_node(out, depth);
+            out << ctx->string_table_.get_string(literal_id_);
         }
+        out << ">";
     }
 
-    void LiteralExprNode::print_children(std::ostream& out, const u32 depth) {
-        // stub
+    void IdentifierExprNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<";
+        if (qualifier_id_ != NO_QUALIFIER) {
+            out << ctx->string_table_.get_string(qualifier_id_) << ".";
+        }
+        out << ctx->string_table_.get_string(name_id_) << ">";
+    }
+
+    CallExprNode::~CallExprNode() {
+        delete callee_;
+        for (SyntaxNodeHandle arg : args_) {
+            delete arg;
+        }
+    }
+
+    void CallExprNode::visit_children(SyntaxChildVisitor& visitor) {
+        visitor.visit(callee_);
+        for (SyntaxNodeHandle arg : args_) {
+            visitor.visit(arg);
+        }
+    }
+
+    void NamedTypeNode::print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) {
+        out << "<" << ctx->string_table_.get_string(name_id_) << ">";
     }
 
-} /* solara */
\ No newline at end of file
+} /* solara */
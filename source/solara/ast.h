@@ -6,16 +6,36 @@
 
 #include "common.h"
 #include "solara.h"
+#include "token.h"
+#include "types.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
 
 namespace solara {
 
     enum class SyntaxNodeType : u08 {
         None = 0,
         ModuleDecl,
+        ImportDecl,
+        FunctionDecl,
+        ParamDecl,
+        VarDecl,
         CompoundStmt,
+        ExprStmt,
+        ReturnStmt,
+        IfStmt,
+        ForStmt,
+        BreakStmt,
+        ContinueStmt,
         BinaryExpr,
         UnaryExpr,
-        LiteralExpr
+        LiteralExpr,
+        IdentifierExpr,
+        CallExpr,
+        NamedType
     };
 
     enum SyntaxNodeCategory {
@@ -29,62 +49,294 @@ namespace solara {
     class SyntaxNode;
     using SyntaxNodeHandle = SyntaxNode*;
 
+    /**
+     * Receives the children of a node in source order. A missing required child is passed as null, while a
+     * missing optional one is not passed at all.
+     */
+    class SyntaxChildVisitor {
+    public:
+        virtual ~SyntaxChildVisitor() = default;
+        virtual void visit(SyntaxNodeHandle child) = 0;
+    };
+
     /**
      * Base class of a node from the Abstract Syntax Tree.
      * Provides overridable functions that allow the creation of easily integrated node child classes.
+     * Nodes own their children and release them on destruction.
      */
     class SyntaxNode {
     public:
         virtual ~SyntaxNode() = default;
 
+        /**
+         * Nodes are placed in a memory resource, normally their parser's arena, which a small header in front
+         * of each node records so that deleting a node gives it back to the same resource. A plain new uses
+         * the heap.
+         */
+        static void* operator new(std::size_t size, std::pmr::memory_resource* resource);
+        static void* operator new(std::size_t size);
+        static void operator delete(void* node, std::pmr::memory_resource* resource);
+        static void operator delete(void* node);
+
         virtual SyntaxNodeType get_type() const = 0;
         virtual const char* get_name() const = 0;
         virtual u16 get_category_flags() const = 0;
 
-        void dump();
-        void dump(std::ostream& out);
-        void print(std::ostream& out, const u32 depth);
+        void dump(CompilerContext* ctx);
+        void dump(CompilerContext* ctx, std::ostream& out);
+        void print(CompilerContext* ctx, std::ostream& out, const u32 depth);
+
+        /** Writes the node's label, such as its name or operator, as it appears in dumps. */
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth);
+        virtual void visit_children(SyntaxChildVisitor& visitor);
+
+        TokenSourceSpan span_ = {};
+
+        /** The resolved type of the node, set by the type checker on expressions and declarations. */
+        TypeId type_id_ = TypeTable::INVALID;
 
     protected:
         SyntaxNode() {}
-
-        virtual void print_spec(std::ostream& out, const u32 depth);
-        virtual void print_children(std::ostream& out, const u32 depth);
     };
 
 #define GENERATE_NODE_BODY(type, category) \
     public: \
-        static SyntaxNodeType get_static_type() { return SyntaxNodeType::type; } \
+        static constexpr SyntaxNodeType get_static_type() { return SyntaxNodeType::type; } \
         virtual SyntaxNodeType get_type() const override { return get_static_type(); } \
         virtual const char* get_name() const override { return #type; } \
         virtual u16 get_category_flags() const override { return category; } \
     private: \
 
+    class ImportDeclNode;
+    class FunctionDeclNode;
+
     class ModuleDeclNode : public SyntaxNode {
         GENERATE_NODE_BODY(ModuleDecl, Declaration)
     public:
-        ModuleDeclNode() {}
+        ModuleDeclNode(u64 name_id, bool pub)
+            : name_id_(name_id)
+            , pub_(pub)
+        {}
+        virtual ~ModuleDeclNode() override;
+
+        u64 name_id_;
+        bool pub_;
+        std::vector<ImportDeclNode*> imports_;
+        std::vector<SyntaxNodeHandle> decls_;
+
+        /** Module-level functions by name, filled when the module scope is declared so importers can find them. */
+        std::unordered_map<u64, FunctionDeclNode*> functions_;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class ImportDeclNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ImportDecl, Declaration)
+    public:
+        ImportDeclNode(u64 name_id)
+            : name_id_(name_id)
+        {}
+
+        u64 name_id_;
+
+        /** The imported module, bound once the module graph has been built. Not owned. */
+        ModuleDeclNode* module_ = nullptr;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+    };
+
+    class ParamDeclNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ParamDecl, Declaration)
+    public:
+        ParamDeclNode(u64 name_id, SyntaxNodeHandle type)
+            : name_id_(name_id)
+            , type_(type)
+        {}
+        virtual ~ParamDeclNode() override;
+
+        u64 name_id_;
+        SyntaxNodeHandle type_;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class CompoundStmtNode;
+
+    class FunctionDeclNode : public SyntaxNode {
+        GENERATE_NODE_BODY(FunctionDecl, Declaration)
+    public:
+        FunctionDeclNode(u64 name_id, bool pub)
+            : name_id_(name_id)
+            , pub_(pub)
+        {}
+        virtual ~FunctionDeclNode() override;
+
+        u64 name_id_;
+        bool pub_;
+        std::vector<ParamDeclNode*> params_;
+        SyntaxNodeHandle return_type_ = nullptr;
+        CompoundStmtNode* body_ = nullptr;
+
+        /** Token buffer range of the body braces, kept so a deferred body can be parsed later. */
+        u64 body_begin_ = 0;
+        u64 body_end_ = 0;
+
+        /** For a declaration read from a module interface, the function it declares once that module is parsed. */
+        FunctionDeclNode* definition_ = nullptr;
 
     protected:
-        virtual void print_children(std::ostream& out, const u32 depth) override;
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class VarDeclNode : public SyntaxNode {
+        GENERATE_NODE_BODY(VarDecl, Declaration | Statement)
+    public:
+        VarDeclNode(u64 name_id, SyntaxNodeHandle type, SyntaxNodeHandle init)
+            : name_id_(name_id)
+            , type_(type)
+            , init_(init)
+        {}
+        virtual ~VarDeclNode() override;
+
+        u64 name_id_;
+        SyntaxNodeHandle type_;
+        SyntaxNodeHandle init_;
+
+        /** Set for a `const` declaration, whose initializer is evaluated once while compiling. */
+        bool const_ = false;
+
+        /** A constant's value in register form once evaluated, read by the kind of its type. */
+        bool evaluated_ = false;
+        i64 value_ = 0;
+
+        /** Set once a constant's evaluation fails, so the constants reading it fail without running it again. */
+        bool failed_ = false;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
     };
 
     class CompoundStmtNode : public SyntaxNode {
         GENERATE_NODE_BODY(CompoundStmt, Statement)
     public:
         CompoundStmtNode() {}
+        virtual ~CompoundStmtNode() override;
+
+        std::vector<SyntaxNodeHandle> stmts_;
 
     protected:
-        virtual void print_children(std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class ExprStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ExprStmt, Statement)
+    public:
+        ExprStmtNode(SyntaxNodeHandle expr)
+            : expr_(expr)
+        {}
+        virtual ~ExprStmtNode() override;
+
+        SyntaxNodeHandle expr_;
+
+    protected:
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class ReturnStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ReturnStmt, Statement)
+    public:
+        ReturnStmtNode(SyntaxNodeHandle expr)
+            : expr_(expr)
+        {}
+        virtual ~ReturnStmtNode() override;
+
+        SyntaxNodeHandle expr_;
+
+    protected:
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class IfStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(IfStmt, Statement)
+    public:
+        IfStmtNode(SyntaxNodeHandle cond, SyntaxNodeHandle then, SyntaxNodeHandle otherwise)
+            : cond_(cond)
+            , then_(then)
+            , else_(otherwise)
+        {}
+        virtual ~IfStmtNode() override;
+
+        SyntaxNodeHandle cond_;
+        SyntaxNodeHandle then_;
+        SyntaxNodeHandle else_;
+
+    protected:
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class ForStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ForStmt, Statement)
+    public:
+        ForStmtNode(SyntaxNodeHandle init, SyntaxNodeHandle cond, SyntaxNodeHandle post, SyntaxNodeHandle body)
+            : init_(init)
+            , cond_(cond)
+            , post_(post)
+            , body_(body)
+        {}
+        virtual ~ForStmtNode() override;
+
+        SyntaxNodeHandle init_;
+        SyntaxNodeHandle cond_;
+        SyntaxNodeHandle post_;
+        SyntaxNodeHandle body_;
+
+    protected:
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class BreakStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(BreakStmt, Statement)
+    public:
+        BreakStmtNode() {}
+    };
+
+    class ContinueStmtNode : public SyntaxNode {
+        GENERATE_NODE_BODY(ContinueStmt, Statement)
+    public:
+        ContinueStmtNode() {}
     };
 
     enum class BinaryOperation : u08 {
         ADD,
         SUB,
         MUL,
-        DIV
+        DIV,
+        MOD,
+        EQ,
+        NEQ,
+        LT,
+        GT,
+        LE,
+        GE,
+        AND,
+        OR,
+        ASSIGN,
+        ADD_ASSIGN,
+        SUB_ASSIGN,
+        MUL_ASSIGN,
+        DIV_ASSIGN,
+        MOD_ASSIGN
     };
 
+    const char* binary_operation_name(const BinaryOperation op);
+
     class BinaryExprNode : public SyntaxNode {
         GENERATE_NODE_BODY(BinaryExpr, Expression)
     public:
@@ -93,20 +345,26 @@ namespace solara {
             , left_(left)
             , right_(right)
         {}
+        virtual ~BinaryExprNode() override;
 
         BinaryOperation op_;
         SyntaxNodeHandle left_;
         SyntaxNodeHandle right_;
 
     protected:
-        virtual void print_children(std::ostream& out, const u32 depth) override;
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
     };
 
     enum class UnaryOperation : u08 {
         INC,
-        DEC
+        DEC,
+        NEG,
+        NOT
     };
 
+    const char* unary_operation_name(const UnaryOperation op);
+
     class UnaryExprNode : public SyntaxNode {
         GENERATE_NODE_BODY(UnaryExpr, Expression)
     public:
@@ -114,31 +372,116 @@ namespace solara {
             : op_(op)
             , expr_(expr)
         {}
+        virtual ~UnaryExprNode() override;
 
         UnaryOperation op_;
         SyntaxNodeHandle expr_;
 
     protected:
-        virtual void print_children(std::ostream& out, const u32 depth) override;
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
     };
 
     class LiteralExprNode : public SyntaxNode {
         GENERATE_NODE_BODY(LiteralExpr, Expression)
     public:
-        LiteralExprNode() {}
+        LiteralExprNode(TokenType literal_type, u64 literal_id)
+            : literal_type_(literal_type)
+            , literal_id_(literal_id)
+        {}
+
+        TokenType literal_type_;
+
+        /** String table entry of a number, or the lexer's literal index of a string. */
+        u64 literal_id_;
+
+        /** Raw text of a string literal between its quotes, a view into the source its lexer retains. */
+        std::string_view text_;
+        bool has_escapes_ = false;
+
+        /** @returns A string literal's value, with its escapes decoded on first use. */
+        std::string_view get_string_value();
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+
+    private:
+        std::string decoded_;
+        bool decoded_valid_ = false;
+    };
+
+    class IdentifierExprNode : public SyntaxNode {
+        GENERATE_NODE_BODY(IdentifierExpr, Expression)
+    public:
+        static constexpr u64 NO_QUALIFIER = ~0ull;
+
+        IdentifierExprNode(u64 name_id, u64 qualifier_id = NO_QUALIFIER)
+            : name_id_(name_id)
+            , qualifier_id_(qualifier_id)
+        {}
+
+        u64 name_id_;
+
+        /** Name of the imported module a qualified identifier such as 'math.sqrt' is looked up in. */
+        u64 qualifier_id_;
+
+        /** The declaration this identifier refers to, bound during symbol resolution. */
+        SyntaxNodeHandle decl_ = nullptr;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
+    };
+
+    class CallExprNode : public SyntaxNode {
+        GENERATE_NODE_BODY(CallExpr, Expression)
+    public:
+        CallExprNode(SyntaxNodeHandle callee)
+            : callee_(callee)
+        {}
+        virtual ~CallExprNode() override;
+
+        SyntaxNodeHandle callee_;
+        std::vector<SyntaxNodeHandle> args_;
 
     protected:
-        virtual void print_children(std::ostream& out, const u32 depth) override;
+        virtual void visit_children(SyntaxChildVisitor& visitor) override;
+    };
+
+    class NamedTypeNode : public SyntaxNode {
+        GENERATE_NODE_BODY(NamedType, Type)
+    public:
+        NamedTypeNode(u64 name_id)
+            : name_id_(name_id)
+        {}
+
+        u64 name_id_;
+
+    protected:
+        virtual void print_spec(CompilerContext* ctx, std::ostream& out, const u32 depth) override;
     };
 
     /**
-     * Makes a new heap-allocated Syntax Node with the specified kind and arguments.
+     * Makes a new Syntax Node with the specified kind and arguments.
+     * @param resource The memory resource the node is placed in.
      * @param args The template arguments forwarded to the constructor.
-     * @returns The handle to the new heap-allocated Syntax Node.
+     * @returns The handle to the new Syntax Node.
      */
     template<typename T, typename... Args>
-    T* make_syntax_node(Args&&... args) {
-        return new T{std::forward<Args>(args)...};
+    T* make_syntax_node(std::pmr::memory_resource* resource, Args&&... args) {
+        return new (resource) T{std::forward<Args>(args)...};
+    }
+
+    /**
+     * Casts a syntax node handle to the specified node kind.
+     * @param node The node to cast, may be null.
+     * @returns The node as the requested kind, or null if it is of a different kind.
+     */
+    template<typename T>
+    T* syntax_node_cast(SyntaxNodeHandle node) {
+        if (node && node->get_type() == T::get_static_type()) {
+            return static_cast<T*>(node);
+        }
+        return nullptr;
     }
 
-} /* solara */
\ No newline at end of file
+} /* solara */
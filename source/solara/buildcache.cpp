@@ -0,0 +1,311 @@
+/**
+ * @file buildcache.cpp
+ */
+
+#include "buildcache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * SHA-256, so distinct programs can be trusted to never share an object.
+     * @see FIPS 180-4
+     */
+    class Sha256 {
+    public:
+        Sha256() {
+            static constexpr u32 INITIAL[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+            };
+            std::memcpy(state_, INITIAL, sizeof(state_));
+        }
+
+        void update(const void* data, u64 size) {
+            const u08* bytes = static_cast<const u08*>(data);
+            length_ += size;
+            while (size > 0) {
+                const u64 count = std::min<u64>(size, 64 - buffered_);
+                std::memcpy(buffer_ + buffered_, bytes, count);
+                buffered_ += count;
+                bytes += count;
+                size -= count;
+                if (buffered_ == 64) {
+                    transform(buffer_);
+                    buffered_ = 0;
+                }
+            }
+        }
+
+        /** Adds a value prefixed by its length, so consecutive fields cannot run into each other. */
+        void update_field(const std::string_view value) {
+            const u64 size = value.size();
+            update(&size, sizeof(size));
+            update(value.data(), value.size());
+        }
+
+        std::string finish() {
+            const u64 bits = length_ * 8;
+            const u08 pad = 0x80;
+            update(&pad, 1);
+            const u08 zero = 0;
+            while (buffered_ != 56) {
+                update(&zero, 1);
+            }
+            u08 length[8];
+            for (u32 i = 0; i < 8; i++) {
+                length[i] = static_cast<u08>(bits >> (56 - 8 * i));
+            }
+            update(length, 8);
+
+            static constexpr char HEX[] = "0123456789abcdef";
+            std::string out;
+            for (const u32 word : state_) {
+                for (i32 shift = 28; shift >= 0; shift -= 4) {
+                    out += HEX[(word >> shift) & 0xF];
+                }
+            }
+            return out;
+        }
+
+    private:
+        static u32 rotate(const u32 x, const u32 n) {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        void transform(const u08* block) {
+            static constexpr u32 K[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+            };
+
+            u32 w[64];
+            for (u32 i = 0; i < 16; i++) {
+                w[i] = (u32(block[i * 4]) << 24) | (u32(block[i * 4 + 1]) << 16) | (u32(block[i * 4 + 2]) << 8) | u32(block[i * 4 + 3]);
+            }
+            for (u32 i = 16; i < 64; i++) {
+                const u32 s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                const u32 s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            u32 a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+            u32 e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+            for (u32 i = 0; i < 64; i++) {
+                const u32 t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                const u32 t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state_[0] += a;
+            state_[1] += b;
+            state_[2] += c;
+            state_[3] += d;
+            state_[4] += e;
+            state_[5] += f;
+            state_[6] += g;
+            state_[7] += h;
+        }
+
+        u32 state_[8];
+        u08 buffer_[64];
+        u64 buffered_ = 0;
+        u64 length_ = 0;
+    };
+
+    BuildCache::BuildCache(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        if (ctx->settings_.build_cache_) {
+            directory_ = ctx->settings_.build_cache_path_;
+        }
+        size_limit_ = ctx->settings_.build_cache_size_;
+    }
+
+    bool BuildCache::is_enabled() const {
+        return !directory_.empty();
+    }
+
+    /**
+     * The compiler build is identified by the size and modification time of its executable, so a rebuilt
+     * compiler never reuses objects of an older one.
+     */
+    std::string BuildCache::get_key(const ModuleGraph& graph) const {
+        Sha256 hash;
+        hash.update_field("solara object 1");
+
+        std::error_code error;
+        const std::filesystem::path executable = std::filesystem::read_symlink("/proc/self/exe", error);
+        if (!error) {
+            const u64 size = std::filesystem::file_size(executable, error);
+            const i64 mtime = static_cast<i64>(std::filesystem::last_write_time(executable, error).time_since_epoch().count());
+            hash.update(&size, sizeof(size));
+            hash.update(&mtime, sizeof(mtime));
+        }
+
+        const CompilerSettings& settings = ctx_->settings_;
+        const u32 options[] = { settings.opt_level_, settings.vectorize_, settings.lazy_bodies_ };
+        hash.update(options, sizeof(options));
+        // constant evaluation fails past its limits, so a program can compile under some limits and not others
+        const u64 limits[] = { settings.const_steps_, settings.const_memory_ };
+        hash.update(limits, sizeof(limits));
+
+        for (const ModuleGraphNode& node : graph.get_modules()) {
+            std::ifstream file(node.path_, std::ios::binary);
+            if (!file.is_open()) {
+                return "";
+            }
+            const std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            hash.update_field(node.name_);
+            hash.update_field(source);
+        }
+        return hash.finish();
+    }
+
+    bool BuildCache::fetch(const std::string& key, const std::filesystem::path& output) {
+        const std::filesystem::path path = get_object_path(key);
+        std::error_code error;
+        std::filesystem::copy_file(path, output, std::filesystem::copy_options::overwrite_existing, error);
+        if (error) {
+            return false;
+        }
+        // an object evicted by another process right after the copy is only a lost refresh
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return true;
+    }
+
+    void BuildCache::store(const std::string& key, const std::filesystem::path& output) {
+        const std::filesystem::path path = get_object_path(key);
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        std::filesystem::path temporary = path;
+        temporary += ".tmp" + std::to_string(std::random_device()());
+        std::filesystem::copy_file(output, temporary, std::filesystem::copy_options::overwrite_existing, error);
+        if (!error) {
+            std::filesystem::rename(temporary, path, error);
+        }
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            ctx_->logger_.log(WARNING, "could not store '" + output.string() + "' in the build cache");
+            return;
+        }
+
+        // the objects are only scanned once the recorded size passes the limit, or when none is recorded yet
+        u64 size = 0;
+        const u64 added = std::filesystem::file_size(path, error);
+        if (!read_recorded_size(size) || size + added > size_limit_) {
+            evict();
+        } else {
+            write_recorded_size(size + added);
+        }
+    }
+
+    std::filesystem::path BuildCache::get_object_path(const std::string& key) const {
+        return directory_ / key.substr(0, 2) / (key.substr(2) + ".o");
+    }
+
+    bool BuildCache::read_recorded_size(u64& out) const {
+        std::ifstream file(directory_ / "size");
+        return static_cast<bool>(file >> out);
+    }
+
+    /** Replaces the recorded size with a rename, so a reader never sees it half written. */
+    void BuildCache::write_recorded_size(const u64 size) const {
+        std::filesystem::path temporary = directory_ / "size";
+        temporary += ".tmp" + std::to_string(std::random_device()());
+        std::error_code error;
+        {
+            std::ofstream file(temporary);
+            file << size;
+            if (!file) {
+                error = std::make_error_code(std::errc::io_error);
+            }
+        }
+        if (!error) {
+            std::filesystem::rename(temporary, directory_ / "size", error);
+        }
+        if (error) {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+
+    /**
+     * Scans the objects and removes the least recently used ones until the store is back to three quarters
+     * of its limit, so eviction does not run again on every store. The size left is recorded for later stores.
+     */
+    void BuildCache::evict() {
+        struct Object {
+            std::filesystem::path path_;
+            std::filesystem::file_time_type mtime_;
+            u64 size_;
+        };
+
+        std::error_code error;
+        std::vector<Object> objects;
+        u64 total = 0;
+        for (auto it = std::filesystem::recursive_directory_iterator(directory_, error);
+             !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            std::error_code entry_error;
+            if (!it->is_regular_file(entry_error) || it->path().extension() != ".o") {
+                continue;
+            }
+            Object object = { it->path(), it->last_write_time(entry_error), it->file_size(entry_error) };
+            if (!entry_error) {
+                total += object.size_;
+                objects.push_back(std::move(object));
+            }
+        }
+        if (total <= size_limit_) {
+            write_recorded_size(total);
+            return;
+        }
+
+        std::sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) {
+            return a.mtime_ < b.mtime_;
+        });
+        u64 evicted = 0;
+        for (const Object& object : objects) {
+            if (total <= size_limit_ / 4 * 3) {
+                break;
+            }
+            if (std::filesystem::remove(object.path_, error)) {
+                total -= object.size_;
+                evicted++;
+            }
+        }
+        write_recorded_size(total);
+        ctx_->logger_.log(INFO, "Evicted " + std::to_string(evicted) + " objects from the build cache.");
+    }
+
+    std::string get_default_build_cache_path() {
+        if (const char* path = std::getenv("SOLARA_CACHE_DIR")) {
+            return path;
+        }
+        if (const char* path = std::getenv("XDG_CACHE_HOME")) {
+            return (std::filesystem::path(path) / "solara").string();
+        }
+        if (const char* path = std::getenv("HOME")) {
+            return (std::filesystem::path(path) / ".cache" / "solara").string();
+        }
+        return "";
+    }
+
+} /* solara */
@@ -0,0 +1,55 @@
+/**
+ * @file buildcache.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "modulegraph.h"
+
+#include <filesystem>
+#include <string>
+
+namespace solara {
+
+    /**
+     * Local content-addressed store of object files shared by every compiler process of the user. An object
+     * is keyed by a hash of the bytes of every source file of its module graph, the compiler build and the
+     * settings that affect code generation or whether constants evaluate, so an unchanged program is never
+     * compiled twice. Objects are placed with an atomic rename and never modified afterwards, so concurrent
+     * processes can share the store. Each hit refreshes the modification time of its object, and the least
+     * recently used objects are evicted once the store grows past its size limit. The store's size is recorded
+     * beside the objects, approximately when processes store at once, so only a store crossing the limit scans them.
+     */
+    class BuildCache {
+    public:
+        BuildCache(CompilerContext* ctx);
+
+        bool is_enabled() const;
+
+        /** @returns The key of the program rooted at the graph's last module, or an empty string if a source could not be read. */
+        std::string get_key(const ModuleGraph& graph) const;
+
+        /** Copies the object stored under a key to the output path. @returns False on a miss. */
+        bool fetch(const std::string& key, const std::filesystem::path& output);
+
+        /** Stores a copy of a freshly written object under a key, evicting old objects if needed. */
+        void store(const std::string& key, const std::filesystem::path& output);
+
+    protected:
+        std::filesystem::path get_object_path(const std::string& key) const;
+        bool read_recorded_size(u64& out) const;
+        void write_recorded_size(const u64 size) const;
+        void evict();
+
+    private:
+        CompilerContext* ctx_;
+        std::filesystem::path directory_;
+        u64 size_limit_ = 0;
+    };
+
+    /** Store used when no --build-cache directory is given: under $SOLARA_CACHE_DIR, $XDG_CACHE_HOME or ~/.cache. */
+    std::string get_default_build_cache_path();
+
+} /* solara */
@@ -0,0 +1,397 @@
+/**
+ * @file bytecode.cpp
+ */
+
+#include "bytecode.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace solara {
+
+    const char* bytecode_op_name(const BcOp op) {
+        static const char* const names[] = {
+#define SOLARA_BYTECODE_NAME(name) #name,
+            SOLARA_BYTECODE_OPS(SOLARA_BYTECODE_NAME)
+#undef SOLARA_BYTECODE_NAME
+        };
+        const u32 index = static_cast<u32>(op);
+        return index < static_cast<u32>(BcOp::Count) ? names[index] : "?";
+    }
+
+    static constexpr u32 NO_REGISTER = ~0u;
+
+    BytecodeCompiler::BytecodeCompiler(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    bool BytecodeCompiler::compile(const IrModule& module, BcModule& out) {
+        out.functions_.clear();
+        out.functions_.resize(module.functions_.size());
+
+        bool ok = true;
+        for (u64 i = 0; i < module.functions_.size(); i++) {
+            if (!compile_function(module, module.functions_[i], out.functions_[i])) {
+                ctx_->logger_.log(
+                    ERROR,
+                    "error: function '" + std::string(ctx_->string_table_.get_string(module.functions_[i].name_id_))
+                        + "' is too large for the bytecode register file"
+                );
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool BytecodeCompiler::compile_function(const IrModule& module, const IrFunction& function, BcFunction& out) {
+        out.name_id_ = function.name_id_;
+        out.param_count_ = static_cast<u32>(ctx_->type_table_.get_params(function.type_).size());
+        out.defined_ = !function.blocks_.empty();
+        out.code_.clear();
+        out.constants_.clear();
+        if (!out.defined_) {
+            return true;
+        }
+        if (module.functions_.size() > MAX_REGISTERS) {
+            // callee indices share the 16-bit operand fields with registers
+            return false;
+        }
+
+        // parameters own the first registers so the caller can place the arguments without knowing the callee
+        const u32 count = static_cast<u32>(function.insts_.size());
+        registers_.assign(count, NO_REGISTER);
+        u32 next = out.param_count_;
+        u32 max_args = 0;
+        for (ValueId id = 0; id < count; id++) {
+            const Instruction& inst = function.insts_[id];
+            if (inst.op_ == Opcode::Param) {
+                registers_[id] = inst.imm_.index_;
+            } else if (inst.op_ != Opcode::Nop && !opcode_is_terminator(inst.op_) && inst.type_ != TypeTable::INVALID) {
+                registers_[id] = next++;
+            }
+            if (inst.op_ == Opcode::Call) {
+                max_args = std::max<u32>(max_args, inst.operand_count_);
+            }
+        }
+        scratch_ = next++;
+        const u32 arg_base = next;
+        out.frame_size_ = next + max_args;
+        if (out.frame_size_ > MAX_REGISTERS) {
+            return false;
+        }
+
+        function_ = &out;
+        fixups_.clear();
+        constant_indices_.clear();
+        std::vector<u32> block_offsets(function.blocks_.size(), 0);
+        const TypeTable& types = ctx_->type_table_;
+
+        for (BlockId b = 0; b < function.blocks_.size(); b++) {
+            const IrBlock& block = function.blocks_[b];
+            block_offsets[b] = static_cast<u32>(out.code_.size());
+
+            for (ValueId id = block.begin_; id < block.end_; id++) {
+                const Instruction& inst = function.insts_[id];
+                const auto operands = function.get_operands(id);
+                const u16 dst = static_cast<u16>(registers_[id]);
+
+                switch (inst.op_) {
+                    case Opcode::Const: {
+                        const TypeInfo& info = types.get_info(inst.type_);
+                        VmValue value;
+                        value.int_ = 0;
+                        if (info.kind == TypeKind::Float) {
+                            if (info.bits == 32) {
+                                value.float32_ = static_cast<f32>(inst.imm_.float_);
+                            } else {
+                                value.float_ = inst.imm_.float_;
+                            }
+                        } else if (info.kind == TypeKind::Int && info.bits < 64) {
+                            // registers hold narrow integers canonically extended to 64 bits
+                            const u32 shift = 64 - info.bits;
+                            const u64 bits = static_cast<u64>(inst.imm_.int_) << shift;
+                            value.int_ = info.is_signed ? static_cast<i64>(bits) >> shift : static_cast<i64>(bits >> shift);
+                        } else {
+                            value.int_ = inst.imm_.int_;
+                        }
+                        const u32 k = add_constant(value);
+                        emit(BcOp::LOADK, dst, static_cast<u16>(k), static_cast<u16>(k >> 16));
+                        break;
+                    }
+                    case Opcode::Call: {
+                        for (u32 i = 0; i < operands.size(); i++) {
+                            emit(BcOp::MOV, static_cast<u16>(arg_base + i), static_cast<u16>(registers_[operands[i]]));
+                        }
+                        const u16 result = registers_[id] != NO_REGISTER ? dst : static_cast<u16>(scratch_);
+                        emit(BcOp::CALL, result, static_cast<u16>(inst.imm_.index_), static_cast<u16>(arg_base));
+                        break;
+                    }
+                    case Opcode::Neg:
+                    case Opcode::Not:
+                        emit_unary(function, id);
+                        break;
+                    case Opcode::Br:
+                        emit_edge_copies(function, b, inst.imm_.targets_[0]);
+                        if (inst.imm_.targets_[0] != b + 1) {
+                            emit_jump(BcOp::JMP, 0, inst.imm_.targets_[0]);
+                        }
+                        break;
+                    case Opcode::CondBr: {
+                        const u16 cond = static_cast<u16>(registers_[operands[0]]);
+                        const BlockId then = inst.imm_.targets_[0];
+                        const BlockId otherwise = inst.imm_.targets_[1];
+                        auto has_phis = [&](const BlockId target) {
+                            const IrBlock& t = function.blocks_[target];
+                            return t.begin_ < t.end_ && function.insts_[t.begin_].op_ == Opcode::Phi;
+                        };
+
+                        if (!has_phis(then) && !has_phis(otherwise)) {
+                            if (otherwise == b + 1) {
+                                emit_jump(BcOp::JMPT, cond, then);
+                            } else {
+                                emit_jump(BcOp::JMPF, cond, otherwise);
+                                if (then != b + 1) {
+                                    emit_jump(BcOp::JMP, 0, then);
+                                }
+                            }
+                            break;
+                        }
+
+                        // copies for each edge live in their own stub, the false stub follows the true one
+                        const u32 branch = static_cast<u32>(out.code_.size());
+                        emit(BcOp::JMPF, cond);
+                        emit_edge_copies(function, b, then);
+                        emit_jump(BcOp::JMP, 0, then);
+                        out.code_[branch].set_wide(static_cast<u32>(out.code_.size()));
+                        emit_edge_copies(function, b, otherwise);
+                        if (otherwise != b + 1) {
+                            emit_jump(BcOp::JMP, 0, otherwise);
+                        }
+                        break;
+                    }
+                    case Opcode::Ret:
+                        if (operands.empty()) {
+                            emit(BcOp::RETV);
+                        } else {
+                            emit(BcOp::RET, static_cast<u16>(registers_[operands[0]]));
+                        }
+                        break;
+                    default:
+                        if (opcode_is_binary(inst.op_)) {
+                            emit_binary(function, id);
+                        }
+                        break;
+                }
+            }
+        }
+
+        for (const auto& [index, target] : fixups_) {
+            out.code_[index].set_wide(block_offsets[target]);
+        }
+        function_ = nullptr;
+        return true;
+    }
+
+    void BytecodeCompiler::emit_binary(const IrFunction& function, const ValueId value) {
+        const Instruction& inst = function.insts_[value];
+        const auto operands = function.get_operands(value);
+        const u16 dst = static_cast<u16>(registers_[value]);
+        const u16 lhs = static_cast<u16>(registers_[operands[0]]);
+        const u16 rhs = static_cast<u16>(registers_[operands[1]]);
+        const TypeInfo& info = ctx_->type_table_.get_info(function.insts_[operands[0]].type_);
+        const u32 index = static_cast<u32>(inst.op_) - static_cast<u32>(Opcode::Add);
+
+        if (info.kind == TypeKind::Float) {
+            // Add Sub Mul Div Rem Eq Ne Lt Gt Le Ge, remainder of floats is rejected by the type checker
+            static const BcOp f32_ops[] = {
+                BcOp::ADD_F32, BcOp::SUB_F32, BcOp::MUL_F32, BcOp::DIV_F32, BcOp::DIV_F32,
+                BcOp::EQ_F32, BcOp::NE_F32, BcOp::LT_F32, BcOp::GT_F32, BcOp::LE_F32, BcOp::GE_F32
+            };
+            static const BcOp f64_ops[] = {
+                BcOp::ADD_F64, BcOp::SUB_F64, BcOp::MUL_F64, BcOp::DIV_F64, BcOp::DIV_F64,
+                BcOp::EQ_F64, BcOp::NE_F64, BcOp::LT_F64, BcOp::GT_F64, BcOp::LE_F64, BcOp::GE_F64
+            };
+            emit(info.bits == 32 ? f32_ops[index] : f64_ops[index], dst, lhs, rhs);
+            return;
+        }
+
+        const bool wide_unsigned = info.kind == TypeKind::Int && info.bits == 64 && !info.is_signed;
+        if (inst.op_ >= Opcode::Eq) {
+            static const BcOp signed_ops[] = { BcOp::EQ_I, BcOp::NE_I, BcOp::LT_S, BcOp::GT_S, BcOp::LE_S, BcOp::GE_S };
+            static const BcOp unsigned_ops[] = { BcOp::EQ_I, BcOp::NE_I, BcOp::LT_U, BcOp::GT_U, BcOp::LE_U, BcOp::GE_U };
+            const u32 compare = static_cast<u32>(inst.op_) - static_cast<u32>(Opcode::Eq);
+            emit(wide_unsigned ? unsigned_ops[compare] : signed_ops[compare], dst, lhs, rhs);
+            return;
+        }
+
+        if (info.bits == 32 && info.is_signed) {
+            static const BcOp i32_ops[] = { BcOp::ADD_I32, BcOp::SUB_I32, BcOp::MUL_I32, BcOp::DIV_I32, BcOp::REM_I32 };
+            emit(i32_ops[index], dst, lhs, rhs);
+            return;
+        }
+
+        static const BcOp i64_ops[] = { BcOp::ADD_I64, BcOp::SUB_I64, BcOp::MUL_I64, BcOp::DIV_S64, BcOp::REM_S64 };
+        BcOp op = i64_ops[index];
+        if (wide_unsigned && inst.op_ == Opcode::Div) {
+            op = BcOp::DIV_U64;
+        } else if (wide_unsigned && inst.op_ == Opcode::Rem) {
+            op = BcOp::REM_U64;
+        }
+        emit(op, dst, lhs, rhs);
+        if (info.bits < 64) {
+            emit(info.is_signed ? BcOp::SEXT : BcOp::ZEXT, dst, static_cast<u16>(info.bits));
+        }
+    }
+
+    void BytecodeCompiler::emit_unary(const IrFunction& function, const ValueId value) {
+        const Instruction& inst = function.insts_[value];
+        const u16 dst = static_cast<u16>(registers_[value]);
+        const u16 src = static_cast<u16>(registers_[function.get_operands(value)[0]]);
+        if (inst.op_ == Opcode::Not) {
+            emit(BcOp::NOT, dst, src);
+            return;
+        }
+
+        const TypeInfo& info = ctx_->type_table_.get_info(inst.type_);
+        if (info.kind == TypeKind::Float) {
+            emit(info.bits == 32 ? BcOp::NEG_F32 : BcOp::NEG_F64, dst, src);
+        } else if (info.bits == 32 && info.is_signed) {
+            emit(BcOp::NEG_I32, dst, src);
+        } else {
+            emit(BcOp::NEG_I64, dst, src);
+            if (info.bits < 64) {
+                emit(info.is_signed ? BcOp::SEXT : BcOp::ZEXT, dst, static_cast<u16>(info.bits));
+            }
+        }
+    }
+
+    /**
+     * Emits the phi copies of one edge. The copies happen in parallel, so they are ordered to never overwrite a
+     * source that is still needed, and a cycle is broken through the scratch register.
+     */
+    void BytecodeCompiler::emit_edge_copies(const IrFunction& function, const BlockId from, const BlockId to) {
+        const IrBlock& target = function.blocks_[to];
+        u32 pred_index = 0;
+        while (pred_index < target.preds_.size() && target.preds_[pred_index] != from) {
+            pred_index++;
+        }
+
+        std::vector<std::pair<u32, u32>> copies;
+        for (ValueId phi = target.begin_; phi < target.end_ && function.insts_[phi].op_ == Opcode::Phi; phi++) {
+            const u32 dst = registers_[phi];
+            const u32 src = registers_[function.get_operands(phi)[pred_index]];
+            if (dst != src && src != NO_REGISTER) {
+                copies.emplace_back(dst, src);
+            }
+        }
+
+        while (!copies.empty()) {
+            bool progress = false;
+            for (u64 i = 0; i < copies.size(); i++) {
+                const u32 dst = copies[i].first;
+                bool blocked = false;
+                for (u64 j = 0; j < copies.size() && !blocked; j++) {
+                    blocked = j != i && copies[j].second == dst;
+                }
+                if (!blocked) {
+                    emit(BcOp::MOV, static_cast<u16>(dst), static_cast<u16>(copies[i].second));
+                    copies.erase(copies.begin() + i);
+                    progress = true;
+                    break;
+                }
+            }
+            if (!progress) {
+                // every destination is still read by another copy: park one source and redirect its readers
+                const u32 parked = copies[0].second;
+                emit(BcOp::MOV, static_cast<u16>(scratch_), static_cast<u16>(parked));
+                for (auto& copy : copies) {
+                    if (copy.second == parked) {
+                        copy.second = scratch_;
+                    }
+                }
+            }
+        }
+    }
+
+    void BytecodeCompiler::emit_jump(const BcOp op, const u16 a, const BlockId target) {
+        fixups_.emplace_back(static_cast<u32>(function_->code_.size()), target);
+        emit(op, a);
+    }
+
+    void BytecodeCompiler::emit(const BcOp op, const u16 a, const u16 b, const u16 c) {
+        BcInst inst;
+        inst.op_ = op;
+        inst.a_ = a;
+        inst.b_ = b;
+        inst.c_ = c;
+        function_->code_.push_back(inst);
+    }
+
+    u32 BytecodeCompiler::add_constant(const VmValue value) {
+        std::vector<VmValue>& constants = function_->constants_;
+        auto [it, inserted] = constant_indices_.emplace(value.int_, static_cast<u32>(constants.size()));
+        if (inserted) {
+            constants.push_back(value);
+        }
+        return it->second;
+    }
+
+    void dump_bytecode(CompilerContext* ctx, const BcModule& module, std::ostream& out) {
+        for (u64 f = 0; f < module.functions_.size(); f++) {
+            const BcFunction& function = module.functions_[f];
+            out << "fn " << ctx->string_table_.get_string(function.name_id_) << " (params " << function.param_count_
+                << ", frame " << function.frame_size_ << ")";
+            if (!function.defined_) {
+                out << ";\n";
+                continue;
+            }
+            out << "\n";
+
+            for (u64 i = 0; i < function.code_.size(); i++) {
+                const BcInst& inst = function.code_[i];
+                out << "  " << std::setw(5) << std::setfill('0') << i << std::setfill(' ') << "  "
+                    << std::left << std::setw(8) << bytecode_op_name(inst.op_) << std::right;
+                switch (inst.op_) {
+                    case BcOp::LOADK:
+                        out << " r" << inst.a_ << ", k" << inst.get_wide() << " (" << function.constants_[inst.get_wide()].int_ << ")";
+                        break;
+                    case BcOp::JMP:
+                        out << " " << inst.get_wide();
+                        break;
+                    case BcOp::JMPF:
+                    case BcOp::JMPT:
+                        out << " r" << inst.a_ << ", " << inst.get_wide();
+                        break;
+                    case BcOp::CALL:
+                        out << " r" << inst.a_ << ", @" << ctx->string_table_.get_string(module.functions_[inst.b_].name_id_)
+                            << ", r" << inst.c_;
+                        break;
+                    case BcOp::SEXT:
+                    case BcOp::ZEXT:
+                        out << " r" << inst.a_ << ", " << inst.b_;
+                        break;
+                    case BcOp::RET:
+                        out << " r" << inst.a_;
+                        break;
+                    case BcOp::RETV:
+                        break;
+                    case BcOp::MOV:
+                    case BcOp::NOT:
+                    case BcOp::NEG_I32:
+                    case BcOp::NEG_I64:
+                    case BcOp::NEG_F32:
+                    case BcOp::NEG_F64:
+                        out << " r" << inst.a_ << ", r" << inst.b_;
+                        break;
+                    default:
+                        out << " r" << inst.a_ << ", r" << inst.b_ << ", r" << inst.c_;
+                        break;
+                }
+                out << "\n";
+            }
+        }
+        out.flush();
+    }
+
+} /* solara */
@@ -0,0 +1,166 @@
+/**
+ * @file bytecode.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Every bytecode operation, with its operand layout.
+     * Integer registers hold values sign- or zero-extended to 64 bits according to their static type, so
+     * comparisons and divisions of narrow types can use the 64-bit forms and only arithmetic needs a width.
+     */
+#define SOLARA_BYTECODE_OPS(X) \
+    X(MOV)        /* a = b */ \
+    X(LOADK)      /* a = constants[b | c << 16] */ \
+    X(ADD_I32)    /* a = wrap32(b + c) */ \
+    X(SUB_I32) \
+    X(MUL_I32) \
+    X(DIV_I32) \
+    X(REM_I32) \
+    X(ADD_I64) \
+    X(SUB_I64) \
+    X(MUL_I64) \
+    X(DIV_S64) \
+    X(REM_S64) \
+    X(DIV_U64) \
+    X(REM_U64) \
+    X(NEG_I32)    /* a = wrap32(-b) */ \
+    X(NEG_I64) \
+    X(SEXT)       /* a = sign-extend the low b bits of a */ \
+    X(ZEXT)       /* a = zero-extend the low b bits of a */ \
+    X(NOT)        /* a = !b */ \
+    X(EQ_I) \
+    X(NE_I) \
+    X(LT_S) \
+    X(LE_S) \
+    X(GT_S) \
+    X(GE_S) \
+    X(LT_U) \
+    X(LE_U) \
+    X(GT_U) \
+    X(GE_U) \
+    X(ADD_F32) \
+    X(SUB_F32) \
+    X(MUL_F32) \
+    X(DIV_F32) \
+    X(NEG_F32) \
+    X(EQ_F32) \
+    X(NE_F32) \
+    X(LT_F32) \
+    X(LE_F32) \
+    X(GT_F32) \
+    X(GE_F32) \
+    X(ADD_F64) \
+    X(SUB_F64) \
+    X(MUL_F64) \
+    X(DIV_F64) \
+    X(NEG_F64) \
+    X(EQ_F64) \
+    X(NE_F64) \
+    X(LT_F64) \
+    X(LE_F64) \
+    X(GT_F64) \
+    X(GE_F64) \
+    X(JMP)        /* pc = b | c << 16 */ \
+    X(JMPF)       /* if !a: pc = b | c << 16 */ \
+    X(JMPT)       /* if a: pc = b | c << 16 */ \
+    X(CALL)       /* a = functions[b](registers from c on), the callee frame starts at register c */ \
+    X(RET)        /* return a */ \
+    X(RETV)       /* return nothing */
+
+    enum class BcOp : u08 {
+#define SOLARA_BYTECODE_ENUM(name) name,
+        SOLARA_BYTECODE_OPS(SOLARA_BYTECODE_ENUM)
+#undef SOLARA_BYTECODE_ENUM
+        Count
+    };
+
+    const char* bytecode_op_name(const BcOp op);
+
+    struct BcInst {
+        BcOp op_;
+        u08 reserved_ = 0;
+        u16 a_ = 0;
+        u16 b_ = 0;
+        u16 c_ = 0;
+
+        u32 get_wide() const { return static_cast<u32>(b_) | static_cast<u32>(c_) << 16; }
+        void set_wide(const u32 value) { b_ = static_cast<u16>(value); c_ = static_cast<u16>(value >> 16); }
+    };
+
+    static_assert(sizeof(BcInst) == 8, "bytecode instructions are meant to be one word");
+
+    /**
+     * An untagged register value; the static type of the register decides which member is live.
+     */
+    union VmValue {
+        i64 int_;
+        f64 float_;
+        f32 float32_;
+    };
+
+    struct BcFunction {
+        u64 name_id_ = 0;
+        u32 param_count_ = 0;
+
+        /** Registers of one frame, including the scratch register and the outgoing argument area. */
+        u32 frame_size_ = 0;
+        bool defined_ = false;
+        std::vector<BcInst> code_;
+        std::vector<VmValue> constants_;
+    };
+
+    struct BcModule {
+        std::vector<BcFunction> functions_;
+    };
+
+    /**
+     * Translates linearized SSA functions to bytecode.
+     * Every value gets its own register, parameters first, so a call only has to place the arguments at the
+     * start of the callee's frame. Phis become copies on the incoming edges, with conditional edges into
+     * blocks with phis split into small stubs.
+     */
+    class BytecodeCompiler {
+    public:
+        static constexpr u32 MAX_REGISTERS = 0xFFFF;
+
+        BytecodeCompiler(CompilerContext* ctx);
+
+        /**
+         * @returns False if a function needs more registers than an instruction can address.
+         */
+        bool compile(const IrModule& module, BcModule& out);
+
+    protected:
+        bool compile_function(const IrModule& module, const IrFunction& function, BcFunction& out);
+        void emit_binary(const IrFunction& function, const ValueId value);
+        void emit_unary(const IrFunction& function, const ValueId value);
+        void emit_edge_copies(const IrFunction& function, const BlockId from, const BlockId to);
+        void emit_jump(const BcOp op, const u16 a, const BlockId target);
+        void emit(const BcOp op, const u16 a = 0, const u16 b = 0, const u16 c = 0);
+        u32 add_constant(const VmValue value);
+
+    private:
+        CompilerContext* ctx_;
+        BcFunction* function_ = nullptr;
+        std::vector<u32> registers_;
+        u32 scratch_ = 0;
+        std::vector<std::pair<u32, BlockId>> fixups_;
+
+        /** Constants are deduplicated by their bit pattern. */
+        std::unordered_map<i64, u32> constant_indices_;
+    };
+
+    void dump_bytecode(CompilerContext* ctx, const BcModule& module, std::ostream& out);
+
+} /* solara */
@@ -0,0 +1,874 @@
+/**
+ * @file codegen.cpp
+ */
+
+#include "codegen.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace solara {
+
+    using namespace x86;
+
+    static const Gpr INT_ARGS[NativeCodeGenerator::MAX_INT_PARAMS] = { RDI, RSI, RDX, RCX, R8, R9 };
+
+    static bool same_location(const Operand& a, const bool a_float, const Operand& b, const bool b_float) {
+        if (a.kind_ != b.kind_) {
+            return false;
+        }
+        if (a.kind_ == Operand::Kind::Register) {
+            return a.reg_ == b.reg_ && a_float == b_float;
+        }
+        return a.reg_ == b.reg_ && a.disp_ == b.disp_;
+    }
+
+    NativeCodeGenerator::NativeCodeGenerator(CompilerContext* ctx) : allocator_(ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+
+        ints_.caller_saved_ = { R10, R9, R8, RCX, RSI, RDI };
+        ints_.callee_saved_ = { RBX, R12, R13, R14, R15 };
+        for (u08 reg = XMM0; reg <= XMM13; reg++) {
+            floats_.caller_saved_.push_back(reg);
+        }
+    }
+
+    bool NativeCodeGenerator::generate(const IrModule& module, NativeModule& out) {
+        bool ok = true;
+        for (const IrFunction& function : module.functions_) {
+            if (!is_supported(function)) {
+                ctx_->logger_.log(
+                    ERROR,
+                    "error: function '" + std::string(ctx_->string_table_.get_string(function.name_id_))
+                        + "' has too many parameters for native code generation"
+                );
+                ok = false;
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+        traps_ = nullptr;
+        emit_module(module, std::vector<bool>(module.functions_.size(), true), out);
+        return true;
+    }
+
+    bool NativeCodeGenerator::generate_unit(const IrModule& module, const u32 root, NativeTrapState* traps, NativeModule& out) {
+        assert(traps != nullptr);
+        std::vector<bool> selected(module.functions_.size(), false);
+        std::vector<u32> work = { root };
+        selected[root] = true;
+        while (!work.empty()) {
+            const IrFunction& function = module.functions_[work.back()];
+            work.pop_back();
+            if (function.blocks_.empty() || !is_supported(function)) {
+                return false;
+            }
+            for (const Instruction& inst : function.insts_) {
+                if (inst.op_ == Opcode::Call && !selected[inst.imm_.index_]) {
+                    selected[inst.imm_.index_] = true;
+                    work.push_back(inst.imm_.index_);
+                }
+            }
+        }
+        traps_ = traps;
+        emit_module(module, selected, out);
+
+        X86Assembler as(&out.code_);
+        as_ = &as;
+        as.align(16);
+        out.functions_[root].adapter_ = as.get_offset();
+        emit_adapter(module.functions_[root], out.functions_[root].offset_);
+        as_ = nullptr;
+        traps_ = nullptr;
+        return true;
+    }
+
+    void NativeCodeGenerator::emit_module(const IrModule& module, const std::vector<bool>& selected, NativeModule& out) {
+        out.code_.clear();
+        out.functions_.clear();
+        out.relocations_.clear();
+
+        X86Assembler as(&out.code_);
+        as_ = &as;
+        calls_.clear();
+        for (u64 i = 0; i < module.functions_.size(); i++) {
+            const IrFunction& function = module.functions_[i];
+            NativeFunction native;
+            native.name_id_ = function.name_id_;
+            native.offset_ = 0;
+            native.size_ = 0;
+            native.adapter_ = NO_ADAPTER;
+            native.defined_ = selected[i] && !function.blocks_.empty();
+            native.global_ = function.pub_ || !native.defined_;
+            if (native.defined_) {
+                as.align(16);
+                native.offset_ = as.get_offset();
+                function_index_ = static_cast<u32>(i);
+                generate_function(function);
+                native.size_ = as.get_offset() - native.offset_;
+            }
+            out.functions_.push_back(native);
+        }
+
+        for (const auto& [at, callee] : calls_) {
+            if (out.functions_[callee].defined_) {
+                as.patch(at, out.functions_[callee].offset_);
+            } else {
+                out.relocations_.push_back({ at, callee });
+            }
+        }
+        as_ = nullptr;
+        function_ = nullptr;
+    }
+
+    bool NativeCodeGenerator::is_supported(const IrFunction& function) const {
+        u32 ints = 0;
+        u32 floats = 0;
+        for (const TypeId param : ctx_->type_table_.get_params(function.type_)) {
+            (is_float(param) ? floats : ints)++;
+        }
+        return ints <= MAX_INT_PARAMS && floats <= MAX_FLOAT_PARAMS;
+    }
+
+    /**
+     * Loads the arguments from an array of interpreter values into their argument registers, calls the function
+     * and stores its result, keeping the array pointers in callee-saved rbx and r13. Its stack pointer after
+     * the pushes is where a trap resumes, returning the trap instead of NativeTrap::None.
+     */
+    void NativeCodeGenerator::emit_adapter(const IrFunction& function, const u32 target) {
+        as_->push(RBP);
+        as_->mov(RBP, Operand::reg(RSP));
+        as_->push(RBX);
+        as_->push(R13);
+        as_->mov(RBX, Operand::reg(RDI));
+        as_->mov(R13, Operand::reg(RSI));
+        as_->mov_imm(R11, static_cast<i64>(reinterpret_cast<uintptr_t>(&traps_->saved_rsp_)));
+        as_->mov(Operand::memory(R11, 0), RSP);
+        as_->mov(RAX, Operand::reg(RSP));
+        as_->alu_imm(Alu::Sub, RAX, static_cast<i32>(UNIT_STACK_BUDGET));
+        as_->mov_imm(R11, static_cast<i64>(reinterpret_cast<uintptr_t>(&traps_->stack_limit_)));
+        as_->mov(Operand::memory(R11, 0), RAX);
+
+        const auto params = ctx_->type_table_.get_params(function.type_);
+        u32 ints = 0;
+        u32 floats = 0;
+        for (u64 p = 0; p < params.size(); p++) {
+            const Operand arg = Operand::memory(RBX, static_cast<i32>(p * sizeof(u64)));
+            if (is_float(params[p])) {
+                as_->sse(Sse::Load, false, static_cast<Xmm>(floats++), arg);
+            } else {
+                as_->mov(INT_ARGS[ints++], arg);
+            }
+        }
+        as_->patch(as_->call(), target);
+
+        const TypeId result = ctx_->type_table_.get_info(function.type_).return_type;
+        if (is_float(result)) {
+            as_->sse_store(false, Operand::memory(R13, 0), XMM0);
+        } else if (ctx_->type_table_.get_info(result).kind != TypeKind::Void) {
+            as_->mov(Operand::memory(R13, 0), RAX);
+        }
+        as_->mov_imm(RAX, static_cast<i64>(NativeTrap::None));
+        as_->pop(R13);
+        as_->pop(RBX);
+        as_->pop(RBP);
+        as_->ret();
+    }
+
+    /** Drops every native frame down to the adapter's and returns the trap from it, naming the current function. */
+    void NativeCodeGenerator::emit_trap_exit(const NativeTrap trap) {
+        as_->mov_imm(R11, static_cast<i64>(reinterpret_cast<uintptr_t>(&traps_->saved_rsp_)));
+        as_->mov(RSP, Operand::memory(R11, 0));
+        as_->mov_imm(RAX, static_cast<i64>(function_index_) << NATIVE_TRAP_SHIFT | static_cast<i64>(trap));
+        as_->pop(R13);
+        as_->pop(RBX);
+        as_->pop(RBP);
+        as_->ret();
+    }
+
+    /**
+     * Frame layout below the saved rbp: the callee-saved registers in use, one home slot per parameter and then
+     * the spill slots. Parameters are stored to their homes on entry, so the argument registers are free to
+     * allocate.
+     */
+    void NativeCodeGenerator::generate_function(const IrFunction& function) {
+        function_ = &function;
+        // a vector loop runs on the entry edge and takes every SSE register
+        std::vector<u32> vector_entries;
+        for (const VectorLoop& loop : function.vector_loops_) {
+            vector_entries.push_back(function.blocks_[loop.preheader_].end_ - 1);
+        }
+        allocator_.allocate(function, ints_, floats_, allocation_, vector_entries);
+
+        std::vector<Gpr> saved;
+        for (const u08 reg : ints_.callee_saved_) {
+            if (allocation_.used_callee_saved_ & BIT(reg)) {
+                saved.push_back(static_cast<Gpr>(reg));
+            }
+        }
+        const auto params = ctx_->type_table_.get_params(function.type_);
+        param_base_ = static_cast<i32>(saved.size() * 8);
+        slot_base_ = param_base_ + static_cast<i32>(params.size() * 8);
+        u32 frame = static_cast<u32>(params.size() + allocation_.stack_slots_) * 8;
+        if ((param_base_ + frame) % 16 != 0) {
+            frame += 8;
+        }
+
+        overflow_jumps_.clear();
+        if (traps_) {
+            // r11 is scratch and never holds an argument
+            as_->mov_imm(R11, static_cast<i64>(reinterpret_cast<uintptr_t>(&traps_->stack_limit_)));
+            as_->alu(Alu::Cmp, RSP, Operand::memory(R11, 0));
+            overflow_jumps_.push_back(as_->jcc(B));
+        }
+        as_->push(RBP);
+        as_->mov(RBP, Operand::reg(RSP));
+        for (const Gpr reg : saved) {
+            as_->push(reg);
+        }
+        if (frame != 0) {
+            as_->alu_imm(Alu::Sub, RSP, static_cast<i32>(frame));
+        }
+        u32 ints = 0;
+        u32 floats = 0;
+        for (u64 p = 0; p < params.size(); p++) {
+            const Operand home = Operand::frame(-(param_base_ + static_cast<i32>(p + 1) * 8));
+            if (is_float(params[p])) {
+                as_->sse_store(false, home, static_cast<Xmm>(floats++));
+            } else {
+                as_->mov(home, INT_ARGS[ints++]);
+            }
+        }
+
+        block_offsets_.assign(function.blocks_.size(), 0);
+        fixups_.clear();
+        return_jumps_.clear();
+        trap_jumps_.clear();
+        for (BlockId b = 0; b < function.blocks_.size(); b++) {
+            block_offsets_[b] = as_->get_offset();
+            for (ValueId id = function.blocks_[b].begin_; id < function.blocks_[b].end_; id++) {
+                emit_instruction(id, b);
+            }
+        }
+
+        for (const u32 at : return_jumps_) {
+            as_->patch(at, as_->get_offset());
+        }
+        as_->lea(RSP, Operand::frame(-param_base_));
+        for (u64 i = saved.size(); i-- > 0;) {
+            as_->pop(saved[i]);
+        }
+        as_->pop(RBP);
+        as_->ret();
+
+        if (!trap_jumps_.empty()) {
+            for (const u32 at : trap_jumps_) {
+                as_->patch(at, as_->get_offset());
+            }
+            if (traps_) {
+                emit_trap_exit(NativeTrap::DivisionByZero);
+            } else {
+                as_->ud2();
+            }
+        }
+        for (const u32 at : overflow_jumps_) {
+            as_->patch(at, as_->get_offset());
+        }
+        if (!overflow_jumps_.empty()) {
+            emit_trap_exit(NativeTrap::StackOverflow);
+        }
+        for (const auto& [at, target] : fixups_) {
+            as_->patch(at, block_offsets_[target]);
+        }
+    }
+
+    void NativeCodeGenerator::emit_instruction(const ValueId id, const BlockId block) {
+        const Instruction& inst = function_->insts_[id];
+        switch (inst.op_) {
+            case Opcode::Nop:
+            case Opcode::Undef:
+            case Opcode::Phi:
+                break;
+            case Opcode::Const: {
+                const TypeInfo& info = ctx_->type_table_.get_info(inst.type_);
+                const Operand dst = operand(id);
+                if (info.kind == TypeKind::Float) {
+                    u64 bits = 0;
+                    if (info.bits == 32) {
+                        const f32 value = static_cast<f32>(inst.imm_.float_);
+                        bits = std::bit_cast<u32>(value);
+                    } else {
+                        bits = std::bit_cast<u64>(inst.imm_.float_);
+                    }
+                    as_->mov_imm(RAX, static_cast<i64>(bits));
+                    if (dst.kind_ == Operand::Kind::Register) {
+                        as_->movq(static_cast<Xmm>(dst.reg_), RAX);
+                    } else {
+                        as_->mov(dst, RAX);
+                    }
+                    break;
+                }
+                i64 value = inst.imm_.int_;
+                if (info.kind == TypeKind::Int && info.bits < 64) {
+                    const u32 shift = 64 - info.bits;
+                    const u64 bits = static_cast<u64>(value) << shift;
+                    value = info.is_signed ? static_cast<i64>(bits) >> shift : static_cast<i64>(bits >> shift);
+                }
+                const Gpr reg = dst.kind_ == Operand::Kind::Register ? static_cast<Gpr>(dst.reg_) : RAX;
+                as_->mov_imm(reg, value);
+                as_->mov(dst, reg);
+                break;
+            }
+            case Opcode::Param: {
+                const Operand home = Operand::frame(-(param_base_ + static_cast<i32>(inst.imm_.index_ + 1) * 8));
+                if (is_float(inst.type_)) {
+                    emit_move({ operand(id), home, true });
+                } else {
+                    // the upper bits of narrow arguments are unspecified by the calling convention
+                    const Operand dst = operand(id);
+                    const Gpr reg = dst.kind_ == Operand::Kind::Register ? static_cast<Gpr>(dst.reg_) : RAX;
+                    as_->mov(reg, home);
+                    canonicalize(reg, inst.type_);
+                    as_->mov(dst, reg);
+                }
+                break;
+            }
+            case Opcode::Neg:
+            case Opcode::Not:
+                emit_unary(id);
+                break;
+            case Opcode::Call:
+                emit_call(id);
+                break;
+            case Opcode::Br:
+            case Opcode::CondBr:
+            case Opcode::Ret:
+                emit_branch(id, block);
+                break;
+            default:
+                if (!opcode_is_binary(inst.op_)) {
+                    break;
+                }
+                if (inst.op_ >= Opcode::Eq) {
+                    emit_compare(id);
+                } else if ((inst.op_ == Opcode::Div || inst.op_ == Opcode::Rem) && !is_float(inst.type_)) {
+                    emit_division(id);
+                } else {
+                    emit_binary(id);
+                }
+                break;
+        }
+    }
+
+    void NativeCodeGenerator::emit_binary(const ValueId id) {
+        const Instruction& inst = function_->insts_[id];
+        const auto operands = function_->get_operands(id);
+        const Operand dst = operand(id);
+        const Operand lhs = operand(operands[0]);
+        const Operand rhs = operand(operands[1]);
+        // compute in place unless the destination register is the right operand
+        const bool in_place = dst.kind_ == Operand::Kind::Register && !(rhs.kind_ == Operand::Kind::Register && rhs.reg_ == dst.reg_);
+
+        if (is_float(inst.type_)) {
+            static const Sse ops[] = { Sse::Add, Sse::Sub, Sse::Mul, Sse::Div };
+            const Xmm t = in_place ? static_cast<Xmm>(dst.reg_) : XMM15;
+            emit_move({ Operand::reg(t), lhs, true });
+            as_->sse(ops[static_cast<u32>(inst.op_) - static_cast<u32>(Opcode::Add)], is_single(inst.type_), t, rhs);
+            emit_move({ dst, Operand::reg(t), true });
+            return;
+        }
+
+        const Gpr t = in_place ? static_cast<Gpr>(dst.reg_) : RAX;
+        as_->mov(t, lhs);
+        if (inst.op_ == Opcode::Mul) {
+            as_->imul(t, rhs);
+        } else {
+            as_->alu(inst.op_ == Opcode::Add ? Alu::Add : Alu::Sub, t, rhs);
+        }
+        canonicalize(t, inst.type_);
+        as_->mov(dst, t);
+    }
+
+    /**
+     * Signed 64-bit division by -1 is done by negation since idiv faults on the most negative dividend; every
+     * narrower type is canonically extended, so its quotient always fits.
+     */
+    void NativeCodeGenerator::emit_division(const ValueId id) {
+        const Instruction& inst = function_->insts_[id];
+        const auto operands = function_->get_operands(id);
+        const TypeInfo& info = ctx_->type_table_.get_info(inst.type_);
+        const bool remainder = inst.op_ == Opcode::Rem;
+
+        as_->mov(RAX, operand(operands[0]));
+        as_->mov(R11, operand(operands[1]));
+        as_->test(R11, R11);
+        trap_jumps_.push_back(as_->jcc(E));
+
+        if (info.bits == 64 && !info.is_signed) {
+            as_->mov_imm(RDX, 0);
+            as_->div(Operand::reg(R11));
+            if (remainder) {
+                as_->mov(RAX, Operand::reg(RDX));
+            }
+        } else if (info.bits == 64) {
+            as_->alu_imm(Alu::Cmp, R11, -1);
+            const u32 normal = as_->jcc(NE);
+            if (remainder) {
+                as_->mov_imm(RAX, 0);
+            } else {
+                as_->neg(RAX);
+            }
+            const u32 done = as_->jmp();
+            as_->patch(normal, as_->get_offset());
+            as_->cqo();
+            as_->idiv(Operand::reg(R11));
+            if (remainder) {
+                as_->mov(RAX, Operand::reg(RDX));
+            }
+            as_->patch(done, as_->get_offset());
+        } else {
+            as_->cqo();
+            as_->idiv(Operand::reg(R11));
+            if (remainder) {
+                as_->mov(RAX, Operand::reg(RDX));
+            }
+        }
+        canonicalize(RAX, inst.type_);
+        as_->mov(operand(id), RAX);
+    }
+
+    void NativeCodeGenerator::emit_compare(const ValueId id) {
+        const Instruction& inst = function_->insts_[id];
+        const auto operands = function_->get_operands(id);
+        const TypeId type = function_->insts_[operands[0]].type_;
+        const u32 index = static_cast<u32>(inst.op_) - static_cast<u32>(Opcode::Eq);
+
+        if (is_float(type)) {
+            // ucomis sets the flags like an unsigned compare and raises parity on NaN; less than is a swapped greater
+            const bool swap = inst.op_ == Opcode::Lt || inst.op_ == Opcode::Le;
+            emit_move({ Operand::reg(XMM15), operand(operands[swap ? 1 : 0]), true });
+            as_->sse(Sse::Ucomi, is_single(type), XMM15, operand(operands[swap ? 0 : 1]));
+            if (inst.op_ == Opcode::Eq || inst.op_ == Opcode::Ne) {
+                const bool eq = inst.op_ == Opcode::Eq;
+                as_->setcc(eq ? E : NE, RAX);
+                as_->setcc(eq ? NP : P, R11);
+                as_->movzx(RAX, RAX, 8);
+                as_->movzx(R11, R11, 8);
+                as_->alu(eq ? Alu::And : Alu::Or, RAX, Operand::reg(R11));
+            } else {
+                as_->setcc(inst.op_ == Opcode::Lt || inst.op_ == Opcode::Gt ? A : AE, RAX);
+                as_->movzx(RAX, RAX, 8);
+            }
+            as_->mov(operand(id), RAX);
+            return;
+        }
+
+        // Eq Ne Lt Gt Le Ge
+        static const Cond signed_conds[] = { E, NE, L, G, LE, GE };
+        static const Cond unsigned_conds[] = { E, NE, B, A, BE, AE };
+        const TypeInfo& info = ctx_->type_table_.get_info(type);
+        const bool is_unsigned = info.kind == TypeKind::Int && !info.is_signed;
+        as_->mov(RAX, operand(operands[0]));
+        as_->alu(Alu::Cmp, RAX, operand(operands[1]));
+        as_->setcc(is_unsigned ? unsigned_conds[index] : signed_conds[index], RAX);
+        as_->movzx(RAX, RAX, 8);
+        as_->mov(operand(id), RAX);
+    }
+
+    void NativeCodeGenerator::emit_unary(const ValueId id) {
+        const Instruction& inst = function_->insts_[id];
+        const Operand dst = operand(id);
+        const Operand src = operand(function_->get_operands(id)[0]);
+
+        if (inst.op_ == Opcode::Not) {
+            as_->mov(RAX, src);
+            as_->alu_imm(Alu::Xor, RAX, 1);
+            as_->mov(dst, RAX);
+        } else if (is_float(inst.type_)) {
+            const bool single = is_single(inst.type_);
+            emit_move({ Operand::reg(XMM15), src, true });
+            as_->mov_imm(RAX, single ? 0x80000000ll : static_cast<i64>(1ull << 63));
+            as_->movq(XMM14, RAX);
+            as_->sse(Sse::Xor, single, XMM15, Operand::reg(XMM14));
+            emit_move({ dst, Operand::reg(XMM15), true });
+        } else {
+            as_->mov(RAX, src);
+            as_->neg(RAX);
+            canonicalize(RAX, inst.type_);
+            as_->mov(dst, RAX);
+        }
+    }
+
+    /**
+     * Values live across the call were given callee-saved registers or stack slots, so only the arguments need
+     * to be placed.
+     */
+    void NativeCodeGenerator::emit_call(const ValueId id) {
+        const Instruction& inst = function_->insts_[id];
+        std::vector<Move> moves;
+        u32 ints = 0;
+        u32 floats = 0;
+        for (const ValueId arg : function_->get_operands(id)) {
+            const bool float_arg = is_float(function_->insts_[arg].type_);
+            const u08 reg = float_arg ? static_cast<u08>(floats++) : static_cast<u08>(INT_ARGS[ints++]);
+            moves.push_back({ Operand::reg(reg), operand(arg), float_arg });
+        }
+        emit_parallel_moves(moves);
+        calls_.emplace_back(as_->call(), inst.imm_.index_);
+
+        if (allocation_.locations_[id].kind_ == LocationKind::None) {
+            return;
+        }
+        if (is_float(inst.type_)) {
+            emit_move({ operand(id), Operand::reg(XMM0), true });
+        } else {
+            canonicalize(RAX, inst.type_);
+            as_->mov(operand(id), RAX);
+        }
+    }
+
+    void NativeCodeGenerator::emit_branch(const ValueId id, const BlockId block) {
+        const Instruction& inst = function_->insts_[id];
+        const BlockId next = block + 1;
+
+        if (inst.op_ == Opcode::Ret) {
+            const auto operands = function_->get_operands(id);
+            if (!operands.empty()) {
+                if (is_float(function_->insts_[operands[0]].type_)) {
+                    emit_move({ Operand::reg(XMM0), operand(operands[0]), true });
+                } else {
+                    as_->mov(RAX, operand(operands[0]));
+                }
+            }
+            // the epilogue follows the last block
+            if (next != function_->blocks_.size()) {
+                return_jumps_.push_back(as_->jmp());
+            }
+            return;
+        }
+
+        if (inst.op_ == Opcode::Br) {
+            emit_edge_copies(block, inst.imm_.targets_[0]);
+            if (inst.imm_.targets_[0] != next) {
+                emit_jump(inst.imm_.targets_[0]);
+            }
+            return;
+        }
+
+        const Operand cond = operand(function_->get_operands(id)[0]);
+        const BlockId then = inst.imm_.targets_[0];
+        const BlockId otherwise = inst.imm_.targets_[1];
+        if (cond.kind_ == Operand::Kind::Register) {
+            as_->test(static_cast<Gpr>(cond.reg_), static_cast<Gpr>(cond.reg_));
+        } else {
+            as_->mov(RAX, cond);
+            as_->test(RAX, RAX);
+        }
+
+        if (!has_phis(then) && !has_phis(otherwise)) {
+            if (otherwise == next) {
+                fixups_.emplace_back(as_->jcc(NE), then);
+            } else {
+                fixups_.emplace_back(as_->jcc(E), otherwise);
+                if (then != next) {
+                    emit_jump(then);
+                }
+            }
+            return;
+        }
+
+        // copies for each edge live in their own stub, the false stub follows the true one
+        const u32 branch = as_->jcc(E);
+        emit_edge_copies(block, then);
+        emit_jump(then);
+        as_->patch(branch, as_->get_offset());
+        emit_edge_copies(block, otherwise);
+        if (otherwise != next) {
+            emit_jump(otherwise);
+        }
+    }
+
+    void NativeCodeGenerator::emit_edge_copies(const BlockId from, const BlockId to) {
+        const IrBlock& target = function_->blocks_[to];
+        u32 pred_index = 0;
+        while (pred_index < target.preds_.size() && target.preds_[pred_index] != from) {
+            pred_index++;
+        }
+
+        std::vector<Move> moves;
+        for (ValueId phi = target.begin_; phi < target.end_ && function_->insts_[phi].op_ == Opcode::Phi; phi++) {
+            const ValueId src = function_->get_operands(phi)[pred_index];
+            if (allocation_.locations_[src].kind_ != LocationKind::None) {
+                moves.push_back({ operand(phi), operand(src), is_float(function_->insts_[phi].type_) });
+            }
+        }
+        emit_parallel_moves(moves);
+
+        for (const VectorLoop& loop : function_->vector_loops_) {
+            if (loop.preheader_ == from && loop.header_ == to) {
+                emit_vector_loop(loop);
+            }
+        }
+    }
+
+    /**
+     * Runs whole groups of iterations with every body value held as four lanes of an SSE register, lane k being
+     * the value of iteration i + k. Sums are accumulated per lane and folded into their phis afterwards, along
+     * with the advanced induction, so the scalar loop that follows only runs the remaining iterations.
+     * SSE2 has no 32-bit lane multiply: the even and odd lanes are multiplied into 64-bit products and their
+     * low halves interleaved back together.
+     */
+    void NativeCodeGenerator::emit_vector_loop(const VectorLoop& loop) {
+        const IrFunction& function = *function_;
+        const IrBlock& header = function.blocks_[loop.header_];
+        const ValueId test = header.end_ - 2;
+        static constexpr u08 NO_XMM = 0xFF;
+        std::vector<u08> lanes(function.insts_.size(), NO_XMM);
+        u08 next = XMM0;
+
+        // sums by their update, with the added value and whether it is subtracted; lanes start at zero and
+        // already hold the negated terms of a subtracting sum, so folding them in is always an add
+        struct Sum {
+            ValueId phi_;
+            ValueId update_;
+            ValueId term_;
+            bool subtract_;
+            Xmm reg_;
+        };
+        std::vector<Sum> sums;
+        for (ValueId phi = header.begin_; phi < test; phi++) {
+            if (phi == loop.induction_) {
+                continue;
+            }
+            const ValueId update = function.get_operands(phi)[1];
+            const auto operands = function.get_operands(update);
+            const bool subtract = function.insts_[update].op_ == Opcode::Sub;
+            sums.push_back({ phi, update, operands[0] == phi ? operands[1] : operands[0], subtract, static_cast<Xmm>(next++) });
+        }
+        const Xmm induction = static_cast<Xmm>(next++);
+        const Xmm step = static_cast<Xmm>(next++);
+        lanes[loop.induction_] = induction;
+
+        // the body is the chain of blocks from the header's true target to the latch
+        std::vector<ValueId> body;
+        std::vector<bool> in_loop(function.blocks_.size(), false);
+        in_loop[loop.header_] = true;
+        for (BlockId b = function.insts_[test + 1].imm_.targets_[0]; b != loop.header_;) {
+            in_loop[b] = true;
+            for (ValueId id = function.blocks_[b].begin_; id + 1 < function.blocks_[b].end_; id++) {
+                body.push_back(id);
+            }
+            b = function.insts_[function.get_terminator(b)].imm_.targets_[0];
+        }
+
+        // the number of iterations left, rounded down to whole steps
+        as_->mov(RAX, operand(loop.bound_));
+        as_->mov(RDX, operand(loop.induction_));
+        as_->alu(Alu::Sub, RAX, Operand::reg(RDX));
+        as_->alu_imm(Alu::Cmp, RAX, VECTOR_LANES);
+        const u32 skip = as_->jcc(L);
+        as_->alu_imm(Alu::And, RAX, -static_cast<i32>(VECTOR_LANES));
+        as_->mov(R11, Operand::reg(RAX));
+        as_->alu(Alu::Add, RAX, Operand::reg(RDX));
+        as_->mov(operand(loop.induction_), RAX);
+
+        auto broadcast = [&](const Xmm reg) {
+            as_->movd(reg, RAX);
+            as_->pshufd(reg, reg, 0);
+        };
+        as_->movd(induction, RDX);
+        as_->pshufd(induction, induction, 0);
+        as_->mov_imm(RAX, static_cast<i64>(1ull << 32));
+        as_->movq(XMM14, RAX);
+        as_->mov_imm(RAX, static_cast<i64>(3ull << 32 | 2));
+        as_->movq(XMM15, RAX);
+        as_->simd(Simd::UnpackLow64, XMM14, XMM15);
+        as_->simd(Simd::Add32, induction, XMM14);
+        as_->mov_imm(RAX, VECTOR_LANES);
+        broadcast(step);
+        for (const Sum& sum : sums) {
+            as_->simd(Simd::Xor, sum.reg_, sum.reg_);
+        }
+
+        // constants and values from outside the loop are the same in every lane
+        for (const ValueId id : body) {
+            const Instruction& inst = function.insts_[id];
+            if (inst.op_ == Opcode::Const) {
+                lanes[id] = next++;
+                as_->mov_imm(RAX, inst.imm_.int_);
+                broadcast(static_cast<Xmm>(lanes[id]));
+                continue;
+            }
+            for (const ValueId operand_id : function.get_operands(id)) {
+                if (lanes[operand_id] == NO_XMM && !in_loop[function.insts_[operand_id].block_]) {
+                    lanes[operand_id] = next++;
+                    as_->mov(RAX, operand(operand_id));
+                    broadcast(static_cast<Xmm>(lanes[operand_id]));
+                }
+            }
+        }
+        assert(next <= XMM14);
+
+        const u32 top = as_->get_offset();
+        for (const ValueId id : body) {
+            const Instruction& inst = function.insts_[id];
+            if (inst.op_ == Opcode::Const) {
+                continue;
+            }
+            const auto found = std::find_if(sums.begin(), sums.end(), [id](const Sum& sum) { return sum.update_ == id; });
+            if (found != sums.end()) {
+                as_->simd(found->subtract_ ? Simd::Sub32 : Simd::Add32, found->reg_, static_cast<Xmm>(lanes[found->term_]));
+                continue;
+            }
+
+            const auto operands = function.get_operands(id);
+            const Xmm lhs = static_cast<Xmm>(lanes[operands[0]]);
+            const Xmm rhs = static_cast<Xmm>(lanes[operands[1]]);
+            const Xmm dst = static_cast<Xmm>(next++);
+            lanes[id] = dst;
+            if (inst.op_ == Opcode::Mul) {
+                as_->simd(Simd::Move, XMM14, lhs);
+                as_->simd(Simd::MulU32, XMM14, rhs);
+                as_->simd(Simd::Move, XMM15, lhs);
+                as_->psrlq(XMM15, 32);
+                as_->simd(Simd::Move, dst, rhs);
+                as_->psrlq(dst, 32);
+                as_->simd(Simd::MulU32, XMM15, dst);
+                as_->pshufd(dst, XMM14, 0x08);
+                as_->pshufd(XMM15, XMM15, 0x08);
+                as_->simd(Simd::UnpackLow32, dst, XMM15);
+            } else {
+                as_->simd(Simd::Move, dst, lhs);
+                as_->simd(inst.op_ == Opcode::Add ? Simd::Add32 : Simd::Sub32, dst, rhs);
+            }
+        }
+        assert(next <= XMM14);
+        as_->simd(Simd::Add32, induction, step);
+        as_->alu_imm(Alu::Sub, R11, VECTOR_LANES);
+        as_->patch(as_->jcc(NE), top);
+
+        for (const Sum& sum : sums) {
+            as_->pshufd(XMM14, sum.reg_, 0x4E);
+            as_->simd(Simd::Add32, sum.reg_, XMM14);
+            as_->pshufd(XMM14, sum.reg_, 0xB1);
+            as_->simd(Simd::Add32, sum.reg_, XMM14);
+            as_->movd(RAX, sum.reg_);
+            as_->mov(RDX, operand(sum.phi_));
+            as_->alu(Alu::Add, RDX, Operand::reg(RAX));
+            canonicalize(RDX, function.insts_[sum.phi_].type_);
+            as_->mov(operand(sum.phi_), RDX);
+        }
+        as_->patch(skip, as_->get_offset());
+    }
+
+    /**
+     * Moves happen in parallel, so they are ordered to never overwrite a source that is still needed, and a cycle
+     * is broken by parking one source in r11 or xmm15.
+     */
+    void NativeCodeGenerator::emit_parallel_moves(std::vector<Move>& moves) {
+        std::erase_if(moves, [](const Move& move) {
+            return same_location(move.dst_, move.float_, move.src_, move.float_);
+        });
+
+        while (!moves.empty()) {
+            bool progress = false;
+            for (u64 i = 0; i < moves.size(); i++) {
+                bool blocked = false;
+                for (u64 j = 0; j < moves.size() && !blocked; j++) {
+                    blocked = j != i && same_location(moves[j].src_, moves[j].float_, moves[i].dst_, moves[i].float_);
+                }
+                if (!blocked) {
+                    emit_move(moves[i]);
+                    moves.erase(moves.begin() + i);
+                    progress = true;
+                    break;
+                }
+            }
+            if (!progress) {
+                const Move parked = moves[0];
+                const Operand scratch = Operand::reg(parked.float_ ? static_cast<u08>(XMM15) : static_cast<u08>(R11));
+                emit_move({ scratch, parked.src_, parked.float_ });
+                for (Move& move : moves) {
+                    if (same_location(move.src_, move.float_, parked.src_, parked.float_)) {
+                        move.src_ = scratch;
+                    }
+                }
+            }
+        }
+    }
+
+    void NativeCodeGenerator::emit_move(const Move& move) {
+        const Operand& dst = move.dst_;
+        const Operand& src = move.src_;
+        if (same_location(dst, move.float_, src, move.float_)) {
+            return;
+        }
+        const bool dst_reg = dst.kind_ == Operand::Kind::Register;
+        const bool src_reg = src.kind_ == Operand::Kind::Register;
+
+        if (!move.float_) {
+            if (dst_reg) {
+                as_->mov(static_cast<Gpr>(dst.reg_), src);
+            } else if (src_reg) {
+                as_->mov(dst, static_cast<Gpr>(src.reg_));
+            } else {
+                as_->mov(RAX, src);
+                as_->mov(dst, RAX);
+            }
+            return;
+        }
+
+        // stack slots are 8 bytes, so whole doubles are moved for either precision
+        if (dst_reg && src_reg) {
+            as_->sse(Sse::Move, true, static_cast<Xmm>(dst.reg_), src);
+        } else if (dst_reg) {
+            as_->sse(Sse::Load, false, static_cast<Xmm>(dst.reg_), src);
+        } else if (src_reg) {
+            as_->sse_store(false, dst, static_cast<Xmm>(src.reg_));
+        } else {
+            as_->sse(Sse::Load, false, XMM14, src);
+            as_->sse_store(false, dst, XMM14);
+        }
+    }
+
+    void NativeCodeGenerator::emit_jump(const BlockId target) {
+        fixups_.emplace_back(as_->jmp(), target);
+    }
+
+    /** Narrow integers are kept sign or zero extended to 64 bits, like the bytecode registers. */
+    void NativeCodeGenerator::canonicalize(const Gpr reg, const TypeId type) {
+        const TypeInfo& info = ctx_->type_table_.get_info(type);
+        if (info.kind != TypeKind::Int || info.bits >= 64) {
+            return;
+        }
+        if (info.is_signed) {
+            as_->movsx(reg, reg, info.bits);
+        } else {
+            as_->movzx(reg, reg, info.bits);
+        }
+    }
+
+    Operand NativeCodeGenerator::operand(const ValueId value) const {
+        const Location& location = allocation_.locations_[value];
+        if (location.kind_ == LocationKind::Register) {
+            return Operand::reg(location.reg_);
+        }
+        return Operand::frame(-(slot_base_ + static_cast<i32>(location.slot_ + 1) * 8));
+    }
+
+    bool NativeCodeGenerator::is_float(const TypeId type) const {
+        return type != TypeTable::INVALID && ctx_->type_table_.get_info(type).kind == TypeKind::Float;
+    }
+
+    bool NativeCodeGenerator::is_single(const TypeId type) const {
+        return ctx_->type_table_.get_info(type).bits == 32;
+    }
+
+    bool NativeCodeGenerator::has_phis(const BlockId block) const {
+        const IrBlock& target = function_->blocks_[block];
+        return target.begin_ < target.end_ && function_->insts_[target.begin_].op_ == Opcode::Phi;
+    }
+
+} /* solara */
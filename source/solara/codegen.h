@@ -0,0 +1,150 @@
+/**
+ * @file codegen.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "x86.h"
+
+#include <vector>
+
+namespace solara {
+
+    static constexpr u32 NO_ADAPTER = ~0u;
+
+    struct NativeFunction {
+        u64 name_id_;
+        u32 offset_;
+        u32 size_;
+
+        /** Offset of the entry taking its arguments from an interpreter frame, or NO_ADAPTER. */
+        u32 adapter_;
+        bool defined_;
+        bool global_;
+    };
+
+    /**
+     * Where the code of a unit finds its adapter's stack when it traps, so the adapter returns the trap to the
+     * interpreter instead of the process faulting. The adapter fills it on every entry, so a unit must only be
+     * entered by one thread at a time.
+     */
+    struct NativeTrapState {
+        u64 saved_rsp_ = 0;
+        u64 stack_limit_ = 0;
+    };
+
+    /** Why a unit's code stopped. An adapter returns the kind in the low bits and the index of the trapping function above. */
+    enum class NativeTrap : u32 {
+        None = 0,
+        DivisionByZero,
+        StackOverflow
+    };
+
+    static constexpr u32 NATIVE_TRAP_SHIFT = 2;
+
+    /** A call to a function without a body, left for the linker: rel32 at offset_ targets functions_[function_]. */
+    struct NativeRelocation {
+        u32 offset_;
+        u32 function_;
+    };
+
+    /**
+     * Machine code of a whole module in one position independent block. Calls between defined functions are
+     * already resolved; only calls to functions without a body are left as relocations.
+     */
+    struct NativeModule {
+        std::vector<u08> code_;
+        std::vector<NativeFunction> functions_;
+        std::vector<NativeRelocation> relocations_;
+    };
+
+    /**
+     * Translates optimized IR to x86-64 machine code following the System V calling convention.
+     * Values are assigned registers by linear scan; rax, rdx and r11 and xmm14 and xmm15 are kept as scratch for
+     * instruction selection and for breaking cycles between parallel copies. Division by zero executes ud2 in a
+     * whole module, which is written out as an object, while the traps of a unit unwind to its adapter and are
+     * returned from it, whether the interpreter or the JIT runner entered it.
+     * Vector loops found by the optimizer get an SSE2 version run on entry, leaving the last few iterations to the
+     * scalar loop.
+     */
+    class NativeCodeGenerator {
+    public:
+        static constexpr u32 MAX_INT_PARAMS = 6;
+        static constexpr u32 MAX_FLOAT_PARAMS = 8;
+
+        /** 32-bit lanes of an SSE register, the iterations a vector loop runs per step. */
+        static constexpr u32 VECTOR_LANES = 4;
+
+        /** Bytes of machine stack a unit may use below its adapter before a call traps as a stack overflow. */
+        static constexpr u32 UNIT_STACK_BUDGET = 1u << 20;
+
+        NativeCodeGenerator(CompilerContext* ctx);
+
+        bool generate(const IrModule& module, NativeModule& out);
+
+        /**
+         * Generates a function and everything it may call, plus an adapter entry for the function taking its
+         * arguments and result as interpreter values and returning a NativeTrap status. Every function checks
+         * its stack against the budget on entry, and a trap unwinds through the given state, which must outlive
+         * the code. Reports nothing, so it can run off the main thread.
+         * @returns False if a function of the unit has no body or an unsupported signature.
+         */
+        bool generate_unit(const IrModule& module, const u32 root, NativeTrapState* traps, NativeModule& out);
+
+    protected:
+        struct Move {
+            x86::Operand dst_;
+            x86::Operand src_;
+            bool float_;
+        };
+
+        void emit_module(const IrModule& module, const std::vector<bool>& selected, NativeModule& out);
+        bool is_supported(const IrFunction& function) const;
+        void emit_adapter(const IrFunction& function, const u32 target);
+        void emit_trap_exit(const NativeTrap trap);
+        void generate_function(const IrFunction& function);
+        void emit_instruction(const ValueId id, const BlockId block);
+        void emit_binary(const ValueId id);
+        void emit_division(const ValueId id);
+        void emit_compare(const ValueId id);
+        void emit_unary(const ValueId id);
+        void emit_call(const ValueId id);
+        void emit_branch(const ValueId id, const BlockId block);
+        void emit_edge_copies(const BlockId from, const BlockId to);
+        void emit_vector_loop(const VectorLoop& loop);
+        void emit_parallel_moves(std::vector<Move>& moves);
+        void emit_move(const Move& move);
+        void emit_jump(const BlockId target);
+        void canonicalize(const x86::Gpr reg, const TypeId type);
+
+        x86::Operand operand(const ValueId value) const;
+        bool is_float(const TypeId type) const;
+        bool is_single(const TypeId type) const;
+        bool has_phis(const BlockId block) const;
+
+    private:
+        CompilerContext* ctx_;
+        LinearScanAllocator allocator_;
+        RegisterAllocation allocation_;
+        RegisterClass ints_;
+        RegisterClass floats_;
+
+        const IrFunction* function_ = nullptr;
+        u32 function_index_ = 0;
+        NativeTrapState* traps_ = nullptr;
+        X86Assembler* as_ = nullptr;
+        i32 param_base_ = 0;
+        i32 slot_base_ = 0;
+        std::vector<u32> block_offsets_;
+        std::vector<std::pair<u32, BlockId>> fixups_;
+        std::vector<u32> return_jumps_;
+        std::vector<u32> trap_jumps_;
+        std::vector<u32> overflow_jumps_;
+        std::vector<std::pair<u32, u32>> calls_;
+    };
+
+} /* solara */
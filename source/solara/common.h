@@ -19,4 +19,8 @@ typedef uint16_t    u16;
 typedef uint32_t    u32;
 typedef uint64_t    u64;
 
+// floating point types
+typedef float       f32;
+typedef double      f64;
+
 #define BIT(x) (1 << x)
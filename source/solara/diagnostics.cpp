@@ -0,0 +1,61 @@
+/**
+ * @file diagnostics.cpp
+ */
+
+#include "diagnostics.h"
+
+#include <sstream>
+
+namespace solara {
+
+    static const char* diagnostic_level_name(const LogLevel level) {
+        switch (level) {
+            case WARNING:
+                return "warning";
+            case ERROR:
+            case CRITICAL:
+                return "error";
+            default:
+                return "note";
+        }
+    }
+
+    void DiagnosticList::report(const LogLevel level, const TokenSourceSpan& span, const std::string& message) {
+        if (level >= ERROR) {
+            error_count_++;
+        }
+        diagnostics_.push_back(Diagnostic{ level, span, message });
+    }
+
+    void DiagnosticList::append(const DiagnosticList& other) {
+        diagnostics_.insert(diagnostics_.end(), other.diagnostics_.begin(), other.diagnostics_.end());
+        error_count_ += other.error_count_;
+    }
+
+    void DiagnosticList::flush(Logger& logger, const std::string& source) {
+        for (const Diagnostic& diagnostic : diagnostics_) {
+            std::ostringstream ss;
+            if (!source.empty()) {
+                ss << source << ":";
+            }
+            ss << (diagnostic.span.line + 1) << ":" << (diagnostic.span.column + 1) << ": "
+               << diagnostic_level_name(diagnostic.level) << ": " << diagnostic.message;
+            logger.log(diagnostic.level, ss.str());
+        }
+        diagnostics_.clear();
+    }
+
+    void DiagnosticList::clear() {
+        diagnostics_.clear();
+        error_count_ = 0;
+    }
+
+    u32 DiagnosticList::get_error_count() const {
+        return error_count_;
+    }
+
+    bool DiagnosticList::empty() const {
+        return diagnostics_.empty();
+    }
+
+} /* solara */
@@ -0,0 +1,43 @@
+/**
+ * @file diagnostics.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "token.h"
+#include "log.h"
+
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    struct Diagnostic {
+        LogLevel level;
+        TokenSourceSpan span;
+        std::string message;
+    };
+
+    /**
+     * Ordered buffer of diagnostics produced by a compiler phase.
+     * Phases that run concurrently each write to their own list, and the lists are merged in source order
+     * afterwards so the reported output does not depend on scheduling.
+     */
+    class DiagnosticList {
+    public:
+        void report(const LogLevel level, const TokenSourceSpan& span, const std::string& message);
+        void append(const DiagnosticList& other);
+        /** Logs and drops the buffered diagnostics, prefixed by the source they refer to if one is given. */
+        void flush(Logger& logger, const std::string& source = "");
+        void clear();
+
+        u32 get_error_count() const;
+        bool empty() const;
+
+    private:
+        std::vector<Diagnostic> diagnostics_;
+        u32 error_count_ = 0;
+    };
+
+} /* solara */
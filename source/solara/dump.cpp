@@ -0,0 +1,270 @@
+/**
+ * @file dump.cpp
+ */
+
+#include "dump.h"
+
+#include <cstring>
+#include <sstream>
+
+namespace solara {
+
+    static constexpr char TOKEN_MAGIC[4] = { 'S', 'T', 'O', 'K' };
+    static constexpr char AST_MAGIC[4] = { 'S', 'A', 'S', 'T' };
+    static constexpr u08 DUMP_VERSION = 1;
+
+    /** Binary tags that are not node types: a missing required child, and the end of a list of children. */
+    static constexpr u08 AST_NULL_TAG = 0xFF;
+    static constexpr u08 AST_END_TAG = 0xFE;
+
+    DumpBuffer::DumpBuffer(std::streambuf* target) {
+        assert(target != nullptr);
+        target_ = target;
+        block_ = std::make_unique<char[]>(CAPACITY);
+        setp(block_.get(), block_.get() + CAPACITY);
+    }
+
+    DumpBuffer::~DumpBuffer() {
+        sync();
+    }
+
+    DumpBuffer::int_type DumpBuffer::overflow(int_type c) {
+        if (!flush_block()) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize DumpBuffer::xsputn(const char* data, std::streamsize count) {
+        if (count > epptr() - pptr()) {
+            if (!flush_block()) {
+                return 0;
+            }
+            // a write larger than the whole block goes straight through
+            if (static_cast<u64>(count) >= CAPACITY) {
+                return target_->sputn(data, count);
+            }
+        }
+        std::memcpy(pptr(), data, static_cast<u64>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+
+    int DumpBuffer::sync() {
+        return flush_block() && target_->pubsync() == 0 ? 0 : -1;
+    }
+
+    bool DumpBuffer::flush_block() {
+        const std::streamsize count = pptr() - pbase();
+        const bool ok = count == 0 || target_->sputn(pbase(), count) == count;
+        setp(block_.get(), block_.get() + CAPACITY);
+        return ok;
+    }
+
+    static void write_leb128(std::ostream& out, u64 value) {
+        do {
+            u08 byte = value & 0x7F;
+            value >>= 7;
+            if (value != 0) {
+                byte |= 0x80;
+            }
+            out.put(static_cast<char>(byte));
+        } while (value != 0);
+    }
+
+    static void write_binary_string(std::ostream& out, const std::string_view string) {
+        write_leb128(out, string.size());
+        out.write(string.data(), static_cast<std::streamsize>(string.size()));
+    }
+
+    static void write_binary_header(std::ostream& out, const char (&magic)[4], const u64 module_count) {
+        out.write(magic, sizeof(magic));
+        out.put(static_cast<char>(DUMP_VERSION));
+        write_leb128(out, module_count);
+    }
+
+    static void write_json_string(std::ostream& out, const std::string_view string) {
+        static constexpr char HEX[] = "0123456789abcdef";
+        out.put('"');
+        for (const char c : string) {
+            switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<u08>(c) < 0x20) {
+                        out << "\\u00" << HEX[(c >> 4) & 0xF] << HEX[c & 0xF];
+                    } else {
+                        out.put(c);
+                    }
+                    break;
+            }
+        }
+        out.put('"');
+    }
+
+    static std::string_view get_module_name(CompilerContext* ctx, const ModuleDeclNode* module) {
+        return module ? ctx->string_table_.get_string(module->name_id_) : std::string_view();
+    }
+
+    void dump_tokens(CompilerContext* ctx, std::span<Parser* const> parsers, const DumpFormat format, std::ostream& out) {
+        if (format == DumpFormat::Binary) {
+            write_binary_header(out, TOKEN_MAGIC, parsers.size());
+        } else if (format == DumpFormat::Json) {
+            out << "[\n";
+        }
+
+        for (u64 m = 0; m < parsers.size(); m++) {
+            const std::pmr::vector<TokenLexeme>& tokens = parsers[m]->get_tokens();
+            const std::string_view module_name = get_module_name(ctx, parsers[m]->get_module());
+            switch (format) {
+                case DumpFormat::Text:
+                    out << "module " << module_name << '\n';
+                    for (const TokenLexeme& token : tokens) {
+                        out << (token.span.line + 1) << ':' << (token.span.column + 1) << ' ' << token_name(token.type);
+                        if (token_has_value(token.type)) {
+                            out << '(' << parsers[m]->get_token_value(token) << ')';
+                        }
+                        out << '\n';
+                    }
+                    break;
+                case DumpFormat::Json:
+                    out << (m == 0 ? "" : ",\n") << "{\"module\":";
+                    write_json_string(out, module_name);
+                    out << ",\"tokens\":[";
+                    for (u64 i = 0; i < tokens.size(); i++) {
+                        const TokenLexeme& token = tokens[i];
+                        out << (i == 0 ? "\n" : ",\n") << "{\"kind\":\"" << token_name(token.type) << '"';
+                        if (token_has_value(token.type)) {
+                            out << ",\"value\":";
+                            write_json_string(out, parsers[m]->get_token_value(token));
+                        }
+                        out << ",\"line\":" << (token.span.line + 1) << ",\"column\":" << (token.span.column + 1) << '}';
+                    }
+                    out << "\n]}";
+                    break;
+                case DumpFormat::Binary:
+                    write_binary_string(out, module_name);
+                    write_leb128(out, tokens.size());
+                    for (const TokenLexeme& token : tokens) {
+                        out.put(static_cast<char>(token.type));
+                        write_leb128(out, token.span.line + 1);
+                        write_leb128(out, token.span.column + 1);
+                        if (token_has_value(token.type)) {
+                            write_binary_string(out, parsers[m]->get_token_value(token));
+                        }
+                    }
+                    break;
+            }
+        }
+
+        if (format == DumpFormat::Json) {
+            out << "\n]\n";
+        }
+    }
+
+    /**
+     * Writes a tree in JSON or binary. Node labels come from print_spec, captured into one reused stream
+     * and stripped of the angle brackets the text format puts around them.
+     */
+    class SyntaxTreeWriter : public SyntaxChildVisitor {
+    public:
+        SyntaxTreeWriter(CompilerContext* ctx, std::ostream& out, const DumpFormat format)
+            : ctx_(ctx)
+            , out_(out)
+            , format_(format)
+        {}
+
+        virtual void visit(SyntaxNodeHandle child) override {
+            if (format_ == DumpFormat::Json) {
+                out_ << (first_child_ ? "" : ",");
+                write_json(child);
+                first_child_ = false;
+            } else {
+                write_binary(child);
+            }
+        }
+
+        void write_json(SyntaxNodeHandle node) {
+            if (!node) {
+                out_ << "null";
+                return;
+            }
+            out_ << "{\"node\":\"" << node->get_name() << "\",\"spec\":";
+            write_json_string(out_, get_spec(node));
+            if (node->type_id_ != TypeTable::INVALID) {
+                out_ << ",\"type\":";
+                write_json_string(out_, ctx_->type_table_.get_name(node->type_id_));
+            }
+            out_ << ",\"line\":" << (node->span_.line + 1) << ",\"column\":" << (node->span_.column + 1) << ",\"children\":[";
+            first_child_ = true;
+            node->visit_children(*this);
+            first_child_ = false;
+            out_ << "]}";
+        }
+
+        void write_binary(SyntaxNodeHandle node) {
+            if (!node) {
+                out_.put(static_cast<char>(AST_NULL_TAG));
+                return;
+            }
+            out_.put(static_cast<char>(node->get_type()));
+            write_leb128(out_, node->span_.line + 1);
+            write_leb128(out_, node->span_.column + 1);
+            write_binary_string(out_, get_spec(node));
+            write_binary_string(out_, node->type_id_ != TypeTable::INVALID ? ctx_->type_table_.get_name(node->type_id_) : "");
+            node->visit_children(*this);
+            out_.put(static_cast<char>(AST_END_TAG));
+        }
+
+    protected:
+        std::string get_spec(SyntaxNodeHandle node) {
+            spec_.str("");
+            node->print_spec(ctx_, spec_, 0);
+            std::string spec = spec_.str();
+            if (spec.size() >= 2 && spec.front() == '<' && spec.back() == '>') {
+                spec = spec.substr(1, spec.size() - 2);
+            }
+            return spec;
+        }
+
+    private:
+        CompilerContext* ctx_;
+        std::ostream& out_;
+        DumpFormat format_;
+        std::ostringstream spec_;
+        bool first_child_ = true;
+    };
+
+    void dump_ast(CompilerContext* ctx, std::span<ModuleDeclNode* const> modules, const DumpFormat format, std::ostream& out) {
+        SyntaxTreeWriter writer(ctx, out, format);
+        switch (format) {
+            case DumpFormat::Text:
+                for (ModuleDeclNode* module : modules) {
+                    module->print(ctx, out, 0);
+                }
+                break;
+            case DumpFormat::Json:
+                out << "[\n";
+                for (u64 i = 0; i < modules.size(); i++) {
+                    out << (i == 0 ? "" : ",\n");
+                    writer.write_json(modules[i]);
+                }
+                out << "\n]\n";
+                break;
+            case DumpFormat::Binary:
+                write_binary_header(out, AST_MAGIC, modules.size());
+                for (ModuleDeclNode* module : modules) {
+                    writer.write_binary(module);
+                }
+                break;
+        }
+    }
+
+} /* solara */
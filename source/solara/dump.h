@@ -0,0 +1,60 @@
+/**
+ * @file dump.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "parser.h"
+#include "ast.h"
+
+#include <memory>
+#include <ostream>
+#include <span>
+#include <streambuf>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Stream buffer that collects output in one large block and hands it to its target only when the block
+     * is full or the buffer is flushed, so a dump costs a few large writes however many lines it has.
+     */
+    class DumpBuffer : public std::streambuf {
+    public:
+        static constexpr u64 CAPACITY = 1 << 20;
+
+        DumpBuffer(std::streambuf* target);
+        virtual ~DumpBuffer() override;
+
+        DumpBuffer(const DumpBuffer&) = delete;
+        DumpBuffer& operator=(const DumpBuffer&) = delete;
+
+    protected:
+        virtual int_type overflow(int_type c) override;
+        virtual std::streamsize xsputn(const char* data, std::streamsize count) override;
+        virtual int sync() override;
+
+    private:
+        bool flush_block();
+
+        std::streambuf* target_;
+        std::unique_ptr<char[]> block_;
+    };
+
+    /**
+     * Writes the token streams of parsed modules, in graph order.
+     * Text is one token per line, JSON an array of modules each with an array of tokens, and binary the
+     * 'STOK' header followed by LEB128-encoded records.
+     */
+    void dump_tokens(CompilerContext* ctx, std::span<Parser* const> parsers, const DumpFormat format, std::ostream& out);
+
+    /**
+     * Writes the syntax trees of modules, in graph order.
+     * Text is the indented tree, JSON nested objects with their children, and binary the 'SAST' header
+     * followed by the nodes in preorder, each list of children closed by an end tag.
+     */
+    void dump_ast(CompilerContext* ctx, std::span<ModuleDeclNode* const> modules, const DumpFormat format, std::ostream& out);
+
+} /* solara */
@@ -0,0 +1,207 @@
+/**
+ * @file elf.cpp
+ */
+
+#include "elf.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace solara {
+
+    // the few ELF constants needed for a relocatable object, see the System V gABI and the x86-64 psABI
+    static constexpr u16 ET_REL = 1;
+    static constexpr u16 EM_X86_64 = 62;
+    static constexpr u32 SHT_PROGBITS = 1;
+    static constexpr u32 SHT_SYMTAB = 2;
+    static constexpr u32 SHT_STRTAB = 3;
+    static constexpr u32 SHT_RELA = 4;
+    static constexpr u64 SHF_ALLOC = 0x2;
+    static constexpr u64 SHF_EXECINSTR = 0x4;
+    static constexpr u64 SHF_INFO_LINK = 0x40;
+    static constexpr u08 STB_LOCAL = 0;
+    static constexpr u08 STB_GLOBAL = 1;
+    static constexpr u08 STT_NOTYPE = 0;
+    static constexpr u08 STT_FUNC = 2;
+    static constexpr u08 STT_SECTION = 3;
+    static constexpr u32 R_X86_64_PLT32 = 4;
+
+    static constexpr u32 EHDR_SIZE = 64;
+    static constexpr u32 SHDR_SIZE = 64;
+    static constexpr u32 SYM_SIZE = 24;
+    static constexpr u32 RELA_SIZE = 24;
+
+    enum Section : u32 {
+        SECTION_NULL = 0,
+        SECTION_TEXT,
+        SECTION_RELA_TEXT,
+        SECTION_SYMTAB,
+        SECTION_STRTAB,
+        SECTION_SHSTRTAB,
+        SECTION_NOTE_STACK,
+        SECTION_COUNT
+    };
+
+    class ElfBuffer {
+    public:
+        void put8(const u08 value) { bytes_.push_back(value); }
+        void put16(const u16 value) { put(value, 2); }
+        void put32(const u32 value) { put(value, 4); }
+        void put64(const u64 value) { put(value, 8); }
+        void put(const u64 value, const u32 size) {
+            for (u32 i = 0; i < size; i++) {
+                bytes_.push_back(static_cast<u08>(value >> (i * 8)));
+            }
+        }
+        void append(const std::vector<u08>& bytes) { bytes_.insert(bytes_.end(), bytes.begin(), bytes.end()); }
+        void align(const u32 alignment) {
+            while (bytes_.size() % alignment != 0) {
+                bytes_.push_back(0);
+            }
+        }
+        u64 size() const { return bytes_.size(); }
+        const std::vector<u08>& get_bytes() const { return bytes_; }
+
+    private:
+        std::vector<u08> bytes_;
+    };
+
+    /** Appends a null terminated name to a string table and returns its offset. */
+    static u32 add_name(std::vector<u08>& table, const std::string_view name) {
+        const u32 offset = static_cast<u32>(table.size());
+        table.insert(table.end(), name.begin(), name.end());
+        table.push_back(0);
+        return offset;
+    }
+
+    bool write_elf_object(CompilerContext* ctx, const NativeModule& module, const std::string& path) {
+        std::vector<u08> strtab(1, 0);
+        std::vector<u08> shstrtab(1, 0);
+        u32 section_names[SECTION_COUNT] = {};
+        section_names[SECTION_TEXT] = add_name(shstrtab, ".text");
+        section_names[SECTION_RELA_TEXT] = add_name(shstrtab, ".rela.text");
+        section_names[SECTION_SYMTAB] = add_name(shstrtab, ".symtab");
+        section_names[SECTION_STRTAB] = add_name(shstrtab, ".strtab");
+        section_names[SECTION_SHSTRTAB] = add_name(shstrtab, ".shstrtab");
+        // an empty note marks the object as not needing an executable stack
+        section_names[SECTION_NOTE_STACK] = add_name(shstrtab, ".note.GNU-stack");
+
+        // local symbols must precede global ones: the null symbol, the text section, local then global functions
+        ElfBuffer symtab;
+        auto put_symbol = [&](const u32 name, const u08 info, const u16 section, const u64 value, const u64 size) {
+            symtab.put32(name);
+            symtab.put8(info);
+            symtab.put8(0);
+            symtab.put16(section);
+            symtab.put64(value);
+            symtab.put64(size);
+        };
+        put_symbol(0, 0, 0, 0, 0);
+        put_symbol(0, (STB_LOCAL << 4) | STT_SECTION, SECTION_TEXT, 0, 0);
+
+        std::vector<u32> symbol_indices(module.functions_.size(), 0);
+        u32 symbol_count = 2;
+        u32 first_global = 0;
+        for (u32 pass = 0; pass < 2; pass++) {
+            const bool global = pass == 1;
+            if (global) {
+                first_global = symbol_count;
+            }
+            for (u64 i = 0; i < module.functions_.size(); i++) {
+                const NativeFunction& function = module.functions_[i];
+                if (function.global_ != global) {
+                    continue;
+                }
+                const u32 name = add_name(strtab, ctx->string_table_.get_string(function.name_id_));
+                if (function.defined_) {
+                    const u08 binding = global ? STB_GLOBAL : STB_LOCAL;
+                    put_symbol(name, static_cast<u08>((binding << 4) | STT_FUNC), SECTION_TEXT, function.offset_, function.size_);
+                } else {
+                    put_symbol(name, (STB_GLOBAL << 4) | STT_NOTYPE, 0, 0, 0);
+                }
+                symbol_indices[i] = symbol_count++;
+            }
+        }
+
+        ElfBuffer rela;
+        for (const NativeRelocation& relocation : module.relocations_) {
+            rela.put64(relocation.offset_);
+            rela.put64((static_cast<u64>(symbol_indices[relocation.function_]) << 32) | R_X86_64_PLT32);
+            // the displacement is relative to the end of the 4 byte field
+            rela.put64(static_cast<u64>(-4ll));
+        }
+
+        ElfBuffer file;
+        file.put(0, EHDR_SIZE);
+
+        u64 offsets[SECTION_COUNT] = {};
+        u64 sizes[SECTION_COUNT] = {};
+        auto place = [&](const Section section, const std::vector<u08>& bytes, const u32 alignment) {
+            file.align(alignment);
+            offsets[section] = file.size();
+            sizes[section] = bytes.size();
+            file.append(bytes);
+        };
+        place(SECTION_TEXT, module.code_, 16);
+        place(SECTION_RELA_TEXT, rela.get_bytes(), 8);
+        place(SECTION_SYMTAB, symtab.get_bytes(), 8);
+        place(SECTION_STRTAB, strtab, 1);
+        place(SECTION_SHSTRTAB, shstrtab, 1);
+        offsets[SECTION_NOTE_STACK] = file.size();
+
+        file.align(8);
+        const u64 section_headers = file.size();
+        auto put_section = [&](const Section section, const u32 type, const u64 flags, const u32 link, const u32 info, const u64 alignment, const u64 entry_size) {
+            file.put32(section_names[section]);
+            file.put32(type);
+            file.put64(flags);
+            file.put64(0);
+            file.put64(offsets[section]);
+            file.put64(sizes[section]);
+            file.put32(link);
+            file.put32(info);
+            file.put64(alignment);
+            file.put64(entry_size);
+        };
+        file.put(0, SHDR_SIZE);
+        put_section(SECTION_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 16, 0);
+        put_section(SECTION_RELA_TEXT, SHT_RELA, SHF_INFO_LINK, SECTION_SYMTAB, SECTION_TEXT, 8, RELA_SIZE);
+        put_section(SECTION_SYMTAB, SHT_SYMTAB, 0, SECTION_STRTAB, first_global, 8, SYM_SIZE);
+        put_section(SECTION_STRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+        put_section(SECTION_SHSTRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+        put_section(SECTION_NOTE_STACK, SHT_PROGBITS, 0, 0, 0, 1, 0);
+
+        std::vector<u08> bytes = file.get_bytes();
+        const u08 ident[16] = { 0x7F, 'E', 'L', 'F', 2, 1, 1, 0 };
+        ElfBuffer header;
+        for (const u08 byte : ident) {
+            header.put8(byte);
+        }
+        header.put16(ET_REL);
+        header.put16(EM_X86_64);
+        header.put32(1);
+        header.put64(0);
+        header.put64(0);
+        header.put64(section_headers);
+        header.put32(0);
+        header.put16(EHDR_SIZE);
+        header.put16(0);
+        header.put16(0);
+        header.put16(SHDR_SIZE);
+        header.put16(SECTION_COUNT);
+        header.put16(SECTION_SHSTRTAB);
+        std::copy(header.get_bytes().begin(), header.get_bytes().end(), bytes.begin());
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (out) {
+            out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+        if (!out) {
+            ctx->logger_.log(ERROR, "error: could not write object file '" + path + "'");
+            return false;
+        }
+        return true;
+    }
+
+} /* solara */
@@ -0,0 +1,23 @@
+/**
+ * @file elf.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "codegen.h"
+
+#include <string>
+
+namespace solara {
+
+    /**
+     * Writes a native module as an x86-64 ELF relocatable object.
+     * Public functions and functions without a body become global symbols, the rest are local. Calls to functions
+     * without a body are left as PLT32 relocations for the linker.
+     * @returns False if the file could not be written.
+     */
+    bool write_elf_object(CompilerContext* ctx, const NativeModule& module, const std::string& path);
+
+} /* solara */
@@ -0,0 +1,510 @@
+/**
+ * @file evaluator.cpp
+ */
+
+#include "evaluator.h"
+
+#include <algorithm>
+
+namespace solara {
+
+    static VmValue make_int(const i64 value) {
+        VmValue out;
+        out.int_ = value;
+        return out;
+    }
+
+    /**
+     * Brings an integer result back to its canonical register form, sign- or zero-extended from its width.
+     */
+    static i64 extend(const u64 value, const TypeInfo& info) {
+        if (info.bits == 0 || info.bits >= 64) {
+            return static_cast<i64>(value);
+        }
+        const u32 shift = 64 - info.bits;
+        return info.is_signed ? static_cast<i64>(value << shift) >> shift : static_cast<i64>((value << shift) >> shift);
+    }
+
+    /** Approximate bytes of one local in a frame's hash map, with its node and bucket. */
+    static constexpr u64 VALUE_BYTES = sizeof(std::pair<const SyntaxNode* const, VmValue>) + 2 * sizeof(void*);
+
+    TreeEvaluator::TreeEvaluator(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        types_ = &ctx->type_table_;
+    }
+
+    bool TreeEvaluator::call(FunctionDeclNode* function, std::span<const VmValue> args, VmValue& out_result) {
+        failed_ = false;
+        error_.clear();
+        frames_.clear();
+        pending_.clear();
+        memoize_ = false;
+        max_depth_ = MAX_CALL_DEPTH;
+        steps_ = 0;
+        memory_ = 0;
+        out_result.int_ = 0;
+
+        if (!function->body_ || args.size() != function->params_.size()) {
+            error_ = "invalid call to '" + std::string(ctx_->string_table_.get_string(function->name_id_)) + "'";
+            return false;
+        }
+
+        frames_.push_back({ function, {}, make_int(0) });
+        for (u64 i = 0; i < args.size(); i++) {
+            frames_.back().values_[function->params_[i]] = args[i];
+        }
+        exec(function->body_);
+        out_result = frames_.back().result_;
+        frames_.pop_back();
+        return !failed_;
+    }
+
+    bool TreeEvaluator::evaluate_constant(VarDeclNode* decl) {
+        failed_ = false;
+        error_.clear();
+        frames_.clear();
+        pending_.clear();
+        memoize_ = true;
+        max_depth_ = MAX_CONSTANT_CALL_DEPTH;
+        steps_ = 0;
+        memory_ = 0;
+
+        // an initializer reads no locals, so it is evaluated in a frame of its own
+        frames_.push_back({ nullptr, {}, make_int(0) });
+        constant_value(decl);
+        frames_.clear();
+        memoize_ = false;
+        return !failed_;
+    }
+
+    void TreeEvaluator::set_limits(const u64 max_steps, const u64 max_memory) {
+        max_steps_ = max_steps;
+        max_memory_ = max_memory;
+    }
+
+    const std::string& TreeEvaluator::get_error() const {
+        return error_;
+    }
+
+    TreeEvaluator::Flow TreeEvaluator::exec(SyntaxNodeHandle stmt) {
+        if (!stmt || failed_) {
+            return failed_ ? Flow::Return : Flow::Normal;
+        }
+        if (!step()) {
+            return Flow::Return;
+        }
+
+        switch (stmt->get_type()) {
+            case SyntaxNodeType::CompoundStmt: {
+                auto node = static_cast<CompoundStmtNode*>(stmt);
+                for (SyntaxNodeHandle child : node->stmts_) {
+                    const Flow flow = exec(child);
+                    if (flow != Flow::Normal) {
+                        return flow;
+                    }
+                }
+                return Flow::Normal;
+            }
+            case SyntaxNodeType::VarDecl: {
+                auto node = static_cast<VarDeclNode*>(stmt);
+                if (node->const_) {
+                    // a constant is read through its declaration, where its value was stored
+                    return Flow::Normal;
+                }
+                const VmValue value = node->init_ ? eval(node->init_) : make_int(0);
+                auto [it, inserted] = frames_.back().values_.try_emplace(node, value);
+                if (inserted) {
+                    reserve_memory(VALUE_BYTES);
+                } else {
+                    it->second = value;
+                }
+                return failed_ ? Flow::Return : Flow::Normal;
+            }
+            case SyntaxNodeType::ExprStmt:
+                eval(static_cast<ExprStmtNode*>(stmt)->expr_);
+                return failed_ ? Flow::Return : Flow::Normal;
+            case SyntaxNodeType::ReturnStmt: {
+                auto node = static_cast<ReturnStmtNode*>(stmt);
+                if (node->expr_) {
+                    const VmValue value = eval(node->expr_);
+                    frames_.back().result_ = value;
+                }
+                return Flow::Return;
+            }
+            case SyntaxNodeType::IfStmt: {
+                auto node = static_cast<IfStmtNode*>(stmt);
+                const VmValue cond = eval(node->cond_);
+                if (failed_) {
+                    return Flow::Return;
+                }
+                return exec(cond.int_ != 0 ? node->then_ : node->else_);
+            }
+            case SyntaxNodeType::ForStmt: {
+                auto node = static_cast<ForStmtNode*>(stmt);
+                exec(node->init_);
+                for (;;) {
+                    if (failed_ || !step()) {
+                        return Flow::Return;
+                    }
+                    if (node->cond_ && eval(node->cond_).int_ == 0) {
+                        break;
+                    }
+                    const Flow flow = exec(node->body_);
+                    if (flow == Flow::Return) {
+                        return flow;
+                    }
+                    if (flow == Flow::Break) {
+                        break;
+                    }
+                    if (node->post_) {
+                        eval(node->post_);
+                    }
+                }
+                return failed_ ? Flow::Return : Flow::Normal;
+            }
+            case SyntaxNodeType::BreakStmt:
+                return Flow::Break;
+            case SyntaxNodeType::ContinueStmt:
+                return Flow::Continue;
+            default:
+                return Flow::Normal;
+        }
+    }
+
+    VmValue TreeEvaluator::eval(SyntaxNodeHandle expr) {
+        if (failed_ || !step()) {
+            return make_int(0);
+        }
+
+        switch (expr->get_type()) {
+            case SyntaxNodeType::LiteralExpr:
+                return eval_literal(static_cast<LiteralExprNode*>(expr));
+            case SyntaxNodeType::IdentifierExpr: {
+                SyntaxNodeHandle decl = static_cast<IdentifierExprNode*>(expr)->decl_;
+                if (auto constant = syntax_node_cast<VarDeclNode>(decl); constant && constant->const_) {
+                    return constant_value(constant);
+                }
+                return lookup(decl);
+            }
+            case SyntaxNodeType::BinaryExpr:
+                return eval_binary(static_cast<BinaryExprNode*>(expr));
+            case SyntaxNodeType::UnaryExpr:
+                return eval_unary(static_cast<UnaryExprNode*>(expr));
+            case SyntaxNodeType::CallExpr:
+                return eval_call(static_cast<CallExprNode*>(expr));
+            default:
+                return make_int(0);
+        }
+    }
+
+    VmValue TreeEvaluator::eval_binary(BinaryExprNode* expr) {
+        switch (expr->op_) {
+            case BinaryOperation::AND: {
+                if (eval(expr->left_).int_ == 0) {
+                    return make_int(0);
+                }
+                return make_int(eval(expr->right_).int_ != 0);
+            }
+            case BinaryOperation::OR: {
+                if (eval(expr->left_).int_ != 0) {
+                    return make_int(1);
+                }
+                return make_int(eval(expr->right_).int_ != 0);
+            }
+            case BinaryOperation::ASSIGN: {
+                // the right side may call functions, so the variable is looked up only once it is evaluated
+                const VmValue value = eval(expr->right_);
+                lookup(static_cast<IdentifierExprNode*>(expr->left_)->decl_) = value;
+                return value;
+            }
+            case BinaryOperation::ADD_ASSIGN:
+            case BinaryOperation::SUB_ASSIGN:
+            case BinaryOperation::MUL_ASSIGN:
+            case BinaryOperation::DIV_ASSIGN:
+            case BinaryOperation::MOD_ASSIGN: {
+                static const BinaryOperation base[] = {
+                    BinaryOperation::ADD, BinaryOperation::SUB, BinaryOperation::MUL, BinaryOperation::DIV, BinaryOperation::MOD
+                };
+                const BinaryOperation op = base[static_cast<u32>(expr->op_) - static_cast<u32>(BinaryOperation::ADD_ASSIGN)];
+                SyntaxNodeHandle decl = static_cast<IdentifierExprNode*>(expr->left_)->decl_;
+                const VmValue current = lookup(decl);
+                const VmValue rhs = eval(expr->right_);
+                const VmValue value = arithmetic(op, expr->type_id_, current, rhs);
+                lookup(decl) = value;
+                return value;
+            }
+            case BinaryOperation::EQ:
+            case BinaryOperation::NEQ:
+            case BinaryOperation::LT:
+            case BinaryOperation::GT:
+            case BinaryOperation::LE:
+            case BinaryOperation::GE: {
+                const VmValue lhs = eval(expr->left_);
+                const VmValue rhs = eval(expr->right_);
+                return compare(expr->op_, expr->left_->type_id_, lhs, rhs);
+            }
+            default: {
+                const VmValue lhs = eval(expr->left_);
+                const VmValue rhs = eval(expr->right_);
+                return arithmetic(expr->op_, expr->type_id_, lhs, rhs);
+            }
+        }
+    }
+
+    VmValue TreeEvaluator::eval_unary(UnaryExprNode* expr) {
+        const TypeInfo& info = types_->get_info(expr->type_id_);
+        switch (expr->op_) {
+            case UnaryOperation::NOT:
+                return make_int(eval(expr->expr_).int_ == 0);
+            case UnaryOperation::NEG: {
+                const VmValue value = eval(expr->expr_);
+                VmValue out;
+                out.int_ = 0;
+                if (info.kind == TypeKind::Float && info.bits == 32) {
+                    out.float32_ = -value.float32_;
+                } else if (info.kind == TypeKind::Float) {
+                    out.float_ = -value.float_;
+                } else {
+                    out.int_ = extend(0 - static_cast<u64>(value.int_), info);
+                }
+                return out;
+            }
+            case UnaryOperation::INC:
+            case UnaryOperation::DEC: {
+                SyntaxNodeHandle decl = static_cast<IdentifierExprNode*>(expr->expr_)->decl_;
+                VmValue one;
+                if (info.kind == TypeKind::Float && info.bits == 32) {
+                    one.float32_ = 1.0f;
+                } else if (info.kind == TypeKind::Float) {
+                    one.float_ = 1.0;
+                } else {
+                    one.int_ = 1;
+                }
+                const BinaryOperation op = expr->op_ == UnaryOperation::INC ? BinaryOperation::ADD : BinaryOperation::SUB;
+                const VmValue value = arithmetic(op, expr->type_id_, lookup(decl), one);
+                lookup(decl) = value;
+                return value;
+            }
+            default:
+                return make_int(0);
+        }
+    }
+
+    VmValue TreeEvaluator::eval_call(CallExprNode* expr) {
+        auto identifier = syntax_node_cast<IdentifierExprNode>(expr->callee_);
+        auto function = identifier ? syntax_node_cast<FunctionDeclNode>(identifier->decl_) : nullptr;
+        if (function && function->definition_) {
+            function = function->definition_;
+        }
+        if (!function || !function->body_) {
+            fail("call to a function without a body");
+            return make_int(0);
+        }
+        if (frames_.size() >= max_depth_) {
+            fail("stack overflow in '" + get_frame_name() + "'");
+            return make_int(0);
+        }
+
+        Environment frame = { function, {}, make_int(0) };
+        CallKey key = { function, {} };
+        for (u64 i = 0; i < expr->args_.size(); i++) {
+            const VmValue value = eval(expr->args_[i]);
+            frame.values_[function->params_[i]] = value;
+            if (memoize_) {
+                key.args_.push_back(value.int_);
+            }
+        }
+        if (failed_) {
+            return make_int(0);
+        }
+        if (memoize_) {
+            const auto it = memo_.find(key);
+            if (it != memo_.end()) {
+                return it->second;
+            }
+        }
+
+        const u64 frame_bytes = sizeof(Environment) + frame.values_.size() * VALUE_BYTES;
+        reserve_memory(frame_bytes);
+        frames_.push_back(std::move(frame));
+        exec(function->body_);
+        const VmValue result = frames_.back().result_;
+        memory_ -= sizeof(Environment) + frames_.back().values_.size() * VALUE_BYTES;
+        frames_.pop_back();
+
+        if (memoize_ && !failed_ && memo_bytes_ < max_memory_) {
+            memo_bytes_ += sizeof(CallKey) + key.args_.size() * sizeof(i64) + VALUE_BYTES;
+            memo_.emplace(std::move(key), result);
+        }
+        return result;
+    }
+
+    VmValue TreeEvaluator::eval_literal(LiteralExprNode* expr) {
+        const std::string_view text = ctx_->string_table_.get_string(expr->literal_id_);
+        const TypeInfo& info = types_->get_info(expr->type_id_);
+        VmValue out;
+        out.int_ = 0;
+
+        if (info.kind == TypeKind::Float) {
+            const f64 value = parse_float_literal(expr->literal_type_, text);
+            if (info.bits == 32) {
+                out.float32_ = static_cast<f32>(value);
+            } else {
+                out.float_ = value;
+            }
+            return out;
+        }
+
+        out.int_ = extend(parse_integer_literal(text), info);
+        return out;
+    }
+
+    VmValue TreeEvaluator::arithmetic(const BinaryOperation op, const TypeId type, const VmValue lhs, const VmValue rhs) {
+        const TypeInfo& info = types_->get_info(type);
+        VmValue out;
+        out.int_ = 0;
+
+        if (info.kind == TypeKind::Float && info.bits == 32) {
+            switch (op) {
+                case BinaryOperation::ADD: out.float32_ = lhs.float32_ + rhs.float32_; break;
+                case BinaryOperation::SUB: out.float32_ = lhs.float32_ - rhs.float32_; break;
+                case BinaryOperation::MUL: out.float32_ = lhs.float32_ * rhs.float32_; break;
+                case BinaryOperation::DIV: out.float32_ = lhs.float32_ / rhs.float32_; break;
+                default: break;
+            }
+            return out;
+        }
+        if (info.kind == TypeKind::Float) {
+            switch (op) {
+                case BinaryOperation::ADD: out.float_ = lhs.float_ + rhs.float_; break;
+                case BinaryOperation::SUB: out.float_ = lhs.float_ - rhs.float_; break;
+                case BinaryOperation::MUL: out.float_ = lhs.float_ * rhs.float_; break;
+                case BinaryOperation::DIV: out.float_ = lhs.float_ / rhs.float_; break;
+                default: break;
+            }
+            return out;
+        }
+
+        const u64 a = static_cast<u64>(lhs.int_);
+        const u64 b = static_cast<u64>(rhs.int_);
+        u64 value = 0;
+        switch (op) {
+            case BinaryOperation::ADD: value = a + b; break;
+            case BinaryOperation::SUB: value = a - b; break;
+            case BinaryOperation::MUL: value = a * b; break;
+            case BinaryOperation::DIV:
+            case BinaryOperation::MOD: {
+                if (b == 0) {
+                    fail("division by zero in '" + get_frame_name() + "'");
+                    return out;
+                }
+                const bool div = op == BinaryOperation::DIV;
+                if (info.bits == 64 && !info.is_signed) {
+                    value = div ? a / b : a % b;
+                } else if (rhs.int_ == -1) {
+                    value = div ? 0 - a : 0;
+                } else {
+                    value = static_cast<u64>(div ? lhs.int_ / rhs.int_ : lhs.int_ % rhs.int_);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        out.int_ = extend(value, info);
+        return out;
+    }
+
+    VmValue TreeEvaluator::compare(const BinaryOperation op, const TypeId type, const VmValue lhs, const VmValue rhs) {
+        const TypeInfo& info = types_->get_info(type);
+        auto test = [op](const auto a, const auto b) {
+            switch (op) {
+                case BinaryOperation::EQ: return a == b;
+                case BinaryOperation::NEQ: return a != b;
+                case BinaryOperation::LT: return a < b;
+                case BinaryOperation::GT: return a > b;
+                case BinaryOperation::LE: return a <= b;
+                case BinaryOperation::GE: return a >= b;
+                default: return false;
+            }
+        };
+
+        if (info.kind == TypeKind::Float && info.bits == 32) {
+            return make_int(test(lhs.float32_, rhs.float32_));
+        }
+        if (info.kind == TypeKind::Float) {
+            return make_int(test(lhs.float_, rhs.float_));
+        }
+        if (info.kind == TypeKind::Int && info.bits == 64 && !info.is_signed) {
+            return make_int(test(static_cast<u64>(lhs.int_), static_cast<u64>(rhs.int_)));
+        }
+        return make_int(test(lhs.int_, rhs.int_));
+    }
+
+    VmValue& TreeEvaluator::lookup(SyntaxNodeHandle decl) {
+        return frames_.back().values_[decl];
+    }
+
+    /** Evaluates a constant the first time it is read; its initializer reads no locals of the current frame. */
+    VmValue TreeEvaluator::constant_value(VarDeclNode* decl) {
+        if (decl->evaluated_) {
+            return make_int(decl->value_);
+        }
+        const std::string name(ctx_->string_table_.get_string(decl->name_id_));
+        if (decl->failed_) {
+            fail("it depends on constant '" + name + "', which could not be evaluated");
+            return make_int(0);
+        }
+        if (!decl->init_) {
+            fail("constant '" + name + "' has no value");
+            return make_int(0);
+        }
+        if (std::find(pending_.begin(), pending_.end(), decl) != pending_.end()) {
+            fail("the value of constant '" + name + "' depends on itself");
+            return make_int(0);
+        }
+
+        pending_.push_back(decl);
+        const VmValue value = eval(decl->init_);
+        pending_.pop_back();
+        if (failed_) {
+            decl->failed_ = true;
+        } else {
+            decl->value_ = value.int_;
+            decl->evaluated_ = true;
+        }
+        return value;
+    }
+
+    /** @returns The name of the function being run, or of the constant whose initializer is. */
+    std::string TreeEvaluator::get_frame_name() const {
+        if (!frames_.empty() && frames_.back().function_) {
+            return std::string(ctx_->string_table_.get_string(frames_.back().function_->name_id_));
+        }
+        return pending_.empty() ? std::string() : std::string(ctx_->string_table_.get_string(pending_.back()->name_id_));
+    }
+
+    bool TreeEvaluator::step() {
+        if (++steps_ > max_steps_) {
+            fail("evaluation took more than " + std::to_string(max_steps_) + " steps");
+            return false;
+        }
+        return true;
+    }
+
+    void TreeEvaluator::reserve_memory(const u64 bytes) {
+        memory_ += bytes;
+        if (memory_ > max_memory_) {
+            fail("evaluation needed more than " + std::to_string(max_memory_) + " bytes of memory");
+        }
+    }
+
+    void TreeEvaluator::fail(const std::string& message) {
+        if (!failed_) {
+            failed_ = true;
+            error_ = message;
+        }
+    }
+
+} /* solara */
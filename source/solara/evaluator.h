@@ -0,0 +1,121 @@
+/**
+ * @file evaluator.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+#include "bytecode.h"
+
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Straightforward interpreter over the typed syntax tree, kept as a reference for the bytecode machine.
+     * Every expression is dispatched through its node, every local lives in a per-call hash map and literals are
+     * parsed each time they are evaluated. It follows the same value rules as the bytecode, so both agree on results.
+     * It also computes constants while compiling, bounded by a number of steps and bytes of frames so a runaway
+     * initializer fails with an error instead of hanging the compiler. Functions can only change their own locals,
+     * so while constants are evaluated every call is memoized by its function and arguments.
+     */
+    class TreeEvaluator {
+    public:
+        static constexpr u32 MAX_CALL_DEPTH = 10000;
+
+        /** Constants are evaluated on compiler threads, whose stacks hold far fewer interpreted calls. */
+        static constexpr u32 MAX_CONSTANT_CALL_DEPTH = 2000;
+
+        TreeEvaluator(CompilerContext* ctx);
+
+        /**
+         * Calls a function with the given arguments.
+         * @returns False on a runtime error, described by get_error.
+         */
+        bool call(FunctionDeclNode* function, std::span<const VmValue> args, VmValue& out_result);
+
+        /**
+         * Evaluates the initializer of a checked constant and stores the value in its declaration, along with
+         * the values of the constants it reads. On failure it and the constants it was reading are marked failed.
+         * @returns False if the evaluation failed or went over its limits, described by get_error.
+         */
+        bool evaluate_constant(VarDeclNode* decl);
+
+        /** Bounds each later evaluation by expressions and statements executed and by bytes of live frames. */
+        void set_limits(const u64 max_steps, const u64 max_memory);
+        const std::string& get_error() const;
+
+    protected:
+        enum class Flow : u08 {
+            Normal = 0,
+            Break,
+            Continue,
+            Return
+        };
+
+        Flow exec(SyntaxNodeHandle stmt);
+        VmValue eval(SyntaxNodeHandle expr);
+        VmValue eval_binary(BinaryExprNode* expr);
+        VmValue eval_unary(UnaryExprNode* expr);
+        VmValue eval_call(CallExprNode* expr);
+        VmValue eval_literal(LiteralExprNode* expr);
+        VmValue arithmetic(const BinaryOperation op, const TypeId type, const VmValue lhs, const VmValue rhs);
+        VmValue compare(const BinaryOperation op, const TypeId type, const VmValue lhs, const VmValue rhs);
+        VmValue& lookup(SyntaxNodeHandle decl);
+        VmValue constant_value(VarDeclNode* decl);
+        std::string get_frame_name() const;
+        bool step();
+        void reserve_memory(const u64 bytes);
+        void fail(const std::string& message);
+
+    private:
+        struct Environment {
+            FunctionDeclNode* function_;
+            std::unordered_map<const SyntaxNode*, VmValue> values_;
+            VmValue result_;
+        };
+
+        struct CallKey {
+            const FunctionDeclNode* function_;
+            std::vector<i64> args_;
+
+            bool operator==(const CallKey& other) const = default;
+        };
+
+        struct CallKeyHash {
+            size_t operator()(const CallKey& key) const {
+                u64 hash = reinterpret_cast<uintptr_t>(key.function_);
+                for (const i64 arg : key.args_) {
+                    hash = (hash ^ static_cast<u64>(arg)) * 0x9E3779B97F4A7C15ull;
+                }
+                return static_cast<size_t>(hash ^ (hash >> 32));
+            }
+        };
+
+        CompilerContext* ctx_;
+        TypeTable* types_;
+        std::vector<Environment> frames_;
+        bool failed_ = false;
+        std::string error_;
+
+        u32 max_depth_ = MAX_CALL_DEPTH;
+        u64 max_steps_ = ~0ull;
+        u64 max_memory_ = ~0ull;
+        u64 steps_ = 0;
+        u64 memory_ = 0;
+
+        /** Constants whose initializers are being evaluated, innermost last, to report one that reads itself. */
+        std::vector<VarDeclNode*> pending_;
+
+        /** Results of calls made while evaluating constants, kept across constants until they fill the memory limit. */
+        bool memoize_ = false;
+        u64 memo_bytes_ = 0;
+        std::unordered_map<CallKey, VmValue, CallKeyHash> memo_;
+    };
+
+} /* solara */
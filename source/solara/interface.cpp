@@ -0,0 +1,302 @@
+/**
+ * @file interface.cpp
+ */
+
+#include "interface.h"
+
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace solara {
+
+    static constexpr char INTERFACE_MAGIC[4] = { 'S', 'O', 'L', 'I' };
+
+    /** Every table starts at an offset from the beginning of the file, aligned to 8 bytes. */
+    struct InterfaceHeader {
+        char magic_[4];
+        u32 version_;
+        u64 source_size_;
+        i64 source_mtime_;
+        u32 name_offset_;
+        u32 name_size_;
+        u32 types_offset_;
+        u32 type_count_;
+        u32 params_offset_;
+        u32 param_count_;
+        u32 functions_offset_;
+        u32 function_count_;
+        u32 strings_offset_;
+        u32 strings_size_;
+    };
+
+    /** Types refer to others by their index in the file, and only to earlier ones. */
+    struct InterfaceType {
+        u08 kind_;
+        u08 bits_;
+        u08 is_signed_;
+        u08 reserved_;
+        u32 return_type_;
+        u32 params_begin_;
+        u32 params_count_;
+    };
+
+    /** Names are ranges of the string table. */
+    struct InterfaceFunction {
+        u32 name_offset_;
+        u32 name_size_;
+        u32 type_;
+    };
+
+    static bool get_source_stamp(const std::filesystem::path& source, u64& out_size, i64& out_mtime) {
+        std::error_code error;
+        const auto mtime = std::filesystem::last_write_time(source, error);
+        out_size = error ? 0 : std::filesystem::file_size(source, error);
+        out_mtime = static_cast<i64>(mtime.time_since_epoch().count());
+        return !error;
+    }
+
+    static u32 align8(const u64 offset) {
+        return static_cast<u32>((offset + 7) & ~u64(7));
+    }
+
+    /** Adds a type and the types it refers to, in an order where every type follows those it refers to. */
+    static u32 add_interface_type(CompilerContext* ctx, const TypeId type, std::unordered_map<TypeId, u32>& indices,
+                                  std::vector<InterfaceType>& types, std::vector<u32>& params) {
+        auto it = indices.find(type);
+        if (it != indices.end()) {
+            return it->second;
+        }
+
+        const TypeTable& table = ctx->type_table_;
+        const TypeInfo& info = table.get_info(type);
+        InterfaceType out = { static_cast<u08>(info.kind), info.bits, info.is_signed, 0, 0, 0, 0 };
+        if (info.kind == TypeKind::Function) {
+            std::vector<u32> function_params;
+            for (const TypeId param : table.get_params(type)) {
+                function_params.push_back(add_interface_type(ctx, param, indices, types, params));
+            }
+            out.return_type_ = add_interface_type(ctx, info.return_type, indices, types, params);
+            out.params_begin_ = static_cast<u32>(params.size());
+            out.params_count_ = static_cast<u32>(function_params.size());
+            params.insert(params.end(), function_params.begin(), function_params.end());
+        }
+
+        const u32 index = static_cast<u32>(types.size());
+        types.push_back(out);
+        indices.emplace(type, index);
+        return index;
+    }
+
+    std::filesystem::path get_interface_path(const std::filesystem::path& source) {
+        std::filesystem::path path = source;
+        return path.replace_extension(".soli");
+    }
+
+    bool write_module_interface(CompilerContext* ctx, ModuleDeclNode* module, const std::filesystem::path& source) {
+        InterfaceHeader header = {};
+        std::memcpy(header.magic_, INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC));
+        header.version_ = INTERFACE_VERSION;
+        if (!get_source_stamp(source, header.source_size_, header.source_mtime_)) {
+            return false;
+        }
+
+        std::string strings(ctx->string_table_.get_string(module->name_id_));
+        header.name_offset_ = 0;
+        header.name_size_ = static_cast<u32>(strings.size());
+
+        std::unordered_map<TypeId, u32> indices;
+        std::vector<InterfaceType> types;
+        std::vector<u32> params;
+        std::vector<InterfaceFunction> functions;
+        for (SyntaxNodeHandle decl : module->decls_) {
+            auto function = syntax_node_cast<FunctionDeclNode>(decl);
+            if (!function || !function->pub_) {
+                continue;
+            }
+            const std::string_view name = ctx->string_table_.get_string(function->name_id_);
+            functions.push_back({ static_cast<u32>(strings.size()), static_cast<u32>(name.size()), 0 });
+            functions.back().type_ = add_interface_type(ctx, function->type_id_, indices, types, params);
+            strings += name;
+        }
+
+        header.types_offset_ = align8(sizeof(InterfaceHeader));
+        header.type_count_ = static_cast<u32>(types.size());
+        header.params_offset_ = align8(header.types_offset_ + types.size() * sizeof(InterfaceType));
+        header.param_count_ = static_cast<u32>(params.size());
+        header.functions_offset_ = align8(header.params_offset_ + params.size() * sizeof(u32));
+        header.function_count_ = static_cast<u32>(functions.size());
+        header.strings_offset_ = align8(header.functions_offset_ + functions.size() * sizeof(InterfaceFunction));
+        header.strings_size_ = static_cast<u32>(strings.size());
+
+        std::vector<u08> bytes(header.strings_offset_ + strings.size(), 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + header.types_offset_, types.data(), types.size() * sizeof(InterfaceType));
+        std::memcpy(bytes.data() + header.params_offset_, params.data(), params.size() * sizeof(u32));
+        std::memcpy(bytes.data() + header.functions_offset_, functions.data(), functions.size() * sizeof(InterfaceFunction));
+        std::memcpy(bytes.data() + header.strings_offset_, strings.data(), strings.size());
+
+        // written under a unique name and renamed over the old file, which is atomic on the same file system
+        const std::filesystem::path path = get_interface_path(source);
+        std::filesystem::path temporary = path;
+        temporary += ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Read-only view of a whole file, mapped where the platform allows and read into memory elsewhere.
+     */
+    class MappedFile {
+    public:
+        MappedFile(const std::filesystem::path& path) {
+#if defined(__unix__) || defined(__APPLE__)
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* data = mmap(nullptr, static_cast<u64>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    data_ = static_cast<const u08*>(data);
+                    size_ = static_cast<u64>(info.st_size);
+                }
+            }
+            close(fd);
+#else
+            std::ifstream file(path, std::ios::binary);
+            buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data_ = reinterpret_cast<const u08*>(buffer_.data());
+            size_ = buffer_.size();
+#endif
+        }
+
+        ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+            if (data_ != nullptr) {
+                munmap(const_cast<u08*>(data_), size_);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const u08* data_ = nullptr;
+        u64 size_ = 0;
+
+    private:
+#if !defined(__unix__) && !defined(__APPLE__)
+        std::string buffer_;
+#endif
+    };
+
+    std::unique_ptr<ModuleDeclNode> read_module_interface(CompilerContext* ctx, const std::filesystem::path& source) {
+        const MappedFile file(get_interface_path(source));
+        if (file.data_ == nullptr || file.size_ < sizeof(InterfaceHeader)) {
+            return nullptr;
+        }
+
+        InterfaceHeader header;
+        std::memcpy(&header, file.data_, sizeof(header));
+        u64 source_size;
+        i64 source_mtime;
+        if (std::memcmp(header.magic_, INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC)) != 0 || header.version_ != INTERFACE_VERSION
+            || !get_source_stamp(source, source_size, source_mtime)
+            || source_size != header.source_size_ || source_mtime != header.source_mtime_) {
+            return nullptr;
+        }
+
+        auto fits = [&file](const u64 offset, const u64 count, const u64 size) {
+            return offset % 8 == 0 && offset <= file.size_ && count <= (file.size_ - offset) / size;
+        };
+        if (!fits(header.types_offset_, header.type_count_, sizeof(InterfaceType))
+            || !fits(header.params_offset_, header.param_count_, sizeof(u32))
+            || !fits(header.functions_offset_, header.function_count_, sizeof(InterfaceFunction))
+            || !fits(header.strings_offset_, header.strings_size_, 1)
+            || static_cast<u64>(header.name_offset_) + header.name_size_ > header.strings_size_) {
+            return nullptr;
+        }
+
+        // the tables are aligned in the file and the mapping is page aligned, so records are read in place
+        const auto types = reinterpret_cast<const InterfaceType*>(file.data_ + header.types_offset_);
+        const auto params = reinterpret_cast<const u32*>(file.data_ + header.params_offset_);
+        const auto functions = reinterpret_cast<const InterfaceFunction*>(file.data_ + header.functions_offset_);
+        const auto strings = reinterpret_cast<const char*>(file.data_ + header.strings_offset_);
+
+        TypeTable& table = ctx->type_table_;
+        std::vector<TypeId> type_ids(header.type_count_, TypeTable::INVALID);
+        std::vector<TypeId> function_params;
+        for (u32 i = 0; i < header.type_count_; i++) {
+            const InterfaceType& type = types[i];
+            switch (static_cast<TypeKind>(type.kind_)) {
+                case TypeKind::Void:
+                    type_ids[i] = table.get_void_type();
+                    break;
+                case TypeKind::Bool:
+                    type_ids[i] = table.get_bool_type();
+                    break;
+                case TypeKind::Int:
+                    type_ids[i] = table.get_int_type(type.bits_, type.is_signed_ != 0);
+                    break;
+                case TypeKind::Float:
+                    type_ids[i] = table.get_float_type(type.bits_);
+                    break;
+                case TypeKind::Function:
+                    if (type.return_type_ >= i || static_cast<u64>(type.params_begin_) + type.params_count_ > header.param_count_) {
+                        return nullptr;
+                    }
+                    function_params.clear();
+                    for (u32 p = 0; p < type.params_count_; p++) {
+                        if (params[type.params_begin_ + p] >= i) {
+                            return nullptr;
+                        }
+                        function_params.push_back(type_ids[params[type.params_begin_ + p]]);
+                    }
+                    type_ids[i] = table.get_function_type(type_ids[type.return_type_], function_params);
+                    break;
+                default:
+                    return nullptr;
+            }
+        }
+
+        const u64 module_name = ctx->string_table_.add(std::string_view(strings + header.name_offset_, header.name_size_));
+        auto module = std::make_unique<ModuleDeclNode>(module_name, true);
+        for (u32 i = 0; i < header.function_count_; i++) {
+            const InterfaceFunction& record = functions[i];
+            if (static_cast<u64>(record.name_offset_) + record.name_size_ > header.strings_size_ || record.type_ >= header.type_count_
+                || table.get_info(type_ids[record.type_]).kind != TypeKind::Function) {
+                return nullptr;
+            }
+            const u64 name_id = ctx->string_table_.add(std::string_view(strings + record.name_offset_, record.name_size_));
+            auto function = make_syntax_node<FunctionDeclNode>(ctx->memory_.get_resource(MemorySubsystem::Syntax), name_id, true);
+            function->type_id_ = type_ids[record.type_];
+            module->decls_.push_back(function);
+            module->functions_.emplace(name_id, function);
+        }
+        return module;
+    }
+
+} /* solara */
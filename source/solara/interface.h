@@ -0,0 +1,40 @@
+/**
+ * @file interface.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+
+#include <filesystem>
+#include <memory>
+
+namespace solara {
+
+    /** Bumped whenever the layout of interface files changes. */
+    static constexpr u32 INTERFACE_VERSION = 1;
+
+    /**
+     * @returns The interface file of a source file: its path with the '.soli' extension.
+     */
+    std::filesystem::path get_interface_path(const std::filesystem::path& source);
+
+    /**
+     * Writes the interface of a declared module: its public function signatures, the types they use and an
+     * embedded string table, in fixed-size records addressed by offsets so the file is used straight from a
+     * read-only mapping. The size and modification time of the source are recorded, and the file is replaced
+     * atomically so readers never see it half written.
+     * @returns False if the file could not be written.
+     */
+    bool write_module_interface(CompilerContext* ctx, ModuleDeclNode* module, const std::filesystem::path& source);
+
+    /**
+     * Maps the interface of a source file and builds a module of bodiless public function declarations from it,
+     * without reading the source itself.
+     * @returns Null if there is no interface, it is malformed, or the source changed since it was written.
+     */
+    std::unique_ptr<ModuleDeclNode> read_module_interface(CompilerContext* ctx, const std::filesystem::path& source);
+
+} /* solara */
@@ -0,0 +1,647 @@
+/**
+ * @file ir.cpp
+ */
+
+#include "ir.h"
+#include "solara.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace solara {
+
+    const char* opcode_name(const Opcode op) {
+        switch (op) {
+            case Opcode::Nop: return "nop";
+            case Opcode::Undef: return "undef";
+            case Opcode::Const: return "const";
+            case Opcode::Param: return "param";
+            case Opcode::Add: return "add";
+            case Opcode::Sub: return "sub";
+            case Opcode::Mul: return "mul";
+            case Opcode::Div: return "div";
+            case Opcode::Rem: return "rem";
+            case Opcode::Eq: return "eq";
+            case Opcode::Ne: return "ne";
+            case Opcode::Lt: return "lt";
+            case Opcode::Gt: return "gt";
+            case Opcode::Le: return "le";
+            case Opcode::Ge: return "ge";
+            case Opcode::Neg: return "neg";
+            case Opcode::Not: return "not";
+            case Opcode::Phi: return "phi";
+            case Opcode::Call: return "call";
+            case Opcode::Br: return "br";
+            case Opcode::CondBr: return "condbr";
+            case Opcode::Ret: return "ret";
+            default: return "?";
+        }
+    }
+
+    bool opcode_is_terminator(const Opcode op) {
+        return op == Opcode::Br || op == Opcode::CondBr || op == Opcode::Ret;
+    }
+
+    bool opcode_is_binary(const Opcode op) {
+        return op >= Opcode::Add && op <= Opcode::Ge;
+    }
+
+    bool opcode_has_side_effects(const Opcode op) {
+        return op == Opcode::Call || opcode_is_terminator(op);
+    }
+
+    IrFunction::IrFunction(const u64 name_id, const TypeId type, const bool pub)
+        : name_id_(name_id)
+        , type_(type)
+        , pub_(pub)
+    {}
+
+    BlockId IrFunction::add_block() {
+        blocks_.emplace_back();
+        return static_cast<BlockId>(blocks_.size() - 1);
+    }
+
+    ValueId IrFunction::append(const BlockId block, const Opcode op, const TypeId type, std::span<const ValueId> operands) {
+        const ValueId id = static_cast<ValueId>(insts_.size());
+        Instruction inst;
+        inst.op_ = op;
+        inst.type_ = type;
+        inst.block_ = block;
+        insts_.push_back(inst);
+        set_operands(id, operands);
+        return id;
+    }
+
+    void IrFunction::add_edge(const BlockId from, const BlockId to) {
+        blocks_[to].preds_.push_back(from);
+    }
+
+    /**
+     * Removes one edge between two blocks, dropping the matching operand of every phi in the target.
+     */
+    void IrFunction::remove_edge(const BlockId from, const BlockId to) {
+        std::vector<BlockId>& preds = blocks_[to].preds_;
+        auto it = std::find(preds.begin(), preds.end(), from);
+        if (it == preds.end()) {
+            return;
+        }
+        const u64 index = it - preds.begin();
+        preds.erase(it);
+
+        std::vector<ValueId> operands;
+        for (ValueId id = 0; id < insts_.size(); id++) {
+            if (insts_[id].op_ != Opcode::Phi || insts_[id].block_ != to) {
+                continue;
+            }
+            const auto current = get_operands(id);
+            operands.assign(current.begin(), current.end());
+            operands.erase(operands.begin() + index);
+            set_operands(id, operands);
+        }
+    }
+
+    std::span<const ValueId> IrFunction::get_operands(const ValueId value) const {
+        const Instruction& inst = insts_[value];
+        if (inst.operand_count_ <= Instruction::INLINE_OPERANDS) {
+            return std::span<const ValueId>(inst.operands_, inst.operand_count_);
+        }
+        return std::span<const ValueId>(operand_pool_.data() + inst.operands_[0], inst.operand_count_);
+    }
+
+    void IrFunction::set_operands(const ValueId value, std::span<const ValueId> operands) {
+        Instruction& inst = insts_[value];
+        inst.operand_count_ = static_cast<u16>(operands.size());
+        if (operands.size() <= Instruction::INLINE_OPERANDS) {
+            std::copy(operands.begin(), operands.end(), inst.operands_);
+            return;
+        }
+        // spilled lists are append-only, linearize compacts the pool
+        const u32 offset = static_cast<u32>(operand_pool_.size());
+        operand_pool_.insert(operand_pool_.end(), operands.begin(), operands.end());
+        inst.operands_[0] = offset;
+    }
+
+    void IrFunction::set_operand(const ValueId value, const u32 index, const ValueId operand) {
+        Instruction& inst = insts_[value];
+        assert(index < inst.operand_count_);
+        if (inst.operand_count_ <= Instruction::INLINE_OPERANDS) {
+            inst.operands_[index] = operand;
+        } else {
+            operand_pool_[inst.operands_[0] + index] = operand;
+        }
+    }
+
+    /**
+     * Redirects every use of a value to another one. Uses are rewritten lazily: readers go through
+     * resolve until the next linearize applies the replacement for good.
+     */
+    void IrFunction::replace_uses(const ValueId value, const ValueId replacement) {
+        if (replacements_.size() < insts_.size()) {
+            replacements_.resize(insts_.size(), NO_VALUE);
+        }
+        if (value != replacement) {
+            replacements_[value] = replacement;
+        }
+    }
+
+    ValueId IrFunction::resolve(ValueId value) const {
+        while (value < replacements_.size() && replacements_[value] != NO_VALUE) {
+            value = replacements_[value];
+        }
+        return value;
+    }
+
+    ValueId IrFunction::get_terminator(const BlockId block) const {
+        const IrBlock& b = blocks_[block];
+        if (b.end_ > b.begin_ && opcode_is_terminator(insts_[b.end_ - 1].op_)) {
+            return b.end_ - 1;
+        }
+        return NO_VALUE;
+    }
+
+    static u32 terminator_successors(const Instruction& inst, BlockId out[2]) {
+        switch (inst.op_) {
+            case Opcode::Br:
+                out[0] = inst.imm_.targets_[0];
+                return 1;
+            case Opcode::CondBr:
+                out[0] = inst.imm_.targets_[0];
+                out[1] = inst.imm_.targets_[1];
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    u32 IrFunction::get_successors(const BlockId block, BlockId out[2]) const {
+        const ValueId terminator = get_terminator(block);
+        if (terminator == NO_VALUE) {
+            return 0;
+        }
+        return terminator_successors(insts_[terminator], out);
+    }
+
+    u32 IrFunction::get_param_count() const {
+        u32 count = 0;
+        for (const Instruction& inst : insts_) {
+            if (inst.op_ == Opcode::Param) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    void IrFunction::linearize() {
+        const u32 block_count = static_cast<u32>(blocks_.size());
+        vector_loops_.clear();
+        if (block_count == 0) {
+            return;
+        }
+
+        // the last live terminator of each block defines its successors
+        std::vector<ValueId> terminators(block_count, NO_VALUE);
+        std::vector<std::vector<ValueId>> members(block_count);
+        for (ValueId id = 0; id < insts_.size(); id++) {
+            const Instruction& inst = insts_[id];
+            if (inst.op_ == Opcode::Nop || resolve(id) != id) {
+                continue;
+            }
+            if (opcode_is_terminator(inst.op_)) {
+                terminators[inst.block_] = id;
+            } else {
+                members[inst.block_].push_back(id);
+            }
+        }
+
+        // depth-first walk from the entry for reachability and reverse post-order
+        std::vector<BlockId> post_order;
+        post_order.reserve(block_count);
+        std::vector<u08> state(block_count, 0);
+        std::vector<std::pair<BlockId, u32>> stack;
+        stack.emplace_back(0, 0);
+        state[0] = 1;
+        while (!stack.empty()) {
+            auto& [block, next] = stack.back();
+            BlockId succs[2];
+            const u32 count = terminators[block] != NO_VALUE ? terminator_successors(insts_[terminators[block]], succs) : 0;
+            if (next < count) {
+                const BlockId succ = succs[next++];
+                if (state[succ] == 0) {
+                    state[succ] = 1;
+                    stack.emplace_back(succ, 0);
+                }
+            } else {
+                post_order.push_back(block);
+                stack.pop_back();
+            }
+        }
+
+        // drop edges coming from unreachable blocks together with their phi operands
+        for (BlockId block : post_order) {
+            std::vector<BlockId>& preds = blocks_[block].preds_;
+            for (u64 i = preds.size(); i-- > 0;) {
+                if (state[preds[i]] != 0) {
+                    continue;
+                }
+                for (ValueId id : members[block]) {
+                    if (insts_[id].op_ != Opcode::Phi) {
+                        continue;
+                    }
+                    const auto current = get_operands(id);
+                    std::vector<ValueId> operands(current.begin(), current.end());
+                    operands.erase(operands.begin() + i);
+                    set_operands(id, operands);
+                }
+                preds.erase(preds.begin() + i);
+            }
+        }
+
+        std::vector<BlockId> block_map(block_count, NO_BLOCK);
+        for (u64 i = 0; i < post_order.size(); i++) {
+            block_map[post_order[post_order.size() - 1 - i]] = static_cast<BlockId>(i);
+        }
+
+        // new instruction order: per block, phis first and the terminator last
+        std::vector<ValueId> order;
+        order.reserve(insts_.size());
+        std::vector<IrBlock> blocks(post_order.size());
+        for (u64 i = post_order.size(); i-- > 0;) {
+            const BlockId old_block = post_order[i];
+            IrBlock& block = blocks[block_map[old_block]];
+            block.begin_ = static_cast<u32>(order.size());
+            for (ValueId id : members[old_block]) {
+                if (insts_[id].op_ == Opcode::Phi) {
+                    order.push_back(id);
+                }
+            }
+            for (ValueId id : members[old_block]) {
+                if (insts_[id].op_ != Opcode::Phi) {
+                    order.push_back(id);
+                }
+            }
+            if (terminators[old_block] != NO_VALUE) {
+                order.push_back(terminators[old_block]);
+            }
+            block.end_ = static_cast<u32>(order.size());
+            for (BlockId pred : blocks_[old_block].preds_) {
+                block.preds_.push_back(block_map[pred]);
+            }
+        }
+
+        std::vector<ValueId> value_map(insts_.size(), NO_VALUE);
+        for (u64 i = 0; i < order.size(); i++) {
+            value_map[order[i]] = static_cast<ValueId>(i);
+        }
+
+        std::vector<Instruction> insts;
+        std::vector<ValueId> pool;
+        insts.reserve(order.size());
+        std::vector<ValueId> operands;
+        for (ValueId old_id : order) {
+            Instruction inst = insts_[old_id];
+            const auto current = get_operands(old_id);
+            operands.clear();
+            for (ValueId operand : current) {
+                const ValueId resolved = resolve(operand);
+                operands.push_back(resolved < value_map.size() ? value_map[resolved] : NO_VALUE);
+            }
+
+            inst.block_ = block_map[inst.block_];
+            if (inst.op_ == Opcode::Br) {
+                inst.imm_.targets_[0] = block_map[inst.imm_.targets_[0]];
+            } else if (inst.op_ == Opcode::CondBr) {
+                inst.imm_.targets_[0] = block_map[inst.imm_.targets_[0]];
+                inst.imm_.targets_[1] = block_map[inst.imm_.targets_[1]];
+            }
+
+            if (operands.size() <= Instruction::INLINE_OPERANDS) {
+                std::copy(operands.begin(), operands.end(), inst.operands_);
+            } else {
+                inst.operands_[0] = static_cast<u32>(pool.size());
+                pool.insert(pool.end(), operands.begin(), operands.end());
+            }
+            insts.push_back(inst);
+        }
+
+        insts_.swap(insts);
+        operand_pool_.swap(pool);
+        blocks_.swap(blocks);
+        replacements_.clear();
+    }
+
+    std::vector<BlockId> compute_dominators(const IrFunction& function) {
+        const u32 count = static_cast<u32>(function.blocks_.size());
+        std::vector<BlockId> idoms(count, NO_BLOCK);
+        if (count == 0) {
+            return idoms;
+        }
+        idoms[0] = 0;
+
+        // blocks are numbered in reverse post-order, so a smaller id is never deeper in the walk
+        auto intersect = [&idoms](BlockId a, BlockId b) {
+            while (a != b) {
+                while (a > b) {
+                    a = idoms[a];
+                }
+                while (b > a) {
+                    b = idoms[b];
+                }
+            }
+            return a;
+        };
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (BlockId block = 1; block < count; block++) {
+                BlockId idom = NO_BLOCK;
+                for (BlockId pred : function.blocks_[block].preds_) {
+                    if (idoms[pred] == NO_BLOCK) {
+                        continue;
+                    }
+                    idom = (idom == NO_BLOCK) ? pred : intersect(pred, idom);
+                }
+                if (idom != NO_BLOCK && idoms[block] != idom) {
+                    idoms[block] = idom;
+                    changed = true;
+                }
+            }
+        }
+        return idoms;
+    }
+
+    bool dominates(std::span<const BlockId> idoms, const BlockId a, BlockId b) {
+        while (b != a) {
+            if (b >= idoms.size() || idoms[b] == b || idoms[b] == NO_BLOCK) {
+                return false;
+            }
+            b = idoms[b];
+        }
+        return true;
+    }
+
+    static void print_value(std::ostream& out, const ValueId value) {
+        if (value == NO_VALUE) {
+            out << "%?";
+        } else {
+            out << "%" << value;
+        }
+    }
+
+    void dump_ir(CompilerContext* ctx, const IrModule& module, std::ostream& out) {
+        out << "module " << ctx->string_table_.get_string(module.name_id_) << "\n";
+        for (const IrFunction& function : module.functions_) {
+            out << "\n";
+            dump_ir(ctx, module, function, out);
+        }
+        out.flush();
+    }
+
+    void dump_ir(CompilerContext* ctx, const IrModule& module, const IrFunction& function, std::ostream& out) {
+        const TypeTable& types = ctx->type_table_;
+        out << (function.pub_ ? "pub " : "") << "fn " << ctx->string_table_.get_string(function.name_id_)
+            << " " << types.get_name(function.type_);
+        if (function.blocks_.empty()) {
+            out << ";\n";
+            return;
+        }
+        out << " {\n";
+
+        for (BlockId b = 0; b < function.blocks_.size(); b++) {
+            const IrBlock& block = function.blocks_[b];
+            out << "bb" << b << ":";
+            if (!block.preds_.empty()) {
+                out << " ; preds:";
+                for (BlockId pred : block.preds_) {
+                    out << " bb" << pred;
+                }
+            }
+            for (const VectorLoop& loop : function.vector_loops_) {
+                if (loop.header_ == b) {
+                    out << " ; vectorized";
+                }
+            }
+            out << "\n";
+
+            for (ValueId id = block.begin_; id < block.end_; id++) {
+                const Instruction& inst = function.insts_[id];
+                const auto operands = function.get_operands(id);
+                out << "    ";
+                if (!opcode_is_terminator(inst.op_)) {
+                    print_value(out, id);
+                    out << " = ";
+                }
+                out << opcode_name(inst.op_);
+                if (inst.type_ != TypeTable::INVALID && !opcode_is_terminator(inst.op_)) {
+                    out << " " << types.get_name(inst.type_);
+                }
+
+                switch (inst.op_) {
+                    case Opcode::Const:
+                        if (types.get_info(inst.type_).kind == TypeKind::Float) {
+                            out << " " << inst.imm_.float_;
+                        } else {
+                            out << " " << inst.imm_.int_;
+                        }
+                        break;
+                    case Opcode::Param:
+                        out << " " << inst.imm_.index_;
+                        break;
+                    case Opcode::Phi:
+                        for (u64 i = 0; i < operands.size(); i++) {
+                            out << (i > 0 ? ", [" : " [");
+                            if (i < block.preds_.size()) {
+                                out << "bb" << block.preds_[i] << ": ";
+                            }
+                            print_value(out, operands[i]);
+                            out << "]";
+                        }
+                        break;
+                    case Opcode::Call: {
+                        const u32 callee = inst.imm_.index_;
+                        out << " @";
+                        if (callee < module.functions_.size()) {
+                            out << ctx->string_table_.get_string(module.functions_[callee].name_id_);
+                        } else {
+                            out << callee;
+                        }
+                        out << "(";
+                        for (u64 i = 0; i < operands.size(); i++) {
+                            out << (i > 0 ? ", " : "");
+                            print_value(out, operands[i]);
+                        }
+                        out << ")";
+                        break;
+                    }
+                    case Opcode::Br:
+                        out << " bb" << inst.imm_.targets_[0];
+                        break;
+                    case Opcode::CondBr:
+                        out << " ";
+                        print_value(out, operands[0]);
+                        out << ", bb" << inst.imm_.targets_[0] << ", bb" << inst.imm_.targets_[1];
+                        break;
+                    default:
+                        for (u64 i = 0; i < operands.size(); i++) {
+                            out << (i > 0 ? ", " : " ");
+                            print_value(out, operands[i]);
+                        }
+                        break;
+                }
+                out << "\n";
+            }
+        }
+        out << "}\n";
+    }
+
+    u32 verify_ir(CompilerContext* ctx, const IrModule& module, const IrFunction& function, std::vector<std::string>& errors) {
+        const TypeTable& types = ctx->type_table_;
+        const std::string_view name = ctx->string_table_.get_string(function.name_id_);
+        const u64 initial = errors.size();
+
+        auto fail = [&](const BlockId block, const ValueId value, const std::string& message) {
+            std::ostringstream ss;
+            ss << "fn " << name << ": bb" << block << ": ";
+            if (value != NO_VALUE) {
+                ss << "%" << value << ": ";
+            }
+            ss << message;
+            errors.push_back(ss.str());
+        };
+
+        const u32 inst_count = static_cast<u32>(function.insts_.size());
+        const u32 block_count = static_cast<u32>(function.blocks_.size());
+        if (block_count == 0) {
+            // a declaration without a lowered body
+            return 0;
+        }
+
+        const std::vector<BlockId> idoms = compute_dominators(function);
+        const TypeId return_type = types.get_info(function.type_).return_type;
+        const TypeId bool_type = const_cast<TypeTable&>(types).get_bool_type();
+
+        u32 expected_begin = 0;
+        for (BlockId b = 0; b < block_count; b++) {
+            const IrBlock& block = function.blocks_[b];
+            if (block.begin_ != expected_begin || block.end_ <= block.begin_ || block.end_ > inst_count) {
+                fail(b, NO_VALUE, "block range is empty or not contiguous");
+                return static_cast<u32>(errors.size() - initial);
+            }
+            expected_begin = block.end_;
+
+            if (b != 0 && idoms[b] == NO_BLOCK) {
+                fail(b, NO_VALUE, "block is unreachable");
+            }
+
+            // every successor must list this block as a predecessor
+            BlockId succs[2];
+            const u32 succ_count = function.get_successors(b, succs);
+            for (u32 i = 0; i < succ_count; i++) {
+                if (succs[i] >= block_count) {
+                    fail(b, NO_VALUE, "branch to a block that does not exist");
+                    continue;
+                }
+                const auto& preds = function.blocks_[succs[i]].preds_;
+                if (std::find(preds.begin(), preds.end(), b) == preds.end()) {
+                    fail(b, NO_VALUE, "successor does not list the block as a predecessor");
+                }
+            }
+
+            bool phis_allowed = true;
+            for (ValueId id = block.begin_; id < block.end_; id++) {
+                const Instruction& inst = function.insts_[id];
+                const auto operands = function.get_operands(id);
+                const bool last = id + 1 == block.end_;
+
+                if (inst.block_ != b) {
+                    fail(b, id, "instruction is tagged with the wrong block");
+                }
+                if (opcode_is_terminator(inst.op_) != last) {
+                    fail(b, id, last ? "block does not end with a terminator" : "terminator in the middle of a block");
+                }
+                if (inst.op_ == Opcode::Phi) {
+                    if (!phis_allowed) {
+                        fail(b, id, "phi after a non-phi instruction");
+                    }
+                    if (operands.size() != block.preds_.size()) {
+                        fail(b, id, "phi operand count does not match the predecessor count");
+                    }
+                } else {
+                    phis_allowed = false;
+                }
+                if (inst.op_ == Opcode::Nop) {
+                    fail(b, id, "nop left in a linearized function");
+                }
+
+                for (u64 i = 0; i < operands.size(); i++) {
+                    const ValueId operand = operands[i];
+                    if (operand >= inst_count) {
+                        fail(b, id, "operand refers to a value that does not exist");
+                        continue;
+                    }
+                    const BlockId def_block = function.insts_[operand].block_;
+                    // a phi operand only has to be available at the end of the matching predecessor
+                    const BlockId use_block = (inst.op_ == Opcode::Phi && i < block.preds_.size()) ? block.preds_[i] : b;
+                    const bool available = (inst.op_ == Opcode::Phi)
+                        ? dominates(idoms, def_block, use_block)
+                        : (def_block == b ? operand < id : dominates(idoms, def_block, use_block));
+                    if (!available) {
+                        fail(b, id, "operand does not dominate its use");
+                    }
+                }
+
+                if (opcode_is_binary(inst.op_)) {
+                    if (operands.size() != 2) {
+                        fail(b, id, "binary instruction needs two operands");
+                    } else if (operands[0] < inst_count && operands[1] < inst_count) {
+                        const TypeId lhs = function.insts_[operands[0]].type_;
+                        const TypeId rhs = function.insts_[operands[1]].type_;
+                        const bool compare = inst.op_ >= Opcode::Eq;
+                        if (lhs != rhs || (!compare && lhs != inst.type_) || (compare && inst.type_ != bool_type)) {
+                            fail(b, id, "operand types do not match the instruction type");
+                        }
+                    }
+                }
+
+                switch (inst.op_) {
+                    case Opcode::CondBr:
+                        if (operands.size() != 1 || (operands[0] < inst_count && function.insts_[operands[0]].type_ != bool_type)) {
+                            fail(b, id, "condition must be a single bool operand");
+                        }
+                        break;
+                    case Opcode::Ret: {
+                        const bool is_void = types.get_info(return_type).kind == TypeKind::Void;
+                        if (is_void != operands.empty()) {
+                            fail(b, id, "return does not match the function return type");
+                        } else if (!is_void && operands[0] < inst_count && function.insts_[operands[0]].type_ != return_type) {
+                            fail(b, id, "returned value has the wrong type");
+                        }
+                        break;
+                    }
+                    case Opcode::Call: {
+                        if (inst.imm_.index_ >= module.functions_.size()) {
+                            fail(b, id, "call to a function that does not exist");
+                            break;
+                        }
+                        const auto params = types.get_params(module.functions_[inst.imm_.index_].type_);
+                        if (params.size() != operands.size()) {
+                            fail(b, id, "call argument count does not match the callee");
+                            break;
+                        }
+                        for (u64 i = 0; i < params.size(); i++) {
+                            if (operands[i] < inst_count && function.insts_[operands[i]].type_ != params[i]) {
+                                fail(b, id, "call argument has the wrong type");
+                            }
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        }
+
+        return static_cast<u32>(errors.size() - initial);
+    }
+
+} /* solara */
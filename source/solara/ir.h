@@ -0,0 +1,167 @@
+/**
+ * @file ir.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "types.h"
+
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    // forward declarations
+    struct CompilerContext;
+
+    /**
+     * Index of an instruction inside its function. Every instruction defines at most one value,
+     * so the instruction index doubles as the id of that value.
+     */
+    using ValueId = u32;
+    using BlockId = u32;
+
+    constexpr ValueId NO_VALUE = ~0u;
+    constexpr BlockId NO_BLOCK = ~0u;
+
+    enum class Opcode : u08 {
+        Nop = 0,
+        Undef,
+        Const,
+        Param,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Rem,
+        Eq,
+        Ne,
+        Lt,
+        Gt,
+        Le,
+        Ge,
+        Neg,
+        Not,
+        Phi,
+        Call,
+        Br,
+        CondBr,
+        Ret
+    };
+
+    const char* opcode_name(const Opcode op);
+    bool opcode_is_terminator(const Opcode op);
+    bool opcode_is_binary(const Opcode op);
+    bool opcode_has_side_effects(const Opcode op);
+
+    /**
+     * A single SSA instruction.
+     * Up to three operands are stored inline; longer operand lists (phis, calls) spill into the
+     * operand pool of the owning function, in which case the first inline slot holds the pool offset.
+     */
+    struct Instruction {
+        static constexpr u32 INLINE_OPERANDS = 3;
+
+        Opcode op_ = Opcode::Nop;
+        u08 reserved_ = 0;
+        u16 operand_count_ = 0;
+        TypeId type_ = TypeTable::INVALID;
+        BlockId block_ = 0;
+        ValueId operands_[INLINE_OPERANDS] = { NO_VALUE, NO_VALUE, NO_VALUE };
+        union {
+            i64 int_;
+            f64 float_;
+            u32 index_;
+            BlockId targets_[2];
+        } imm_ = { 0 };
+    };
+
+    static_assert(sizeof(Instruction) == 32, "instructions are meant to pack two per cache line");
+
+    /**
+     * A basic block is the range [begin_, end_) of its function's instruction array, with phis first and
+     * the terminator last. Phi operands are ordered like the predecessor list.
+     */
+    struct IrBlock {
+        u32 begin_ = 0;
+        u32 end_ = 0;
+        std::vector<BlockId> preds_;
+    };
+
+    /**
+     * Counted loop found safe to run several iterations at a time. The header holds only phis, the exit test
+     * `induction_ < bound_` and its branch; the body is a straight line of 32-bit integer adds, subs and muls
+     * ending in latch_, and every header phi other than the induction is a sum of the body's values.
+     */
+    struct VectorLoop {
+        BlockId preheader_;
+        BlockId header_;
+        BlockId latch_;
+        ValueId induction_;
+        ValueId bound_;
+    };
+
+    class IrFunction {
+    public:
+        IrFunction(const u64 name_id, const TypeId type, const bool pub);
+
+        BlockId add_block();
+        ValueId append(const BlockId block, const Opcode op, const TypeId type, std::span<const ValueId> operands = {});
+        void add_edge(const BlockId from, const BlockId to);
+        void remove_edge(const BlockId from, const BlockId to);
+
+        std::span<const ValueId> get_operands(const ValueId value) const;
+        void set_operands(const ValueId value, std::span<const ValueId> operands);
+        void set_operand(const ValueId value, const u32 index, const ValueId operand);
+        void replace_uses(const ValueId value, const ValueId replacement);
+        ValueId resolve(ValueId value) const;
+
+        ValueId get_terminator(const BlockId block) const;
+        u32 get_successors(const BlockId block, BlockId out[2]) const;
+        u32 get_param_count() const;
+
+        /**
+         * Puts the function into canonical form: unreachable blocks and nops are dropped, pending
+         * replacements are applied, blocks are renumbered in reverse post-order and every block's
+         * instructions are made contiguous. Value ids change, so any analysis must be recomputed and vector
+         * loops are dropped.
+         */
+        void linearize();
+
+        u64 name_id_;
+        TypeId type_;
+        bool pub_;
+        std::vector<Instruction> insts_;
+        std::vector<ValueId> operand_pool_;
+        std::vector<IrBlock> blocks_;
+        std::vector<VectorLoop> vector_loops_;
+
+    private:
+        std::vector<ValueId> replacements_;
+    };
+
+    struct IrModule {
+        u64 name_id_ = 0;
+        std::vector<IrFunction> functions_;
+    };
+
+    /**
+     * Computes the immediate dominator of every block, with the entry block dominating itself.
+     * @see Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+     */
+    std::vector<BlockId> compute_dominators(const IrFunction& function);
+    bool dominates(std::span<const BlockId> idoms, const BlockId a, BlockId b);
+
+    void dump_ir(CompilerContext* ctx, const IrModule& module, std::ostream& out);
+    void dump_ir(CompilerContext* ctx, const IrModule& module, const IrFunction& function, std::ostream& out);
+
+    /**
+     * Checks the structural and SSA invariants of a linearized function.
+     * @returns The number of violations found, each of them appended to the errors list.
+     */
+    u32 verify_ir(CompilerContext* ctx, const IrModule& module, const IrFunction& function, std::vector<std::string>& errors);
+
+} /* solara */
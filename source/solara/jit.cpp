@@ -0,0 +1,124 @@
+/**
+ * @file jit.cpp
+ */
+
+#include "jit.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SOLARA_JIT_HOST 1
+#else
+#define SOLARA_JIT_HOST 0
+#endif
+
+namespace solara {
+
+    JitModule::JitModule(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    JitModule::~JitModule() {
+        release();
+    }
+
+    bool JitModule::load(const NativeModule& module) {
+        release();
+        error_.clear();
+
+        if (!SOLARA_JIT_HOST) {
+            error_ = "native code can only run on an x86-64 host";
+            return false;
+        }
+        if (!module.relocations_.empty()) {
+            const u64 name_id = module.functions_[module.relocations_.front().function_].name_id_;
+            error_ = "call to '" + std::string(ctx_->string_table_.get_string(name_id)) + "' which has no body";
+            return false;
+        }
+        if (module.code_.empty()) {
+            error_ = "module has no code";
+            return false;
+        }
+
+#if defined(_WIN32)
+        size_ = module.code_.size();
+        memory_ = static_cast<u08*>(VirtualAlloc(nullptr, size_, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        if (memory_ == nullptr) {
+            error_ = "could not allocate executable memory";
+            return false;
+        }
+        std::memcpy(memory_, module.code_.data(), module.code_.size());
+        DWORD old_protection;
+        if (!VirtualProtect(memory_, size_, PAGE_EXECUTE_READ, &old_protection)) {
+            error_ = "could not make the code executable";
+            release();
+            return false;
+        }
+        FlushInstructionCache(GetCurrentProcess(), memory_, size_);
+#elif defined(__unix__) || defined(__APPLE__)
+        const u64 page = static_cast<u64>(sysconf(_SC_PAGESIZE));
+        size_ = (module.code_.size() + page - 1) / page * page;
+        void* memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            size_ = 0;
+            error_ = "could not map executable memory";
+            return false;
+        }
+        memory_ = static_cast<u08*>(memory);
+        std::memcpy(memory_, module.code_.data(), module.code_.size());
+        if (mprotect(memory_, size_, PROT_READ | PROT_EXEC) != 0) {
+            error_ = "could not make the code executable";
+            release();
+            return false;
+        }
+#else
+        error_ = "executable memory is not supported on this platform";
+        return false;
+#endif
+
+        offsets_.clear();
+        for (const NativeFunction& function : module.functions_) {
+            offsets_.push_back(function.defined_ ? function.offset_ : ~0u);
+        }
+        return true;
+    }
+
+    const void* JitModule::get_function(const u32 index) const {
+        if (memory_ == nullptr || index >= offsets_.size() || offsets_[index] == ~0u) {
+            return nullptr;
+        }
+        return memory_ + offsets_[index];
+    }
+
+    const void* JitModule::get_address(const u32 offset) const {
+        return offset < size_ ? memory_ + offset : nullptr;
+    }
+
+    const std::string& JitModule::get_error() const {
+        return error_;
+    }
+
+    void JitModule::release() {
+        if (memory_ == nullptr) {
+            return;
+        }
+#if defined(_WIN32)
+        VirtualFree(memory_, 0, MEM_RELEASE);
+#elif defined(__unix__) || defined(__APPLE__)
+        munmap(memory_, size_);
+#endif
+        memory_ = nullptr;
+        size_ = 0;
+        offsets_.clear();
+    }
+
+} /* solara */
@@ -0,0 +1,49 @@
+/**
+ * @file jit.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "codegen.h"
+
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Native module loaded into executable memory of this process.
+     * The code is copied into fresh read-write pages which are then flipped to read-execute, so the memory is never
+     * writable and executable at the same time.
+     */
+    class JitModule {
+    public:
+        JitModule(CompilerContext* ctx);
+        ~JitModule();
+
+        JitModule(const JitModule&) = delete;
+        JitModule& operator=(const JitModule&) = delete;
+
+        /**
+         * Maps the module's code. Every function the code calls must have a body.
+         * @returns False if the host cannot run the code or the memory could not be mapped, described by get_error.
+         */
+        bool load(const NativeModule& module);
+        const void* get_function(const u32 index) const;
+        const void* get_address(const u32 offset) const;
+        const std::string& get_error() const;
+
+    protected:
+        void release();
+
+    private:
+        CompilerContext* ctx_;
+        u08* memory_ = nullptr;
+        u64 size_ = 0;
+        std::vector<u32> offsets_;
+        std::string error_;
+    };
+
+} /* solara */
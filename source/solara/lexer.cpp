@@ -3,9 +3,17 @@
  */
 
 #include "lexer.h"
+#include "utf8.h"
+
+#include <bit>
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace solara {
 
@@ -13,24 +21,25 @@ namespace solara {
         return c == '\n';
     }
 
-    static bool is_unicode_char(const char c) {
-        return !is_newline(c);
-    }
-
-    static bool is_unicode_letter(const char c) {
+    static bool is_ascii_letter(const char c) {
         return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
     }
 
-    static bool is_unicode_digit(const char c) {
+    static bool is_ascii_digit(const char c) {
         return (c >= '0' && c <= '9');
     }
 
+    /** Bytes of multi-byte UTF-8 sequences, which leave the ASCII fast path for a table lookup. */
+    static bool is_high_bit(const char c) {
+        return static_cast<u08>(c) >= 0x80;
+    }
+
     static bool is_letter(const char c) {
-        return is_unicode_letter(c) || (c == '_');
+        return is_ascii_letter(c) || (c == '_');
     }
 
     static bool is_decimal_digit(const char c) {
-        return is_unicode_digit(c);
+        return is_ascii_digit(c);
     }
 
     static bool is_octal_digit(const char c) {
@@ -38,14 +47,74 @@ namespace solara {
     }
 
     static bool is_hexadecimal_digit(const char c) {
-        return is_unicode_digit(c) || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+        return is_ascii_digit(c) || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
     }
 
     static bool is_white_space(const char c) {
         return c == ' ' || c == '\t' || c == '\r' || is_newline(c) || c == '\0';
     }
 
-    Lexer::Lexer(CompilerContext* ctx) {
+    /** @returns The offset of the first quote, backslash or newline at or after an offset, or npos. */
+    static u64 find_string_delimiter(const std::string_view text, u64 offset) {
+        const char* data = text.data();
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; offset + 16 <= text.size(); offset += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+            const __m128i found = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)), _mm_cmpeq_epi8(block, newline)
+            );
+            const u32 mask = static_cast<u32>(_mm_movemask_epi8(found));
+            if (mask != 0) {
+                return offset + static_cast<u64>(std::countr_zero(mask));
+            }
+        }
+#endif
+        for (; offset < text.size(); offset++) {
+            if (data[offset] == '"' || data[offset] == '\\' || data[offset] == '\n') {
+                return offset;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    std::string decode_string_escapes(const std::string_view text) {
+        std::string out;
+        out.reserve(text.size());
+        for (u64 i = 0; i < text.size(); i++) {
+            if (text[i] != '\\' || i + 1 >= text.size()) {
+                out += text[i];
+                continue;
+            }
+            const char c = text[++i];
+            switch (c) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case '0': out += '\0'; break;
+                case 'x':
+                    out += static_cast<char>(std::stoul(std::string(text.substr(i + 1, 2)), nullptr, 16));
+                    i += 2;
+                    break;
+                case 'u': {
+                    const u64 end = text.find('}', i);
+                    append_utf8(out, static_cast<u32>(std::stoul(std::string(text.substr(i + 2, end - i - 2)), nullptr, 16)));
+                    i = end;
+                    break;
+                }
+                default:
+                    out += c;
+                    break;
+            }
+        }
+        return out;
+    }
+
+    Lexer::Lexer(CompilerContext* ctx)
+        : source_(ctx->memory_.get_resource(MemorySubsystem::Source))
+    {
         assert(ctx != nullptr);
         ctx_ = ctx;
     }
@@ -54,6 +123,8 @@ namespace solara {
         pos_ = 0;
         line_ = 0;
         column_ = 0;
+        stream_ = nullptr;
+        reset_literals();
 
         if (std::filesystem::exists(path) && std::filesystem::is_regular_file(path)) {
             std::ifstream file(path);
@@ -63,13 +134,170 @@ namespace solara {
                 return;
             }
 
-            source_.assign(
-                std::istreambuf_iterator<char>(file),
-                std::istreambuf_iterator<char>()
-            );
+            // read in one piece, so the buffer is allocated once at the size of the file
+            std::error_code error;
+            const u64 size = std::filesystem::file_size(path, error);
+            source_.resize(error ? 0 : size);
+            file.read(source_.data(), static_cast<std::streamsize>(source_.size()));
+            source_.resize(static_cast<u64>(file.gcount()));
         } else {
             std::cout << "Error: Source file does not exist: " << path << std::endl;
         }
+        text_ = source_;
+        utf8_error_ = false;
+        validate_utf8(0);
+    }
+
+    void Lexer::init_text(const std::string_view text) {
+        pos_ = 0;
+        line_ = 0;
+        column_ = 0;
+        stream_ = nullptr;
+        reset_literals();
+
+        source_.assign(text.begin(), text.end());
+        text_ = source_;
+        utf8_error_ = false;
+        validate_utf8(0);
+    }
+
+    void Lexer::reset_literals() {
+        errors_.clear();
+        string_literals_.clear();
+        string_literal_ids_.clear();
+        retained_literals_.clear();
+    }
+
+    void Lexer::init(SourceStream* stream) {
+        assert(stream != nullptr);
+        pos_ = 0;
+        line_ = 0;
+        column_ = 0;
+        source_.clear();
+        text_ = source_;
+        stream_ = stream;
+        validated_ = 0;
+        utf8_error_ = false;
+        reset_literals();
+    }
+
+    void Lexer::tokenize_all(std::pmr::vector<TokenLexeme>& out) {
+        if (tokenize_parallel(out)) {
+            return;
+        }
+        TokenLexeme token = next_token();
+        while (token.type != TokenType::END) {
+            out.push_back(token);
+            token = next_token();
+        }
+        out.push_back(token);
+    }
+
+    /**
+     * Splits the source after newlines and lexes the chunks concurrently, each assuming it starts outside a
+     * comment. Only a block comment can span a newline, so a serial pass then re-lexes just the chunks that
+     * an earlier chunk left inside one, and joins the tokens with their lines rebased. Every chunk starts a
+     * line, so columns need no rebasing. Literals are interned in that pass, in source order, so string
+     * table ids match a serial run.
+     * @returns False if the source is too small to be worth splitting, or is streamed.
+     */
+    bool Lexer::tokenize_parallel(std::pmr::vector<TokenLexeme>& out) {
+        const u32 threads = ctx_->thread_pool_.get_thread_count();
+        if (stream_ || pos_ != 0 || text_.size() < PARALLEL_SIZE || threads <= 1) {
+            return false;
+        }
+
+        const u64 chunk_size = std::max<u64>(MIN_CHUNK_SIZE, text_.size() / (threads * 4));
+        std::vector<LexedChunk> chunks;
+        u64 begin = 0;
+        while (begin < text_.size()) {
+            const u64 newline = text_.find('\n', std::min<u64>(begin + chunk_size, text_.size()) - 1);
+            const u64 end = newline == std::string_view::npos ? text_.size() : newline + 1;
+            LexedChunk& chunk = chunks.emplace_back(ctx_->memory_.get_resource(MemorySubsystem::Tokens));
+            chunk.begin_ = begin;
+            chunk.end_ = end;
+            begin = end;
+        }
+
+        ctx_->thread_pool_.parallel_for(chunks.size(), [this, &chunks](const u64 index, const u32) {
+            tokenize_chunk(chunks[index]);
+        });
+
+        u64 line = 0;
+        u64 relexed = 0;
+        bool in_comment = false;
+        for (LexedChunk& chunk : chunks) {
+            if (chunk.starts_in_comment_ != in_comment) {
+                chunk.starts_in_comment_ = in_comment;
+                tokenize_chunk(chunk);
+                relexed++;
+            }
+
+            u64 literal = 0;
+            u64 identifier = 0;
+            for (TokenLexeme token : chunk.tokens_) {
+                token.span.line += line;
+                if (token_has_value(token.type)) {
+                    const std::string_view text = text_.substr(chunk.begin_ + token.literal_id, chunk.literal_lengths_[literal++]);
+                    if (token.type == TokenType::IDENTIFIER) {
+                        token.literal_id = ctx_->string_table_.add_prehashed(text, chunk.identifier_hashes_[identifier++]);
+                    } else if (token.type == TokenType::LIT_STRING) {
+                        token.literal_id = add_string_literal(text);
+                    } else {
+                        token.literal_id = ctx_->string_table_.add(text);
+                    }
+                }
+                out.push_back(token);
+            }
+            for (LexerError& error : chunk.errors_) {
+                error.span_.line += line;
+                errors_.push_back(std::move(error));
+            }
+            chunk.end_token_.span.line += line;
+            line = chunk.end_token_.span.line;
+            in_comment = chunk.ends_in_comment_;
+        }
+        out.push_back(chunks.back().end_token_);
+        ctx_->logger_.log(
+            INFO, "Lexed " + std::to_string(chunks.size()) + " chunks in parallel, " + std::to_string(relexed) + " re-lexed after a comment."
+        );
+
+        pos_ = text_.size();
+        line_ = out.back().span.line;
+        column_ = out.back().span.column;
+        return true;
+    }
+
+    void Lexer::tokenize_chunk(LexedChunk& chunk) {
+        Lexer lexer(ctx_);
+        lexer.text_ = text_.substr(chunk.begin_, chunk.end_ - chunk.begin_);
+        lexer.deferred_lengths_ = &chunk.literal_lengths_;
+        lexer.deferred_hashes_ = &chunk.identifier_hashes_;
+        chunk.tokens_.clear();
+        chunk.literal_lengths_.clear();
+        chunk.identifier_hashes_.clear();
+        chunk.errors_.clear();
+        if (chunk.starts_in_comment_) {
+            lexer.consume_multiline_comment();
+        }
+
+        TokenLexeme token = lexer.next_token();
+        while (token.type != TokenType::END) {
+            chunk.tokens_.push_back(token);
+            token = lexer.next_token();
+        }
+        chunk.end_token_ = token;
+        chunk.ends_in_comment_ = lexer.in_comment_;
+        chunk.errors_ = std::move(lexer.errors_);
+    }
+
+    const std::vector<LexerError>& Lexer::get_errors() const {
+        return errors_;
+    }
+
+    const StringLiteral& Lexer::get_string_literal(const u64 id) const {
+        assert(id < string_literals_.size());
+        return string_literals_[id];
     }
 
     TokenLexeme Lexer::next_token() {
@@ -81,17 +309,20 @@ namespace solara {
         return token;
     }
 
-    char Lexer::peek(const u32 offset) const {
-        const size_t s = source_.size();
+    char Lexer::peek(const u32 offset) {
+        const size_t s = text_.size();
         const u64 i = pos_ + offset;
         if (i < s) {
-            return source_.at(i);
+            return text_[i];
+        }
+        if (stream_ && fill(offset)) {
+            return text_[pos_ + offset];
         }
         return '\0';
     }
 
-    bool Lexer::has_next(const u32 offset) const {
-        return (pos_ + offset) < source_.size();
+    bool Lexer::has_next(const u32 offset) {
+        return (pos_ + offset) < text_.size() || (stream_ && fill(offset));
     }
 
     TokenLexeme Lexer::tokenize() {
@@ -103,100 +334,74 @@ namespace solara {
 
         // clear and handle white spaces
         while (is_white_space(c)) {
-            pos_++;
+            if (!has_next()) {
+                return create_end_token();
+            }
+            advance(1);
             if (c == '\n') {
                 newline();
             }
             c = peek(0);
         }
 
-        // generate identifiers or keywords
-        if (is_letter(c)) {
-            u64 i = 1;
+        // generate identifiers or keywords, staying on ASCII until a high-bit byte shows up, and hashing each
+        // byte as it is scanned so neither the keyword check nor the string table reads the word again
+        const u32 start = is_letter(c) ? 1 : is_high_bit(c) ? get_xid_length(0, true) : 0;
+        if (start != 0) {
+            u64 hash = STRING_HASH_SEED;
+            for (u32 b = 0; b < start; b++) {
+                hash = hash_string_step(hash, peek(b));
+            }
+            u64 i = start;
             c = peek(i);
-            while (is_letter(c) || is_unicode_digit(c)) {
-                i++;
+            for (;;) {
+                if (is_letter(c) || is_ascii_digit(c)) {
+                    hash = hash_string_step(hash, c);
+                    i++;
+                } else if (const u32 length = is_high_bit(c) ? get_xid_length(i, false) : 0) {
+                    for (u32 b = 0; b < length; b++) {
+                        hash = hash_string_step(hash, peek(static_cast<u32>(i + b)));
+                    }
+                    i += length;
+                } else {
+                    break;
+                }
                 c = peek(i);
             }
-            return create_keyword_token(i);
+            return create_keyword_token(i, hash);
         }
 
         // generate number literals
-        if (is_unicode_digit(c) || c == '.') {
-            enum {
-                FlagDecimal         = 1 << 0,
-                FlagOctal           = 1 << 1,
-                FlagHexadecimal     = 1 << 2,
-                FlagFloatingPoint   = 1 << 3
-            };
-
-            u08 flags = 0;
-            u64 i = 1;
-
-            if (c >= '1' && c <= '9') {
-                flags |= FlagDecimal;
-            } else if (c == '0') {
-                c = peek(i);
-                i++;
-                if (is_octal_digit(c)) {
-                    flags |= FlagOctal;
-                } else if (c == 'x' || c == 'X') {
-                    c = peek(i);
+        if (is_ascii_digit(c) || (c == '.' && is_decimal_digit(peek(1)))) {
+            TokenType type = TokenType::LIT_INT;
+            u64 i = 0;
+
+            if (c == '0' && (peek(1) == 'x' || peek(1) == 'X')) {
+                i = 2;
+                while (is_hexadecimal_digit(peek(i))) {
                     i++;
-                    if (is_hexadecimal_digit(c)) {
-                        flags |= FlagHexadecimal;
-                    } else {
-                        // TODO: error
-                    }
-                } else if (!is_decimal_digit(c)) {
-                    // might still be octal "0" or floating point if '.' is found
-                    flags |= FlagOctal;
                 }
-            } else if (c == '.') {
-                c = peek(i);
-                i++;
-                if (is_decimal_digit(c)) {
-                    flags |= FlagFloatingPoint;
-                } else {
-                    // TODO: error
+            } else {
+                // octal literals share the decimal scan, their base is resolved from the leading '0'
+                while (is_decimal_digit(peek(i))) {
+                    i++;
                 }
-            }
-
-            c = peek(i);
-
-            while (!is_white_space(c)) {
-                if (is_decimal_digit(c)) {
-                    if (is_octal_digit(c)) {
-
-                    } else {
-                        if (flags & FlagOctal) {
-                            // TODO: error - incorrect octal scan
-                        }
-                    }
-                } else if (is_hexadecimal_digit(c)) {
-                    if (flags & FlagHexadecimal) {
-                        
-                    } else {
-                        // TODO: error - hexadecimal was not being scanned
+                if (peek(i) == '.') {
+                    type = TokenType::LIT_FLOAT;
+                    i++;
+                    while (is_decimal_digit(peek(i))) {
+                        i++;
                     }
-                } else if (c == '.') {
-                    if (flags & FlagFloatingPoint) {
-                        // TODO: error - point has already been scanned
-                    } else if (flags & FlagHexadecimal) {
-                        // TODO: error - hexadecimal was being scanned
-                    } else {
-                        flags |= FlagFloatingPoint;
+                } else if (c == '0') {
+                    for (u64 j = 1; j < i; j++) {
+                        if (!is_octal_digit(peek(j))) {
+                            error({ line_, column_ + j }, "invalid digit in octal literal");
+                            break;
+                        }
                     }
-                } else if (is_white_space(c)) {
-                    
-                } else {
-
                 }
-
-                i++;
-                c = peek(i);
             }
-            return create_token(TokenType::LIT_INT, i - 1);
+            return create_token(type, i);
         }
 
         if (c == '/') {
@@ -328,6 +533,10 @@ namespace solara {
             }
         }
 
+        if (c == '"') {
+            return tokenize_string();
+        }
+
         // punctuation
         if (c == '(') {
             return create_token(TokenType::LPAR, 1);
@@ -360,21 +569,44 @@ namespace solara {
             return create_token(TokenType::SEMICOLON, 1);
         }
 
-        pos_++;
+        // a code point that fits nowhere is skipped whole, as one column
+        u32 length = 1;
+        if (is_high_bit(c)) {
+            decode(0, length);
+        }
+        pos_ += length;
         column_++;
 
         return create_invalid_token();
     }
 
+    /** Decodes the code point at an offset, fetching the rest of its sequence into a streamed window first. */
+    u32 Lexer::decode(const u64 offset, u32& out_length) {
+        const u08 lead = static_cast<u08>(peek(static_cast<u32>(offset)));
+        has_next(static_cast<u32>(offset + (lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0)));
+        return decode_utf8(text_, pos_ + offset, out_length);
+    }
+
+    /** @returns The length of the code point at an offset if it can start or continue an identifier, else 0. */
+    u32 Lexer::get_xid_length(const u64 offset, const bool start) {
+        u32 length;
+        const u32 code_point = decode(offset, length);
+        return (start ? is_xid_start(code_point) : is_xid_continue(code_point)) ? length : 0;
+    }
+
     TokenLexeme Lexer::create_token(const TokenType type, u64 length) {
         TokenLexeme token;
         token.type = type;
+        token.literal_id = 0;
         token.span.line = line_;
         token.span.column = column_;
 
-        if (token_has_value(type)) {
+        if (token_has_value(type) && deferred_lengths_) {
+            token.literal_id = pos_;
+            deferred_lengths_->push_back(static_cast<u32>(length));
+        } else if (token_has_value(type)) {
             const u64 begin = pos_;
-            const std::string_view view = source_;
+            const std::string_view view = text_;
             const std::string_view token_literal = view.substr(begin, length);
             const u64 tok_lit_id = ctx_->string_table_.add(token_literal);
             token.literal_id = tok_lit_id;
@@ -386,15 +618,22 @@ namespace solara {
         return token;
     }
 
-    TokenLexeme Lexer::create_keyword_token(const u64 length) {
+    TokenLexeme Lexer::create_keyword_token(const u64 length, const u64 hash) {
         const u64 begin = pos_;
-        const std::string_view source_view = source_;
+        const std::string_view source_view = text_;
         const std::string_view token_view = source_view.substr(begin, length);
 
         TokenLexeme out;
-        out.type = identify_keyword(token_view);
-        if (out.type == TokenType::IDENTIFIER) {
-            out.literal_id = ctx_->string_table_.add(token_view);
+        out.type = identify_keyword(token_view, hash);
+        out.literal_id = 0;
+        out.span.line = line_;
+        out.span.column = column_;
+        if (out.type == TokenType::IDENTIFIER && deferred_lengths_) {
+            out.literal_id = pos_;
+            deferred_lengths_->push_back(static_cast<u32>(length));
+            deferred_hashes_->push_back(hash);
+        } else if (out.type == TokenType::IDENTIFIER) {
+            out.literal_id = ctx_->string_table_.add_prehashed(token_view, hash);
         }
 
         pos_ += length;
@@ -403,15 +642,122 @@ namespace solara {
         return out;
     }
 
+    /**
+     * Lexes a string literal from its opening quote. The scan jumps between quotes, backslashes and newlines,
+     * and escapes are only checked, so the literal's text is left in place. A literal is ended by its line.
+     */
+    TokenLexeme Lexer::tokenize_string() {
+        const TokenSourceSpan span = { line_, column_ };
+        u64 i = 1;
+        bool terminated = false;
+        for (;;) {
+            const u64 found = find_string_delimiter(text_, pos_ + i);
+            if (found == std::string_view::npos) {
+                i = text_.size() - pos_;
+                if (has_next(static_cast<u32>(i))) {
+                    continue;
+                }
+                break;
+            }
+            i = found - pos_;
+            const char c = text_[found];
+            if (c == '"') {
+                terminated = true;
+                break;
+            }
+            if (c == '\n') {
+                break;
+            }
+            i += check_escape(i);
+        }
+        if (!terminated) {
+            error(span, "unterminated string literal");
+        }
+
+        TokenLexeme token;
+        token.type = TokenType::LIT_STRING;
+        token.span = span;
+        const std::string_view text = text_.substr(pos_ + 1, i - 1);
+        if (deferred_lengths_) {
+            token.literal_id = pos_ + 1;
+            deferred_lengths_->push_back(static_cast<u32>(text.size()));
+        } else {
+            token.literal_id = add_string_literal(text);
+        }
+
+        const u64 length = terminated ? i + 1 : i;
+        pos_ += length;
+        column_ += length;
+        return token;
+    }
+
+    /**
+     * Checks the escape sequence at an offset from pos_, one of \n \t \r \0 \\ \" \' \xHH or \u{H...}.
+     * @returns Its length, reaching past a malformed sequence up to the next character, but never a newline.
+     */
+    u32 Lexer::check_escape(const u64 offset) {
+        const TokenSourceSpan span = { line_, column_ + offset };
+        const char c = peek(static_cast<u32>(offset + 1));
+        switch (c) {
+            case 'n': case 't': case 'r': case '0': case '\\': case '"': case '\'':
+                return 2;
+            case 'x':
+                if (is_hexadecimal_digit(peek(static_cast<u32>(offset + 2))) && is_hexadecimal_digit(peek(static_cast<u32>(offset + 3)))) {
+                    return 4;
+                }
+                error(span, "\\x escape needs two hexadecimal digits");
+                return 2;
+            case 'u': {
+                u32 i = 2;
+                u32 value = 0;
+                if (peek(static_cast<u32>(offset + i)) == '{') {
+                    i++;
+                    while (i < 9 && is_hexadecimal_digit(peek(static_cast<u32>(offset + i)))) {
+                        const char digit = peek(static_cast<u32>(offset + i));
+                        value = value * 16 + static_cast<u32>(is_ascii_digit(digit) ? digit - '0' : (digit | 0x20) - 'a' + 10);
+                        i++;
+                    }
+                    if (i > 3 && peek(static_cast<u32>(offset + i)) == '}' && value <= 0x10FFFF && (value < 0xD800 || value > 0xDFFF)) {
+                        return i + 1;
+                    }
+                }
+                error(span, "\\u escape needs a code point as {H...}, at most U+10FFFF and not a surrogate");
+                return 2;
+            }
+            default:
+                error(span, "unknown escape sequence");
+                return c == '\n' || !has_next(static_cast<u32>(offset + 1)) ? 1 : 2;
+        }
+    }
+
+    /** Interns a literal's raw text as a view, copied first only when the source is streamed. */
+    u64 Lexer::add_string_literal(const std::string_view text) {
+        auto it = string_literal_ids_.find(text);
+        if (it != string_literal_ids_.end()) {
+            return it->second;
+        }
+        const std::string_view view = stream_ ? std::string_view(retained_literals_.emplace_back(text)) : text;
+        const u64 id = string_literals_.size();
+        string_literals_.push_back({ view, view.find('\\') != std::string_view::npos });
+        string_literal_ids_.emplace(view, id);
+        return id;
+    }
+
     TokenLexeme Lexer::create_end_token() {
         TokenLexeme out;
         out.type = TokenType::END;
+        out.literal_id = 0;
+        out.span.line = line_;
+        out.span.column = column_;
         return out;
     }
 
     TokenLexeme Lexer::create_invalid_token() {
         TokenLexeme out;
         out.type = TokenType::NONE;
+        out.literal_id = 0;
+        out.span.line = line_;
+        out.span.column = column_;
         return out;
     }
 
@@ -425,30 +771,91 @@ namespace solara {
         column_ = 0;
     }
 
+    // comments move pos_ along as they are scanned, so a streamed window never has to hold a whole comment
+
     void Lexer::consume_singleline_comment() {
-        u64 i = 0;
-        char c = peek(i);
-        while (!is_newline(c)) {
-            i++;
-            c = peek(i);
+        while (has_next() && !is_newline(peek())) {
+            pos_++;
         }
-        pos_ += i;
     }
 
     void Lexer::consume_multiline_comment() {
-        u64 i = 0;
-        while (has_next(i)) {
-            char c = peek(i);
-            i++;
-            if (c == '*') {
-                c = peek(i);
-                i++;
-                if (c == '/') {
-                    break;
+        in_comment_ = true;
+        while (has_next()) {
+            const char c = peek();
+            pos_++;
+            if (c == '\n') {
+                newline();
+            } else if (c == '*' && peek() == '/') {
+                pos_++;
+                in_comment_ = false;
+                break;
+            }
+        }
+    }
+
+    /**
+     * Drops the consumed and validated part of a streamed window and appends chunks until it holds the byte at
+     * an offset from pos_. Tokens never refer back before pos_, so a token or comment split across chunks is simply
+     * joined in the window.
+     * @returns False once the stream has ended before that byte.
+     */
+    bool Lexer::fill(const u64 offset) {
+        // bytes not yet validated stay, even once lexed, so a sequence split between chunks is checked whole
+        const u64 consumed = std::min(pos_, validated_);
+        source_.erase(0, consumed);
+        text_ = source_;
+        validated_ -= consumed;
+        pos_ -= consumed;
+        while (pos_ + offset >= source_.size()) {
+            const std::string_view chunk = stream_->acquire();
+            if (chunk.empty()) {
+                // a failed read must not pass for the end of the source, or a truncated module would compile
+                if (!stream_->get_error().empty()) {
+                    error({ line_, column_ }, stream_->get_error());
                 }
+                // a sequence cut short by the end of the stream is an error too
+                stream_ = nullptr;
+                validate_utf8(validated_);
+                return false;
             }
+            source_.append(chunk);
+            text_ = source_;
+            stream_->release();
+            validate_utf8(validated_);
         }
-        pos_ += i;
+        return true;
+    }
+
+    /**
+     * Checks the text from an offset on and records the position of the first malformed byte, counted from
+     * the current position. A streamed window leaves out a sequence its last chunk cuts short, until the
+     * rest has arrived.
+     */
+    void Lexer::validate_utf8(const u64 begin) {
+        std::string_view rest = text_.substr(begin);
+        if (stream_) {
+            rest.remove_suffix(get_incomplete_utf8_tail(rest));
+        }
+        validated_ = begin + rest.size();
+        const u64 invalid = utf8_error_ ? std::string_view::npos : find_invalid_utf8(rest);
+        if (invalid == std::string_view::npos) {
+            return;
+        }
+
+        // a malformed sequence already lexed over, at most three bytes back on the same line, is reported here
+        const u64 offset = std::max(begin + invalid, pos_);
+        const std::string_view before = text_.substr(pos_, offset - pos_);
+        const u64 last_newline = before.rfind('\n');
+        TokenSourceSpan span;
+        span.line = line_ + static_cast<u64>(std::count(before.begin(), before.end(), '\n'));
+        span.column = last_newline == std::string_view::npos ? column_ + before.size() : before.size() - last_newline - 1;
+        utf8_error_ = true;
+        error(span, "source is not valid UTF-8");
+    }
+
+    void Lexer::error(const TokenSourceSpan& span, const std::string& message) {
+        errors_.push_back({ span, message });
     }
 
 } /* solara */
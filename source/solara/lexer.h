@@ -7,35 +7,140 @@
 #include "common.h"
 #include "token.h"
 #include "solara.h"
+#include "sourcestream.h"
 
+#include <deque>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
 
 namespace solara {
 
+    /**
+     * Raw text of a string literal between its quotes. It views the source buffer, which the lexer keeps for
+     * as long as it lives, or a copy the lexer retains when the source is streamed.
+     */
+    struct StringLiteral {
+        std::string_view text_;
+        bool has_escapes_ = false;
+    };
+
+    struct LexerError {
+        TokenSourceSpan span_;
+        std::string message_;
+    };
+
+    /** @returns The value of a string literal's raw text, with its escapes, already checked by the lexer, decoded. */
+    std::string decode_string_escapes(const std::string_view text);
+
     class Lexer {
     public:
         Lexer(CompilerContext* ctx);
 
         void init(const std::filesystem::path& path);
+
+        /** Lexes a copy of source text that was already read, such as a file a query engine holds as an input. */
+        void init_text(const std::string_view text);
+
+        /**
+         * Lexes a stream instead of a whole file. Only a window from the current token on is kept, and it is
+         * refilled from the stream's chunks when a token or comment runs past its end.
+         */
+        void init(SourceStream* stream);
+
+        /**
+         * Lexes the rest of the source into a buffer ending with the END token. A large file is lexed in
+         * parallel chunks, with the same tokens, positions and string table entries as a serial run.
+         */
+        void tokenize_all(std::pmr::vector<TokenLexeme>& out);
+
+        /**
+         * Errors found while lexing: malformed string literals, and the first malformed UTF-8
+         * byte, since the source is checked to be UTF-8 before it is lexed, or as it arrives when streamed.
+         */
+        const std::vector<LexerError>& get_errors() const;
+
+        /**
+         * String literal tokens carry an index into the lexer's literals rather than a string table id, so their
+         * text is never copied. Literals with the same raw text share an index.
+         */
+        const StringLiteral& get_string_literal(const u64 id) const;
         TokenLexeme next_token();
-        char peek(const u32 offset = 0) const;
-        bool has_next(const u32 offset = 0) const;
+        char peek(const u32 offset = 0);
+        bool has_next(const u32 offset = 0);
+
+        /** Sources at least this large are split into chunks and lexed in parallel. */
+        static constexpr u64 PARALLEL_SIZE = 4 << 20;
+        static constexpr u64 MIN_CHUNK_SIZE = 1 << 20;
 
     protected:
+        /** Tokens of a chunk with positions relative to its start and literals not yet interned. */
+        struct LexedChunk {
+            LexedChunk(std::pmr::memory_resource* resource)
+                : tokens_(resource)
+            {}
+
+            u64 begin_ = 0;
+            u64 end_ = 0;
+            std::pmr::vector<TokenLexeme> tokens_;
+            std::vector<u32> literal_lengths_;
+            std::vector<u64> identifier_hashes_;
+            std::vector<LexerError> errors_;
+            TokenLexeme end_token_ = {};
+            bool starts_in_comment_ = false;
+            bool ends_in_comment_ = false;
+        };
+
+        bool tokenize_parallel(std::pmr::vector<TokenLexeme>& out);
+        void tokenize_chunk(LexedChunk& chunk);
         TokenLexeme tokenize();
+        TokenLexeme tokenize_string();
+        u32 check_escape(const u64 offset);
+        u64 add_string_literal(const std::string_view text);
+        void error(const TokenSourceSpan& span, const std::string& message);
         TokenLexeme create_token(const TokenType type, u64 length);
-        TokenLexeme create_keyword_token(const u64 length);
+        TokenLexeme create_keyword_token(const u64 length, const u64 hash);
         TokenLexeme create_end_token();
         TokenLexeme create_invalid_token();
         void advance(const u32 amount);
         void newline();
         void consume_singleline_comment();
         void consume_multiline_comment();
+        bool fill(const u64 offset);
+        u32 decode(const u64 offset, u32& out_length);
+        u32 get_xid_length(const u64 offset, const bool start);
+        void validate_utf8(const u64 begin);
+        void reset_literals();
 
     private:
         CompilerContext* ctx_;
-        std::string source_;
+        std::pmr::string source_;
+
+        /** The part of the source being lexed: all of it, or one chunk of another lexer's source. */
+        std::string_view text_;
+        SourceStream* stream_ = nullptr;
+
+        /** Set while a block comment is open, so a chunk can tell whether it ended inside one. */
+        bool in_comment_ = false;
+
+        u64 validated_ = 0;
+        bool utf8_error_ = false;
+        std::vector<LexerError> errors_;
+
+        std::vector<StringLiteral> string_literals_;
+        std::unordered_map<std::string_view, u64> string_literal_ids_;
+
+        /** Copies of the string literals of a streamed source, whose window does not outlive them. */
+        std::deque<std::string> retained_literals_;
+
+        /** When set, literals are left to the caller: literal ids hold offsets and their lengths go here. */
+        std::vector<u32>* deferred_lengths_ = nullptr;
+
+        /** The hashes of deferred identifiers, taken while scanning them, so the serial merge need not rehash. */
+        std::vector<u64>* deferred_hashes_ = nullptr;
         u64 pos_ = 0;
         u64 column_ = 0;
         u64 line_ = 0;
@@ -39,6 +39,8 @@ namespace solara {
     }
 
     void Logger::log(const LogLevel level, const std::string& message) {
+        // localtime shares its result between threads, so the lock is taken before it
+        std::lock_guard<std::mutex> lock(mutex_);
         time_t now = time(0);
         tm* timeinfo = localtime(&now);
         char timestamp[20];
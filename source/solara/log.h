@@ -8,6 +8,7 @@
 
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <string>
 
 namespace solara {
@@ -20,6 +21,9 @@ namespace solara {
         CRITICAL
     };
 
+    /**
+     * Writes messages to the standard output and the log file. Messages from concurrent threads never interleave.
+     */
     class Logger {
     public:
         Logger(const std::filesystem::path& path);
@@ -28,6 +32,7 @@ namespace solara {
         void log(const LogLevel level, const std::string& message);
 
     private:
+        std::mutex mutex_;
         std::ofstream output_file_;
     };
 
@@ -0,0 +1,575 @@
+/**
+ * @file lowering.cpp
+ */
+
+#include "lowering.h"
+#include "bytecode.h"
+
+#include <string>
+
+namespace solara {
+
+    static Opcode binary_opcode(const BinaryOperation op) {
+        switch (op) {
+            case BinaryOperation::ADD:
+            case BinaryOperation::ADD_ASSIGN:
+                return Opcode::Add;
+            case BinaryOperation::SUB:
+            case BinaryOperation::SUB_ASSIGN:
+                return Opcode::Sub;
+            case BinaryOperation::MUL:
+            case BinaryOperation::MUL_ASSIGN:
+                return Opcode::Mul;
+            case BinaryOperation::DIV:
+            case BinaryOperation::DIV_ASSIGN:
+                return Opcode::Div;
+            case BinaryOperation::MOD:
+            case BinaryOperation::MOD_ASSIGN:
+                return Opcode::Rem;
+            case BinaryOperation::EQ: return Opcode::Eq;
+            case BinaryOperation::NEQ: return Opcode::Ne;
+            case BinaryOperation::LT: return Opcode::Lt;
+            case BinaryOperation::GT: return Opcode::Gt;
+            case BinaryOperation::LE: return Opcode::Le;
+            case BinaryOperation::GE: return Opcode::Ge;
+            default: return Opcode::Nop;
+        }
+    }
+
+    IrLowering::IrLowering(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        types_ = &ctx->type_table_;
+        bool_type_ = types_->get_bool_type();
+    }
+
+    IrModule IrLowering::lower(ModuleDeclNode* module) {
+        IrModule out = declare(module);
+        if (!module) {
+            return out;
+        }
+        u32 index = 0;
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                lower_function(function, out.functions_[index++]);
+            }
+        }
+        return out;
+    }
+
+    IrModule IrLowering::declare(ModuleDeclNode* module) {
+        IrModule out;
+        function_indices_.clear();
+        if (!module) {
+            return out;
+        }
+        out.name_id_ = module->name_id_;
+
+        // functions are numbered first so calls can target functions declared later
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                function_indices_[function] = static_cast<u32>(out.functions_.size());
+                out.functions_.emplace_back(function->name_id_, function->type_id_, function->pub_);
+            }
+        }
+
+        // imported functions are declarations under their qualified name, which the linker binds to the definition
+        for (ImportDeclNode* import : module->imports_) {
+            const std::string prefix = std::string(ctx_->string_table_.get_string(import->name_id_)) + ".";
+            for (SyntaxNodeHandle decl : import->module_->decls_) {
+                auto function = syntax_node_cast<FunctionDeclNode>(decl);
+                if (function && function->pub_) {
+                    const u64 name_id = ctx_->string_table_.add(prefix + std::string(ctx_->string_table_.get_string(function->name_id_)));
+                    function_indices_[function] = static_cast<u32>(out.functions_.size());
+                    out.functions_.emplace_back(name_id, function->type_id_, true);
+                }
+            }
+        }
+        return out;
+    }
+
+    u32 IrLowering::get_function_index(const FunctionDeclNode* function) const {
+        const auto it = function_indices_.find(function);
+        return it != function_indices_.end() ? it->second : ~0u;
+    }
+
+    /**
+     * Lowers a single function. A function whose body was never parsed is left without blocks and acts as a declaration.
+     */
+    void IrLowering::lower_function(FunctionDeclNode* function, IrFunction& out) {
+        if (!function->body_) {
+            return;
+        }
+
+        function_ = &out;
+        block_states_.clear();
+        variables_.clear();
+        variable_types_.clear();
+        definitions_.clear();
+        phis_.clear();
+        loops_.clear();
+
+        block_ = new_block();
+        seal_block(block_);
+
+        for (u64 i = 0; i < function->params_.size(); i++) {
+            ParamDeclNode* param = function->params_[i];
+            const ValueId value = emit(Opcode::Param, param->type_id_);
+            function_->insts_[value].imm_.index_ = static_cast<u32>(i);
+            write_variable(get_variable(param), block_, value);
+        }
+
+        lower_statement(function->body_);
+
+        // falling off the end returns the zero value of the return type
+        const TypeId return_type = types_->get_info(function->type_id_).return_type;
+        if (types_->get_info(return_type).kind == TypeKind::Void) {
+            emit_ret(NO_VALUE);
+        } else {
+            emit_ret(emit_const(return_type, 0));
+        }
+
+        // phis can only become trivial after their operands were folded, so sweep until nothing changes
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (ValueId phi : phis_) {
+                if (function_->insts_[phi].op_ == Opcode::Phi && try_remove_trivial_phi(phi) != phi) {
+                    changed = true;
+                }
+            }
+        }
+
+        function_->linearize();
+        function_ = nullptr;
+    }
+
+    void IrLowering::lower_statement(SyntaxNodeHandle stmt) {
+        if (!stmt) {
+            return;
+        }
+
+        switch (stmt->get_type()) {
+            case SyntaxNodeType::CompoundStmt: {
+                auto node = static_cast<CompoundStmtNode*>(stmt);
+                for (SyntaxNodeHandle child : node->stmts_) {
+                    lower_statement(child);
+                }
+                break;
+            }
+            case SyntaxNodeType::VarDecl: {
+                auto node = static_cast<VarDeclNode*>(stmt);
+                if (node->const_) {
+                    // its value was computed while checking and is emitted where it is read
+                    break;
+                }
+                const ValueId value = node->init_ ? lower_expression(node->init_) : emit_const(node->type_id_, 0);
+                write_variable(get_variable(node), block_, value);
+                break;
+            }
+            case SyntaxNodeType::ExprStmt:
+                lower_expression(static_cast<ExprStmtNode*>(stmt)->expr_);
+                break;
+            case SyntaxNodeType::ReturnStmt: {
+                auto node = static_cast<ReturnStmtNode*>(stmt);
+                emit_ret(node->expr_ ? lower_expression(node->expr_) : NO_VALUE);
+                start_unreachable_block();
+                break;
+            }
+            case SyntaxNodeType::IfStmt:
+                lower_if(static_cast<IfStmtNode*>(stmt));
+                break;
+            case SyntaxNodeType::ForStmt:
+                lower_for(static_cast<ForStmtNode*>(stmt));
+                break;
+            case SyntaxNodeType::BreakStmt:
+                if (!loops_.empty()) {
+                    emit_br(loops_.back().break_);
+                    start_unreachable_block();
+                }
+                break;
+            case SyntaxNodeType::ContinueStmt:
+                if (!loops_.empty()) {
+                    emit_br(loops_.back().continue_);
+                    start_unreachable_block();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void IrLowering::lower_if(IfStmtNode* stmt) {
+        const ValueId cond = lower_expression(stmt->cond_);
+        const BlockId then = new_block();
+        const BlockId merge = new_block();
+        const BlockId otherwise = stmt->else_ ? new_block() : merge;
+
+        emit_condbr(cond, then, otherwise);
+        seal_block(then);
+        if (otherwise != merge) {
+            seal_block(otherwise);
+        }
+
+        block_ = then;
+        lower_statement(stmt->then_);
+        emit_br(merge);
+
+        if (otherwise != merge) {
+            block_ = otherwise;
+            lower_statement(stmt->else_);
+            emit_br(merge);
+        }
+
+        seal_block(merge);
+        block_ = merge;
+    }
+
+    /**
+     * Lowers a loop to a header testing the condition, the body, a latch running the post statement and an exit.
+     * The header and the latch stay unsealed until every back edge and continue has been seen.
+     */
+    void IrLowering::lower_for(ForStmtNode* stmt) {
+        lower_statement(stmt->init_);
+
+        const BlockId header = new_block();
+        const BlockId body = new_block();
+        const BlockId latch = new_block();
+        const BlockId exit = new_block();
+
+        emit_br(header);
+        block_ = header;
+        if (stmt->cond_) {
+            emit_condbr(lower_expression(stmt->cond_), body, exit);
+        } else {
+            emit_br(body);
+        }
+        seal_block(body);
+
+        loops_.push_back({ exit, latch });
+        block_ = body;
+        lower_statement(stmt->body_);
+        emit_br(latch);
+        loops_.pop_back();
+
+        seal_block(latch);
+        block_ = latch;
+        if (stmt->post_) {
+            lower_expression(stmt->post_);
+        }
+        emit_br(header);
+
+        seal_block(header);
+        seal_block(exit);
+        block_ = exit;
+    }
+
+    ValueId IrLowering::lower_expression(SyntaxNodeHandle expr) {
+        switch (expr->get_type()) {
+            case SyntaxNodeType::LiteralExpr:
+                return lower_literal(static_cast<LiteralExprNode*>(expr));
+            case SyntaxNodeType::IdentifierExpr: {
+                auto node = static_cast<IdentifierExprNode*>(expr);
+                if (auto constant = syntax_node_cast<VarDeclNode>(node->decl_); constant && constant->const_) {
+                    return lower_constant(constant);
+                }
+                return read_variable(get_variable(node->decl_), block_);
+            }
+            case SyntaxNodeType::BinaryExpr:
+                return lower_binary(static_cast<BinaryExprNode*>(expr));
+            case SyntaxNodeType::UnaryExpr:
+                return lower_unary(static_cast<UnaryExprNode*>(expr));
+            case SyntaxNodeType::CallExpr:
+                return lower_call(static_cast<CallExprNode*>(expr));
+            default:
+                return emit(Opcode::Undef, expr->type_id_);
+        }
+    }
+
+    ValueId IrLowering::lower_binary(BinaryExprNode* expr) {
+        switch (expr->op_) {
+            case BinaryOperation::AND:
+            case BinaryOperation::OR:
+                return lower_logical(expr);
+            case BinaryOperation::ASSIGN: {
+                auto target = static_cast<IdentifierExprNode*>(expr->left_);
+                const ValueId value = lower_expression(expr->right_);
+                write_variable(get_variable(target->decl_), block_, value);
+                return value;
+            }
+            case BinaryOperation::ADD_ASSIGN:
+            case BinaryOperation::SUB_ASSIGN:
+            case BinaryOperation::MUL_ASSIGN:
+            case BinaryOperation::DIV_ASSIGN:
+            case BinaryOperation::MOD_ASSIGN: {
+                auto target = static_cast<IdentifierExprNode*>(expr->left_);
+                const u32 variable = get_variable(target->decl_);
+                const ValueId current = read_variable(variable, block_);
+                const ValueId operands[2] = { current, lower_expression(expr->right_) };
+                const ValueId value = emit(binary_opcode(expr->op_), expr->type_id_, operands);
+                write_variable(variable, block_, value);
+                return value;
+            }
+            default: {
+                const ValueId operands[2] = { lower_expression(expr->left_), lower_expression(expr->right_) };
+                return emit(binary_opcode(expr->op_), expr->type_id_, operands);
+            }
+        }
+    }
+
+    /**
+     * Short-circuits `&&` and `||`: the right operand gets its own block and the result is merged with a phi.
+     */
+    ValueId IrLowering::lower_logical(BinaryExprNode* expr) {
+        const ValueId left = lower_expression(expr->left_);
+        const BlockId right_block = new_block();
+        const BlockId merge = new_block();
+
+        if (expr->op_ == BinaryOperation::AND) {
+            emit_condbr(left, right_block, merge);
+        } else {
+            emit_condbr(left, merge, right_block);
+        }
+        seal_block(right_block);
+
+        block_ = right_block;
+        const ValueId right = lower_expression(expr->right_);
+        emit_br(merge);
+
+        seal_block(merge);
+        block_ = merge;
+
+        // the merge block lists its predecessors in edge order, the left operand's block first
+        const ValueId operands[2] = { left, right };
+        const ValueId phi = emit(Opcode::Phi, bool_type_, operands);
+        phis_.push_back(phi);
+        return phi;
+    }
+
+    ValueId IrLowering::lower_unary(UnaryExprNode* expr) {
+        switch (expr->op_) {
+            case UnaryOperation::NEG: {
+                const ValueId operand = lower_expression(expr->expr_);
+                return emit(Opcode::Neg, expr->type_id_, std::span<const ValueId>(&operand, 1));
+            }
+            case UnaryOperation::NOT: {
+                const ValueId operand = lower_expression(expr->expr_);
+                return emit(Opcode::Not, expr->type_id_, std::span<const ValueId>(&operand, 1));
+            }
+            case UnaryOperation::INC:
+            case UnaryOperation::DEC: {
+                auto target = static_cast<IdentifierExprNode*>(expr->expr_);
+                const u32 variable = get_variable(target->decl_);
+                const ValueId operands[2] = { read_variable(variable, block_), emit_const(expr->type_id_, 1) };
+                const ValueId value = emit(expr->op_ == UnaryOperation::INC ? Opcode::Add : Opcode::Sub, expr->type_id_, operands);
+                write_variable(variable, block_, value);
+                return value;
+            }
+            default:
+                return emit(Opcode::Undef, expr->type_id_);
+        }
+    }
+
+    ValueId IrLowering::lower_call(CallExprNode* expr) {
+        std::vector<ValueId> args;
+        args.reserve(expr->args_.size());
+        for (SyntaxNodeHandle arg : expr->args_) {
+            args.push_back(lower_expression(arg));
+        }
+
+        u32 callee = ~0u;
+        if (auto identifier = syntax_node_cast<IdentifierExprNode>(expr->callee_)) {
+            auto it = function_indices_.find(syntax_node_cast<FunctionDeclNode>(identifier->decl_));
+            if (it != function_indices_.end()) {
+                callee = it->second;
+            }
+        }
+
+        const ValueId value = emit(Opcode::Call, expr->type_id_, args);
+        function_->insts_[value].imm_.index_ = callee;
+        return value;
+    }
+
+    ValueId IrLowering::lower_literal(LiteralExprNode* expr) {
+        const std::string_view text = ctx_->string_table_.get_string(expr->literal_id_);
+        const ValueId value = emit(Opcode::Const, expr->type_id_);
+        Instruction& inst = function_->insts_[value];
+        if (types_->get_info(expr->type_id_).kind == TypeKind::Float) {
+            inst.imm_.float_ = parse_float_literal(expr->literal_type_, text);
+        } else {
+            inst.imm_.int_ = static_cast<i64>(parse_integer_literal(text));
+        }
+        return value;
+    }
+
+    /** A constant is read as the value its initializer evaluated to, kept in register form. */
+    ValueId IrLowering::lower_constant(VarDeclNode* decl) {
+        assert(decl->evaluated_);
+        VmValue constant;
+        constant.int_ = decl->value_;
+
+        const TypeInfo& info = types_->get_info(decl->type_id_);
+        const ValueId value = emit(Opcode::Const, decl->type_id_);
+        Instruction& inst = function_->insts_[value];
+        if (info.kind == TypeKind::Float && info.bits == 32) {
+            inst.imm_.float_ = constant.float32_;
+        } else if (info.kind == TypeKind::Float) {
+            inst.imm_.float_ = constant.float_;
+        } else {
+            inst.imm_.int_ = constant.int_;
+        }
+        return value;
+    }
+
+    ValueId IrLowering::emit(const Opcode op, const TypeId type, std::span<const ValueId> operands) {
+        return function_->append(block_, op, type, operands);
+    }
+
+    ValueId IrLowering::emit_const(const TypeId type, const i64 value) {
+        const ValueId id = emit(Opcode::Const, type);
+        if (types_->get_info(type).kind == TypeKind::Float) {
+            function_->insts_[id].imm_.float_ = static_cast<f64>(value);
+        } else {
+            function_->insts_[id].imm_.int_ = value;
+        }
+        return id;
+    }
+
+    void IrLowering::emit_br(const BlockId target) {
+        const ValueId id = emit(Opcode::Br, TypeTable::INVALID);
+        function_->insts_[id].imm_.targets_[0] = target;
+        if (!is_unreachable(block_)) {
+            function_->add_edge(block_, target);
+        }
+    }
+
+    void IrLowering::emit_condbr(const ValueId cond, const BlockId then, const BlockId otherwise) {
+        const ValueId id = emit(Opcode::CondBr, TypeTable::INVALID, std::span<const ValueId>(&cond, 1));
+        function_->insts_[id].imm_.targets_[0] = then;
+        function_->insts_[id].imm_.targets_[1] = otherwise;
+        if (!is_unreachable(block_)) {
+            function_->add_edge(block_, then);
+            function_->add_edge(block_, otherwise);
+        }
+    }
+
+    void IrLowering::emit_ret(const ValueId value) {
+        if (value == NO_VALUE) {
+            emit(Opcode::Ret, TypeTable::INVALID);
+        } else {
+            emit(Opcode::Ret, TypeTable::INVALID, std::span<const ValueId>(&value, 1));
+        }
+    }
+
+    BlockId IrLowering::new_block() {
+        block_states_.emplace_back();
+        return function_->add_block();
+    }
+
+    /**
+     * Continues emission after a jump in a block nothing branches to; linearize drops it later.
+     */
+    void IrLowering::start_unreachable_block() {
+        block_ = new_block();
+        seal_block(block_);
+    }
+
+    /**
+     * Checks if a block can never be entered. Edges out of such blocks are not recorded, so they cannot feed phis.
+     */
+    bool IrLowering::is_unreachable(const BlockId block) const {
+        return block != 0 && block_states_[block].sealed_ && function_->blocks_[block].preds_.empty();
+    }
+
+    u32 IrLowering::get_variable(SyntaxNodeHandle decl) {
+        auto it = variables_.find(decl);
+        if (it != variables_.end()) {
+            return it->second;
+        }
+        const u32 variable = static_cast<u32>(variable_types_.size());
+        variables_.emplace(decl, variable);
+        variable_types_.push_back(decl ? decl->type_id_ : TypeTable::INVALID);
+        return variable;
+    }
+
+    void IrLowering::write_variable(const u32 variable, const BlockId block, const ValueId value) {
+        definitions_[(static_cast<u64>(block) << 32) | variable] = value;
+    }
+
+    ValueId IrLowering::read_variable(const u32 variable, const BlockId block) {
+        auto it = definitions_.find((static_cast<u64>(block) << 32) | variable);
+        if (it != definitions_.end()) {
+            return function_->resolve(it->second);
+        }
+        return read_variable_recursive(variable, block);
+    }
+
+    ValueId IrLowering::read_variable_recursive(const u32 variable, const BlockId block) {
+        const auto& preds = function_->blocks_[block].preds_;
+        ValueId value;
+        if (!block_states_[block].sealed_) {
+            // the predecessors are not all known yet, the operands are filled in when the block is sealed
+            value = function_->append(block, Opcode::Phi, variable_types_[variable]);
+            phis_.push_back(value);
+            block_states_[block].incomplete_phis_.emplace_back(variable, value);
+        } else if (preds.size() == 1) {
+            value = read_variable(variable, preds[0]);
+        } else {
+            // the phi is written first so a cycle through a loop finds it instead of recursing forever
+            value = function_->append(block, Opcode::Phi, variable_types_[variable]);
+            phis_.push_back(value);
+            write_variable(variable, block, value);
+            value = add_phi_operands(variable, value);
+        }
+        write_variable(variable, block, value);
+        return value;
+    }
+
+    ValueId IrLowering::add_phi_operands(const u32 variable, const ValueId phi) {
+        const BlockId block = function_->insts_[phi].block_;
+        std::vector<ValueId> operands;
+        operands.reserve(function_->blocks_[block].preds_.size());
+        for (u64 i = 0; i < function_->blocks_[block].preds_.size(); i++) {
+            operands.push_back(read_variable(variable, function_->blocks_[block].preds_[i]));
+        }
+        function_->set_operands(phi, operands);
+        return try_remove_trivial_phi(phi);
+    }
+
+    /**
+     * Replaces a phi that merges a single value (besides itself) with that value.
+     * @returns The value the phi stands for after the check.
+     */
+    ValueId IrLowering::try_remove_trivial_phi(const ValueId phi) {
+        ValueId same = NO_VALUE;
+        for (ValueId operand : function_->get_operands(phi)) {
+            operand = function_->resolve(operand);
+            if (operand == same || operand == phi) {
+                continue;
+            }
+            if (same != NO_VALUE) {
+                return phi;
+            }
+            same = operand;
+        }
+
+        if (same == NO_VALUE) {
+            // only reachable through itself or from nowhere: the value is undefined
+            same = function_->append(0, Opcode::Undef, function_->insts_[phi].type_);
+        }
+        function_->replace_uses(phi, same);
+        function_->insts_[phi].op_ = Opcode::Nop;
+        return same;
+    }
+
+    void IrLowering::seal_block(const BlockId block) {
+        // filling a phi can read other variables through this block and queue more incomplete phis
+        for (u64 i = 0; i < block_states_[block].incomplete_phis_.size(); i++) {
+            const auto [variable, phi] = block_states_[block].incomplete_phis_[i];
+            add_phi_operands(variable, phi);
+        }
+        block_states_[block].incomplete_phis_.clear();
+        block_states_[block].sealed_ = true;
+    }
+
+} /* solara */
@@ -0,0 +1,98 @@
+/**
+ * @file lowering.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+#include "ir.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Lowers a resolved and typed module to SSA form.
+     * Local variables never touch memory: their definitions are tracked per block and phis are placed on the fly
+     * while the body is walked, then trivial phis are folded away once the function is complete.
+     * @see Braun et al., "Simple and Efficient Construction of Static Single Assignment Form"
+     */
+    class IrLowering {
+    public:
+        IrLowering(CompilerContext* ctx);
+
+        IrModule lower(ModuleDeclNode* module);
+
+        /**
+         * Numbers the functions of a module, its own in declaration order and then the public functions of its
+         * imports, so calls can target any of them.
+         * @returns The module with a header for every function and no bodies lowered yet.
+         */
+        IrModule declare(ModuleDeclNode* module);
+
+        /** Lowers one function of the module last declared into its header. */
+        void lower_function(FunctionDeclNode* function, IrFunction& out);
+
+        /** @returns The index declare gave a function, or ~0u if the module does not know it. */
+        u32 get_function_index(const FunctionDeclNode* function) const;
+
+    protected:
+        void lower_statement(SyntaxNodeHandle stmt);
+        void lower_if(IfStmtNode* stmt);
+        void lower_for(ForStmtNode* stmt);
+        ValueId lower_expression(SyntaxNodeHandle expr);
+        ValueId lower_binary(BinaryExprNode* expr);
+        ValueId lower_logical(BinaryExprNode* expr);
+        ValueId lower_unary(UnaryExprNode* expr);
+        ValueId lower_call(CallExprNode* expr);
+        ValueId lower_literal(LiteralExprNode* expr);
+        ValueId lower_constant(VarDeclNode* decl);
+
+        ValueId emit(const Opcode op, const TypeId type, std::span<const ValueId> operands = {});
+        ValueId emit_const(const TypeId type, const i64 value);
+        void emit_br(const BlockId target);
+        void emit_condbr(const ValueId cond, const BlockId then, const BlockId otherwise);
+        void emit_ret(const ValueId value);
+        BlockId new_block();
+        void start_unreachable_block();
+        bool is_unreachable(const BlockId block) const;
+
+        u32 get_variable(SyntaxNodeHandle decl);
+        void write_variable(const u32 variable, const BlockId block, const ValueId value);
+        ValueId read_variable(const u32 variable, const BlockId block);
+        ValueId read_variable_recursive(const u32 variable, const BlockId block);
+        ValueId add_phi_operands(const u32 variable, const ValueId phi);
+        ValueId try_remove_trivial_phi(const ValueId phi);
+        void seal_block(const BlockId block);
+
+    private:
+        struct BlockState {
+            bool sealed_ = false;
+            std::vector<std::pair<u32, ValueId>> incomplete_phis_;
+        };
+
+        struct LoopTargets {
+            BlockId break_;
+            BlockId continue_;
+        };
+
+        CompilerContext* ctx_;
+        TypeTable* types_;
+        TypeId bool_type_;
+        std::unordered_map<const FunctionDeclNode*, u32> function_indices_;
+
+        // per-function state
+        IrFunction* function_ = nullptr;
+        BlockId block_ = 0;
+        std::vector<BlockState> block_states_;
+        std::unordered_map<const SyntaxNode*, u32> variables_;
+        std::vector<TypeId> variable_types_;
+        std::unordered_map<u64, ValueId> definitions_;
+        std::vector<ValueId> phis_;
+        std::vector<LoopTargets> loops_;
+    };
+
+} /* solara */
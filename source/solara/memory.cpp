@@ -0,0 +1,262 @@
+/**
+ * @file memory.cpp
+ */
+
+#include "memory.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace solara {
+
+    static u64 align_up(const u64 value, const u64 alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::string_view memory_subsystem_name(const MemorySubsystem subsystem) {
+        switch (subsystem) {
+            case MemorySubsystem::Strings: return "strings";
+            case MemorySubsystem::Source: return "source";
+            case MemorySubsystem::Tokens: return "tokens";
+            case MemorySubsystem::Syntax: return "syntax";
+            default: return "unknown";
+        }
+    }
+
+    ArenaAllocator::ArenaAllocator(std::pmr::memory_resource* upstream, const u64 initial_block_size) {
+        assert(upstream != nullptr);
+        upstream_ = upstream;
+        initial_block_size_ = initial_block_size;
+        next_block_size_ = initial_block_size;
+    }
+
+    ArenaAllocator::~ArenaAllocator() {
+        release();
+    }
+
+    void ArenaAllocator::release() {
+        while (blocks_ != nullptr) {
+            Block* next = blocks_->next_;
+            upstream_->deallocate(blocks_, blocks_->size_, alignof(std::max_align_t));
+            blocks_ = next;
+        }
+        cursor_ = nullptr;
+        end_ = nullptr;
+        next_block_size_ = initial_block_size_;
+        used_ = 0;
+    }
+
+    u64 ArenaAllocator::get_used() const {
+        return used_;
+    }
+
+    void* ArenaAllocator::do_allocate(std::size_t bytes, std::size_t alignment) {
+        char* pointer = reinterpret_cast<char*>(align_up(reinterpret_cast<u64>(cursor_), alignment));
+        if (cursor_ == nullptr || pointer + bytes > end_) {
+            return allocate_block(bytes, alignment);
+        }
+        cursor_ = pointer + bytes;
+        used_ += bytes;
+        return pointer;
+    }
+
+    /** Starts a new block large enough for the request, at least doubling the last one up to a limit. */
+    void* ArenaAllocator::allocate_block(const u64 bytes, const u64 alignment) {
+        const u64 header = align_up(sizeof(Block), std::max<u64>(alignment, alignof(std::max_align_t)));
+        const u64 size = std::max(next_block_size_, header + bytes);
+        Block* block = static_cast<Block*>(upstream_->allocate(size, alignof(std::max_align_t)));
+        block->next_ = blocks_;
+        block->size_ = size;
+        blocks_ = block;
+        next_block_size_ = std::min(next_block_size_ * 2, MAX_BLOCK_SIZE);
+
+        char* pointer = reinterpret_cast<char*>(block) + header;
+        cursor_ = pointer + bytes;
+        end_ = reinterpret_cast<char*>(block) + size;
+        used_ += bytes;
+        return pointer;
+    }
+
+    void ArenaAllocator::do_deallocate(void*, std::size_t, std::size_t) {
+        // memory is only given back all at once
+    }
+
+    bool ArenaAllocator::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    PoolAllocator::PoolAllocator(const u64 block_size, std::pmr::memory_resource* upstream) {
+        assert(upstream != nullptr);
+        upstream_ = upstream;
+        block_size_ = align_up(std::max<u64>(block_size, sizeof(FreeBlock)), alignof(std::max_align_t));
+    }
+
+    PoolAllocator::~PoolAllocator() {
+        for (void* slab : slabs_) {
+            upstream_->deallocate(slab, block_size_ * BLOCKS_PER_SLAB, alignof(std::max_align_t));
+        }
+    }
+
+    bool PoolAllocator::is_pooled(const u64 bytes, const u64 alignment) const {
+        return bytes <= block_size_ && alignment <= alignof(std::max_align_t);
+    }
+
+    void* PoolAllocator::do_allocate(std::size_t bytes, std::size_t alignment) {
+        if (!is_pooled(bytes, alignment)) {
+            return upstream_->allocate(bytes, alignment);
+        }
+        if (free_ == nullptr) {
+            char* slab = static_cast<char*>(upstream_->allocate(block_size_ * BLOCKS_PER_SLAB, alignof(std::max_align_t)));
+            slabs_.push_back(slab);
+            for (u64 i = BLOCKS_PER_SLAB; i-- > 0;) {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * block_size_);
+                block->next_ = free_;
+                free_ = block;
+            }
+        }
+        FreeBlock* block = free_;
+        free_ = block->next_;
+        return block;
+    }
+
+    void PoolAllocator::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) {
+        if (!is_pooled(bytes, alignment)) {
+            upstream_->deallocate(pointer, bytes, alignment);
+            return;
+        }
+        FreeBlock* block = static_cast<FreeBlock*>(pointer);
+        block->next_ = free_;
+        free_ = block;
+    }
+
+    bool PoolAllocator::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    TrackingAllocator::TrackingAllocator(std::pmr::memory_resource* upstream) {
+        assert(upstream != nullptr);
+        upstream_ = upstream;
+    }
+
+    u64 TrackingAllocator::get_current() const {
+        return current_.load(std::memory_order_relaxed);
+    }
+
+    u64 TrackingAllocator::get_peak() const {
+        return peak_.load(std::memory_order_relaxed);
+    }
+
+    u64 TrackingAllocator::get_total() const {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+    u64 TrackingAllocator::get_count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    void TrackingAllocator::reset_peak() {
+        peak_.store(current_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void* TrackingAllocator::do_allocate(std::size_t bytes, std::size_t alignment) {
+        void* pointer = upstream_->allocate(bytes, alignment);
+        const u64 current = current_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        u64 peak = peak_.load(std::memory_order_relaxed);
+        while (current > peak && !peak_.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+        total_.fetch_add(bytes, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        return pointer;
+    }
+
+    void TrackingAllocator::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) {
+        upstream_->deallocate(pointer, bytes, alignment);
+        current_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    bool TrackingAllocator::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    MemoryTracker::MemoryTracker()
+        : subsystems_{ TrackingAllocator(&total_), TrackingAllocator(&total_), TrackingAllocator(&total_), TrackingAllocator(&total_) }
+    {
+        static_assert(SUBSYSTEM_COUNT == 4, "every subsystem needs a tracker drawing from the total");
+    }
+
+    std::pmr::memory_resource* MemoryTracker::get_resource(const MemorySubsystem subsystem) {
+        assert(subsystem < MemorySubsystem::Count);
+        return &subsystems_[static_cast<u64>(subsystem)];
+    }
+
+    const TrackingAllocator& MemoryTracker::get_tracker(const MemorySubsystem subsystem) const {
+        assert(subsystem < MemorySubsystem::Count);
+        return subsystems_[static_cast<u64>(subsystem)];
+    }
+
+    const TrackingAllocator& MemoryTracker::get_total() const {
+        return total_;
+    }
+
+    void MemoryTracker::reset_phases() {
+        phases_.clear();
+    }
+
+    /** A phase's allocations are counted from the totals it starts with, which the entry holds until it ends. */
+    void MemoryTracker::begin_phase(const std::string& name) {
+        PhaseMemory& phase = phases_.emplace_back();
+        phase.name_ = name;
+        for (u64 i = 0; i < SUBSYSTEM_COUNT; i++) {
+            phase.allocated_[i] = subsystems_[i].get_total();
+            subsystems_[i].reset_peak();
+        }
+        phase.allocated_[SUBSYSTEM_COUNT] = total_.get_total();
+        total_.reset_peak();
+    }
+
+    void MemoryTracker::end_phase() {
+        assert(!phases_.empty());
+        PhaseMemory& phase = phases_.back();
+        for (u64 i = 0; i < SUBSYSTEM_COUNT; i++) {
+            phase.allocated_[i] = subsystems_[i].get_total() - phase.allocated_[i];
+            phase.peak_[i] = subsystems_[i].get_peak();
+        }
+        phase.allocated_[SUBSYSTEM_COUNT] = total_.get_total() - phase.allocated_[SUBSYSTEM_COUNT];
+        phase.peak_[SUBSYSTEM_COUNT] = total_.get_peak();
+    }
+
+    const std::vector<MemoryTracker::PhaseMemory>& MemoryTracker::get_phases() const {
+        return phases_;
+    }
+
+    void MemoryTracker::print(std::ostream& out) const {
+        const auto kib = [](const u64 bytes) { return static_cast<f64>(bytes) / 1024.0; };
+
+        out << "memory usage (KiB allocated / peak live)\n";
+        out << "  " << std::left << std::setw(12) << "phase" << std::right;
+        for (u64 i = 0; i <= SUBSYSTEM_COUNT; i++) {
+            out << std::setw(24) << (i < SUBSYSTEM_COUNT ? memory_subsystem_name(static_cast<MemorySubsystem>(i)) : "all");
+        }
+        out << "\n" << std::fixed << std::setprecision(1);
+        for (const PhaseMemory& phase : phases_) {
+            out << "  " << std::left << std::setw(12) << phase.name_ << std::right;
+            for (u64 i = 0; i <= SUBSYSTEM_COUNT; i++) {
+                out << std::setw(12) << kib(phase.allocated_[i]) << std::setw(12) << kib(phase.peak_[i]);
+            }
+            out << "\n";
+        }
+        // the last row holds what is still live after the phases, next to the highest peak of any of them
+        out << "  " << std::left << std::setw(12) << "live" << std::right;
+        for (u64 i = 0; i <= SUBSYSTEM_COUNT; i++) {
+            const TrackingAllocator& tracker = i < SUBSYSTEM_COUNT ? subsystems_[i] : total_;
+            u64 peak = tracker.get_peak();
+            for (const PhaseMemory& phase : phases_) {
+                peak = std::max(peak, phase.peak_[i]);
+            }
+            out << std::setw(12) << kib(tracker.get_current()) << std::setw(12) << kib(peak);
+        }
+        out << "\n" << std::defaultfloat;
+        out.flush();
+    }
+
+} /* solara */
@@ -0,0 +1,209 @@
+/**
+ * @file memory.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <atomic>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace solara {
+
+    /** Parts of the compiler whose memory is accounted separately. */
+    enum class MemorySubsystem : u08 {
+        Strings = 0,
+        Source,
+        Tokens,
+        Syntax,
+        Count
+    };
+
+    std::string_view memory_subsystem_name(const MemorySubsystem subsystem);
+
+    /**
+     * Monotonic arena. Allocations are carved out of blocks that double in size, and the blocks only go back
+     * to the upstream resource when the arena is released or destroyed, so deallocating is free. An arena is
+     * not thread-safe: each owner allocates from its own, or under its own lock.
+     */
+    class ArenaAllocator : public std::pmr::memory_resource {
+    public:
+        static constexpr u64 INITIAL_BLOCK_SIZE = 16 << 10;
+        static constexpr u64 MAX_BLOCK_SIZE = 16 << 20;
+
+        ArenaAllocator(std::pmr::memory_resource* upstream, const u64 initial_block_size = INITIAL_BLOCK_SIZE);
+        virtual ~ArenaAllocator() override;
+
+        ArenaAllocator(const ArenaAllocator&) = delete;
+        ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+        /** Gives every block back to the upstream resource, invalidating all allocations. */
+        void release();
+
+        /** @returns The bytes handed out since the arena was created or released. */
+        u64 get_used() const;
+
+    protected:
+        virtual void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        virtual void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        struct Block {
+            Block* next_;
+            u64 size_;
+        };
+
+        void* allocate_block(const u64 bytes, const u64 alignment);
+
+        std::pmr::memory_resource* upstream_;
+        Block* blocks_ = nullptr;
+        char* cursor_ = nullptr;
+        char* end_ = nullptr;
+        u64 initial_block_size_;
+        u64 next_block_size_;
+        u64 used_ = 0;
+    };
+
+    /**
+     * Pool of fixed-size blocks, threaded on a free list and taken from the upstream resource in slabs.
+     * Requests larger than the block size, or more aligned than max_align_t, pass through to the upstream
+     * resource. Like the arena, a pool is not thread-safe.
+     */
+    class PoolAllocator : public std::pmr::memory_resource {
+    public:
+        static constexpr u64 BLOCKS_PER_SLAB = 256;
+
+        PoolAllocator(const u64 block_size, std::pmr::memory_resource* upstream);
+        virtual ~PoolAllocator() override;
+
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    protected:
+        virtual void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        virtual void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next_;
+        };
+
+        bool is_pooled(const u64 bytes, const u64 alignment) const;
+
+        std::pmr::memory_resource* upstream_;
+        u64 block_size_;
+        FreeBlock* free_ = nullptr;
+        std::vector<void*> slabs_;
+    };
+
+    /**
+     * Forwards to an upstream resource and counts what passes through it: the bytes live now, their peak,
+     * and the bytes and allocations made in total. The counters are atomic, so threads may share a tracker.
+     */
+    class TrackingAllocator : public std::pmr::memory_resource {
+    public:
+        TrackingAllocator(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+        u64 get_current() const;
+        u64 get_peak() const;
+        u64 get_total() const;
+        u64 get_count() const;
+
+        /** Restarts the peak from the bytes live now, so it can be read per phase. */
+        void reset_peak();
+
+    protected:
+        virtual void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        virtual void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        std::pmr::memory_resource* upstream_;
+        std::atomic<u64> current_ = 0;
+        std::atomic<u64> peak_ = 0;
+        std::atomic<u64> total_ = 0;
+        std::atomic<u64> count_ = 0;
+    };
+
+    /**
+     * The compiler context's memory. Each subsystem allocates from its own tracking resource, directly or
+     * through an arena or pool layered on top, and all of them draw from one more tracker that sees the
+     * whole. The compile driver brackets its phases so the report can say, per phase and subsystem, how
+     * many bytes were allocated and how many were live at once.
+     */
+    class MemoryTracker {
+    public:
+        static constexpr u64 SUBSYSTEM_COUNT = static_cast<u64>(MemorySubsystem::Count);
+
+        struct PhaseMemory {
+            std::string name_;
+            std::array<u64, SUBSYSTEM_COUNT + 1> allocated_ = {};
+            std::array<u64, SUBSYSTEM_COUNT + 1> peak_ = {};
+        };
+
+        MemoryTracker();
+
+        MemoryTracker(const MemoryTracker&) = delete;
+        MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+        std::pmr::memory_resource* get_resource(const MemorySubsystem subsystem);
+        const TrackingAllocator& get_tracker(const MemorySubsystem subsystem) const;
+        const TrackingAllocator& get_total() const;
+
+        /** Forgets the phases recorded so far, for a new compilation in the same context. */
+        void reset_phases();
+        void begin_phase(const std::string& name);
+        void end_phase();
+        const std::vector<PhaseMemory>& get_phases() const;
+
+        void print(std::ostream& out) const;
+
+    private:
+        TrackingAllocator total_;
+        std::array<TrackingAllocator, SUBSYSTEM_COUNT> subsystems_;
+        std::vector<PhaseMemory> phases_;
+    };
+
+    /** Brackets the phases of a compilation for the memory report, ending the last one on every way out. */
+    class MemoryPhase {
+    public:
+        MemoryPhase(MemoryTracker& tracker, const std::string& name)
+            : tracker_(tracker)
+        {
+            tracker_.begin_phase(name);
+        }
+
+        ~MemoryPhase() {
+            end();
+        }
+
+        MemoryPhase(const MemoryPhase&) = delete;
+        MemoryPhase& operator=(const MemoryPhase&) = delete;
+
+        void next(const std::string& name) {
+            end();
+            tracker_.begin_phase(name);
+            active_ = true;
+        }
+
+        void end() {
+            if (active_) {
+                tracker_.end_phase();
+                active_ = false;
+            }
+        }
+
+    private:
+        MemoryTracker& tracker_;
+        bool active_ = true;
+    };
+
+} /* solara */
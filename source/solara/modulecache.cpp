@@ -0,0 +1,71 @@
+/**
+ * @file modulecache.cpp
+ */
+
+#include "modulecache.h"
+
+#include <algorithm>
+
+namespace solara {
+
+    ModuleCache::ModuleCache(CompilerContext* ctx)
+        : queries_(ctx)
+    {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    ModuleCache::Entry* ModuleCache::find(const std::filesystem::path& path, const bool lazy_bodies) {
+        const auto it = entries_.find(get_key(path));
+        if (it == entries_.end() || it->second.lazy_bodies_ != lazy_bodies
+            || !std::all_of(it->second.sources_.begin(), it->second.sources_.end(), is_current)) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        return &it->second;
+    }
+
+    ModuleCache::Entry* ModuleCache::insert(const std::filesystem::path& path, const bool lazy_bodies, const ModuleGraph& graph, std::vector<std::shared_ptr<Parser>> parsers) {
+        Entry entry;
+        for (const ModuleGraphNode& node : graph.get_modules()) {
+            std::error_code error;
+            Source source;
+            source.path_ = node.path_;
+            source.mtime_ = std::filesystem::last_write_time(node.path_, error);
+            source.size_ = error ? 0 : std::filesystem::file_size(node.path_, error);
+            entry.sources_.push_back(std::move(source));
+        }
+        entry.lazy_bodies_ = lazy_bodies;
+        entry.parsers_ = std::move(parsers);
+        Entry& stored = entries_[get_key(path)];
+        stored = std::move(entry);
+        return &stored;
+    }
+
+    ModuleQueries& ModuleCache::get_queries() {
+        return queries_;
+    }
+
+    u64 ModuleCache::get_hits() const {
+        return hits_;
+    }
+
+    u64 ModuleCache::get_misses() const {
+        return misses_;
+    }
+
+    bool ModuleCache::is_current(const Source& source) {
+        std::error_code error;
+        const auto mtime = std::filesystem::last_write_time(source.path_, error);
+        const u64 size = error ? 0 : std::filesystem::file_size(source.path_, error);
+        return !error && mtime == source.mtime_ && size == source.size_;
+    }
+
+    std::string ModuleCache::get_key(const std::filesystem::path& path) const {
+        std::error_code error;
+        const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return (error ? path : canonical).string();
+    }
+
+} /* solara */
@@ -0,0 +1,71 @@
+/**
+ * @file modulecache.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "parser.h"
+#include "modulegraph.h"
+#include "queries.h"
+#include "ir.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace solara {
+
+    /**
+     * Compilation results kept between requests of a long running compiler: for every root source file, the
+     * parsers of the modules it imports and of itself, which own their syntax trees, once the trees passed
+     * semantic analysis, and the optimized IR of each pipeline configuration it was compiled with. An entry is
+     * used while every one of those files keeps its size and modification time. Once one changed, the module
+     * queries analyze the changed modules and their importers again, but lower only the functions whose bodies
+     * or module signatures changed.
+     */
+    class ModuleCache {
+    public:
+        struct Source {
+            std::filesystem::path path_;
+            std::filesystem::file_time_type mtime_;
+            u64 size_ = 0;
+        };
+
+        struct Entry {
+            std::vector<Source> sources_;
+            bool lazy_bodies_ = false;
+
+            /** Parsers in module graph order, the root last, shared with the module queries. */
+            std::vector<std::shared_ptr<Parser>> parsers_;
+            std::unordered_map<u32, IrModule> optimized_;
+        };
+
+        ModuleCache(CompilerContext* ctx);
+
+        /** @returns The entry of a source file if it is still current, or null. */
+        Entry* find(const std::filesystem::path& path, const bool lazy_bodies);
+
+        /** Stores the analyzed modules of a graph, replacing the stale entry of the same root file. */
+        Entry* insert(const std::filesystem::path& path, const bool lazy_bodies, const ModuleGraph& graph, std::vector<std::shared_ptr<Parser>> parsers);
+
+        ModuleQueries& get_queries();
+
+        u64 get_hits() const;
+        u64 get_misses() const;
+
+    protected:
+        static bool is_current(const Source& source);
+        std::string get_key(const std::filesystem::path& path) const;
+
+    private:
+        CompilerContext* ctx_;
+        ModuleQueries queries_;
+        std::unordered_map<std::string, Entry> entries_;
+        u64 hits_ = 0;
+        u64 misses_ = 0;
+    };
+
+} /* solara */
@@ -0,0 +1,243 @@
+/**
+ * @file modulegraph.cpp
+ */
+
+#include "modulegraph.h"
+
+#include <fstream>
+#include <unordered_map>
+
+namespace solara {
+
+    /**
+     * Reads just enough of a source file to split its header into words, refilling a small buffer on demand.
+     * Nothing is interned; the header is thrown away once the graph is built.
+     */
+    struct HeaderScanner {
+        static constexpr u64 CHUNK_SIZE = 4096;
+
+        std::ifstream file_;
+        std::string buffer_;
+        u64 pos_ = 0;
+
+        char peek(const u64 offset = 0) {
+            while (pos_ + offset >= buffer_.size()) {
+                char chunk[CHUNK_SIZE];
+                file_.read(chunk, CHUNK_SIZE);
+                if (file_.gcount() <= 0) {
+                    return '\0';
+                }
+                buffer_.append(chunk, static_cast<u64>(file_.gcount()));
+            }
+            return buffer_[pos_ + offset];
+        }
+
+        /** Bytes of non-ASCII code points are taken as identifier characters; the lexer checks them properly. */
+        static bool is_identifier_char(const char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || static_cast<u08>(c) >= 0x80;
+        }
+
+        /** @returns The next identifier or punctuation character, or an empty string at the end of the file. */
+        std::string next() {
+            for (;;) {
+                const char c = peek();
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    pos_++;
+                } else if (c == '/' && peek(1) == '/') {
+                    while (peek() != '\0' && peek() != '\n') {
+                        pos_++;
+                    }
+                } else if (c == '/' && peek(1) == '*') {
+                    pos_ += 2;
+                    while (peek() != '\0' && !(peek() == '*' && peek(1) == '/')) {
+                        pos_++;
+                    }
+                    pos_ += 2;
+                } else {
+                    break;
+                }
+            }
+
+            const u64 begin = pos_;
+            if (!is_identifier_char(peek())) {
+                return peek() == '\0' ? std::string() : std::string(1, buffer_[pos_++]);
+            }
+            while (is_identifier_char(peek())) {
+                pos_++;
+            }
+            return buffer_.substr(begin, pos_ - begin);
+        }
+    };
+
+    ModuleGraph::ModuleGraph(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    bool ModuleGraph::build(const std::filesystem::path& root) {
+        modules_.clear();
+        if (!std::filesystem::is_regular_file(root)) {
+            ctx_->logger_.log(ERROR, "error: source file '" + root.string() + "' does not exist");
+            return false;
+        }
+        add_module(root);
+        if (!scan_header(modules_[0].path_, modules_[0])) {
+            return false;
+        }
+        return add_imports();
+    }
+
+    bool ModuleGraph::build(const ModuleGraphNode& root) {
+        modules_.clear();
+        modules_.push_back(root);
+        modules_[0].dependencies_.clear();
+        return add_imports();
+    }
+
+    /** Adds every module reachable from the root, which must be the only module so far, and sorts them. */
+    bool ModuleGraph::add_imports() {
+        std::unordered_map<std::string, u32> indices = { { modules_[0].path_.string(), 0 } };
+        std::unordered_map<std::string, u32> names = { { modules_[0].name_, 0 } };
+        for (u32 i = 0; i < modules_.size(); i++) {
+            for (u64 j = 0; j < modules_[i].imports_.size(); j++) {
+                const std::string name = modules_[i].imports_[j];
+                const std::filesystem::path path = modules_[i].path_.parent_path() / (name + ".sol");
+
+                auto it = indices.find(std::filesystem::weakly_canonical(path).string());
+                if (it == indices.end()) {
+                    if (!std::filesystem::is_regular_file(path)) {
+                        ctx_->logger_.log(
+                            ERROR,
+                            "error: " + modules_[i].path_.filename().string() + ": cannot find module '" + name
+                                + "', looked for '" + path.string() + "'"
+                        );
+                        return false;
+                    }
+                    const u32 index = add_module(path);
+                    if (!scan_header(modules_[index].path_, modules_[index])) {
+                        return false;
+                    }
+                    if (modules_[index].name_ != name) {
+                        ctx_->logger_.log(
+                            ERROR,
+                            "error: '" + path.string() + "' declares module '" + modules_[index].name_
+                                + "' but is imported as '" + name + "'"
+                        );
+                        return false;
+                    }
+                    if (names.count(name) != 0) {
+                        // qualified names of the linked program must stay unique
+                        ctx_->logger_.log(ERROR, "error: more than one module is named '" + name + "'");
+                        return false;
+                    }
+                    names.emplace(name, index);
+                    it = indices.emplace(modules_[index].path_.string(), index).first;
+                }
+                modules_[i].dependencies_.push_back(it->second);
+            }
+        }
+        return sort();
+    }
+
+    const std::vector<ModuleGraphNode>& ModuleGraph::get_modules() const {
+        return modules_;
+    }
+
+    /**
+     * Reads '[pub] module name;' and the imports after it. A file without a module declaration scans as an
+     * unnamed module without imports and is left for the parser to report.
+     */
+    bool ModuleGraph::scan_header(const std::filesystem::path& path, ModuleGraphNode& out) {
+        HeaderScanner scanner;
+        scanner.file_.open(path, std::ios::binary);
+        if (!scanner.file_.is_open()) {
+            ctx_->logger_.log(ERROR, "error: could not open source file '" + path.string() + "'");
+            return false;
+        }
+
+        std::string word = scanner.next();
+        if (word == "pub") {
+            word = scanner.next();
+        }
+        if (word != "module") {
+            return true;
+        }
+        out.name_ = scanner.next();
+        if (scanner.next() != ";") {
+            return true;
+        }
+
+        while (scanner.next() == "import") {
+            const std::string name = scanner.next();
+            if (name.empty() || !HeaderScanner::is_identifier_char(name[0]) || scanner.next() != ";") {
+                break;
+            }
+            out.imports_.push_back(name);
+        }
+        return true;
+    }
+
+    u32 ModuleGraph::add_module(const std::filesystem::path& path) {
+        ModuleGraphNode node;
+        node.path_ = std::filesystem::weakly_canonical(path);
+        modules_.push_back(std::move(node));
+        return static_cast<u32>(modules_.size() - 1);
+    }
+
+    /**
+     * Orders the modules by a depth-first walk from the root, placing each module after its imports.
+     * @returns False if the imports form a cycle, which is reported with the modules along it.
+     */
+    bool ModuleGraph::sort() {
+        enum class Mark : u08 { None = 0, Active, Done };
+
+        std::vector<Mark> marks(modules_.size(), Mark::None);
+        std::vector<u32> order;
+        std::vector<std::pair<u32, u32>> stack = { { 0, 0 } };
+        marks[0] = Mark::Active;
+        while (!stack.empty()) {
+            auto& [module, next] = stack.back();
+            if (next == modules_[module].dependencies_.size()) {
+                marks[module] = Mark::Done;
+                order.push_back(module);
+                stack.pop_back();
+                continue;
+            }
+
+            const u32 dependency = modules_[module].dependencies_[next++];
+            if (marks[dependency] == Mark::Active) {
+                std::string cycle = modules_[dependency].name_;
+                u64 i = stack.size();
+                while (stack[i - 1].first != dependency) {
+                    i--;
+                }
+                for (; i < stack.size(); i++) {
+                    cycle += " -> " + modules_[stack[i].first].name_;
+                }
+                cycle += " -> " + modules_[dependency].name_;
+                ctx_->logger_.log(ERROR, "error: import cycle: " + cycle);
+                return false;
+            }
+            if (marks[dependency] == Mark::None) {
+                marks[dependency] = Mark::Active;
+                stack.emplace_back(dependency, 0);
+            }
+        }
+
+        std::vector<u32> positions(modules_.size());
+        for (u32 i = 0; i < order.size(); i++) {
+            positions[order[i]] = i;
+        }
+        std::vector<ModuleGraphNode> sorted;
+        sorted.reserve(order.size());
+        for (const u32 module : order) {
+            sorted.push_back(std::move(modules_[module]));
+            for (u32& dependency : sorted.back().dependencies_) {
+                dependency = positions[dependency];
+            }
+        }
+        modules_.swap(sorted);
+        return true;
+    }
+
+} /* solara */
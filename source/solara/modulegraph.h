@@ -0,0 +1,60 @@
+/**
+ * @file modulegraph.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    struct ModuleGraphNode {
+        std::filesystem::path path_;
+        std::string name_;
+        std::vector<std::string> imports_;
+
+        /** Graph indices of the imported modules, in import order. */
+        std::vector<u32> dependencies_;
+    };
+
+    /**
+     * Modules reachable from a root source file through its imports. The graph is built from a scan of each
+     * file's header, the module declaration and the imports that must directly follow it, so it is known
+     * before any file is parsed. Module 'name' imported from a file is looked up as 'name.sol' next to it.
+     */
+    class ModuleGraph {
+    public:
+        ModuleGraph(CompilerContext* ctx);
+
+        /**
+         * Scans the root file and every module it imports, directly or not.
+         * @returns False if a module is missing, misnamed, or part of an import cycle.
+         */
+        bool build(const std::filesystem::path& root);
+
+        /**
+         * Builds the graph of a root whose header is already known, such as a module parsed from a stream.
+         * Its imports are looked up next to its path, which need not exist.
+         */
+        bool build(const ModuleGraphNode& root);
+
+        /** Modules in topological order: every module comes after the modules it imports, the root last. */
+        const std::vector<ModuleGraphNode>& get_modules() const;
+
+    protected:
+        bool scan_header(const std::filesystem::path& path, ModuleGraphNode& out);
+        u32 add_module(const std::filesystem::path& path);
+        bool add_imports();
+        bool sort();
+
+    private:
+        CompilerContext* ctx_;
+        std::vector<ModuleGraphNode> modules_;
+    };
+
+} /* solara */
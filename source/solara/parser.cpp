@@ -5,21 +5,173 @@
 #include "parser.h"
 
 #include <iostream>
+#include <sstream>
 
 namespace solara {
 
-    Parser::Parser(CompilerContext* ctx) 
-        : lexer_(ctx) 
+    /**
+     * Binding powers of the infix operators, from loosest to tightest.
+     */
+    enum BindingPower : u08 {
+        BP_NONE = 0,
+        BP_ASSIGN = 10,
+        BP_OR = 20,
+        BP_AND = 30,
+        BP_EQUALITY = 40,
+        BP_RELATIONAL = 50,
+        BP_ADDITIVE = 60,
+        BP_MULTIPLICATIVE = 70,
+        BP_PREFIX = 80,
+        BP_CALL = 90
+    };
+
+    static u08 infix_binding_power(const TokenType type) {
+        switch (type) {
+            case TokenType::OP_ASSIGN:
+            case TokenType::OP_PLUS_ASSIGN:
+            case TokenType::OP_MINUS_ASSIGN:
+            case TokenType::OP_STAR_ASSIGN:
+            case TokenType::OP_DIV_ASSIGN:
+            case TokenType::OP_MOD_ASSIGN:
+                return BP_ASSIGN;
+            case TokenType::OP_OR:
+                return BP_OR;
+            case TokenType::OP_AND:
+                return BP_AND;
+            case TokenType::OP_EQ:
+            case TokenType::OP_NEQ:
+                return BP_EQUALITY;
+            case TokenType::OP_LT:
+            case TokenType::OP_GT:
+            case TokenType::OP_LE:
+            case TokenType::OP_GE:
+                return BP_RELATIONAL;
+            case TokenType::OP_PLUS:
+            case TokenType::OP_MINUS:
+                return BP_ADDITIVE;
+            case TokenType::OP_STAR:
+            case TokenType::OP_DIV:
+            case TokenType::OP_MOD:
+                return BP_MULTIPLICATIVE;
+            case TokenType::LPAR:
+                return BP_CALL;
+            default:
+                return BP_NONE;
+        }
+    }
+
+    static BinaryOperation binary_operation_of(const TokenType type) {
+        switch (type) {
+            case TokenType::OP_PLUS: return BinaryOperation::ADD;
+            case TokenType::OP_MINUS: return BinaryOperation::SUB;
+            case TokenType::OP_STAR: return BinaryOperation::MUL;
+            case TokenType::OP_DIV: return BinaryOperation::DIV;
+            case TokenType::OP_MOD: return BinaryOperation::MOD;
+            case TokenType::OP_EQ: return BinaryOperation::EQ;
+            case TokenType::OP_NEQ: return BinaryOperation::NEQ;
+            case TokenType::OP_LT: return BinaryOperation::LT;
+            case TokenType::OP_GT: return BinaryOperation::GT;
+            case TokenType::OP_LE: return BinaryOperation::LE;
+            case TokenType::OP_GE: return BinaryOperation::GE;
+            case TokenType::OP_AND: return BinaryOperation::AND;
+            case TokenType::OP_OR: return BinaryOperation::OR;
+            case TokenType::OP_ASSIGN: return BinaryOperation::ASSIGN;
+            case TokenType::OP_PLUS_ASSIGN: return BinaryOperation::ADD_ASSIGN;
+            case TokenType::OP_MINUS_ASSIGN: return BinaryOperation::SUB_ASSIGN;
+            case TokenType::OP_STAR_ASSIGN: return BinaryOperation::MUL_ASSIGN;
+            case TokenType::OP_DIV_ASSIGN: return BinaryOperation::DIV_ASSIGN;
+            case TokenType::OP_MOD_ASSIGN: return BinaryOperation::MOD_ASSIGN;
+            default: return BinaryOperation::ADD;
+        }
+    }
+
+    Parser::Parser(CompilerContext* ctx)
+        : lexer_(ctx)
+        , tokens_(ctx->memory_.get_resource(MemorySubsystem::Tokens))
+        , syntax_arena_(ctx->memory_.get_resource(MemorySubsystem::Syntax))
     {
         assert(ctx != nullptr);
         ctx_ = ctx;
     }
 
+    Parser::~Parser() {
+        delete module_;
+    }
+
     void Parser::init(const std::filesystem::path& path) {
         lexer_.init(path);
+        lex_and_parse();
+    }
+
+    void Parser::init(SourceStream* stream) {
+        lexer_.init(stream);
+        lex_and_parse();
+    }
+
+    void Parser::init_text(const std::string_view text) {
+        lexer_.init_text(text);
+        lex_and_parse();
+    }
+
+    void Parser::lex_and_parse() {
+        // a streamed source is tokenized whole as well, since lazy bodies and the queries index the token buffer,
+        // so only its raw bytes are bounded by the stream's ring
+        tokens_.clear();
+        lexer_.tokenize_all(tokens_);
+        for (const LexerError& lexer_error : lexer_.get_errors()) {
+            error(lexer_error.span_, lexer_error.message_);
+        }
+
+        index_ = 0;
+        token_ = tokens_[0];
+
         parse();
     }
 
+    /**
+     * Enables deferred body parsing. Function bodies are then only brace-matched over the token buffer,
+     * and parsed the first time they are requested through get_function_body.
+     */
+    void Parser::set_lazy_bodies(const bool lazy) {
+        lazy_bodies_ = lazy;
+    }
+
+    void Parser::set_source_name(const std::string& name) {
+        source_name_ = name;
+    }
+
+    ModuleDeclNode* Parser::get_module() const {
+        return module_;
+    }
+
+    const std::pmr::vector<TokenLexeme>& Parser::get_tokens() const {
+        return tokens_;
+    }
+
+    std::string_view Parser::get_token_value(const TokenLexeme& token) const {
+        if (token.type == TokenType::LIT_STRING) {
+            return lexer_.get_string_literal(token.literal_id).text_;
+        }
+        return ctx_->string_table_.get_string(token.literal_id);
+    }
+
+    CompoundStmtNode* Parser::get_function_body(FunctionDeclNode* function) {
+        if (function->body_ || function->body_end_ <= function->body_begin_) {
+            return function->body_;
+        }
+
+        const u64 index = index_;
+        seek(function->body_begin_);
+        function->body_ = parse_function_body();
+        seek(index);
+
+        return function->body_;
+    }
+
+    u32 Parser::get_error_count() const {
+        return error_count_;
+    }
+
     TokenLexeme Parser::match(const TokenType token) {
         TokenLexeme out;
         out.type = TokenType::NONE;
@@ -27,66 +179,484 @@ namespace solara {
             out = token_;
             consume();
         } else {
-            // TODO: error
+            std::ostringstream ss;
+            ss << "expected " << token_name(token) << " but found " << token_name(token_.type);
+            error(ss.str());
         }
         return out;
     }
 
     void Parser::consume() {
-        token_ = lexer_.next_token();
-        print_token(ctx_, token_);
-        if (token_.type == TokenType::END) {
-            // TODO: finish
+        if (index_ + 1 < tokens_.size()) {
+            index_++;
+        }
+        token_ = tokens_[index_];
+    }
+
+    void Parser::seek(const u64 index) {
+        index_ = index < tokens_.size() ? index : tokens_.size() - 1;
+        token_ = tokens_[index_];
+    }
+
+    const TokenLexeme& Parser::peek(const u32 offset) const {
+        const u64 i = index_ + 1 + offset;
+        if (i < tokens_.size()) {
+            return tokens_[i];
+        }
+        return tokens_.back();
+    }
+
+    void Parser::error(const std::string& message) {
+        error(token_.span, message);
+    }
+
+    void Parser::error(const TokenSourceSpan& span, const std::string& message) {
+        error_count_++;
+        std::ostringstream ss;
+        if (!source_name_.empty()) {
+            ss << source_name_ << ":";
+        }
+        ss << (span.line + 1) << ":" << (span.column + 1) << ": error: " << message;
+        ctx_->logger_.log(ERROR, ss.str());
+    }
+
+    void Parser::synchronize() {
+        while (token_.type != TokenType::END) {
+            if (token_.type == TokenType::SEMICOLON) {
+                consume();
+                return;
+            }
+            if (token_.type == TokenType::RBRACE) {
+                return;
+            }
+            consume();
         }
     }
 
     void Parser::parse() {
-        consume();
         bool pub_module = false;
         if (token_.type == TokenType::KW_PUB) {
             pub_module = true;
             consume();
         }
-        parse_module(pub_module);
+        module_ = parse_module(pub_module);
     }
 
-    void Parser::parse_module(const bool pub) {
+    ModuleDeclNode* Parser::parse_module(const bool pub) {
+        const TokenSourceSpan span = token_.span;
         match(TokenType::KW_MODULE);
         auto name = match(TokenType::IDENTIFIER);
         match(TokenType::SEMICOLON);
 
-        if (name.type == TokenType::IDENTIFIER) {
-            std::cout << ctx_->string_table_.get_string(name.literal_id) << std::endl;
+        auto module = make_syntax_node<ModuleDeclNode>(&syntax_arena_, name.literal_id, pub);
+        module->span_ = span;
+
+        parse_imports(module);
+        parse_program(module);
+        return module;
+    }
+
+    /**
+     * Imports must directly follow the module declaration, which lets the module graph be built from the
+     * first few tokens of every file.
+     */
+    void Parser::parse_imports(ModuleDeclNode* module) {
+        while (token_.type == TokenType::KW_IMPORT) {
+            const TokenSourceSpan span = token_.span;
+            consume();
+            auto name = match(TokenType::IDENTIFIER);
+            match(TokenType::SEMICOLON);
+
+            auto import = make_syntax_node<ImportDeclNode>(&syntax_arena_, name.literal_id);
+            import->span_ = span;
+            module->imports_.push_back(import);
+        }
+    }
+
+    void Parser::parse_program(ModuleDeclNode* module) {
+        while (token_.type != TokenType::END) {
+            bool pub = false;
+            if (token_.type == TokenType::KW_PUB) {
+                pub = true;
+                consume();
+            }
+
+            if (token_.type == TokenType::KW_FN) {
+                module->decls_.push_back(parse_function(pub));
+            } else if (token_.type == TokenType::KW_CONST) {
+                if (pub) {
+                    error("constants cannot be exported");
+                }
+                module->decls_.push_back(parse_const_decl());
+            } else {
+                error("expected a declaration");
+                consume();
+                synchronize();
+            }
         }
+    }
 
-        parse_program();
+    FunctionDeclNode* Parser::parse_function(const bool pub) {
+        const TokenSourceSpan span = token_.span;
+        match(TokenType::KW_FN);
+        auto name = match(TokenType::IDENTIFIER);
+
+        auto function = make_syntax_node<FunctionDeclNode>(&syntax_arena_, name.literal_id, pub);
+        function->span_ = span;
+
+        parse_function_params(function);
+        if (token_.type == TokenType::COLON) {
+            consume();
+            function->return_type_ = parse_type();
+        }
+        if (lazy_bodies_) {
+            skip_function_body(function);
+        } else {
+            function->body_begin_ = index_;
+            function->body_ = parse_function_body();
+            function->body_end_ = index_ - 1;
+        }
+        return function;
     }
 
-    void Parser::parse_program() {
+    void Parser::parse_function_params(FunctionDeclNode* function) {
+        match(TokenType::LPAR);
+        while (token_.type != TokenType::RPAR && token_.type != TokenType::END) {
+            const TokenSourceSpan span = token_.span;
+            auto name = match(TokenType::IDENTIFIER);
+            match(TokenType::COLON);
+
+            auto param = make_syntax_node<ParamDeclNode>(&syntax_arena_, name.literal_id, parse_type());
+            param->span_ = span;
+            function->params_.push_back(param);
+
+            if (token_.type != TokenType::COMMA) {
+                break;
+            }
+            consume();
+        }
+        match(TokenType::RPAR);
+    }
 
+    CompoundStmtNode* Parser::parse_function_body() {
+        return parse_block();
     }
 
-    void Parser::parse_function(const bool pub) {
+    /**
+     * Records the token range of a function body by brace matching and moves past it without parsing.
+     * @returns False if the body is missing or its braces are unbalanced.
+     */
+    bool Parser::skip_function_body(FunctionDeclNode* function) {
+        if (token_.type != TokenType::LBRACE) {
+            match(TokenType::LBRACE);
+            return false;
+        }
+
+        u64 depth = 0;
+        for (u64 i = index_; i < tokens_.size(); i++) {
+            const TokenType type = tokens_[i].type;
+            if (type == TokenType::LBRACE) {
+                depth++;
+            } else if (type == TokenType::RBRACE) {
+                depth--;
+                if (depth == 0) {
+                    function->body_begin_ = index_;
+                    function->body_end_ = i;
+                    seek(i + 1);
+                    return true;
+                }
+            }
+        }
 
+        error("unterminated function body");
+        seek(tokens_.size() - 1);
+        return false;
     }
 
-    void Parser::parse_function_params() {
+    CompoundStmtNode* Parser::parse_block() {
+        auto block = make_syntax_node<CompoundStmtNode>(&syntax_arena_);
+        block->span_ = token_.span;
 
+        match(TokenType::LBRACE);
+        while (token_.type != TokenType::RBRACE && token_.type != TokenType::END) {
+            const u64 index = index_;
+            SyntaxNodeHandle stmt = parse_statement();
+            if (stmt) {
+                block->stmts_.push_back(stmt);
+            } else if (index == index_) {
+                // make progress on tokens that cannot start a statement
+                consume();
+            }
+        }
+        match(TokenType::RBRACE);
+        return block;
     }
 
-    void Parser::parse_function_body() {
+    SyntaxNodeHandle Parser::parse_statement() {
+        const TokenSourceSpan span = token_.span;
+        SyntaxNodeHandle stmt = nullptr;
+
+        switch (token_.type) {
+            case TokenType::LBRACE:
+                return parse_block();
+            case TokenType::KW_IF:
+                return parse_if();
+            case TokenType::KW_FOR:
+                return parse_for();
+            case TokenType::KW_RETURN: {
+                consume();
+                SyntaxNodeHandle expr = nullptr;
+                if (token_.type != TokenType::SEMICOLON) {
+                    expr = parse_expression(BP_NONE);
+                }
+                stmt = make_syntax_node<ReturnStmtNode>(&syntax_arena_, expr);
+                break;
+            }
+            case TokenType::KW_BREAK:
+                consume();
+                stmt = make_syntax_node<BreakStmtNode>(&syntax_arena_);
+                break;
+            case TokenType::KW_CONTINUE:
+                consume();
+                stmt = make_syntax_node<ContinueStmtNode>(&syntax_arena_);
+                break;
+            case TokenType::SEMICOLON:
+                consume();
+                return nullptr;
+            case TokenType::KW_CONST:
+                return parse_const_decl();
+            default:
+                if (token_.type == TokenType::IDENTIFIER && peek().type == TokenType::COLON) {
+                    return parse_var_decl();
+                }
+                SyntaxNodeHandle expr = parse_expression(BP_NONE);
+                if (!expr) {
+                    synchronize();
+                    return nullptr;
+                }
+                stmt = make_syntax_node<ExprStmtNode>(&syntax_arena_, expr);
+                break;
+        }
 
+        stmt->span_ = span;
+        if (!match(TokenType::SEMICOLON).is_valid()) {
+            synchronize();
+        }
+        return stmt;
     }
 
-    void Parser::parse_statement() {
+    SyntaxNodeHandle Parser::parse_var_decl() {
+        const TokenSourceSpan span = token_.span;
+        auto name = match(TokenType::IDENTIFIER);
+        match(TokenType::COLON);
+        SyntaxNodeHandle type = parse_type();
+
+        SyntaxNodeHandle init = nullptr;
+        if (token_.type == TokenType::OP_ASSIGN) {
+            consume();
+            init = parse_expression(BP_NONE);
+        }
 
+        auto decl = make_syntax_node<VarDeclNode>(&syntax_arena_, name.literal_id, type, init);
+        decl->span_ = span;
+        if (!match(TokenType::SEMICOLON).is_valid()) {
+            synchronize();
+        }
+        return decl;
+    }
+
+    /** A constant is a variable declaration after `const` that must be initialized. */
+    SyntaxNodeHandle Parser::parse_const_decl() {
+        const TokenSourceSpan span = token_.span;
+        match(TokenType::KW_CONST);
+        auto decl = static_cast<VarDeclNode*>(parse_var_decl());
+        decl->const_ = true;
+        decl->span_ = span;
+        if (!decl->init_) {
+            error(span, "a constant needs an initializer");
+        }
+        return decl;
+    }
+
+    SyntaxNodeHandle Parser::parse_if() {
+        const TokenSourceSpan span = token_.span;
+        match(TokenType::KW_IF);
+        SyntaxNodeHandle cond = parse_expression(BP_NONE);
+        SyntaxNodeHandle then = parse_block();
+
+        SyntaxNodeHandle otherwise = nullptr;
+        if (token_.type == TokenType::KW_ELSE) {
+            consume();
+            if (token_.type == TokenType::KW_IF) {
+                otherwise = parse_if();
+            } else {
+                otherwise = parse_block();
+            }
+        }
+
+        auto stmt = make_syntax_node<IfStmtNode>(&syntax_arena_, cond, then, otherwise);
+        stmt->span_ = span;
+        return stmt;
+    }
+
+    /**
+     * Parses the three loop forms: `for { }`, `for cond { }` and `for init; cond; post { }`.
+     */
+    SyntaxNodeHandle Parser::parse_for() {
+        const TokenSourceSpan span = token_.span;
+        match(TokenType::KW_FOR);
+
+        SyntaxNodeHandle init = nullptr;
+        SyntaxNodeHandle cond = nullptr;
+        SyntaxNodeHandle post = nullptr;
+
+        if (token_.type != TokenType::LBRACE) {
+            if (token_.type == TokenType::IDENTIFIER && peek().type == TokenType::COLON) {
+                init = parse_var_decl();
+            } else if (token_.type == TokenType::SEMICOLON) {
+                consume();
+            } else {
+                SyntaxNodeHandle expr = parse_expression(BP_NONE);
+                if (token_.type == TokenType::LBRACE) {
+                    cond = expr;
+                } else {
+                    init = make_syntax_node<ExprStmtNode>(&syntax_arena_, expr);
+                    init->span_ = span;
+                    match(TokenType::SEMICOLON);
+                }
+            }
+
+            if (!cond && token_.type != TokenType::LBRACE) {
+                if (token_.type != TokenType::SEMICOLON) {
+                    cond = parse_expression(BP_NONE);
+                }
+                match(TokenType::SEMICOLON);
+                if (token_.type != TokenType::LBRACE) {
+                    post = parse_expression(BP_NONE);
+                }
+            }
+        }
+
+        SyntaxNodeHandle body = parse_block();
+        auto stmt = make_syntax_node<ForStmtNode>(&syntax_arena_, init, cond, post, body);
+        stmt->span_ = span;
+        return stmt;
+    }
+
+    SyntaxNodeHandle Parser::parse_type() {
+        const TokenSourceSpan span = token_.span;
+        auto name = match(TokenType::IDENTIFIER);
+        if (!name.is_valid()) {
+            return nullptr;
+        }
+        auto type = make_syntax_node<NamedTypeNode>(&syntax_arena_, name.literal_id);
+        type->span_ = span;
+        return type;
     }
 
     /**
      * @see Pratt Parsing
      */
-    void Parser::parse_expression(const u08 rbp) {
+    SyntaxNodeHandle Parser::parse_expression(const u08 rbp) {
+        SyntaxNodeHandle left = parse_prefix();
+        while (left && infix_binding_power(token_.type) > rbp) {
+            left = parse_infix(left);
+        }
+        return left;
+    }
+
+    SyntaxNodeHandle Parser::parse_prefix() {
+        const TokenSourceSpan span = token_.span;
+        SyntaxNodeHandle expr = nullptr;
+
+        switch (token_.type) {
+            case TokenType::LIT_INT:
+            case TokenType::LIT_FLOAT:
+                expr = make_syntax_node<LiteralExprNode>(&syntax_arena_, token_.type, token_.literal_id);
+                consume();
+                break;
+            case TokenType::LIT_STRING: {
+                const StringLiteral& literal = lexer_.get_string_literal(token_.literal_id);
+                auto node = make_syntax_node<LiteralExprNode>(&syntax_arena_, token_.type, token_.literal_id);
+                node->text_ = literal.text_;
+                node->has_escapes_ = literal.has_escapes_;
+                expr = node;
+                consume();
+                break;
+            }
+            case TokenType::IDENTIFIER:
+                if (peek().type == TokenType::PERIOD && peek(1).type == TokenType::IDENTIFIER) {
+                    const u64 qualifier_id = token_.literal_id;
+                    consume();
+                    consume();
+                    expr = make_syntax_node<IdentifierExprNode>(&syntax_arena_, token_.literal_id, qualifier_id);
+                } else {
+                    expr = make_syntax_node<IdentifierExprNode>(&syntax_arena_, token_.literal_id);
+                }
+                consume();
+                break;
+            case TokenType::LPAR:
+                consume();
+                expr = parse_expression(BP_NONE);
+                match(TokenType::RPAR);
+                return expr;
+            case TokenType::OP_MINUS:
+                consume();
+                expr = make_syntax_node<UnaryExprNode>(&syntax_arena_, UnaryOperation::NEG, parse_expression(BP_PREFIX));
+                break;
+            case TokenType::OP_NOT:
+                consume();
+                expr = make_syntax_node<UnaryExprNode>(&syntax_arena_, UnaryOperation::NOT, parse_expression(BP_PREFIX));
+                break;
+            case TokenType::OP_INC:
+                consume();
+                expr = make_syntax_node<UnaryExprNode>(&syntax_arena_, UnaryOperation::INC, parse_expression(BP_PREFIX));
+                break;
+            case TokenType::OP_DEC:
+                consume();
+                expr = make_syntax_node<UnaryExprNode>(&syntax_arena_, UnaryOperation::DEC, parse_expression(BP_PREFIX));
+                break;
+            default: {
+                std::ostringstream ss;
+                ss << "expected an expression but found " << token_name(token_.type);
+                error(ss.str());
+                return nullptr;
+            }
+        }
+
+        expr->span_ = span;
+        return expr;
+    }
+
+    SyntaxNodeHandle Parser::parse_infix(SyntaxNodeHandle left) {
+        const TokenSourceSpan span = token_.span;
+        const TokenType type = token_.type;
+        const u08 bp = infix_binding_power(type);
+        consume();
+
+        if (type == TokenType::LPAR) {
+            auto call = make_syntax_node<CallExprNode>(&syntax_arena_, left);
+            call->span_ = left->span_;
+            while (token_.type != TokenType::RPAR && token_.type != TokenType::END) {
+                SyntaxNodeHandle arg = parse_expression(BP_NONE);
+                if (!arg) {
+                    break;
+                }
+                call->args_.push_back(arg);
+                if (token_.type != TokenType::COMMA) {
+                    break;
+                }
+                consume();
+            }
+            match(TokenType::RPAR);
+            return call;
+        }
 
+        // assignments are right associative
+        const u08 rbp = (bp == BP_ASSIGN) ? bp - 1 : bp;
+        auto expr = make_syntax_node<BinaryExprNode>(&syntax_arena_, binary_operation_of(type), left, parse_expression(rbp));
+        expr->span_ = span;
+        return expr;
     }
 
-} /* solara */
\ No newline at end of file
+} /* solara */
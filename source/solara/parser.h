@@ -8,32 +8,74 @@
 #include "solara.h"
 #include "token.h"
 #include "lexer.h"
+#include "ast.h"
+
+#include <vector>
 
 namespace solara {
 
     class Parser {
     public:
         Parser(CompilerContext* ctx);
+        ~Parser();
 
         void init(const std::filesystem::path& path);
+        void init(SourceStream* stream);
+        void init_text(const std::string_view text);
+        void set_lazy_bodies(const bool lazy);
+
+        /** Names the source in error messages; errors carry only a position when no name is set. */
+        void set_source_name(const std::string& name);
+        ModuleDeclNode* get_module() const;
+        const std::pmr::vector<TokenLexeme>& get_tokens() const;
+
+        /** @returns The text of a token with a value; a string literal's comes raw from the lexer. */
+        std::string_view get_token_value(const TokenLexeme& token) const;
+        CompoundStmtNode* get_function_body(FunctionDeclNode* function);
+        u32 get_error_count() const;
 
     protected:
         TokenLexeme match(const TokenType token);
         void consume();
+        void seek(const u64 index);
+        const TokenLexeme& peek(const u32 offset = 0) const;
+        void error(const std::string& message);
+        void error(const TokenSourceSpan& span, const std::string& message);
+        void synchronize();
 
+        void lex_and_parse();
         void parse();
-        void parse_module(const bool pub);
-        void parse_program();
-        void parse_function(const bool pub);
-        void parse_function_params();
-        void parse_function_body();
-        void parse_statement();
-        void parse_expression(const u08 rbp);
+        ModuleDeclNode* parse_module(const bool pub);
+        void parse_imports(ModuleDeclNode* module);
+        void parse_program(ModuleDeclNode* module);
+        FunctionDeclNode* parse_function(const bool pub);
+        void parse_function_params(FunctionDeclNode* function);
+        CompoundStmtNode* parse_function_body();
+        bool skip_function_body(FunctionDeclNode* function);
+        CompoundStmtNode* parse_block();
+        SyntaxNodeHandle parse_statement();
+        SyntaxNodeHandle parse_var_decl();
+        SyntaxNodeHandle parse_const_decl();
+        SyntaxNodeHandle parse_if();
+        SyntaxNodeHandle parse_for();
+        SyntaxNodeHandle parse_type();
+        SyntaxNodeHandle parse_expression(const u08 rbp);
+        SyntaxNodeHandle parse_prefix();
+        SyntaxNodeHandle parse_infix(SyntaxNodeHandle left);
 
     private:
         CompilerContext* ctx_;
         Lexer lexer_;
+        std::pmr::vector<TokenLexeme> tokens_;
+
+        /** Nodes of the tree are placed here and only freed with the parser, so deleting them is free. */
+        ArenaAllocator syntax_arena_;
+        u64 index_ = 0;
         TokenLexeme token_;
+        bool lazy_bodies_ = false;
+        std::string source_name_;
+        ModuleDeclNode* module_ = nullptr;
+        u32 error_count_ = 0;
     };
 
-} /* solara */
\ No newline at end of file
+} /* solara */
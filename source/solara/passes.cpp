@@ -0,0 +1,807 @@
+/**
+ * @file passes.cpp
+ */
+
+#include "passes.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    static bool is_const(const IrFunction& function, const ValueId value) {
+        return value < function.insts_.size() && function.insts_[value].op_ == Opcode::Const;
+    }
+
+    /**
+     * Truncates a result to the width of its integer type, sign-extending signed types.
+     */
+    static i64 wrap_int(const u64 value, const TypeInfo& info) {
+        if (info.bits == 0 || info.bits >= 64) {
+            return static_cast<i64>(value);
+        }
+        const u64 mask = (1ull << info.bits) - 1;
+        u64 out = value & mask;
+        if (info.is_signed && (out >> (info.bits - 1)) & 1) {
+            out |= ~mask;
+        }
+        return static_cast<i64>(out);
+    }
+
+    static bool compare(const Opcode op, const auto a, const auto b) {
+        switch (op) {
+            case Opcode::Eq: return a == b;
+            case Opcode::Ne: return a != b;
+            case Opcode::Lt: return a < b;
+            case Opcode::Gt: return a > b;
+            case Opcode::Le: return a <= b;
+            case Opcode::Ge: return a >= b;
+            default: return false;
+        }
+    }
+
+    /**
+     * Evaluates a binary instruction on constant operands.
+     * @returns False if the operation cannot be folded, like a division by zero.
+     */
+    static bool fold_binary(const Opcode op, const TypeInfo& operand, const TypeInfo& result,
+                            const Instruction& lhs, const Instruction& rhs, Instruction& out) {
+        const bool comparison = op >= Opcode::Eq;
+
+        if (operand.kind == TypeKind::Float) {
+            const f64 a = lhs.imm_.float_;
+            const f64 b = rhs.imm_.float_;
+            if (comparison) {
+                out.imm_.int_ = compare(op, a, b) ? 1 : 0;
+                return true;
+            }
+            f64 value;
+            switch (op) {
+                case Opcode::Add: value = a + b; break;
+                case Opcode::Sub: value = a - b; break;
+                case Opcode::Mul: value = a * b; break;
+                case Opcode::Div: value = a / b; break;
+                default: return false;
+            }
+            out.imm_.float_ = operand.bits == 32 ? static_cast<f64>(static_cast<f32>(value)) : value;
+            return true;
+        }
+
+        const i64 a = lhs.imm_.int_;
+        const i64 b = rhs.imm_.int_;
+        if (comparison) {
+            const bool value = operand.is_signed ? compare(op, a, b) : compare(op, static_cast<u64>(a), static_cast<u64>(b));
+            out.imm_.int_ = value ? 1 : 0;
+            return true;
+        }
+
+        // wrap-around arithmetic is done on unsigned values so it never overflows
+        const u64 ua = static_cast<u64>(a);
+        const u64 ub = static_cast<u64>(b);
+        u64 value;
+        switch (op) {
+            case Opcode::Add: value = ua + ub; break;
+            case Opcode::Sub: value = ua - ub; break;
+            case Opcode::Mul: value = ua * ub; break;
+            case Opcode::Div:
+            case Opcode::Rem:
+                if (b == 0 || (operand.is_signed && b == -1 && a == INT64_MIN)) {
+                    return false;
+                }
+                if (operand.is_signed) {
+                    value = static_cast<u64>(op == Opcode::Div ? a / b : a % b);
+                } else {
+                    value = op == Opcode::Div ? ua / ub : ua % ub;
+                }
+                break;
+            default:
+                return false;
+        }
+        out.imm_.int_ = wrap_int(value, result);
+        return true;
+    }
+
+    ConstantPropagationPass::ConstantPropagationPass(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        bool_type_ = ctx->type_table_.get_bool_type();
+    }
+
+    PassResult ConstantPropagationPass::run(IrModule& module, const u32 index, AnalysisCache& analyses) {
+        IrFunction& function = module.functions_[index];
+        const TypeTable& types = ctx_->type_table_;
+        const UseLists& uses = analyses.get_uses();
+
+        PassResult result;
+        bool cfg_changed = false;
+
+        const u32 count = static_cast<u32>(function.insts_.size());
+        std::vector<ValueId> worklist;
+        std::vector<u08> queued(count, 1);
+        worklist.reserve(count);
+        for (u32 i = count; i-- > 0;) {
+            worklist.push_back(i);
+        }
+
+        auto push = [&](const ValueId value) {
+            if (value < count && !queued[value]) {
+                queued[value] = 1;
+                worklist.push_back(value);
+            }
+        };
+        auto push_users = [&](const ValueId value) {
+            for (ValueId user : uses.get_users(value)) {
+                push(user);
+            }
+        };
+        auto make_const = [&](const ValueId value, const i64 imm) {
+            Instruction& inst = function.insts_[value];
+            inst.op_ = Opcode::Const;
+            inst.operand_count_ = 0;
+            inst.imm_.int_ = imm;
+            push_users(value);
+            result.changed_ = true;
+        };
+        auto replace = [&](const ValueId value, const ValueId replacement) {
+            function.replace_uses(value, replacement);
+            function.insts_[value].op_ = Opcode::Nop;
+            push_users(value);
+            result.changed_ = true;
+        };
+
+        std::vector<ValueId> operands;
+        while (!worklist.empty()) {
+            const ValueId id = worklist.back();
+            worklist.pop_back();
+            queued[id] = 0;
+
+            const Instruction inst = function.insts_[id];
+            if (inst.op_ == Opcode::Nop) {
+                continue;
+            }
+            operands.clear();
+            for (ValueId operand : function.get_operands(id)) {
+                operands.push_back(function.resolve(operand));
+            }
+
+            if (opcode_is_binary(inst.op_)) {
+                const ValueId lhs = operands[0];
+                const ValueId rhs = operands[1];
+                const TypeInfo& operand_info = types.get_info(function.insts_[lhs].type_);
+                const TypeInfo& result_info = types.get_info(inst.type_);
+                if (is_const(function, lhs) && is_const(function, rhs)) {
+                    Instruction folded = inst;
+                    if (fold_binary(inst.op_, operand_info, result_info, function.insts_[lhs], function.insts_[rhs], folded)) {
+                        make_const(id, folded.imm_.int_);
+                    }
+                    continue;
+                }
+                if (operand_info.kind != TypeKind::Int) {
+                    continue;
+                }
+
+                // integer identities, floats are left alone because of signed zeros and NaNs
+                auto const_equals = [&](const ValueId value, const i64 imm) {
+                    return is_const(function, value) && function.insts_[value].imm_.int_ == imm;
+                };
+                switch (inst.op_) {
+                    case Opcode::Add:
+                        if (const_equals(rhs, 0)) {
+                            replace(id, lhs);
+                        } else if (const_equals(lhs, 0)) {
+                            replace(id, rhs);
+                        }
+                        break;
+                    case Opcode::Sub:
+                        if (const_equals(rhs, 0)) {
+                            replace(id, lhs);
+                        } else if (lhs == rhs) {
+                            make_const(id, 0);
+                        }
+                        break;
+                    case Opcode::Mul:
+                        if (const_equals(rhs, 1)) {
+                            replace(id, lhs);
+                        } else if (const_equals(lhs, 1)) {
+                            replace(id, rhs);
+                        } else if (const_equals(lhs, 0) || const_equals(rhs, 0)) {
+                            make_const(id, 0);
+                        }
+                        break;
+                    case Opcode::Div:
+                        if (const_equals(rhs, 1)) {
+                            replace(id, lhs);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                continue;
+            }
+
+            switch (inst.op_) {
+                case Opcode::Neg:
+                    if (is_const(function, operands[0])) {
+                        const Instruction& operand = function.insts_[operands[0]];
+                        const TypeInfo& info = types.get_info(inst.type_);
+                        if (info.kind == TypeKind::Float) {
+                            Instruction& target = function.insts_[id];
+                            make_const(id, 0);
+                            target.imm_.float_ = -operand.imm_.float_;
+                        } else {
+                            make_const(id, wrap_int(0 - static_cast<u64>(operand.imm_.int_), info));
+                        }
+                    }
+                    break;
+                case Opcode::Not:
+                    if (is_const(function, operands[0])) {
+                        make_const(id, function.insts_[operands[0]].imm_.int_ == 0 ? 1 : 0);
+                    }
+                    break;
+                case Opcode::Phi: {
+                    // a phi of one value (besides itself) is that value, a phi of equal constants is a constant
+                    ValueId same = NO_VALUE;
+                    bool unique = true;
+                    bool equal_consts = !operands.empty();
+                    for (ValueId operand : operands) {
+                        if (operand == id) {
+                            continue;
+                        }
+                        if (same != NO_VALUE && operand != same) {
+                            unique = false;
+                        }
+                        if (!is_const(function, operand) || (same != NO_VALUE && is_const(function, same)
+                            && function.insts_[operand].imm_.int_ != function.insts_[same].imm_.int_)) {
+                            equal_consts = false;
+                        }
+                        if (same == NO_VALUE) {
+                            same = operand;
+                        }
+                    }
+                    if (same == NO_VALUE) {
+                        break;
+                    }
+                    if (unique) {
+                        replace(id, same);
+                    } else if (equal_consts) {
+                        make_const(id, function.insts_[same].imm_.int_);
+                    }
+                    break;
+                }
+                case Opcode::CondBr: {
+                    if (!is_const(function, operands[0])) {
+                        break;
+                    }
+                    const bool taken = function.insts_[operands[0]].imm_.int_ != 0;
+                    const BlockId target = inst.imm_.targets_[taken ? 0 : 1];
+                    const BlockId dropped = inst.imm_.targets_[taken ? 1 : 0];
+
+                    Instruction& branch = function.insts_[id];
+                    branch.op_ = Opcode::Br;
+                    branch.operand_count_ = 0;
+                    branch.imm_.targets_[0] = target;
+                    branch.imm_.targets_[1] = NO_BLOCK;
+                    function.remove_edge(inst.block_, dropped);
+
+                    // the dropped target lost a phi operand, so its phis may have become trivial
+                    const IrBlock& block = function.blocks_[dropped];
+                    for (ValueId phi = block.begin_; phi < block.end_ && function.insts_[phi].op_ == Opcode::Phi; phi++) {
+                        push(phi);
+                    }
+                    result.changed_ = true;
+                    cfg_changed = true;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        result.preserved_ = cfg_changed ? ANALYSIS_NONE : analysis_bit(AnalysisKind::Dominators);
+        return result;
+    }
+
+    DeadCodeEliminationPass::DeadCodeEliminationPass(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    PassResult DeadCodeEliminationPass::run(IrModule& module, const u32 index, AnalysisCache& analyses) {
+        IrFunction& function = module.functions_[index];
+        const u32 count = static_cast<u32>(function.insts_.size());
+
+        // mark from the roots instead of sweeping unused values, so dead cycles through phis go too
+        std::vector<u08> live(count, 0);
+        std::vector<ValueId> stack;
+        for (ValueId id = 0; id < count; id++) {
+            if (opcode_has_side_effects(function.insts_[id].op_)) {
+                live[id] = 1;
+                stack.push_back(id);
+            }
+        }
+        while (!stack.empty()) {
+            const ValueId id = stack.back();
+            stack.pop_back();
+            for (ValueId operand : function.get_operands(id)) {
+                operand = function.resolve(operand);
+                if (operand < count && !live[operand]) {
+                    live[operand] = 1;
+                    stack.push_back(operand);
+                }
+            }
+        }
+
+        PassResult result;
+        for (ValueId id = 0; id < count; id++) {
+            if (!live[id] && function.insts_[id].op_ != Opcode::Nop) {
+                function.insts_[id].op_ = Opcode::Nop;
+                result.changed_ = true;
+            }
+        }
+        result.preserved_ = analysis_bit(AnalysisKind::Dominators);
+        (void)analyses;
+        return result;
+    }
+
+    /**
+     * What an instruction computes, independent of where it is.
+     */
+    struct ValueKey {
+        Opcode op_;
+        TypeId type_;
+        ValueId lhs_;
+        ValueId rhs_;
+        i64 imm_;
+
+        bool operator==(const ValueKey& other) const = default;
+    };
+
+    struct ValueKeyHash {
+        u64 operator()(const ValueKey& key) const {
+            u64 hash = static_cast<u64>(key.op_) * 0x9E3779B97F4A7C15ull;
+            hash ^= (static_cast<u64>(key.type_) << 32 | key.lhs_) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+            hash ^= static_cast<u64>(key.rhs_) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+            hash ^= static_cast<u64>(key.imm_) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+
+    static bool is_numberable(const Opcode op) {
+        return op == Opcode::Const || opcode_is_binary(op) || op == Opcode::Neg || op == Opcode::Not;
+    }
+
+    static bool is_commutative(const Opcode op) {
+        return op == Opcode::Add || op == Opcode::Mul || op == Opcode::Eq || op == Opcode::Ne;
+    }
+
+    ValueNumberingPass::ValueNumberingPass(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    PassResult ValueNumberingPass::run(IrModule& module, const u32 index, AnalysisCache& analyses) {
+        IrFunction& function = module.functions_[index];
+        const std::vector<BlockId>& idoms = analyses.get_dominators();
+        const u32 block_count = static_cast<u32>(function.blocks_.size());
+
+        // dominator tree children, sliced out of one array like the use lists
+        std::vector<u32> offsets(block_count + 1, 0);
+        for (BlockId block = 1; block < block_count; block++) {
+            if (idoms[block] != NO_BLOCK) {
+                offsets[idoms[block] + 1]++;
+            }
+        }
+        for (u32 i = 0; i < block_count; i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        std::vector<BlockId> children(offsets[block_count]);
+        std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+        for (BlockId block = 1; block < block_count; block++) {
+            if (idoms[block] != NO_BLOCK) {
+                children[cursor[idoms[block]]++] = block;
+            }
+        }
+
+        PassResult result;
+        std::unordered_map<ValueKey, ValueId, ValueKeyHash> table;
+        std::vector<ValueKey> scope;
+
+        // values of a block are visible in every block it dominates, so the table follows a walk of the tree
+        struct Frame {
+            BlockId block_;
+            u64 scope_mark_;
+            u32 next_child_;
+        };
+        std::vector<Frame> stack;
+        stack.push_back({ 0, 0, 0 });
+        bool entered = false;
+
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            if (!entered) {
+                frame.scope_mark_ = scope.size();
+                const IrBlock& block = function.blocks_[frame.block_];
+                for (ValueId id = block.begin_; id < block.end_; id++) {
+                    const Instruction& inst = function.insts_[id];
+                    if (!is_numberable(inst.op_)) {
+                        continue;
+                    }
+
+                    const auto operands = function.get_operands(id);
+                    ValueKey key = { inst.op_, inst.type_, NO_VALUE, NO_VALUE, 0 };
+                    if (inst.op_ == Opcode::Const) {
+                        key.imm_ = inst.imm_.int_;
+                    } else {
+                        key.lhs_ = function.resolve(operands[0]);
+                        if (operands.size() > 1) {
+                            key.rhs_ = function.resolve(operands[1]);
+                        }
+                        if (is_commutative(inst.op_) && key.rhs_ < key.lhs_) {
+                            std::swap(key.lhs_, key.rhs_);
+                        }
+                    }
+
+                    auto [it, inserted] = table.emplace(key, id);
+                    if (inserted) {
+                        scope.push_back(key);
+                    } else {
+                        function.replace_uses(id, it->second);
+                        function.insts_[id].op_ = Opcode::Nop;
+                        result.changed_ = true;
+                    }
+                }
+            }
+
+            const BlockId block = frame.block_;
+            if (frame.next_child_ < offsets[block + 1] - offsets[block]) {
+                const BlockId child = children[offsets[block] + frame.next_child_++];
+                stack.push_back({ child, 0, 0 });
+                entered = false;
+                continue;
+            }
+
+            while (scope.size() > frame.scope_mark_) {
+                table.erase(scope.back());
+                scope.pop_back();
+            }
+            stack.pop_back();
+            entered = true;
+        }
+
+        result.preserved_ = analysis_bit(AnalysisKind::Dominators);
+        return result;
+    }
+
+    InliningPass::InliningPass(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    PassResult InliningPass::run(IrModule& module, const u32 index, AnalysisCache& analyses) {
+        IrFunction& caller = module.functions_[index];
+
+        std::vector<ValueId> sites;
+        for (ValueId id = 0; id < caller.insts_.size(); id++) {
+            const Instruction& inst = caller.insts_[id];
+            if (inst.op_ != Opcode::Call || inst.imm_.index_ >= module.functions_.size() || inst.imm_.index_ == index) {
+                continue;
+            }
+            const IrFunction& callee = module.functions_[inst.imm_.index_];
+            if (callee.pub_ && !callee.blocks_.empty() && callee.insts_.size() <= MAX_CALLEE_INSTS) {
+                sites.push_back(id);
+            }
+        }
+
+        // the last call first, so splitting a block never moves a site that is still pending
+        PassResult result;
+        for (u64 i = sites.size(); i-- > 0;) {
+            if (caller.insts_.size() > MAX_CALLER_INSTS) {
+                break;
+            }
+            inline_call(caller, sites[i], module.functions_[caller.insts_[sites[i]].imm_.index_]);
+            result.changed_ = true;
+        }
+        result.preserved_ = ANALYSIS_NONE;
+        (void)analyses;
+        return result;
+    }
+
+    /**
+     * Splits the call's block after the call, copies the callee's blocks in between and turns its returns
+     * into jumps to the continuation, where a phi merges the returned values.
+     */
+    void InliningPass::inline_call(IrFunction& caller, const ValueId call, const IrFunction& callee) {
+        const BlockId block = caller.insts_[call].block_;
+        const BlockId continuation = caller.add_block();
+
+        // everything after the call moves to the continuation, and the successors learn their new predecessor
+        const u32 original_count = static_cast<u32>(caller.insts_.size());
+        for (ValueId id = call + 1; id < original_count; id++) {
+            Instruction& inst = caller.insts_[id];
+            if (inst.block_ != block || inst.op_ == Opcode::Nop) {
+                continue;
+            }
+            inst.block_ = continuation;
+            BlockId succs[2] = { NO_BLOCK, NO_BLOCK };
+            u32 succ_count = 0;
+            if (inst.op_ == Opcode::Br) {
+                succs[succ_count++] = inst.imm_.targets_[0];
+            } else if (inst.op_ == Opcode::CondBr) {
+                succs[succ_count++] = inst.imm_.targets_[0];
+                if (inst.imm_.targets_[1] != inst.imm_.targets_[0]) {
+                    succs[succ_count++] = inst.imm_.targets_[1];
+                }
+            }
+            for (u32 i = 0; i < succ_count; i++) {
+                auto& preds = caller.blocks_[succs[i]].preds_;
+                std::replace(preds.begin(), preds.end(), block, continuation);
+            }
+        }
+
+        std::vector<BlockId> block_map(callee.blocks_.size());
+        for (BlockId b = 0; b < callee.blocks_.size(); b++) {
+            block_map[b] = caller.add_block();
+        }
+
+        const auto call_operands = caller.get_operands(call);
+        std::vector<ValueId> args;
+        for (ValueId operand : call_operands) {
+            args.push_back(caller.resolve(operand));
+        }
+
+        // copy first, then map operands, since phis refer to values defined further down
+        std::vector<ValueId> value_map(callee.insts_.size(), NO_VALUE);
+        std::vector<ValueId> returned;
+        std::vector<BlockId> return_blocks;
+        for (ValueId id = 0; id < callee.insts_.size(); id++) {
+            const Instruction& inst = callee.insts_[id];
+            const BlockId target_block = block_map[inst.block_];
+            switch (inst.op_) {
+                case Opcode::Param:
+                    value_map[id] = args[inst.imm_.index_];
+                    break;
+                case Opcode::Ret: {
+                    const ValueId jump = caller.append(target_block, Opcode::Br, TypeTable::INVALID);
+                    caller.insts_[jump].imm_.targets_[0] = continuation;
+                    return_blocks.push_back(target_block);
+                    if (inst.operand_count_ > 0) {
+                        returned.push_back(callee.get_operands(id)[0]);
+                    }
+                    break;
+                }
+                default: {
+                    const ValueId copy = caller.append(target_block, inst.op_, inst.type_);
+                    caller.insts_[copy].imm_ = inst.imm_;
+                    if (inst.op_ == Opcode::Br || inst.op_ == Opcode::CondBr) {
+                        caller.insts_[copy].imm_.targets_[0] = block_map[inst.imm_.targets_[0]];
+                        if (inst.op_ == Opcode::CondBr) {
+                            caller.insts_[copy].imm_.targets_[1] = block_map[inst.imm_.targets_[1]];
+                        }
+                    }
+                    value_map[id] = copy;
+                    break;
+                }
+            }
+        }
+
+        std::vector<ValueId> operands;
+        for (ValueId id = 0; id < callee.insts_.size(); id++) {
+            const Instruction& inst = callee.insts_[id];
+            if (inst.op_ == Opcode::Param || inst.op_ == Opcode::Ret || inst.operand_count_ == 0) {
+                continue;
+            }
+            operands.clear();
+            for (ValueId operand : callee.get_operands(id)) {
+                operands.push_back(value_map[operand]);
+            }
+            caller.set_operands(value_map[id], operands);
+        }
+
+        for (BlockId b = 0; b < callee.blocks_.size(); b++) {
+            for (BlockId pred : callee.blocks_[b].preds_) {
+                caller.add_edge(block_map[pred], block_map[b]);
+            }
+        }
+
+        const ValueId jump = caller.append(block, Opcode::Br, TypeTable::INVALID);
+        caller.insts_[jump].imm_.targets_[0] = block_map[0];
+        caller.add_edge(block, block_map[0]);
+        for (BlockId return_block : return_blocks) {
+            caller.add_edge(return_block, continuation);
+        }
+
+        if (!returned.empty()) {
+            ValueId value;
+            if (returned.size() == 1) {
+                value = value_map[returned[0]];
+            } else {
+                operands.clear();
+                for (ValueId operand : returned) {
+                    operands.push_back(value_map[operand]);
+                }
+                value = caller.append(continuation, Opcode::Phi, caller.insts_[call].type_, operands);
+            }
+            caller.replace_uses(call, value);
+        }
+        caller.insts_[call].op_ = Opcode::Nop;
+    }
+
+    LoopVectorizationPass::LoopVectorizationPass(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    /**
+     * Only records plans, so the function counts as unchanged and is not linearized, which would drop them.
+     */
+    PassResult LoopVectorizationPass::run(IrModule& module, const u32 index, AnalysisCache& analyses) {
+        IrFunction& function = module.functions_[index];
+        const UseLists& uses = analyses.get_uses();
+        function.vector_loops_.clear();
+        for (BlockId header = 0; header < function.blocks_.size(); header++) {
+            VectorLoop loop;
+            if (match_loop(function, uses, header, loop)) {
+                function.vector_loops_.push_back(loop);
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Adds, subs and muls on 32-bit integers wrap the same way in every lane, so the iterations of a vector step
+     * may run side by side and the lanes of each sum be added up afterwards without changing the result.
+     * Blocks are in reverse post-order, so the header of a loop precedes its body and the latch comes last.
+     */
+    bool LoopVectorizationPass::match_loop(const IrFunction& function, const UseLists& uses, const BlockId header, VectorLoop& out) const {
+        const IrBlock& block = function.blocks_[header];
+        if (block.preds_.size() != 2 || block.preds_[0] >= header || block.preds_[1] < header) {
+            return false;
+        }
+        const BlockId preheader = block.preds_[0];
+        const BlockId latch = block.preds_[1];
+
+        ValueId test = block.begin_;
+        while (test < block.end_ && function.insts_[test].op_ == Opcode::Phi) {
+            test++;
+        }
+        if (test == block.begin_ || block.end_ - test != 2) {
+            return false;
+        }
+        const Instruction& compare = function.insts_[test];
+        const Instruction& branch = function.insts_[test + 1];
+        if (compare.op_ != Opcode::Lt || branch.op_ != Opcode::CondBr || function.get_operands(test + 1)[0] != test) {
+            return false;
+        }
+
+        // the body is a chain of blocks, each entered only from the previous one
+        std::vector<bool> in_body(function.blocks_.size(), false);
+        BlockId previous = header;
+        BlockId current = branch.imm_.targets_[0];
+        for (u32 count = 1;; count++) {
+            if (current <= header || count > MAX_BODY_BLOCKS || in_body[current]) {
+                return false;
+            }
+            const IrBlock& member = function.blocks_[current];
+            const Instruction& jump = function.insts_[function.get_terminator(current)];
+            if (member.preds_.size() != 1 || member.preds_[0] != previous || jump.op_ != Opcode::Br) {
+                return false;
+            }
+            in_body[current] = true;
+            if (jump.imm_.targets_[0] == header) {
+                break;
+            }
+            previous = current;
+            current = jump.imm_.targets_[0];
+        }
+        if (current != latch) {
+            return false;
+        }
+
+        const auto test_operands = function.get_operands(test);
+        const ValueId induction = test_operands[0];
+        const ValueId bound = test_operands[1];
+        auto in_loop = [&](const ValueId value) {
+            const BlockId owner = function.insts_[value].block_;
+            return owner == header || in_body[owner];
+        };
+        auto is_header_phi = [&](const ValueId value) {
+            return value >= block.begin_ && value < test;
+        };
+        if (!is_header_phi(induction) || in_loop(bound) || !is_int32(function.insts_[bound].type_)) {
+            return false;
+        }
+
+        std::vector<ValueId> updates;
+        for (ValueId phi = block.begin_; phi < test; phi++) {
+            if (!is_int32(function.insts_[phi].type_)) {
+                return false;
+            }
+            const ValueId next = function.get_operands(phi)[1];
+            if (!in_loop(next) || function.insts_[next].block_ == header) {
+                return false;
+            }
+            const Instruction& step = function.insts_[next];
+            const auto step_operands = function.get_operands(next);
+
+            if (phi == induction) {
+                const ValueId one = step_operands[0] == phi ? step_operands[1] : step_operands[0];
+                if (step.op_ != Opcode::Add || (step_operands[0] != phi && step_operands[1] != phi)
+                    || !is_const(function, one) || function.insts_[one].imm_.int_ != 1) {
+                    return false;
+                }
+                continue;
+            }
+
+            // a sum feeds nothing in the loop but its own update, which feeds nothing but the phi
+            const bool adds = step.op_ == Opcode::Add && (step_operands[0] == phi || step_operands[1] == phi);
+            const bool subtracts = step.op_ == Opcode::Sub && step_operands[0] == phi;
+            if (!adds && !subtracts) {
+                return false;
+            }
+            for (const ValueId user : uses.get_users(phi)) {
+                if (in_loop(user) && user != next) {
+                    return false;
+                }
+            }
+            const auto next_users = uses.get_users(next);
+            if (next_users.size() != 1 || next_users[0] != phi || step_operands[0] == step_operands[1]) {
+                return false;
+            }
+            updates.push_back(next);
+        }
+        if (updates.empty()) {
+            return false;
+        }
+
+        // the induction and its step, the sums, every body value and every invariant each take a register
+        u64 values = 2 + updates.size();
+        std::vector<ValueId> invariants;
+        for (BlockId b = header + 1; b <= latch; b++) {
+            if (!in_body[b]) {
+                continue;
+            }
+            const IrBlock& member = function.blocks_[b];
+            for (ValueId id = member.begin_; id + 1 < member.end_; id++) {
+                const Instruction& inst = function.insts_[id];
+                const bool arithmetic = inst.op_ == Opcode::Add || inst.op_ == Opcode::Sub || inst.op_ == Opcode::Mul;
+                if ((!arithmetic && inst.op_ != Opcode::Const) || !is_int32(inst.type_)) {
+                    return false;
+                }
+                if (std::find(updates.begin(), updates.end(), id) == updates.end()) {
+                    values++;
+                }
+                for (const ValueId operand : function.get_operands(id)) {
+                    if (in_loop(operand)) {
+                        continue;
+                    }
+                    if (!is_int32(function.insts_[operand].type_)) {
+                        return false;
+                    }
+                    if (std::find(invariants.begin(), invariants.end(), operand) == invariants.end()) {
+                        invariants.push_back(operand);
+                    }
+                }
+            }
+        }
+        if (values + invariants.size() > MAX_VECTOR_VALUES) {
+            return false;
+        }
+
+        out.preheader_ = preheader;
+        out.header_ = header;
+        out.latch_ = latch;
+        out.induction_ = induction;
+        out.bound_ = bound;
+        return true;
+    }
+
+    bool LoopVectorizationPass::is_int32(const TypeId type) const {
+        if (type == TypeTable::INVALID) {
+            return false;
+        }
+        const TypeInfo& info = ctx_->type_table_.get_info(type);
+        return info.kind == TypeKind::Int && info.bits == 32;
+    }
+
+} /* solara */
@@ -0,0 +1,105 @@
+/**
+ * @file passes.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+#include "passmanager.h"
+
+namespace solara {
+
+    /**
+     * Folds instructions whose operands are constants, simplifies algebraic identities and phis that merge
+     * a single value, and turns conditional branches on constants into jumps. Folding is driven by a
+     * worklist over the use lists, so a fold only revisits the instructions it can affect.
+     */
+    class ConstantPropagationPass : public Pass {
+    public:
+        ConstantPropagationPass(CompilerContext* ctx);
+
+        virtual const char* get_name() const override { return "constprop"; }
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) override;
+
+    private:
+        CompilerContext* ctx_;
+        TypeId bool_type_;
+    };
+
+    /**
+     * Removes every instruction that neither has side effects nor feeds one, including dead phi cycles.
+     */
+    class DeadCodeEliminationPass : public Pass {
+    public:
+        DeadCodeEliminationPass(CompilerContext* ctx);
+
+        virtual const char* get_name() const override { return "dce"; }
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) override;
+
+    private:
+        CompilerContext* ctx_;
+    };
+
+    /**
+     * Common subexpression elimination by dominator-based value numbering: a pure instruction that computes
+     * the same operation on the same values as one in a dominating block is replaced by it.
+     */
+    class ValueNumberingPass : public Pass {
+    public:
+        ValueNumberingPass(CompilerContext* ctx);
+
+        virtual const char* get_name() const override { return "cse"; }
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) override;
+
+    private:
+        CompilerContext* ctx_;
+    };
+
+    /**
+     * Inlines calls to small public functions. Callees are read while callers change, so it runs serially.
+     */
+    class InliningPass : public Pass {
+    public:
+        static constexpr u32 MAX_CALLEE_INSTS = 48;
+        static constexpr u32 MAX_CALLER_INSTS = 4096;
+
+        InliningPass(CompilerContext* ctx);
+
+        virtual const char* get_name() const override { return "inline"; }
+        virtual bool is_function_pass() const override { return false; }
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) override;
+
+    protected:
+        void inline_call(IrFunction& caller, const ValueId call, const IrFunction& callee);
+
+    private:
+        CompilerContext* ctx_;
+    };
+
+    /**
+     * Finds counted loops whose iterations only feed 32-bit integer sums and records them as vector loops. The
+     * native backend runs such a loop several iterations at a time in SIMD registers and lets the original loop
+     * finish the remaining ones. The instructions themselves are left untouched.
+     */
+    class LoopVectorizationPass : public Pass {
+    public:
+        /** Values a vector loop may keep in registers: sixteen SSE registers less two scratch ones. */
+        static constexpr u32 MAX_VECTOR_VALUES = 14;
+        static constexpr u32 MAX_BODY_BLOCKS = 8;
+
+        LoopVectorizationPass(CompilerContext* ctx);
+
+        virtual const char* get_name() const override { return "vectorize"; }
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) override;
+
+    protected:
+        bool match_loop(const IrFunction& function, const UseLists& uses, const BlockId header, VectorLoop& out) const;
+        bool is_int32(const TypeId type) const;
+
+    private:
+        CompilerContext* ctx_;
+    };
+
+} /* solara */
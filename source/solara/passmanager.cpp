@@ -0,0 +1,203 @@
+/**
+ * @file passmanager.cpp
+ */
+
+#include "passmanager.h"
+#include "passes.h"
+
+#include <chrono>
+#include <iomanip>
+
+namespace solara {
+
+    std::span<const ValueId> UseLists::get_users(const ValueId value) const {
+        if (value + 1 >= offsets_.size()) {
+            return {};
+        }
+        return std::span<const ValueId>(users_.data() + offsets_[value], offsets_[value + 1] - offsets_[value]);
+    }
+
+    UseLists compute_uses(const IrFunction& function) {
+        const u32 count = static_cast<u32>(function.insts_.size());
+        UseLists out;
+        out.offsets_.assign(count + 1, 0);
+
+        // count first, then fill, so every list lands in one allocation
+        for (ValueId id = 0; id < count; id++) {
+            for (ValueId operand : function.get_operands(id)) {
+                if (operand < count) {
+                    out.offsets_[operand + 1]++;
+                }
+            }
+        }
+        for (u32 i = 0; i < count; i++) {
+            out.offsets_[i + 1] += out.offsets_[i];
+        }
+
+        out.users_.resize(out.offsets_[count]);
+        std::vector<u32> cursor(out.offsets_.begin(), out.offsets_.end() - 1);
+        for (ValueId id = 0; id < count; id++) {
+            for (ValueId operand : function.get_operands(id)) {
+                if (operand < count) {
+                    out.users_[cursor[operand]++] = id;
+                }
+            }
+        }
+        return out;
+    }
+
+    AnalysisCache::AnalysisCache(const IrFunction* function) {
+        assert(function != nullptr);
+        function_ = function;
+    }
+
+    const std::vector<BlockId>& AnalysisCache::get_dominators() {
+        if (!(valid_ & analysis_bit(AnalysisKind::Dominators))) {
+            dominators_ = compute_dominators(*function_);
+            valid_ |= analysis_bit(AnalysisKind::Dominators);
+        }
+        return dominators_;
+    }
+
+    const UseLists& AnalysisCache::get_uses() {
+        if (!(valid_ & analysis_bit(AnalysisKind::Uses))) {
+            uses_ = compute_uses(*function_);
+            valid_ |= analysis_bit(AnalysisKind::Uses);
+        }
+        return uses_;
+    }
+
+    void AnalysisCache::invalidate(const AnalysisSet preserved) {
+        valid_ &= preserved;
+    }
+
+    static u64 count_instructions(const IrModule& module) {
+        u64 count = 0;
+        for (const IrFunction& function : module.functions_) {
+            count += function.insts_.size();
+        }
+        return count;
+    }
+
+    PassManager::PassManager(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    void PassManager::add_pass(std::unique_ptr<Pass> pass) {
+        PassStats stats;
+        stats.name_ = pass->get_name();
+        stats_.push_back(stats);
+        passes_.push_back(std::move(pass));
+    }
+
+    void PassManager::add_default_pipeline(const u32 level) {
+        if (level == 0) {
+            return;
+        }
+
+        add_pass(std::make_unique<ConstantPropagationPass>(ctx_));
+        add_pass(std::make_unique<ValueNumberingPass>(ctx_));
+        add_pass(std::make_unique<DeadCodeEliminationPass>(ctx_));
+        if (level < 2) {
+            return;
+        }
+
+        // inlined bodies expose constant arguments and redundant work to a second round of cleanups
+        add_pass(std::make_unique<InliningPass>(ctx_));
+        add_pass(std::make_unique<ConstantPropagationPass>(ctx_));
+        add_pass(std::make_unique<ValueNumberingPass>(ctx_));
+        add_pass(std::make_unique<DeadCodeEliminationPass>(ctx_));
+        if (ctx_->settings_.vectorize_) {
+            add_pass(std::make_unique<LoopVectorizationPass>(ctx_));
+        }
+    }
+
+    void PassManager::run(IrModule& module) {
+        insts_before_ = count_instructions(module);
+        functions_ = module.functions_.size();
+
+        std::vector<AnalysisCache> analyses;
+        analyses.reserve(module.functions_.size());
+        for (const IrFunction& function : module.functions_) {
+            analyses.emplace_back(&function);
+        }
+
+        for (u64 i = 0; i < passes_.size(); i++) {
+            run_pass(module, i, analyses);
+            stats_[i].insts_after_ = count_instructions(module);
+        }
+    }
+
+    void PassManager::run_pass(IrModule& module, const u64 pass_index, std::vector<AnalysisCache>& analyses) {
+        Pass* pass = passes_[pass_index].get();
+        const auto start = std::chrono::steady_clock::now();
+
+        const u64 count = module.functions_.size();
+        std::vector<u08> changed(count, 0);
+        auto run_one = [&](const u64 index) {
+            IrFunction& function = module.functions_[index];
+            if (function.blocks_.empty()) {
+                return;
+            }
+            const PassResult result = pass->run(module, static_cast<u32>(index), analyses[index]);
+            if (result.changed_) {
+                function.linearize();
+                analyses[index].invalidate(result.preserved_ & ~analysis_bit(AnalysisKind::Uses));
+                changed[index] = 1;
+            }
+        };
+
+        if (pass->is_function_pass()) {
+            ctx_->thread_pool_.parallel_for(count, [&](const u64 index, const u32) {
+                run_one(index);
+            });
+        } else {
+            for (u64 i = 0; i < count; i++) {
+                run_one(i);
+            }
+        }
+
+        const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+        stats_[pass_index].seconds_ += elapsed.count();
+        for (u08 flag : changed) {
+            stats_[pass_index].changed_ += flag;
+        }
+
+#ifndef NDEBUG
+        // a broken pass is much easier to find right where it ran than at the end of the pipeline
+        std::vector<std::string> errors;
+        for (u64 i = 0; i < count; i++) {
+            if (changed[i]) {
+                verify_ir(ctx_, module, module.functions_[i], errors);
+            }
+        }
+        for (const std::string& error : errors) {
+            ctx_->logger_.log(ERROR, std::string("internal error: invalid IR after ") + pass->get_name() + ": " + error);
+        }
+#endif
+    }
+
+    void PassManager::print_timings(std::ostream& out) const {
+        f64 total = 0.0;
+        for (const PassStats& stats : stats_) {
+            total += stats.seconds_;
+        }
+
+        out << "pass timing (" << functions_ << " functions, " << insts_before_ << " instructions)\n";
+        out << "  " << std::left << std::setw(20) << "pass" << std::right
+            << std::setw(12) << "time (ms)" << std::setw(8) << "%"
+            << std::setw(10) << "changed" << std::setw(10) << "insts" << "\n";
+        for (const PassStats& stats : stats_) {
+            out << "  " << std::left << std::setw(20) << stats.name_ << std::right << std::fixed
+                << std::setw(12) << std::setprecision(3) << stats.seconds_ * 1000.0
+                << std::setw(8) << std::setprecision(1) << (total > 0.0 ? stats.seconds_ * 100.0 / total : 0.0)
+                << std::setw(10) << stats.changed_ << std::setw(10) << stats.insts_after_ << "\n";
+        }
+        out << "  " << std::left << std::setw(20) << "total" << std::right << std::fixed
+            << std::setw(12) << std::setprecision(3) << total * 1000.0 << "\n";
+        out << std::defaultfloat;
+        out.flush();
+    }
+
+} /* solara */
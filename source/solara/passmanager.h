@@ -0,0 +1,126 @@
+/**
+ * @file passmanager.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+
+#include <memory>
+#include <ostream>
+#include <span>
+#include <vector>
+
+namespace solara {
+
+    enum class AnalysisKind : u08 {
+        Dominators = 0,
+        Uses
+    };
+
+    /** Set of analyses, one bit per AnalysisKind. */
+    using AnalysisSet = u08;
+
+    constexpr AnalysisSet ANALYSIS_NONE = 0;
+    constexpr AnalysisSet ANALYSIS_ALL = 0xFF;
+
+    constexpr AnalysisSet analysis_bit(const AnalysisKind kind) {
+        return static_cast<AnalysisSet>(BIT(static_cast<u08>(kind)));
+    }
+
+    /**
+     * Users of every value, stored as one flat array sliced by per-value offsets.
+     * An instruction that uses a value twice is listed twice.
+     */
+    struct UseLists {
+        std::vector<u32> offsets_;
+        std::vector<ValueId> users_;
+
+        std::span<const ValueId> get_users(const ValueId value) const;
+    };
+
+    UseLists compute_uses(const IrFunction& function);
+
+    /**
+     * Lazily computed analyses of one function. Results stay cached until a pass that changed the
+     * function reports them as not preserved.
+     */
+    class AnalysisCache {
+    public:
+        AnalysisCache(const IrFunction* function);
+
+        const std::vector<BlockId>& get_dominators();
+        const UseLists& get_uses();
+        void invalidate(const AnalysisSet preserved);
+
+    private:
+        const IrFunction* function_;
+        AnalysisSet valid_ = ANALYSIS_NONE;
+        std::vector<BlockId> dominators_;
+        UseLists uses_;
+    };
+
+    struct PassResult {
+        bool changed_ = false;
+
+        /** Analyses still valid after the change. Value ids are renumbered after every change, so use lists never are. */
+        AnalysisSet preserved_ = ANALYSIS_ALL;
+    };
+
+    class Pass {
+    public:
+        virtual ~Pass() = default;
+
+        virtual const char* get_name() const = 0;
+
+        /**
+         * Function passes only read and write the function they run on, so the manager runs them across the
+         * thread pool. Other passes may look at the whole module and run serially.
+         */
+        virtual bool is_function_pass() const { return true; }
+
+        /**
+         * Runs the pass on one function of the module. The function is linearized on entry; the pass may leave
+         * nops and pending replacements behind, the manager linearizes again when it reports a change.
+         */
+        virtual PassResult run(IrModule& module, const u32 index, AnalysisCache& analyses) = 0;
+    };
+
+    /**
+     * Runs a pipeline of passes over every function of a module and keeps per-pass statistics.
+     */
+    class PassManager {
+    public:
+        PassManager(CompilerContext* ctx);
+
+        void add_pass(std::unique_ptr<Pass> pass);
+
+        /**
+         * Builds the pipeline of an optimization level: none at 0, local cleanups at 1, inlining, a second
+         * round of cleanups and, unless disabled, loop vectorization at 2.
+         */
+        void add_default_pipeline(const u32 level);
+        void run(IrModule& module);
+        void print_timings(std::ostream& out) const;
+
+    protected:
+        void run_pass(IrModule& module, const u64 pass_index, std::vector<AnalysisCache>& analyses);
+
+    private:
+        struct PassStats {
+            const char* name_;
+            f64 seconds_ = 0.0;
+            u64 changed_ = 0;
+            u64 insts_after_ = 0;
+        };
+
+        CompilerContext* ctx_;
+        std::vector<std::unique_ptr<Pass>> passes_;
+        std::vector<PassStats> stats_;
+        u64 insts_before_ = 0;
+        u64 functions_ = 0;
+    };
+
+} /* solara */
@@ -0,0 +1,344 @@
+/**
+ * @file pipeline.cpp
+ */
+
+#include "pipeline.h"
+#include "lowering.h"
+#include "interface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace solara {
+
+    static constexpr u32 STAGE_COUNT = static_cast<u32>(PipelineStage::Count);
+
+    /** Heap order of ready tasks: earlier stages first, since interfaces unblock other modules. */
+    struct ReadyOrder {
+        bool operator()(const u32 a, const u32 b) const {
+            return a % STAGE_COUNT != b % STAGE_COUNT ? a % STAGE_COUNT > b % STAGE_COUNT : a > b;
+        }
+    };
+
+    ModulePipeline::ModulePipeline(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    bool ModulePipeline::run(const ModuleGraph& graph) {
+        build_tasks(graph);
+
+        // a single worker leaves the pool free for the stages' own parallel loops
+        const u32 workers = static_cast<u32>(std::min<u64>(ctx_->thread_pool_.get_thread_count(), states_.size()));
+        if (workers <= 1) {
+            work();
+        } else {
+            ctx_->thread_pool_.parallel_for(workers, [this](const u64, const u32) { work(); });
+        }
+
+        std::vector<f64> paths(tasks_.size(), 0.0);
+        critical_path_ = 0.0;
+        total_work_ = 0.0;
+        for (u32 i = 0; i < tasks_.size(); i++) {
+            // prerequisites always have lower ids
+            for (const u32 prerequisite : tasks_[i].prerequisites_) {
+                paths[i] = std::max(paths[i], paths[prerequisite]);
+            }
+            paths[i] += tasks_[i].seconds_;
+            critical_path_ = std::max(critical_path_, paths[i]);
+            total_work_ += tasks_[i].seconds_;
+        }
+        ctx_->logger_.log(
+            INFO,
+            "Compiled " + std::to_string(states_.size()) + " modules with "
+                + std::to_string(total_work_ * 1000.0) + " ms of work, critical path "
+                + std::to_string(critical_path_ * 1000.0) + " ms."
+        );
+
+        bool ok = true;
+        for (u32 i = 0; i < states_.size(); i++) {
+            if (states_[i].analyzer_) {
+                states_[i].analyzer_->get_diagnostics().flush(
+                    ctx_->logger_, states_[i].root_ ? "" : states_[i].node_->path_.filename().string()
+                );
+            }
+            ok = ok && tasks_[i * STAGE_COUNT + static_cast<u32>(PipelineStage::Lower)].ok_;
+        }
+        return ok;
+    }
+
+    void ModulePipeline::set_root_parser(std::unique_ptr<Parser> parser) {
+        root_parser_ = std::move(parser);
+    }
+
+    std::vector<std::unique_ptr<Parser>>& ModulePipeline::get_parsers() {
+        return parsers_;
+    }
+
+    std::vector<std::unique_ptr<ModuleDeclNode>>& ModulePipeline::get_interfaces() {
+        return interfaces_;
+    }
+
+    std::vector<IrModule>& ModulePipeline::get_modules() {
+        return modules_;
+    }
+
+    f64 ModulePipeline::get_critical_path() const {
+        return critical_path_;
+    }
+
+    f64 ModulePipeline::get_total_work() const {
+        return total_work_;
+    }
+
+    /**
+     * Task i * STAGE_COUNT + s is stage s of module i. A module waits for its own previous stage, and its
+     * bodies are checked once its imports are declared, unless an import's interface could be read up front.
+     * Its constants are evaluated after those of its imports, even of imports read from an interface.
+     */
+    void ModulePipeline::build_tasks(const ModuleGraph& graph) {
+        const std::vector<ModuleGraphNode>& nodes = graph.get_modules();
+        states_.clear();
+        states_.resize(nodes.size());
+        parsers_.clear();
+        parsers_.resize(nodes.size());
+        modules_.clear();
+        modules_.resize(nodes.size());
+        interfaces_.clear();
+        interfaces_.resize(nodes.size());
+
+        tasks_.clear();
+        tasks_.resize(nodes.size() * STAGE_COUNT);
+        for (u32 i = 0; i < nodes.size(); i++) {
+            states_[i].node_ = &nodes[i];
+            states_[i].root_ = i + 1 == nodes.size();
+            if (ctx_->settings_.module_interfaces_ && !states_[i].root_) {
+                interfaces_[i] = read_module_interface(ctx_, nodes[i].path_);
+                if (interfaces_[i] && ctx_->string_table_.get_string(interfaces_[i]->name_id_) != nodes[i].name_) {
+                    interfaces_[i].reset();
+                }
+            }
+            for (u32 stage = 0; stage < STAGE_COUNT; stage++) {
+                Task& task = tasks_[i * STAGE_COUNT + stage];
+                task.module_ = i;
+                task.stage_ = static_cast<PipelineStage>(stage);
+                if (stage > 0) {
+                    task.prerequisites_.push_back(i * STAGE_COUNT + stage - 1);
+                }
+            }
+            for (const u32 dependency : nodes[i].dependencies_) {
+                tasks_[i * STAGE_COUNT + static_cast<u32>(PipelineStage::Evaluate)].prerequisites_.push_back(
+                    dependency * STAGE_COUNT + static_cast<u32>(PipelineStage::Evaluate)
+                );
+                if (interfaces_[dependency]) {
+                    continue;
+                }
+                tasks_[i * STAGE_COUNT + static_cast<u32>(PipelineStage::Check)].prerequisites_.push_back(
+                    dependency * STAGE_COUNT + static_cast<u32>(PipelineStage::Declare)
+                );
+            }
+        }
+
+        ready_.clear();
+        finished_ = 0;
+        for (u32 i = 0; i < tasks_.size(); i++) {
+            tasks_[i].waiting_ = static_cast<u32>(tasks_[i].prerequisites_.size());
+            for (const u32 prerequisite : tasks_[i].prerequisites_) {
+                tasks_[prerequisite].dependents_.push_back(i);
+            }
+            if (tasks_[i].waiting_ == 0) {
+                ready_.push_back(i);
+            }
+        }
+        std::make_heap(ready_.begin(), ready_.end(), ReadyOrder());
+    }
+
+    /**
+     * Takes ready tasks until every task has finished. A task whose prerequisites failed is skipped but still
+     * finishes, so its dependents are released and the run always ends.
+     */
+    void ModulePipeline::work() {
+        for (;;) {
+            u32 id;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_changed_.wait(lock, [this] { return !ready_.empty() || finished_ == tasks_.size(); });
+                if (ready_.empty()) {
+                    return;
+                }
+                std::pop_heap(ready_.begin(), ready_.end(), ReadyOrder());
+                id = ready_.back();
+                ready_.pop_back();
+            }
+
+            Task& task = tasks_[id];
+            bool ok = std::all_of(task.prerequisites_.begin(), task.prerequisites_.end(), [this](const u32 prerequisite) {
+                return tasks_[prerequisite].ok_;
+            });
+            const auto start = std::chrono::steady_clock::now();
+            if (ok) {
+                ok = run_task(task);
+            }
+            const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                task.ok_ = ok;
+                task.seconds_ = elapsed.count();
+                finished_++;
+                for (const u32 dependent : task.dependents_) {
+                    if (--tasks_[dependent].waiting_ == 0) {
+                        ready_.push_back(dependent);
+                        std::push_heap(ready_.begin(), ready_.end(), ReadyOrder());
+                    }
+                }
+            }
+            ready_changed_.notify_all();
+        }
+    }
+
+    bool ModulePipeline::run_task(Task& task) {
+        ModuleState& state = states_[task.module_];
+        switch (task.stage_) {
+            case PipelineStage::Parse: {
+                if (state.root_ && root_parser_) {
+                    parsers_[task.module_] = std::move(root_parser_);
+                    return parsers_[task.module_]->get_module() && parsers_[task.module_]->get_error_count() == 0;
+                }
+                auto parser = std::make_unique<Parser>(ctx_);
+                parser->set_lazy_bodies(ctx_->settings_.lazy_bodies_);
+                if (!state.root_) {
+                    parser->set_source_name(state.node_->path_.filename().string());
+                }
+                parser->init(state.node_->path_);
+                const bool ok = parser->get_module() && parser->get_error_count() == 0;
+                parsers_[task.module_] = std::move(parser);
+                return ok;
+            }
+            case PipelineStage::Declare: {
+                state.analyzer_ = std::make_unique<SemanticAnalyzer>(ctx_);
+                state.analyzer_->declare(parsers_[task.module_]->get_module());
+                const bool ok = state.analyzer_->get_diagnostics().get_error_count() == 0;
+                if (ok && ctx_->settings_.module_interfaces_ && !state.root_ && !interfaces_[task.module_]
+                    && !write_module_interface(ctx_, parsers_[task.module_]->get_module(), state.node_->path_)) {
+                    ctx_->logger_.log(WARNING, "could not write the interface of '" + state.node_->path_.string() + "'");
+                }
+                return ok;
+            }
+            case PipelineStage::Check:
+                if (!bind_imports(task.module_)) {
+                    return false;
+                }
+                state.analyzer_->check_bodies(parsers_[task.module_]->get_module());
+                return state.analyzer_->get_diagnostics().get_error_count() == 0;
+            case PipelineStage::Evaluate:
+                bind_definitions(task.module_);
+                state.analyzer_->evaluate_constants(parsers_[task.module_]->get_module());
+                return state.analyzer_->get_diagnostics().get_error_count() == 0;
+            case PipelineStage::Lower: {
+                IrLowering lowering(ctx_);
+                modules_[task.module_] = lowering.lower(parsers_[task.module_]->get_module());
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Points every import of a module at the tree of the module it names. The graph was scanned before the
+     * file was parsed, so an import it does not know of means the file changed in between.
+     */
+    bool ModulePipeline::bind_imports(const u32 module) {
+        const ModuleGraphNode& node = *states_[module].node_;
+        for (ImportDeclNode* import : parsers_[module]->get_module()->imports_) {
+            const std::string_view name = ctx_->string_table_.get_string(import->name_id_);
+            for (const u32 dependency : node.dependencies_) {
+                if (states_[dependency].node_->name_ == name) {
+                    import->module_ = interfaces_[dependency] ? interfaces_[dependency].get() : parsers_[dependency]->get_module();
+                }
+            }
+            if (!import->module_) {
+                states_[module].analyzer_->get_diagnostics().report(
+                    ERROR, import->span_, "module '" + std::string(name) + "' changed while it was being compiled"
+                );
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Points the declarations read from a module's interface at the functions they declare, for the tree
+     * evaluator. Importers evaluate their constants only after this, so they may call them.
+     */
+    void ModulePipeline::bind_definitions(const u32 module) {
+        if (!interfaces_[module]) {
+            return;
+        }
+        const auto& definitions = parsers_[module]->get_module()->functions_;
+        for (auto& [name_id, function] : interfaces_[module]->functions_) {
+            const auto it = definitions.find(name_id);
+            function->definition_ = it != definitions.end() ? it->second : nullptr;
+        }
+    }
+
+    IrModule link_modules(CompilerContext* ctx, std::vector<IrModule>& modules, std::span<ModuleDeclNode* const> decls) {
+        if (modules.size() == 1) {
+            return std::move(modules.front());
+        }
+
+        IrModule out;
+        out.name_id_ = modules.back().name_id_;
+
+        // a module numbers its own functions first and declares the functions it imports after them
+        std::vector<u32> own_counts(modules.size(), 0);
+        std::vector<std::vector<u32>> indices(modules.size());
+        std::vector<u32> begins(modules.size() + 1, 0);
+        std::unordered_map<u64, u32> definitions;
+        for (u64 i = 0; i < modules.size(); i++) {
+            const bool root = i + 1 == modules.size();
+            const std::string prefix = std::string(ctx->string_table_.get_string(decls[i]->name_id_)) + ".";
+            for (SyntaxNodeHandle decl : decls[i]->decls_) {
+                own_counts[i] += syntax_node_cast<FunctionDeclNode>(decl) != nullptr;
+            }
+
+            begins[i] = static_cast<u32>(out.functions_.size());
+            for (u32 j = 0; j < own_counts[i]; j++) {
+                IrFunction& function = modules[i].functions_[j];
+                if (!root) {
+                    function.name_id_ = ctx->string_table_.add(prefix + std::string(ctx->string_table_.get_string(function.name_id_)));
+                }
+                definitions.emplace(function.name_id_, static_cast<u32>(out.functions_.size()));
+                indices[i].push_back(static_cast<u32>(out.functions_.size()));
+                out.functions_.push_back(std::move(function));
+            }
+        }
+        begins[modules.size()] = static_cast<u32>(out.functions_.size());
+
+        for (u64 i = 0; i < modules.size(); i++) {
+            for (u32 j = own_counts[i]; j < modules[i].functions_.size(); j++) {
+                IrFunction& function = modules[i].functions_[j];
+                auto it = definitions.find(function.name_id_);
+                if (it == definitions.end()) {
+                    it = definitions.emplace(function.name_id_, static_cast<u32>(out.functions_.size())).first;
+                    out.functions_.push_back(std::move(function));
+                }
+                indices[i].push_back(it->second);
+            }
+        }
+
+        for (u64 i = 0; i < modules.size(); i++) {
+            for (u32 f = begins[i]; f < begins[i + 1]; f++) {
+                for (Instruction& inst : out.functions_[f].insts_) {
+                    if (inst.op_ == Opcode::Call && inst.imm_.index_ != ~0u) {
+                        inst.imm_.index_ = indices[i][inst.imm_.index_];
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+} /* solara */
@@ -0,0 +1,116 @@
+/**
+ * @file pipeline.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "modulegraph.h"
+#include "parser.h"
+#include "analyzer.h"
+#include "ir.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace solara {
+
+    enum class PipelineStage : u08 {
+        Parse = 0,
+        Declare,
+        Check,
+        Evaluate,
+        Lower,
+        Count
+    };
+
+    /**
+     * Compiles the modules of a graph up to IR, each in stages run as soon as their inputs are ready.
+     * A module's bodies need only the declared interfaces of its imports, so dependents are checked while
+     * their imports still check their own bodies, and interface stages are always picked first.
+     * Diagnostics are flushed per module in graph order, so the output does not depend on scheduling.
+     * An imported module with a current interface file is known without parsing it, so its importers are
+     * checked against the interface right away; the module itself is still compiled, for its code.
+     * Constants are evaluated once a module is checked and its imports have evaluated theirs, since they may
+     * call imported functions; lowering only waits for the module's own constants.
+     */
+    class ModulePipeline {
+    public:
+        ModulePipeline(CompilerContext* ctx);
+
+        /**
+         * Runs every stage of every module across the thread pool and reports its critical path.
+         * @returns False if any module reported errors.
+         */
+        bool run(const ModuleGraph& graph);
+
+        /** Hands over the already parsed root module, such as one read from a stream, for the next run. */
+        void set_root_parser(std::unique_ptr<Parser> parser);
+
+        /** Parsers of the modules, owning their syntax trees, in graph order. */
+        std::vector<std::unique_ptr<Parser>>& get_parsers();
+
+        /** Modules read from interface files, which the trees of their importers refer to, in graph order. */
+        std::vector<std::unique_ptr<ModuleDeclNode>>& get_interfaces();
+
+        /** Lowered, unlinked IR of the modules in graph order. */
+        std::vector<IrModule>& get_modules();
+
+        /** @returns Seconds of the longest chain of dependent stages of the last run. */
+        f64 get_critical_path() const;
+
+        /** @returns Seconds spent in all stages of the last run, summed. */
+        f64 get_total_work() const;
+
+    protected:
+        struct Task {
+            u32 module_;
+            PipelineStage stage_;
+            std::vector<u32> prerequisites_;
+            std::vector<u32> dependents_;
+            u32 waiting_ = 0;
+            bool ok_ = false;
+            f64 seconds_ = 0.0;
+        };
+
+        struct ModuleState {
+            const ModuleGraphNode* node_;
+            std::unique_ptr<SemanticAnalyzer> analyzer_;
+            bool root_ = false;
+        };
+
+        void build_tasks(const ModuleGraph& graph);
+        void work();
+        bool run_task(Task& task);
+        bool bind_imports(const u32 module);
+        void bind_definitions(const u32 module);
+
+    private:
+        CompilerContext* ctx_;
+        std::vector<Task> tasks_;
+        std::vector<ModuleState> states_;
+        std::vector<std::unique_ptr<Parser>> parsers_;
+        std::unique_ptr<Parser> root_parser_;
+        std::vector<std::unique_ptr<ModuleDeclNode>> interfaces_;
+        std::vector<IrModule> modules_;
+        f64 critical_path_ = 0.0;
+        f64 total_work_ = 0.0;
+
+        std::mutex mutex_;
+        std::condition_variable ready_changed_;
+        std::vector<u32> ready_;
+        u64 finished_ = 0;
+    };
+
+    /**
+     * Links the IR of modules in graph order into one module. Functions of the root keep their names and the
+     * others are renamed 'module.name', which is how importers declare them, so each call to an import is
+     * bound to its definition by name.
+     */
+    IrModule link_modules(CompilerContext* ctx, std::vector<IrModule>& modules, std::span<ModuleDeclNode* const> decls);
+
+} /* solara */
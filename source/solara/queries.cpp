@@ -0,0 +1,336 @@
+/**
+ * @file queries.cpp
+ */
+
+#include "queries.h"
+#include "analyzer.h"
+#include "stringtable.h"
+#include "syntaxwalk.h"
+
+#include <fstream>
+#include <iterator>
+
+namespace solara {
+
+    /** Adapts a member of ModuleQueries to the engine's query interface. */
+    class ModuleQueryAdapter : public Query {
+    public:
+        using Compute = QueryValue (ModuleQueries::*)(QueryEngine&, const u64);
+
+        ModuleQueryAdapter(ModuleQueries* queries, Compute compute)
+            : queries_(queries)
+            , compute_(compute)
+        {}
+
+        virtual QueryValue compute(QueryEngine& engine, const u64 key) override {
+            return (queries_->*compute_)(engine, key);
+        }
+
+    private:
+        ModuleQueries* queries_;
+        Compute compute_;
+    };
+
+    static constexpr u32 query_kind(const ModuleQuery query) {
+        return static_cast<u32>(query);
+    }
+
+    static u64 hash_value(u64 hash, const u64 value) {
+        for (u32 i = 0; i < 8; i++) {
+            hash = hash_string_step(hash, static_cast<char>(value >> (i * 8)));
+        }
+        return hash;
+    }
+
+    /** Folds the values of the constants declared in a body into a hash. */
+    struct ConstantHasher {
+        u64 hash_;
+
+        void leave(VarDeclNode* node) {
+            if (node->const_) {
+                hash_ = hash_value(hash_, static_cast<u64>(node->value_));
+            }
+        }
+    };
+
+    static u64 function_key(const u64 path_id, const u64 name_id) {
+        assert(path_id <= 0xFFFFFFFFull && name_id <= 0xFFFFFFFFull);
+        return path_id << 32 | name_id;
+    }
+
+    ModuleQueries::ModuleQueries(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+
+        const std::pair<ModuleQuery, ModuleQueryAdapter::Compute> queries[] = {
+            { ModuleQuery::ModuleTree, &ModuleQueries::compute_tree },
+            { ModuleQuery::ModuleSignature, &ModuleQueries::compute_signature },
+            { ModuleQuery::FunctionSource, &ModuleQueries::compute_function_source },
+            { ModuleQuery::FunctionIr, &ModuleQueries::compute_function_ir },
+            { ModuleQuery::ModuleIr, &ModuleQueries::compute_module_ir },
+        };
+        for (const auto& [kind, compute] : queries) {
+            engine_.register_query(query_kind(kind), std::make_unique<ModuleQueryAdapter>(this, compute));
+        }
+    }
+
+    bool ModuleQueries::run(const ModuleGraph& graph) {
+        if (lazy_bodies_ != ctx_->settings_.lazy_bodies_) {
+            engine_.clear();
+            lowerings_.clear();
+            lazy_bodies_ = ctx_->settings_.lazy_bodies_;
+        }
+        engine_.reset_counts();
+        modules_.clear();
+        parsers_.clear();
+
+        const std::vector<ModuleGraphNode>& nodes = graph.get_modules();
+        std::vector<u64> path_ids;
+        for (const ModuleGraphNode& node : nodes) {
+            path_ids.push_back(ctx_->string_table_.add(node.path_.string()));
+        }
+        for (u32 i = 0; i < nodes.size(); i++) {
+            std::ifstream file(nodes[i].path_, std::ios::binary);
+            if (!file.is_open()) {
+                ctx_->logger_.log(ERROR, "error: could not read source file '" + nodes[i].path_.string() + "'");
+                return false;
+            }
+            auto text = std::make_shared<std::string>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            const u64 fingerprint = hash_string(*text);
+            engine_.set_input(query_kind(ModuleQuery::SourceText), path_ids[i], { std::move(text), fingerprint });
+
+            auto info = std::make_shared<ModuleInput>();
+            info->source_name_ = i + 1 == nodes.size() ? "" : nodes[i].path_.filename().string();
+            u64 info_hash = hash_string(info->source_name_);
+            for (const u32 dependency : nodes[i].dependencies_) {
+                info->dependencies_.push_back(path_ids[dependency]);
+                info->dependency_names_.push_back(nodes[dependency].name_);
+                info_hash = hash_value(info_hash, path_ids[dependency]);
+                info_hash = hash_value(info_hash, hash_string(nodes[dependency].name_));
+            }
+            engine_.set_input(query_kind(ModuleQuery::ModuleInfo), path_ids[i], { std::move(info), info_hash });
+        }
+
+        // a failed tree is invalidated, so the next run reports its errors again even if nothing changed
+        std::vector<u64> failed;
+        for (const u64 path_id : path_ids) {
+            if (!engine_.get_untracked<ModuleTree>(query_kind(ModuleQuery::ModuleTree), path_id)->ok_) {
+                failed.push_back(path_id);
+            }
+        }
+        for (const u64 path_id : failed) {
+            engine_.invalidate(query_kind(ModuleQuery::ModuleTree), path_id);
+        }
+        if (!failed.empty()) {
+            return false;
+        }
+
+        for (const u64 path_id : path_ids) {
+            modules_.push_back(*engine_.get_untracked<IrModule>(query_kind(ModuleQuery::ModuleIr), path_id));
+            parsers_.push_back(engine_.get_untracked<ModuleTree>(query_kind(ModuleQuery::ModuleTree), path_id)->parser_);
+        }
+        ctx_->logger_.log(
+            INFO,
+            "Brought " + std::to_string(nodes.size()) + " modules up to date with " + std::to_string(engine_.get_computed_count())
+                + " queries computed and " + std::to_string(engine_.get_reused_count()) + " reused."
+        );
+        return true;
+    }
+
+    std::vector<IrModule>& ModuleQueries::get_modules() {
+        return modules_;
+    }
+
+    const std::vector<std::shared_ptr<Parser>>& ModuleQueries::get_parsers() const {
+        return parsers_;
+    }
+
+    QueryEngine& ModuleQueries::get_engine() {
+        return engine_;
+    }
+
+    /**
+     * Parses a module and, once its imports are analyzed, analyzes it against their trees. Nothing from the
+     * previous tree is reused: declarations, every body and the constants are checked again even when the edit
+     * was inside one body. A new tree always counts as changed, since the trees of importers would point into
+     * it, so they are redone as well.
+     */
+    QueryValue ModuleQueries::compute_tree(QueryEngine& engine, const u64 path_id) {
+        const auto text = engine.get<std::string>(query_kind(ModuleQuery::SourceText), path_id);
+        const auto info = engine.get<ModuleInput>(query_kind(ModuleQuery::ModuleInfo), path_id);
+
+        auto tree = std::make_shared<ModuleTree>();
+        bool dependencies_ok = true;
+        for (const u64 dependency : info->dependencies_) {
+            tree->dependencies_.push_back(engine.get<ModuleTree>(query_kind(ModuleQuery::ModuleTree), dependency));
+            dependencies_ok = dependencies_ok && tree->dependencies_.back()->ok_;
+        }
+
+        tree->parser_ = std::make_shared<Parser>(ctx_);
+        tree->parser_->set_lazy_bodies(lazy_bodies_);
+        if (!info->source_name_.empty()) {
+            tree->parser_->set_source_name(info->source_name_);
+        }
+        tree->parser_->init_text(*text);
+        ModuleDeclNode* module = tree->parser_->get_module();
+        if (!module || tree->parser_->get_error_count() != 0 || !dependencies_ok) {
+            return { std::move(tree), ++tree_serial_ };
+        }
+
+        SemanticAnalyzer analyzer(ctx_);
+        DiagnosticList& diagnostics = analyzer.get_diagnostics();
+        analyzer.declare(module);
+        bool bound = diagnostics.get_error_count() == 0;
+        for (u32 i = 0; bound && i < module->imports_.size(); i++) {
+            ImportDeclNode* import = module->imports_[i];
+            const std::string_view name = ctx_->string_table_.get_string(import->name_id_);
+            for (u32 j = 0; j < info->dependencies_.size(); j++) {
+                if (info->dependency_names_[j] == name) {
+                    import->module_ = tree->dependencies_[j]->parser_->get_module();
+                }
+            }
+            if (!import->module_) {
+                diagnostics.report(ERROR, import->span_, "module '" + std::string(name) + "' changed while it was being compiled");
+                bound = false;
+            }
+        }
+        if (bound) {
+            analyzer.check_bodies(module);
+        }
+        if (bound && diagnostics.get_error_count() == 0) {
+            analyzer.evaluate_constants(module);
+        }
+        diagnostics.flush(ctx_->logger_, info->source_name_);
+        tree->ok_ = bound && diagnostics.get_error_count() == 0;
+        return { std::move(tree), ++tree_serial_ };
+    }
+
+    /**
+     * Fingerprints every token of a module outside its function bodies, which holds its name, imports and
+     * declarations, together with the signatures of its imports. Positions are left out, so moving code
+     * around inside a file keeps the signature. The values of module-level constants are added as well,
+     * since a constant calling a function changes with that function's body.
+     */
+    QueryValue ModuleQueries::compute_signature(QueryEngine& engine, const u64 path_id) {
+        const auto tree = engine.get<ModuleTree>(query_kind(ModuleQuery::ModuleTree), path_id);
+        const auto info = engine.get<ModuleInput>(query_kind(ModuleQuery::ModuleInfo), path_id);
+
+        u64 hash = STRING_HASH_SEED;
+        const Parser& parser = *tree->parser_;
+        u64 begin = 0;
+        if (ModuleDeclNode* module = parser.get_module()) {
+            for (SyntaxNodeHandle decl : module->decls_) {
+                auto function = syntax_node_cast<FunctionDeclNode>(decl);
+                if (function && function->body_end_ > function->body_begin_ && function->body_begin_ >= begin) {
+                    hash = hash_tokens(parser, begin, function->body_begin_, hash);
+                    begin = function->body_end_ + 1;
+                }
+            }
+        }
+        hash = hash_tokens(parser, begin, parser.get_tokens().size(), hash);
+        if (ModuleDeclNode* module = parser.get_module()) {
+            ConstantHasher hasher = { hash };
+            for (SyntaxNodeHandle decl : module->decls_) {
+                if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                    hasher.leave(constant);
+                }
+            }
+            hash = hasher.hash_;
+        }
+
+        for (const u64 dependency : info->dependencies_) {
+            hash = hash_value(hash, engine.get_value(query_kind(ModuleQuery::ModuleSignature), dependency).fingerprint_);
+        }
+        return { nullptr, hash };
+    }
+
+    /** Fingerprints the tokens of a body and the values of the constants it declares. */
+    QueryValue ModuleQueries::compute_function_source(QueryEngine& engine, const u64 key) {
+        const auto tree = engine.get<ModuleTree>(query_kind(ModuleQuery::ModuleTree), key >> 32);
+        u64 hash = hash_value(STRING_HASH_SEED, key & 0xFFFFFFFFull);
+        FunctionDeclNode* function = find_function(*tree, key & 0xFFFFFFFFull);
+        if (function && function->body_end_ > function->body_begin_) {
+            hash = hash_tokens(*tree->parser_, function->body_begin_, function->body_end_ + 1, hash);
+        }
+        if (function && function->body_) {
+            ConstantHasher hasher = { hash };
+            FusedSyntaxWalk<ConstantHasher> walk(hasher);
+            walk.walk_children(function->body_);
+            hash = hasher.hash_;
+        }
+        return { nullptr, hash };
+    }
+
+    /**
+     * Lowers one function of a module's current tree. The result depends only on the function's body and
+     * on the signature, which fixes the numbering of the functions its calls target, so the tree itself is
+     * read untracked.
+     */
+    QueryValue ModuleQueries::compute_function_ir(QueryEngine& engine, const u64 key) {
+        const u64 path_id = key >> 32;
+        const u64 signature = engine.get_value(query_kind(ModuleQuery::ModuleSignature), path_id).fingerprint_;
+        const u64 source = engine.get_value(query_kind(ModuleQuery::FunctionSource), key).fingerprint_;
+        const auto tree = engine.get_untracked<ModuleTree>(query_kind(ModuleQuery::ModuleTree), path_id);
+
+        ModuleLowering& lowering = get_lowering(path_id, tree);
+        FunctionDeclNode* function = find_function(*tree, key & 0xFFFFFFFFull);
+        const u32 index = lowering.lowering_->get_function_index(function);
+        assert(index < lowering.headers_.functions_.size());
+        auto out = std::make_shared<IrFunction>(lowering.headers_.functions_[index]);
+        lowering.lowering_->lower_function(function, *out);
+        return { std::move(out), hash_value(hash_value(STRING_HASH_SEED, signature), source) };
+    }
+
+    QueryValue ModuleQueries::compute_module_ir(QueryEngine& engine, const u64 path_id) {
+        u64 hash = engine.get_value(query_kind(ModuleQuery::ModuleSignature), path_id).fingerprint_;
+        const auto tree = engine.get_untracked<ModuleTree>(query_kind(ModuleQuery::ModuleTree), path_id);
+
+        ModuleLowering& lowering = get_lowering(path_id, tree);
+        auto out = std::make_shared<IrModule>(lowering.headers_);
+        u32 index = 0;
+        for (SyntaxNodeHandle decl : tree->parser_->get_module()->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                const QueryValue& value = engine.get_value(query_kind(ModuleQuery::FunctionIr), function_key(path_id, function->name_id_));
+                out->functions_[index++] = *std::static_pointer_cast<const IrFunction>(value.value_);
+                hash = hash_value(hash, value.fingerprint_);
+            }
+        }
+        return { std::move(out), hash };
+    }
+
+    /** Numbers the functions of a tree the first time one of them is lowered, and again once the tree changed. */
+    ModuleQueries::ModuleLowering& ModuleQueries::get_lowering(const u64 path_id, const std::shared_ptr<const ModuleTree>& tree) {
+        ModuleLowering& lowering = lowerings_[path_id];
+        if (lowering.tree_ != tree) {
+            lowering.tree_ = tree;
+            lowering.lowering_ = std::make_unique<IrLowering>(ctx_);
+            lowering.headers_ = lowering.lowering_->declare(tree->parser_->get_module());
+        }
+        return lowering;
+    }
+
+    FunctionDeclNode* ModuleQueries::find_function(const ModuleTree& tree, const u64 name_id) const {
+        ModuleDeclNode* module = tree.parser_->get_module();
+        if (!module) {
+            return nullptr;
+        }
+        const auto it = module->functions_.find(name_id);
+        return it != module->functions_.end() ? it->second : nullptr;
+    }
+
+    /** Folds the kinds and values of a range of tokens into a hash, leaving out their positions. */
+    u64 ModuleQueries::hash_tokens(const Parser& parser, const u64 begin, const u64 end, u64 hash) const {
+        const std::pmr::vector<TokenLexeme>& tokens = parser.get_tokens();
+        for (u64 i = begin; i < end && i < tokens.size(); i++) {
+            hash = hash_value(hash, static_cast<u64>(tokens[i].type));
+            if (token_has_value(tokens[i].type)) {
+                for (const char c : parser.get_token_value(tokens[i])) {
+                    hash = hash_string_step(hash, c);
+                }
+                hash = hash_value(hash, 0);
+            }
+        }
+        return hash;
+    }
+
+} /* solara */
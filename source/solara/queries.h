@@ -0,0 +1,114 @@
+/**
+ * @file queries.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "query.h"
+#include "parser.h"
+#include "modulegraph.h"
+#include "lowering.h"
+#include "ir.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    enum class ModuleQuery : u32 {
+        /** Input: the text of a source file, keyed by the string id of its path. */
+        SourceText = 0,
+
+        /** Input: how a module is named in diagnostics and which modules it imports. */
+        ModuleInfo,
+
+        /** A module's parser and tree, analyzed against the trees of its imports; redone whole on any edit. */
+        ModuleTree,
+
+        /** Everything about a module its importers and its own function bodies can see: all but the bodies, and the values of its constants. */
+        ModuleSignature,
+
+        /** The tokens and constant values of one function body, keyed by the path id and the function's name id. */
+        FunctionSource,
+
+        /** The IR of one function. */
+        FunctionIr,
+
+        /** A module's unlinked IR, assembled from its functions. */
+        ModuleIr,
+        Count
+    };
+
+    /**
+     * The front end of a long running compiler as memoized queries over the files of a module graph. Only
+     * lowering is incremental per function. Any edit to a file, even inside one body, parses its module again,
+     * declares it, checks every body and evaluates its constants, and does the same for every module importing
+     * it, since their trees point into its tree. Symbols and types have no queries of their own. Each function is
+     * lowered on its own, and its IR is reused while its body tokens and its module's signature stay the same,
+     * both compared without positions. So editing one body lowers only that function again. Interface files are
+     * not used.
+     */
+    class ModuleQueries {
+    public:
+        struct ModuleInput {
+            std::string source_name_;
+            std::vector<u64> dependencies_;
+            std::vector<std::string> dependency_names_;
+        };
+
+        struct ModuleTree {
+            std::shared_ptr<Parser> parser_;
+            std::vector<std::shared_ptr<const ModuleTree>> dependencies_;
+            bool ok_ = false;
+        };
+
+        ModuleQueries(CompilerContext* ctx);
+
+        /**
+         * Sets the files of a graph as inputs and brings every module up to date, in graph order.
+         * @returns False if any module reported errors; they are reported again by the next run.
+         */
+        bool run(const ModuleGraph& graph);
+
+        /** Lowered, unlinked IR of the modules of the last run, in graph order. */
+        std::vector<IrModule>& get_modules();
+
+        /** Parsers of the modules of the last run, in graph order, shared with the queries. */
+        const std::vector<std::shared_ptr<Parser>>& get_parsers() const;
+
+        QueryEngine& get_engine();
+
+    protected:
+        /** A lowering that numbered a tree's functions, kept while the tree is current. */
+        struct ModuleLowering {
+            std::shared_ptr<const ModuleTree> tree_;
+            std::unique_ptr<IrLowering> lowering_;
+            IrModule headers_;
+        };
+
+        QueryValue compute_tree(QueryEngine& engine, const u64 path_id);
+        QueryValue compute_signature(QueryEngine& engine, const u64 path_id);
+        QueryValue compute_function_source(QueryEngine& engine, const u64 key);
+        QueryValue compute_function_ir(QueryEngine& engine, const u64 key);
+        QueryValue compute_module_ir(QueryEngine& engine, const u64 path_id);
+
+        ModuleLowering& get_lowering(const u64 path_id, const std::shared_ptr<const ModuleTree>& tree);
+        FunctionDeclNode* find_function(const ModuleTree& tree, const u64 name_id) const;
+        u64 hash_tokens(const Parser& parser, const u64 begin, const u64 end, u64 hash) const;
+
+    private:
+        CompilerContext* ctx_;
+        QueryEngine engine_;
+        std::unordered_map<u64, ModuleLowering> lowerings_;
+        bool lazy_bodies_ = false;
+        u64 tree_serial_ = 0;
+
+        std::vector<IrModule> modules_;
+        std::vector<std::shared_ptr<Parser>> parsers_;
+    };
+
+} /* solara */
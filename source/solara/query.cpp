@@ -0,0 +1,121 @@
+/**
+ * @file query.cpp
+ */
+
+#include "query.h"
+
+namespace solara {
+
+    void QueryEngine::register_query(const u32 kind, std::unique_ptr<Query> query) {
+        if (queries_.size() <= kind) {
+            queries_.resize(kind + 1);
+        }
+        queries_[kind] = std::move(query);
+    }
+
+    bool QueryEngine::set_input(const u32 kind, const u64 key, QueryValue value) {
+        Slot& slot = slots_[{ kind, key }];
+        const bool changed = !slot.input_ || slot.value_.fingerprint_ != value.fingerprint_;
+        slot.input_ = true;
+        slot.value_ = std::move(value);
+        if (changed) {
+            slot.changed_at_ = ++revision_;
+        }
+        slot.verified_at_ = revision_;
+        return changed;
+    }
+
+    void QueryEngine::invalidate(const u32 kind, const u64 key) {
+        auto it = slots_.find({ kind, key });
+        if (it == slots_.end()) {
+            return;
+        }
+        revision_++;
+        if (it->second.input_) {
+            it->second.changed_at_ = revision_;
+        } else {
+            it->second.verified_at_ = 0;
+        }
+    }
+
+    void QueryEngine::clear() {
+        assert(frames_.empty());
+        slots_.clear();
+        revision_++;
+    }
+
+    const QueryValue& QueryEngine::get_value(const u32 kind, const u64 key) {
+        return demand({ kind, key }, true);
+    }
+
+    const QueryValue& QueryEngine::get_value_untracked(const u32 kind, const u64 key) {
+        return demand({ kind, key }, false);
+    }
+
+    u64 QueryEngine::get_revision() const {
+        return revision_;
+    }
+
+    u64 QueryEngine::get_computed_count() const {
+        return computed_;
+    }
+
+    u64 QueryEngine::get_reused_count() const {
+        return reused_;
+    }
+
+    void QueryEngine::reset_counts() {
+        computed_ = 0;
+        reused_ = 0;
+    }
+
+    const QueryValue& QueryEngine::demand(const QueryKey& key, const bool track) {
+        if (track && !frames_.empty()) {
+            frames_.back()->push_back(key);
+        }
+
+        Slot& slot = slots_[key];
+        assert(!slot.active_ && "query depends on itself");
+        if (slot.input_ || slot.verified_at_ == revision_) {
+            return slot.value_;
+        }
+        if (slot.verified_at_ != 0 && is_unchanged(slot)) {
+            slot.verified_at_ = revision_;
+            reused_++;
+            return slot.value_;
+        }
+        execute(slot, key);
+        return slot.value_;
+    }
+
+    /** Brings the dependencies up to date in the order they were read, stopping at the first that changed. */
+    bool QueryEngine::is_unchanged(const Slot& slot) {
+        for (const QueryKey& dependency : slot.dependencies_) {
+            demand(dependency, false);
+            if (slots_[dependency].changed_at_ > slot.verified_at_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void QueryEngine::execute(Slot& slot, const QueryKey& key) {
+        assert(key.kind_ < queries_.size() && queries_[key.kind_] && "query kind was never registered");
+        std::vector<QueryKey> dependencies;
+        slot.active_ = true;
+        frames_.push_back(&dependencies);
+        QueryValue value = queries_[key.kind_]->compute(*this, key.key_);
+        frames_.pop_back();
+        slot.active_ = false;
+        computed_++;
+
+        // an equal result is backdated, so the queries that read the old one need not run again
+        if (slot.verified_at_ == 0 || slot.changed_at_ == 0 || value.fingerprint_ != slot.value_.fingerprint_) {
+            slot.changed_at_ = revision_;
+        }
+        slot.value_ = std::move(value);
+        slot.verified_at_ = revision_;
+        slot.dependencies_ = std::move(dependencies);
+    }
+
+} /* solara */
@@ -0,0 +1,128 @@
+/**
+ * @file query.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace solara {
+
+    struct QueryKey {
+        u32 kind_;
+        u64 key_;
+
+        bool operator==(const QueryKey& other) const {
+            return kind_ == other.kind_ && key_ == other.key_;
+        }
+    };
+
+    struct QueryKeyHash {
+        size_t operator()(const QueryKey& key) const {
+            return static_cast<size_t>(key.key_ * 0x9E3779B97F4A7C15ull) ^ key.kind_;
+        }
+    };
+
+    /** A query's result, with a fingerprint that is equal for results that downstream queries cannot tell apart. */
+    struct QueryValue {
+        std::shared_ptr<const void> value_;
+        u64 fingerprint_ = 0;
+    };
+
+    class QueryEngine;
+
+    /** Computes one kind of query. Whatever it reads through the engine becomes a dependency of its result. */
+    class Query {
+    public:
+        virtual ~Query() = default;
+        virtual QueryValue compute(QueryEngine& engine, const u64 key) = 0;
+    };
+
+    /**
+     * Memoizes queries by kind and key, and records which queries each one read. Setting an input whose
+     * fingerprint differs starts a new revision. A result is then reused if none of its dependencies changed
+     * since it was last verified, which is checked from the bottom up; otherwise it is computed again, and
+     * if the new result has the old fingerprint it keeps the revision it last changed in, so the queries
+     * depending on it stay valid. Queries are demanded from one thread, while a query may still use the
+     * thread pool inside its own computation.
+     * @see Matsakis et al., "Salsa", and the red-green algorithm of rustc's incremental compilation
+     */
+    class QueryEngine {
+    public:
+        QueryEngine() = default;
+
+        QueryEngine(const QueryEngine&) = delete;
+        QueryEngine& operator=(const QueryEngine&) = delete;
+
+        void register_query(const u32 kind, std::unique_ptr<Query> query);
+
+        /**
+         * Sets an input query, which other queries read like any other.
+         * @returns True if its fingerprint changed, which started a new revision.
+         */
+        bool set_input(const u32 kind, const u64 key, QueryValue value);
+
+        /** Forces a query to be computed again the next time it is demanded, like an input that changed. */
+        void invalidate(const u32 kind, const u64 key);
+
+        /** Drops every result and input. */
+        void clear();
+
+        /** Brings a query up to date and records it as a dependency of the query being computed, if any. */
+        const QueryValue& get_value(const u32 kind, const u64 key);
+
+        /**
+         * Brings a query up to date without recording a dependency. Only for a query whose result is fully
+         * determined by dependencies the caller does record, to reach data those dependencies summarize.
+         */
+        const QueryValue& get_value_untracked(const u32 kind, const u64 key);
+
+        template<typename T>
+        std::shared_ptr<const T> get(const u32 kind, const u64 key) {
+            return std::static_pointer_cast<const T>(get_value(kind, key).value_);
+        }
+
+        template<typename T>
+        std::shared_ptr<const T> get_untracked(const u32 kind, const u64 key) {
+            return std::static_pointer_cast<const T>(get_value_untracked(kind, key).value_);
+        }
+
+        u64 get_revision() const;
+
+        /** Queries computed and queries reused without computing them since the counts were last reset. */
+        u64 get_computed_count() const;
+        u64 get_reused_count() const;
+        void reset_counts();
+
+    protected:
+        struct Slot {
+            QueryValue value_;
+            u64 changed_at_ = 0;
+            u64 verified_at_ = 0;
+            std::vector<QueryKey> dependencies_;
+            bool input_ = false;
+            bool active_ = false;
+        };
+
+        const QueryValue& demand(const QueryKey& key, const bool track);
+        bool is_unchanged(const Slot& slot);
+        void execute(Slot& slot, const QueryKey& key);
+
+    private:
+        std::vector<std::unique_ptr<Query>> queries_;
+
+        /** Node-based, so a slot stays put while queries it depends on are inserted. */
+        std::unordered_map<QueryKey, Slot, QueryKeyHash> slots_;
+
+        /** Dependencies being recorded for each query on the stack of computations. */
+        std::vector<std::vector<QueryKey>*> frames_;
+        u64 revision_ = 1;
+        u64 computed_ = 0;
+        u64 reused_ = 0;
+    };
+
+} /* solara */
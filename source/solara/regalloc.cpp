@@ -0,0 +1,232 @@
+/**
+ * @file regalloc.cpp
+ */
+
+#include "regalloc.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace solara {
+
+    LinearScanAllocator::LinearScanAllocator(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    void LinearScanAllocator::allocate(const IrFunction& function, const RegisterClass& ints, const RegisterClass& floats, RegisterAllocation& out,
+                                       std::span<const u32> float_clobbers) {
+        out.locations_.assign(function.insts_.size(), Location{});
+        out.stack_slots_ = 0;
+        out.used_callee_saved_ = 0;
+
+        build_intervals(function, float_clobbers);
+        std::sort(intervals_.begin(), intervals_.end(), [](const Interval& a, const Interval& b) {
+            return a.start_ != b.start_ ? a.start_ < b.start_ : a.value_ < b.value_;
+        });
+
+        struct Active {
+            u32 end_;
+            ValueId value_;
+            u08 reg_;
+            bool float_;
+        };
+        std::vector<Active> active;
+        u32 busy[2] = { 0, 0 };
+
+        auto is_callee_saved = [&](const RegisterClass& regs, const u08 reg) {
+            return std::find(regs.callee_saved_.begin(), regs.callee_saved_.end(), reg) != regs.callee_saved_.end();
+        };
+        auto take = [&](const std::vector<u08>& pool, const u32 mask) -> i32 {
+            for (const u08 reg : pool) {
+                if ((mask & BIT(reg)) == 0) {
+                    return reg;
+                }
+            }
+            return -1;
+        };
+
+        for (const Interval& interval : intervals_) {
+            // an interval ending where this one starts is only read by the instruction defining this one
+            for (u64 i = 0; i < active.size();) {
+                if (active[i].end_ <= interval.start_) {
+                    busy[active[i].float_] &= ~BIT(active[i].reg_);
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    i++;
+                }
+            }
+
+            const RegisterClass& regs = interval.float_ ? floats : ints;
+            u32& mask = busy[interval.float_];
+            i32 reg = -1;
+            if (!interval.crosses_call_) {
+                reg = take(regs.caller_saved_, mask);
+            }
+            if (reg < 0) {
+                reg = take(regs.callee_saved_, mask);
+            }
+
+            Location& location = out.locations_[interval.value_];
+            if (reg < 0) {
+                // spill whichever live interval ends last, as long as its register suits this interval
+                i64 victim = -1;
+                for (u64 i = 0; i < active.size(); i++) {
+                    const Active& candidate = active[i];
+                    if (candidate.float_ != interval.float_ || (interval.crosses_call_ && !is_callee_saved(regs, candidate.reg_))) {
+                        continue;
+                    }
+                    if (victim < 0 || candidate.end_ > active[victim].end_) {
+                        victim = static_cast<i64>(i);
+                    }
+                }
+                if (victim >= 0 && active[victim].end_ > interval.end_) {
+                    Location& spilled = out.locations_[active[victim].value_];
+                    spilled.kind_ = LocationKind::Stack;
+                    spilled.slot_ = out.stack_slots_++;
+                    reg = active[victim].reg_;
+                    active[victim] = active.back();
+                    active.pop_back();
+                    mask &= ~BIT(reg);
+                } else {
+                    location.kind_ = LocationKind::Stack;
+                    location.slot_ = out.stack_slots_++;
+                    continue;
+                }
+            }
+
+            location.kind_ = LocationKind::Register;
+            location.reg_ = static_cast<u08>(reg);
+            mask |= BIT(reg);
+            active.push_back({ interval.end_, interval.value_, location.reg_, interval.float_ });
+            if (is_callee_saved(regs, location.reg_)) {
+                out.used_callee_saved_ |= BIT(location.reg_);
+            }
+        }
+    }
+
+    /**
+     * Positions are instruction indices of the linearized function. Block liveness is solved backwards with bit
+     * sets; a phi operand is live out of its predecessor and the phi itself is written at the end of every
+     * predecessor, where its incoming copies are placed.
+     */
+    void LinearScanAllocator::build_intervals(const IrFunction& function, std::span<const u32> float_clobbers) {
+        const TypeTable& types = ctx_->type_table_;
+        const u32 count = static_cast<u32>(function.insts_.size());
+        const u64 block_count = function.blocks_.size();
+        const u64 words = (count + 63) / 64;
+
+        std::vector<u64> gen(block_count * words, 0);
+        std::vector<u64> kill(block_count * words, 0);
+        std::vector<u64> phi_uses(block_count * words, 0);
+        std::vector<u64> live_in(block_count * words, 0);
+        std::vector<u64> live_out(block_count * words, 0);
+        auto set = [words](std::vector<u64>& bits, const BlockId b, const ValueId v) {
+            bits[b * words + v / 64] |= 1ull << (v % 64);
+        };
+        auto test = [words](const std::vector<u64>& bits, const BlockId b, const ValueId v) {
+            return (bits[b * words + v / 64] >> (v % 64)) & 1;
+        };
+
+        for (BlockId b = 0; b < block_count; b++) {
+            const IrBlock& block = function.blocks_[b];
+            for (ValueId id = block.begin_; id < block.end_; id++) {
+                const auto operands = function.get_operands(id);
+                if (function.insts_[id].op_ == Opcode::Phi) {
+                    for (u64 i = 0; i < operands.size(); i++) {
+                        set(phi_uses, block.preds_[i], operands[i]);
+                    }
+                } else {
+                    for (const ValueId operand : operands) {
+                        if (!test(kill, b, operand)) {
+                            set(gen, b, operand);
+                        }
+                    }
+                }
+                set(kill, b, id);
+            }
+        }
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (u64 b = block_count; b-- > 0;) {
+                BlockId successors[2];
+                const u32 successor_count = function.get_successors(static_cast<BlockId>(b), successors);
+                for (u64 w = 0; w < words; w++) {
+                    u64 out = phi_uses[b * words + w];
+                    for (u32 s = 0; s < successor_count; s++) {
+                        out |= live_in[successors[s] * words + w];
+                    }
+                    const u64 in = gen[b * words + w] | (out & ~kill[b * words + w]);
+                    if (out != live_out[b * words + w] || in != live_in[b * words + w]) {
+                        live_out[b * words + w] = out;
+                        live_in[b * words + w] = in;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        std::vector<u32> starts(count);
+        std::vector<u32> ends(count);
+        std::vector<u32> calls;
+        for (ValueId id = 0; id < count; id++) {
+            starts[id] = id;
+            ends[id] = id;
+            const Instruction& inst = function.insts_[id];
+            if (inst.op_ == Opcode::Call) {
+                calls.push_back(id);
+            }
+            if (inst.op_ != Opcode::Phi) {
+                for (const ValueId operand : function.get_operands(id)) {
+                    ends[operand] = std::max(ends[operand], id);
+                }
+            }
+        }
+        for (BlockId b = 0; b < block_count; b++) {
+            const IrBlock& block = function.blocks_[b];
+            const u32 last = block.end_ - 1;
+            for (u64 w = 0; w < words; w++) {
+                for (u64 bits = live_in[b * words + w]; bits != 0; bits &= bits - 1) {
+                    const ValueId v = static_cast<ValueId>(w * 64 + std::countr_zero(bits));
+                    starts[v] = std::min(starts[v], block.begin_);
+                }
+                for (u64 bits = live_out[b * words + w]; bits != 0; bits &= bits - 1) {
+                    const ValueId v = static_cast<ValueId>(w * 64 + std::countr_zero(bits));
+                    ends[v] = std::max(ends[v], last);
+                }
+            }
+            for (ValueId id = block.begin_; id < block.end_ && function.insts_[id].op_ == Opcode::Phi; id++) {
+                for (const BlockId pred : block.preds_) {
+                    const u32 copy = function.blocks_[pred].end_ - 1;
+                    starts[id] = std::min(starts[id], copy);
+                    ends[id] = std::max(ends[id], copy);
+                }
+            }
+        }
+
+        std::vector<u32> float_calls(calls);
+        float_calls.insert(float_calls.end(), float_clobbers.begin(), float_clobbers.end());
+        std::sort(float_calls.begin(), float_calls.end());
+
+        intervals_.clear();
+        for (ValueId id = 0; id < count; id++) {
+            const Instruction& inst = function.insts_[id];
+            if (inst.op_ == Opcode::Nop || opcode_is_terminator(inst.op_) || inst.type_ == TypeTable::INVALID) {
+                continue;
+            }
+            const TypeInfo& info = types.get_info(inst.type_);
+            if (info.kind == TypeKind::Void) {
+                continue;
+            }
+            const bool is_float = info.kind == TypeKind::Float;
+            const std::vector<u32>& clobbers = is_float ? float_calls : calls;
+            const auto call = std::upper_bound(clobbers.begin(), clobbers.end(), starts[id]);
+            const bool crosses_call = call != clobbers.end() && *call < ends[id];
+            intervals_.push_back({ id, starts[id], ends[id], is_float, crosses_call });
+        }
+    }
+
+} /* solara */
@@ -0,0 +1,84 @@
+/**
+ * @file regalloc.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+
+#include <span>
+#include <vector>
+
+namespace solara {
+
+    enum class LocationKind : u08 {
+        None = 0,
+        Register,
+        Stack
+    };
+
+    /**
+     * Where a value lives for its whole lifetime: a machine register or a numbered stack slot.
+     */
+    struct Location {
+        LocationKind kind_ = LocationKind::None;
+        u08 reg_ = 0;
+        u32 slot_ = 0;
+
+        bool operator==(const Location& other) const {
+            return kind_ == other.kind_ && (kind_ == LocationKind::Register ? reg_ == other.reg_ : slot_ == other.slot_);
+        }
+    };
+
+    /**
+     * Registers a class of values may be given. Values live across a call can only use the callee-saved ones.
+     */
+    struct RegisterClass {
+        std::vector<u08> caller_saved_;
+        std::vector<u08> callee_saved_;
+    };
+
+    struct RegisterAllocation {
+        std::vector<Location> locations_;
+        u32 stack_slots_ = 0;
+
+        /** Callee-saved registers handed out, one bit per register number. */
+        u32 used_callee_saved_ = 0;
+    };
+
+    /**
+     * Linear-scan register allocation over a linearized function.
+     * Each value gets a single interval, the hull of the positions where it is live, computed from block liveness.
+     * Intervals are scanned by start; when no register is free the interval that ends last is spilled.
+     * @see Poletto and Sarkar, "Linear Scan Register Allocation"
+     */
+    class LinearScanAllocator {
+    public:
+        LinearScanAllocator(CompilerContext* ctx);
+
+        /**
+         * @param float_clobbers Positions where every float register is overwritten, so float values live across
+         * them are handled like values live across a call.
+         */
+        void allocate(const IrFunction& function, const RegisterClass& ints, const RegisterClass& floats, RegisterAllocation& out,
+                      std::span<const u32> float_clobbers = {});
+
+    protected:
+        struct Interval {
+            ValueId value_;
+            u32 start_;
+            u32 end_;
+            bool float_;
+            bool crosses_call_;
+        };
+
+        void build_intervals(const IrFunction& function, std::span<const u32> float_clobbers);
+
+    private:
+        CompilerContext* ctx_;
+        std::vector<Interval> intervals_;
+    };
+
+} /* solara */
@@ -0,0 +1,184 @@
+/**
+ * @file resolver.cpp
+ */
+
+#include "resolver.h"
+#include "syntaxwalk.h"
+
+#include <sstream>
+
+namespace solara {
+
+    Resolver::Resolver(CompilerContext* ctx, DiagnosticList* diagnostics, const SymbolTable* module_scope)
+        : symbols_(module_scope)
+    {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        diagnostics_ = diagnostics;
+        symbols_.reserve(ctx_->string_table_.get_size(), 64, 16);
+    }
+
+    void Resolver::resolve(ModuleDeclNode* module) {
+        if (!module) {
+            return;
+        }
+
+        declare_module(module);
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                resolve_function(function);
+            } else if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                resolve_constant(constant);
+            }
+        }
+        symbols_.leave_scope();
+    }
+
+    /**
+     * Opens the module scope and declares every module-level symbol in it.
+     * The scope is left open so function bodies can be resolved against it afterwards.
+     */
+    void Resolver::declare_module(ModuleDeclNode* module) {
+        symbols_.reserve(ctx_->string_table_.get_size(), static_cast<u32>(module->decls_.size()) + 64, 16);
+        symbols_.enter_scope();
+
+        for (ImportDeclNode* import : module->imports_) {
+            declare(import->name_id_, SymbolKind::Module, import);
+        }
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                declare(function->name_id_, SymbolKind::Function, function);
+                module->functions_.emplace(function->name_id_, function);
+            } else if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                declare(constant->name_id_, SymbolKind::Constant, constant);
+            }
+        }
+    }
+
+    void Resolver::set_diagnostics(DiagnosticList* diagnostics) {
+        diagnostics_ = diagnostics;
+    }
+
+    const SymbolTable& Resolver::get_symbols() const {
+        return symbols_;
+    }
+
+    void Resolver::resolve_function(FunctionDeclNode* function) {
+        begin_function(function);
+        if (function->body_) {
+            FusedSyntaxWalk<Resolver> walk(*this);
+            walk.walk_children(function->body_);
+        }
+        end_function();
+    }
+
+    /** Resolves the initializer of a module-level constant against the module scope. */
+    void Resolver::resolve_constant(VarDeclNode* decl) {
+        in_constant_ = true;
+        FusedSyntaxWalk<Resolver> walk(*this);
+        walk.walk_children(decl);
+        in_constant_ = false;
+    }
+
+    /** The body shares the parameter scope, so locals cannot shadow parameters. */
+    void Resolver::begin_function(FunctionDeclNode* function) {
+        symbols_.enter_scope();
+        for (ParamDeclNode* param : function->params_) {
+            declare(param->name_id_, SymbolKind::Parameter, param);
+        }
+    }
+
+    void Resolver::end_function() {
+        symbols_.leave_scope();
+    }
+
+    void Resolver::enter(CompoundStmtNode*) {
+        symbols_.enter_scope();
+    }
+
+    void Resolver::leave(CompoundStmtNode*) {
+        symbols_.leave_scope();
+    }
+
+    void Resolver::enter(ForStmtNode*) {
+        symbols_.enter_scope();
+    }
+
+    void Resolver::leave(ForStmtNode*) {
+        symbols_.leave_scope();
+    }
+
+    void Resolver::enter(VarDeclNode* node) {
+        in_constant_ = node->const_;
+    }
+
+    /** A variable is declared once its initializer was resolved, so the initializer cannot refer to it. */
+    void Resolver::leave(VarDeclNode* node) {
+        in_constant_ = false;
+        declare(node->name_id_, node->const_ ? SymbolKind::Constant : SymbolKind::Variable, node);
+    }
+
+    void Resolver::enter(IdentifierExprNode* node) {
+        if (node->qualifier_id_ != IdentifierExprNode::NO_QUALIFIER) {
+            resolve_qualified(node);
+            return;
+        }
+        const Symbol* symbol = symbols_.lookup(node->name_id_);
+        if (symbol && symbol->kind == SymbolKind::Module) {
+            std::ostringstream ss;
+            ss << "module '" << ctx_->string_table_.get_string(node->name_id_) << "' cannot be used as a value";
+            error(node, ss.str());
+        } else if (symbol && in_constant_ && (symbol->kind == SymbolKind::Parameter || symbol->kind == SymbolKind::Variable)) {
+            std::ostringstream ss;
+            ss << "the value of a constant cannot depend on the variable '" << ctx_->string_table_.get_string(node->name_id_) << "'";
+            error(node, ss.str());
+        } else if (symbol) {
+            node->decl_ = symbol->decl;
+        } else {
+            std::ostringstream ss;
+            ss << "use of undeclared identifier '" << ctx_->string_table_.get_string(node->name_id_) << "'";
+            error(node, ss.str());
+        }
+    }
+
+    /**
+     * Binds a name qualified by an import to a public function of the imported module, whose scope has been
+     * declared before any body of the importer is resolved.
+     */
+    void Resolver::resolve_qualified(IdentifierExprNode* node) {
+        const Symbol* symbol = symbols_.lookup(node->qualifier_id_);
+        if (!symbol || symbol->kind != SymbolKind::Module) {
+            std::ostringstream ss;
+            ss << "'" << ctx_->string_table_.get_string(node->qualifier_id_) << "' is not an imported module";
+            error(node, ss.str());
+            return;
+        }
+
+        const ModuleDeclNode* module = static_cast<ImportDeclNode*>(symbol->decl)->module_;
+        assert(module != nullptr);
+        const auto it = module->functions_.find(node->name_id_);
+        if (it == module->functions_.end() || !it->second->pub_) {
+            std::ostringstream ss;
+            ss << "module '" << ctx_->string_table_.get_string(node->qualifier_id_) << "' has no public function '"
+               << ctx_->string_table_.get_string(node->name_id_) << "'";
+            error(node, ss.str());
+            return;
+        }
+        node->decl_ = it->second;
+    }
+
+    void Resolver::declare(const u64 name_id, const SymbolKind kind, SyntaxNodeHandle decl) {
+        if (symbols_.lookup_local(name_id)) {
+            std::ostringstream ss;
+            ss << "redefinition of '" << ctx_->string_table_.get_string(name_id) << "'";
+            error(decl, ss.str());
+            return;
+        }
+        symbols_.declare(name_id, kind, decl);
+    }
+
+    void Resolver::error(SyntaxNodeHandle node, const std::string& message) {
+        diagnostics_->report(ERROR, node->span_, message);
+    }
+
+} /* solara */
@@ -0,0 +1,64 @@
+/**
+ * @file resolver.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+#include "symboltable.h"
+#include "diagnostics.h"
+
+#include <string>
+
+namespace solara {
+
+    /**
+     * Binds every identifier of a module to its declaration.
+     * Module-level declarations are visible from every function body regardless of their order, and the
+     * public functions of imported modules through names qualified by the import.
+     * The initializer of a constant may refer to functions and other constants, but not to variables.
+     * Function bodies can also be resolved one at a time against the scope of another resolver, which
+     * is only read, so independent bodies may be resolved concurrently.
+     */
+    class Resolver {
+    public:
+        Resolver(CompilerContext* ctx, DiagnosticList* diagnostics, const SymbolTable* module_scope = nullptr);
+
+        void resolve(ModuleDeclNode* module);
+        void declare_module(ModuleDeclNode* module);
+        void resolve_function(FunctionDeclNode* function);
+        void resolve_constant(VarDeclNode* decl);
+        void set_diagnostics(DiagnosticList* diagnostics);
+        const SymbolTable& get_symbols() const;
+
+        /**
+         * Hooks for a fused walk over a function body, which resolve_function runs on its own. The body is
+         * walked between begin_function and end_function, without the hooks of the body block itself.
+         */
+        void begin_function(FunctionDeclNode* function);
+        void end_function();
+        void enter(CompoundStmtNode* node);
+        void leave(CompoundStmtNode* node);
+        void enter(ForStmtNode* node);
+        void leave(ForStmtNode* node);
+        void enter(VarDeclNode* node);
+        void leave(VarDeclNode* node);
+        void enter(IdentifierExprNode* node);
+
+    protected:
+        void resolve_qualified(IdentifierExprNode* node);
+        void declare(const u64 name_id, const SymbolKind kind, SyntaxNodeHandle decl);
+        void error(SyntaxNodeHandle node, const std::string& message);
+
+    private:
+        CompilerContext* ctx_;
+        DiagnosticList* diagnostics_;
+        SymbolTable symbols_;
+
+        /** Set while resolving the initializer of a constant, which may not read variables. */
+        bool in_constant_ = false;
+    };
+
+} /* solara */
@@ -0,0 +1,333 @@
+/**
+ * @file server.cpp
+ */
+
+#include "server.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SOLARA_SERVER_HOST 1
+#else
+#define SOLARA_SERVER_HOST 0
+#endif
+
+#if SOLARA_SERVER_HOST && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace solara {
+
+#if SOLARA_SERVER_HOST
+
+    /*
+     * Messages are a u32 count followed by that many strings, each a u32 length and its bytes, in host order
+     * since both ends run on the same machine. A request is the working directory and then the arguments; a
+     * response is the exit status as a string and then the output.
+     */
+
+    static bool write_all(const i32 fd, const void* data, u64 size) {
+        const u08* bytes = static_cast<const u08*>(data);
+        while (size > 0) {
+            const ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<u64>(written);
+        }
+        return true;
+    }
+
+    static bool read_all(const i32 fd, void* data, u64 size) {
+        u08* bytes = static_cast<u08*>(data);
+        while (size > 0) {
+            const ssize_t count = recv(fd, bytes, size, 0);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            bytes += count;
+            size -= static_cast<u64>(count);
+        }
+        return true;
+    }
+
+    static bool send_strings(const i32 fd, const std::vector<std::string>& strings) {
+        std::string message;
+        auto put32 = [&message](const u32 value) {
+            message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        put32(static_cast<u32>(strings.size()));
+        for (const std::string& string : strings) {
+            put32(static_cast<u32>(string.size()));
+            message += string;
+        }
+        return write_all(fd, message.data(), message.size());
+    }
+
+    static bool receive_strings(const i32 fd, std::vector<std::string>& out) {
+        static constexpr u32 MAX_STRINGS = 4096;
+        u32 count = 0;
+        if (!read_all(fd, &count, sizeof(count)) || count > MAX_STRINGS) {
+            return false;
+        }
+        out.assign(count, std::string());
+        for (std::string& string : out) {
+            u32 size = 0;
+            if (!read_all(fd, &size, sizeof(size))) {
+                return false;
+            }
+            string.resize(size);
+            if (size > 0 && !read_all(fd, string.data(), size)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool make_address(const std::string& path, sockaddr_un& out) {
+        std::memset(&out, 0, sizeof(out));
+        out.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(out.sun_path)) {
+            return false;
+        }
+        std::memcpy(out.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    static i32 connect_to(const std::string& path) {
+        sockaddr_un address;
+        if (!make_address(path, address)) {
+            return -1;
+        }
+        const i32 fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /** @returns True if the process at the other end of a connection runs as the current user. */
+    static bool is_peer_current_user(const i32 fd) {
+#if defined(SO_PEERCRED)
+        ucred credentials;
+        socklen_t size = sizeof(credentials);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == getuid();
+#else
+        uid_t uid = 0;
+        gid_t gid = 0;
+        return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+    }
+
+    /** Directory of the default socket when there is no XDG_RUNTIME_DIR, named after the user in the shared temporary directory. */
+    static std::filesystem::path get_private_socket_directory() {
+        std::error_code error;
+        const std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+        return (error ? std::filesystem::path("/tmp") : directory) / ("solara-" + std::to_string(getuid()));
+    }
+
+    /**
+     * Creates the directory of the default socket if it is missing. Anyone can create a name in the shared
+     * temporary directory first, so it is used only if it is a real directory owned by the user, with no
+     * access for anyone else.
+     */
+    static bool prepare_private_socket_directory(const std::filesystem::path& directory) {
+        if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+            return false;
+        }
+        struct stat status;
+        return lstat(directory.c_str(), &status) == 0 && S_ISDIR(status.st_mode) && status.st_uid == getuid()
+            && (status.st_mode & 077) == 0;
+    }
+
+#endif
+
+    CompileServer::CompileServer(CompilerContext* ctx) : cache_(ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+    }
+
+    bool CompileServer::serve(const std::string& path) {
+#if SOLARA_SERVER_HOST
+        sockaddr_un address;
+        if (!make_address(path, address)) {
+            ctx_->logger_.log(ERROR, "error: invalid socket path '" + path + "'");
+            return false;
+        }
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        if (directory == get_private_socket_directory() && !prepare_private_socket_directory(directory)) {
+            ctx_->logger_.log(ERROR, "error: '" + directory.string() + "' is not a directory private to this user");
+            return false;
+        }
+
+        // a socket nobody answers on is left over from a server that did not shut down
+        const i32 existing = connect_to(path);
+        if (existing >= 0) {
+            close(existing);
+            ctx_->logger_.log(ERROR, "error: a server is already listening on '" + path + "'");
+            return false;
+        }
+        unlink(path.c_str());
+
+        const i32 listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listener, 16) != 0) {
+            ctx_->logger_.log(ERROR, "error: could not listen on '" + path + "': " + std::strerror(errno));
+            if (listener >= 0) {
+                close(listener);
+            }
+            return false;
+        }
+        signal(SIGPIPE, SIG_IGN);
+        ctx_->logger_.log(INFO, "Listening on '" + path + "'.");
+
+        stop_ = false;
+        while (!stop_) {
+            const i32 connection = accept(listener, nullptr, nullptr);
+            if (connection < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ctx_->logger_.log(ERROR, std::string("error: accept failed: ") + std::strerror(errno));
+                break;
+            }
+            handle(connection);
+            close(connection);
+        }
+
+        close(listener);
+        unlink(path.c_str());
+        ctx_->logger_.log(
+            INFO,
+            "Server stopped, module cache hits " + std::to_string(cache_.get_hits()) + ", misses "
+                + std::to_string(cache_.get_misses()) + "."
+        );
+        return true;
+#else
+        (void)path;
+        ctx_->logger_.log(ERROR, "error: the compile server needs Unix domain sockets");
+        return false;
+#endif
+    }
+
+    /**
+     * Runs one request in the client's working directory with the client's settings. The thread pool and the
+     * log file belong to the server and keep theirs.
+     */
+    void CompileServer::handle(const i32 connection) {
+#if SOLARA_SERVER_HOST
+        std::vector<std::string> request;
+        if (!receive_strings(connection, request) || request.empty()) {
+            return;
+        }
+
+        std::vector<char*> argv;
+        std::string program = "solara";
+        argv.push_back(program.data());
+        for (u64 i = 1; i < request.size(); i++) {
+            argv.push_back(request[i].data());
+        }
+        CompilerSettings settings;
+        parse_settings(static_cast<i32>(argv.size()), argv.data(), settings);
+        settings.jobs_ = ctx_->settings_.jobs_;
+        settings.log_output_file_ = ctx_->settings_.log_output_file_;
+
+        std::ostringstream output;
+        bool ok = true;
+        if (settings.stop_server_) {
+            stop_ = true;
+            output << "Server stopped.\n";
+        } else {
+            std::error_code error;
+            const std::filesystem::path home = std::filesystem::current_path(error);
+            std::filesystem::current_path(request[0], error);
+            if (error) {
+                ok = false;
+                output << "error: could not enter directory '" << request[0] << "'\n";
+            } else {
+                const CompilerSettings previous = ctx_->settings_;
+                ctx_->settings_ = settings;
+                std::streambuf* out = std::cout.rdbuf(output.rdbuf());
+                ok = compile(ctx_, &cache_);
+                std::cout.flush();
+                std::cout.rdbuf(out);
+                ctx_->settings_ = previous;
+                std::filesystem::current_path(home, error);
+            }
+        }
+        send_strings(connection, { ok ? "0" : "1", output.str() });
+#else
+        (void)connection;
+#endif
+    }
+
+    std::string get_default_socket_path() {
+#if SOLARA_SERVER_HOST
+        const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+        if (runtime != nullptr && runtime[0] == '/') {
+            return (std::filesystem::path(runtime) / "solara.sock").string();
+        }
+        return (get_private_socket_directory() / "server.sock").string();
+#else
+        return "";
+#endif
+    }
+
+    i32 run_client(i32 argc, char* argv[], const CompilerSettings& settings) {
+#if SOLARA_SERVER_HOST
+        const i32 fd = connect_to(settings.socket_path_);
+        if (fd >= 0 && !is_peer_current_user(fd)) {
+            close(fd);
+            std::fprintf(stderr, "error: the server on '%s' runs as another user\n", settings.socket_path_.c_str());
+            return 1;
+        }
+        if (fd >= 0) {
+            std::error_code error;
+            std::vector<std::string> request = { std::filesystem::current_path(error).string() };
+            for (i32 i = 1; i < argc; i++) {
+                request.emplace_back(argv[i]);
+            }
+            std::vector<std::string> response;
+            const bool ok = send_strings(fd, request) && receive_strings(fd, response) && response.size() == 2;
+            close(fd);
+            if (ok) {
+                std::fwrite(response[1].data(), 1, response[1].size(), stdout);
+                std::fflush(stdout);
+                return response[0] == "0" ? 0 : 1;
+            }
+            std::fprintf(stderr, "error: lost the connection to the compile server\n");
+            return 1;
+        }
+#endif
+        if (settings.stop_server_) {
+            std::fprintf(stderr, "error: no compile server is listening\n");
+            return 1;
+        }
+        CompilerSettings local = settings;
+        local.client_ = false;
+        return init(local) ? 0 : 1;
+    }
+
+} /* solara */
@@ -0,0 +1,55 @@
+/**
+ * @file server.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "modulecache.h"
+
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Compiler daemon listening on a Unix domain socket. Each connection carries one request, the client's
+     * working directory and command line, and gets back everything the compilation printed and an exit status.
+     * Requests are served one at a time on a single compiler context, so interned strings, types, the thread
+     * pool and the module cache stay warm between them.
+     */
+    class CompileServer {
+    public:
+        CompileServer(CompilerContext* ctx);
+
+        /**
+         * Serves requests until a client asks the server to stop.
+         * @returns False if the socket could not be set up.
+         */
+        bool serve(const std::string& path);
+
+    protected:
+        void handle(const i32 connection);
+
+    private:
+        CompilerContext* ctx_;
+        ModuleCache cache_;
+        bool stop_ = false;
+    };
+
+    /**
+     * Socket a server listens on when no --socket path is given: solara.sock in $XDG_RUNTIME_DIR, or else
+     * server.sock in a solara-<uid> directory of the temporary directory, which the server creates with mode 0700.
+     * A client only sends its request to a server running as the same user.
+     */
+    std::string get_default_socket_path();
+
+    /**
+     * Forwards a command line to a running server and prints its output. Compiles in this process when no
+     * server is listening.
+     * @returns The exit status of the compilation.
+     */
+    i32 run_client(i32 argc, char* argv[], const CompilerSettings& settings);
+
+} /* solara */
@@ -10,8 +10,29 @@
 #include "stringtable.h"
 #include "parser.h"
 #include "ast.h"
+#include "analyzer.h"
+#include "lowering.h"
+#include "passmanager.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "evaluator.h"
+#include "codegen.h"
+#include "elf.h"
+#include "jit.h"
+#include "tiering.h"
+#include "modulecache.h"
+#include "server.h"
+#include "modulegraph.h"
+#include "pipeline.h"
+#include "buildcache.h"
+#include "sourcestream.h"
+#include "dump.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
 
 namespace solara {
 
@@ -19,7 +40,15 @@ namespace solara {
         enum class ParseState {
             None = 0,
             InputFile,
-            OutputFile
+            OutputFile,
+            Jobs,
+            Socket,
+            BuildCache,
+            BuildCacheSize,
+            ConstSteps,
+            ConstMemory,
+            DumpFormat,
+            DumpOutput
         };
 
         ParseState parse_state = ParseState::InputFile;
@@ -31,14 +60,87 @@ namespace solara {
                 continue;
             }
 
-            if (arg.at(0) == '-') {
+            // a lone '-' is a value, the standard input
+            if (arg.at(0) == '-' && arg.size() > 1) {
                 if (arg.compare("-s") == 0) {
                     parse_state = ParseState::InputFile;
                 } else if (arg.compare("-o") == 0) {
                     parse_state = ParseState::OutputFile;
+                } else if (arg.compare("-j") == 0) {
+                    parse_state = ParseState::Jobs;
+                } else if (arg.compare("--lazy-bodies") == 0) {
+                    out_settings.lazy_bodies_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--no-interfaces") == 0) {
+                    out_settings.module_interfaces_ = false;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--dump-tokens") == 0) {
+                    out_settings.dump_tokens_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--dump-ast") == 0) {
+                    out_settings.dump_ast_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--dump-format") == 0) {
+                    parse_state = ParseState::DumpFormat;
+                } else if (arg.compare("--dump-output") == 0) {
+                    parse_state = ParseState::DumpOutput;
+                } else if (arg.compare("--dump-ir") == 0) {
+                    out_settings.dump_ir_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("-O0") == 0 || arg.compare("-O1") == 0 || arg.compare("-O2") == 0) {
+                    out_settings.opt_level_ = static_cast<u32>(arg.at(2) - '0');
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--no-vectorize") == 0) {
+                    out_settings.vectorize_ = false;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--time-passes") == 0) {
+                    out_settings.time_passes_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--memory-stats") == 0) {
+                    out_settings.memory_stats_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--dump-bytecode") == 0) {
+                    out_settings.dump_bytecode_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--run") == 0) {
+                    out_settings.run_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--run-tree") == 0) {
+                    out_settings.run_tree_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--jit") == 0) {
+                    out_settings.jit_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--tiered") == 0) {
+                    out_settings.tiered_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--server") == 0) {
+                    out_settings.server_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--client") == 0) {
+                    out_settings.client_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--stop-server") == 0) {
+                    out_settings.client_ = true;
+                    out_settings.stop_server_ = true;
+                    parse_state = ParseState::None;
+                } else if (arg.compare("--socket") == 0) {
+                    parse_state = ParseState::Socket;
+                } else if (arg.compare("--build-cache") == 0) {
+                    parse_state = ParseState::BuildCache;
+                } else if (arg.compare("--build-cache-size") == 0) {
+                    parse_state = ParseState::BuildCacheSize;
+                } else if (arg.compare("--const-steps") == 0) {
+                    parse_state = ParseState::ConstSteps;
+                } else if (arg.compare("--const-memory") == 0) {
+                    parse_state = ParseState::ConstMemory;
+                } else if (arg.compare("--no-build-cache") == 0) {
+                    out_settings.build_cache_ = false;
+                    parse_state = ParseState::None;
                 } else {
                     parse_state = ParseState::None;
                 }
+                continue;
             }
 
             switch (parse_state) {
@@ -48,13 +150,180 @@ namespace solara {
                 case ParseState::OutputFile:
                     out_settings.output_file_ = arg;
                     break;
+                case ParseState::Jobs:
+                    out_settings.jobs_ = std::max(static_cast<u32>(std::strtoul(arg.c_str(), nullptr, 10)), 1u);
+                    break;
+                case ParseState::Socket:
+                    out_settings.socket_path_ = arg;
+                    break;
+                case ParseState::BuildCache:
+                    out_settings.build_cache_path_ = arg;
+                    break;
+                case ParseState::BuildCacheSize:
+                    out_settings.build_cache_size_ = static_cast<u64>(std::strtoull(arg.c_str(), nullptr, 10)) << 20;
+                    break;
+                case ParseState::ConstSteps:
+                    out_settings.const_steps_ = static_cast<u64>(std::strtoull(arg.c_str(), nullptr, 10));
+                    break;
+                case ParseState::ConstMemory:
+                    out_settings.const_memory_ = static_cast<u64>(std::strtoull(arg.c_str(), nullptr, 10)) << 20;
+                    break;
+                case ParseState::DumpFormat:
+                    if (arg == "json") {
+                        out_settings.dump_format_ = DumpFormat::Json;
+                    } else if (arg == "binary") {
+                        out_settings.dump_format_ = DumpFormat::Binary;
+                    } else {
+                        out_settings.dump_format_ = DumpFormat::Text;
+                    }
+                    break;
+                case ParseState::DumpOutput:
+                    out_settings.dump_output_file_ = arg;
+                    break;
                 default:
                     break;
             }
         }
+
+        if (out_settings.socket_path_.empty()) {
+            out_settings.socket_path_ = get_default_socket_path();
+        }
+        if (out_settings.build_cache_path_.empty()) {
+            out_settings.build_cache_path_ = get_default_build_cache_path();
+        }
     }
 
-    void init(const CompilerSettings& settings) {
+    static void print_result(CompilerContext* ctx, const TypeId type, const VmValue value, const char* engine, const f64 seconds) {
+        const TypeInfo& info = ctx->type_table_.get_info(ctx->type_table_.get_info(type).return_type);
+        std::cout << "main() returned ";
+        if (info.kind == TypeKind::Void) {
+            std::cout << "nothing";
+        } else if (info.kind == TypeKind::Float) {
+            std::cout << (info.bits == 32 ? static_cast<f64>(value.float32_) : value.float_);
+        } else if (info.kind == TypeKind::Int && info.bits == 64 && !info.is_signed) {
+            std::cout << static_cast<u64>(value.int_);
+        } else {
+            std::cout << value.int_;
+        }
+        std::cout << " (" << engine << ", " << seconds * 1000.0 << " ms)" << std::endl;
+    }
+
+    /**
+     * Runs the module's main function on the requested engines and reports the result and the time it took.
+     * @returns False if main could not be run or stopped with a runtime error on any of the engines.
+     */
+    static bool run_main(CompilerContext* ctx, ModuleDeclNode* module, const IrModule& ir, const CompilerSettings& settings) {
+        u32 main_index = ~0u;
+        for (u32 i = 0; i < ir.functions_.size(); i++) {
+            if (ctx->string_table_.get_string(ir.functions_[i].name_id_) == "main") {
+                main_index = i;
+            }
+        }
+        if (main_index == ~0u || !ctx->type_table_.get_params(ir.functions_[main_index].type_).empty()) {
+            ctx->logger_.log(ERROR, "error: no 'main' function without parameters to run");
+            return false;
+        }
+
+        bool ok = true;
+
+        if (settings.run_ || settings.tiered_) {
+            BcModule bytecode;
+            BytecodeCompiler compiler(ctx);
+            if (!compiler.compile(ir, bytecode)) {
+                return false;
+            }
+
+            for (const bool tiered : { false, true }) {
+                if (tiered ? !settings.tiered_ : !settings.run_) {
+                    continue;
+                }
+                // the compiler thread is joined only after the machine that may still call into its code is gone
+                std::unique_ptr<TieredCompiler> tiers = tiered ? std::make_unique<TieredCompiler>(ctx, &ir) : nullptr;
+                VirtualMachine vm(ctx, &bytecode);
+                vm.set_tiering(tiers.get());
+                VmValue result;
+                const auto start = std::chrono::steady_clock::now();
+                const bool finished = vm.call(main_index, {}, result);
+                const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+                if (!finished) {
+                    ctx->logger_.log(ERROR, "runtime error: " + vm.get_error());
+                    ok = false;
+                    continue;
+                }
+                print_result(ctx, ir.functions_[main_index].type_, result, tiered ? "tiered" : "vm", elapsed.count());
+                if (tiered) {
+                    ctx->logger_.log(INFO, "Promoted " + std::to_string(tiers->get_promoted_count()) + " functions to native code.");
+                }
+            }
+        }
+
+        if (settings.jit_) {
+            // main is entered through an adapter, as a tiered unit is, so its traps come back as runtime errors
+            const auto compile_start = std::chrono::steady_clock::now();
+            NativeModule native;
+            NativeTrapState traps;
+            NativeCodeGenerator codegen(ctx);
+            if (!codegen.generate_unit(ir, main_index, &traps, native)) {
+                ctx->logger_.log(ERROR, "error: 'main' calls a function without a body or with too many parameters for native code generation");
+                return false;
+            }
+            JitModule jit(ctx);
+            if (!jit.load(native)) {
+                ctx->logger_.log(ERROR, "error: " + jit.get_error());
+                return false;
+            }
+            const std::chrono::duration<f64> compile_time = std::chrono::steady_clock::now() - compile_start;
+            ctx->logger_.log(
+                INFO,
+                "Compiled " + std::to_string(native.code_.size()) + " bytes of native code in "
+                    + std::to_string(compile_time.count() * 1000.0) + " ms."
+            );
+
+            const void* entry = jit.get_address(native.functions_[main_index].adapter_);
+            const NativeAdapter adapter = reinterpret_cast<NativeAdapter>(const_cast<void*>(entry));
+            VmValue result;
+            result.int_ = 0;
+            const auto start = std::chrono::steady_clock::now();
+            const u32 status = adapter(nullptr, &result);
+            const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+            if (status != static_cast<u32>(NativeTrap::None)) {
+                const auto trap = static_cast<NativeTrap>(status & ((1u << NATIVE_TRAP_SHIFT) - 1));
+                ctx->logger_.log(
+                    ERROR,
+                    std::string("runtime error: ") + (trap == NativeTrap::DivisionByZero ? "division by zero" : "stack overflow")
+                        + " in '" + std::string(ctx->string_table_.get_string(ir.functions_[status >> NATIVE_TRAP_SHIFT].name_id_)) + "'"
+                );
+                ok = false;
+            } else {
+                print_result(ctx, ir.functions_[main_index].type_, result, "jit", elapsed.count());
+            }
+        }
+
+        if (settings.run_tree_) {
+            FunctionDeclNode* main_decl = nullptr;
+            for (SyntaxNodeHandle decl : module->decls_) {
+                auto function = syntax_node_cast<FunctionDeclNode>(decl);
+                if (function && function->name_id_ == ir.functions_[main_index].name_id_) {
+                    main_decl = function;
+                }
+            }
+
+            TreeEvaluator evaluator(ctx);
+            VmValue result;
+            const auto start = std::chrono::steady_clock::now();
+            const bool finished = evaluator.call(main_decl, {}, result);
+            const std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+            if (!finished) {
+                ctx->logger_.log(ERROR, "runtime error: " + evaluator.get_error());
+                ok = false;
+            } else {
+                print_result(ctx, ir.functions_[main_index].type_, result, "tree", elapsed.count());
+            }
+        }
+        return ok;
+    }
+
+    bool init(const CompilerSettings& settings) {
         CompilerContext ctx(settings);
 
         ctx.logger_.log(
@@ -62,30 +331,187 @@ namespace solara {
             "Solara Context has been initialized."
         );
 
-        auto expr1 = make_syntax_node<LiteralExprNode>();
-        auto expr2 = make_syntax_node<LiteralExprNode>();
-        auto bin1 = make_syntax_node<BinaryExprNode>(BinaryOperation::SUB, expr1, expr2);
-        auto expr3 = make_syntax_node<LiteralExprNode>();
-        auto ast = make_syntax_node<BinaryExprNode>(BinaryOperation::ADD, bin1, expr3);
-        ast->dump();
-
-        delete expr1;
-        delete expr2;
-        delete bin1;
-        delete expr3;
-        delete ast;
-
-#if 0
-        Lexer lexer(&ctx);
-        lexer.init(settings.input_file_);
-        while (lexer.has_next()) {
-            auto tok = lexer.next_token();
-            print_token(&ctx, tok);
-        }
-
-        Parser parser(&ctx);
-        parser.init(settings.input_file_);
-#endif
+        if (settings.server_) {
+            CompileServer server(&ctx);
+            return server.serve(settings.socket_path_);
+        }
+        return compile(&ctx, nullptr);
+    }
+
+    /**
+     * Cached modules already passed analysis, so only their later stages run again; their optimized IR is
+     * reused too unless the pass timings were asked for. With a cache, changed files go through the module
+     * queries instead of the pipeline, which reuse whatever the changes left valid.
+     */
+    bool compile(CompilerContext* ctx, ModuleCache* cache) {
+        const CompilerSettings& settings = ctx->settings_;
+        ctx->memory_.reset_phases();
+        MemoryPhase phase(ctx->memory_, "front end");
+
+        // a streamed source can only be read once, so it is never cached
+        const bool streamed = is_stream_source(settings.input_file_);
+        ModuleCache::Entry* entry = cache && !streamed ? cache->find(settings.input_file_, settings.lazy_bodies_) : nullptr;
+        ModulePipeline pipeline(ctx);
+        std::vector<IrModule> lowered_modules;
+        BuildCache build_cache(ctx);
+        std::string object_key;
+        if (entry == nullptr) {
+            ModuleGraph graph(ctx);
+            if (streamed) {
+                // the root is parsed as it is read, and its header is taken from the tree instead of a scan
+                SourceStream stream(ctx);
+                if (!stream.open(settings.input_file_)) {
+                    return false;
+                }
+                auto parser = std::make_unique<Parser>(ctx);
+                parser->set_lazy_bodies(settings.lazy_bodies_);
+                parser->init(&stream);
+
+                ModuleGraphNode root;
+                root.path_ = settings.input_file_ == "-" ? std::filesystem::current_path() / "-"
+                                                         : std::filesystem::weakly_canonical(settings.input_file_);
+                if (ModuleDeclNode* decl = parser->get_module()) {
+                    root.name_ = ctx->string_table_.get_string(decl->name_id_);
+                    for (ImportDeclNode* import : decl->imports_) {
+                        root.imports_.emplace_back(ctx->string_table_.get_string(import->name_id_));
+                    }
+                }
+                pipeline.set_root_parser(std::move(parser));
+                if (!graph.build(root)) {
+                    return false;
+                }
+            } else if (!graph.build(settings.input_file_)) {
+                return false;
+            }
+
+            // a program only compiled to an object is taken whole from the build cache, without parsing it
+            const bool object_only = !settings.output_file_.empty() && !settings.dump_tokens_ && !settings.dump_ast_ && !settings.dump_ir_ && !settings.time_passes_
+                && !settings.dump_bytecode_ && !settings.run_ && !settings.run_tree_ && !settings.jit_ && !settings.tiered_;
+            if (build_cache.is_enabled() && !streamed && !settings.output_file_.empty()) {
+                object_key = build_cache.get_key(graph);
+                if (object_only && !object_key.empty() && build_cache.fetch(object_key, settings.output_file_)) {
+                    ctx->logger_.log(INFO, "Build cache hit for '" + settings.output_file_ + "'.");
+                    return true;
+                }
+            }
+
+            if (cache && !streamed) {
+                ModuleQueries& queries = cache->get_queries();
+                if (!queries.run(graph)) {
+                    return false;
+                }
+                lowered_modules = std::move(queries.get_modules());
+                entry = cache->insert(settings.input_file_, settings.lazy_bodies_, graph, queries.get_parsers());
+            } else {
+                if (!pipeline.run(graph)) {
+                    return false;
+                }
+                lowered_modules = std::move(pipeline.get_modules());
+            }
+        }
+
+        std::vector<Parser*> parsers;
+        if (entry) {
+            for (const std::shared_ptr<Parser>& parser : entry->parsers_) {
+                parsers.push_back(parser.get());
+            }
+        } else {
+            for (const std::unique_ptr<Parser>& parser : pipeline.get_parsers()) {
+                parsers.push_back(parser.get());
+            }
+        }
+        std::vector<ModuleDeclNode*> modules;
+        for (Parser* parser : parsers) {
+            modules.push_back(parser->get_module());
+        }
+        ModuleDeclNode* module = modules.back();
+        if (settings.dump_tokens_ || settings.dump_ast_) {
+            // the log shares the standard output, so machine-readable dumps are best sent to their own file
+            std::ofstream dump_file;
+            if (!settings.dump_output_file_.empty()) {
+                dump_file.open(settings.dump_output_file_, std::ios::binary | std::ios::trunc);
+                if (!dump_file.is_open()) {
+                    ctx->logger_.log(ERROR, "error: could not open dump output '" + settings.dump_output_file_ + "'");
+                    return false;
+                }
+            }
+            DumpBuffer buffer(dump_file.is_open() ? dump_file.rdbuf() : std::cout.rdbuf());
+            std::ostream out(&buffer);
+            if (settings.dump_tokens_) {
+                dump_tokens(ctx, parsers, settings.dump_format_, out);
+            }
+            if (settings.dump_ast_) {
+                dump_ast(ctx, modules, settings.dump_format_, out);
+            }
+        }
+
+        const u32 pipeline_key = settings.opt_level_ | (settings.vectorize_ ? 0x100 : 0);
+        const bool reuse = entry && !settings.time_passes_ && entry->optimized_.count(pipeline_key) != 0;
+        IrModule lowered;
+        PassManager passes(ctx);
+        if (!reuse) {
+            phase.next("link");
+            if (lowered_modules.empty()) {
+                for (ModuleDeclNode* decl : modules) {
+                    IrLowering lowering(ctx);
+                    lowered_modules.push_back(lowering.lower(decl));
+                }
+            }
+            lowered = link_modules(ctx, lowered_modules, modules);
+
+            std::vector<std::string> ir_errors;
+            for (const IrFunction& function : lowered.functions_) {
+                verify_ir(ctx, lowered, function, ir_errors);
+            }
+            for (const std::string& error : ir_errors) {
+                ctx->logger_.log(ERROR, "internal error: invalid IR: " + error);
+            }
+            if (!ir_errors.empty()) {
+                return false;
+            }
+
+            phase.next("optimize");
+            passes.add_default_pipeline(settings.opt_level_);
+            passes.run(lowered);
+            if (entry) {
+                entry->optimized_[pipeline_key] = lowered;
+            }
+        }
+        const IrModule& ir = reuse ? entry->optimized_[pipeline_key] : lowered;
+
+        if (settings.dump_ir_) {
+            dump_ir(ctx, ir, std::cout);
+        }
+        if (settings.time_passes_) {
+            passes.print_timings(std::cout);
+        }
+
+        if (settings.dump_bytecode_) {
+            BcModule bytecode;
+            BytecodeCompiler compiler(ctx);
+            if (compiler.compile(ir, bytecode)) {
+                dump_bytecode(ctx, bytecode, std::cout);
+            }
+        }
+        if (!settings.output_file_.empty()) {
+            phase.next("codegen");
+            NativeModule native;
+            NativeCodeGenerator codegen(ctx);
+            if (!codegen.generate(ir, native) || !write_elf_object(ctx, native, settings.output_file_)) {
+                return false;
+            }
+            if (!object_key.empty()) {
+                build_cache.store(object_key, settings.output_file_);
+            }
+        }
+        phase.end();
+        if (settings.memory_stats_) {
+            ctx->memory_.print(std::cout);
+        }
+        if (settings.run_ || settings.run_tree_ || settings.jit_ || settings.tiered_) {
+            return run_main(ctx, module, ir, settings);
+        }
+        return true;
     }
 
 } /* solara */
@@ -8,32 +8,75 @@
 #pragma once
 
 #include "common.h"
+#include "memory.h"
 #include "stringtable.h"
+#include "types.h"
 #include "log.h"
+#include "threadpool.h"
 
+#include <algorithm>
 #include <string>
 
 namespace solara {
 
+    /** Output format of --dump-tokens and --dump-ast. */
+    enum class DumpFormat : u08 {
+        Text = 0,
+        Json,
+        Binary
+    };
+
     struct CompilerSettings {
         std::string input_file_ = "";
         std::string output_file_ = "";
         std::filesystem::path log_output_file_;
+        u32 jobs_ = 0;
+        bool lazy_bodies_ = false;
+        bool module_interfaces_ = true;
+        bool dump_tokens_ = false;
+        bool dump_ast_ = false;
+        DumpFormat dump_format_ = DumpFormat::Text;
+        std::string dump_output_file_ = "";
+        bool dump_ir_ = false;
+        u32 opt_level_ = 0;
+        bool vectorize_ = true;
+        bool time_passes_ = false;
+        bool memory_stats_ = false;
+        bool dump_bytecode_ = false;
+        bool run_ = false;
+        bool run_tree_ = false;
+        bool jit_ = false;
+        bool tiered_ = false;
+        bool server_ = false;
+        bool client_ = false;
+        bool stop_server_ = false;
+        std::string socket_path_ = "";
+        bool build_cache_ = true;
+        std::string build_cache_path_ = "";
+        u64 build_cache_size_ = u64(256) << 20;
+        u64 const_steps_ = 10000000;
+        u64 const_memory_ = u64(64) << 20;
 
         CompilerSettings() {
             log_output_file_ = "logs/solara.log";
+            jobs_ = std::max(std::thread::hardware_concurrency(), 1u);
         }
     };
 
     struct CompilerContext {
         CompilerSettings settings_;
+        MemoryTracker memory_;
         StringTable string_table_;
         Logger logger_;
+        TypeTable type_table_;
+        ThreadPool thread_pool_;
 
         CompilerContext(const CompilerSettings& settings)
             : settings_(settings)
             , string_table_(this)
             , logger_(settings.log_output_file_)
+            , type_table_(this)
+            , thread_pool_(settings.jobs_)
         {}
     };
 
@@ -42,9 +85,19 @@ namespace solara {
      */
     void parse_settings(i32 argc, char* argv[], CompilerSettings& out_settings);
 
+    // forward declarations
+    class ModuleCache;
+
     /**
      * 
      */
-    void init(const CompilerSettings& settings);
+    bool init(const CompilerSettings& settings);
+
+    /**
+     * Compiles the input file with the context's settings, reusing and filling the module cache if one is given,
+     * and runs its main function if asked to.
+     * @returns False if the compilation reported errors or the run failed.
+     */
+    bool compile(CompilerContext* ctx, ModuleCache* cache);
 
 } /* solara */
@@ -0,0 +1,141 @@
+/**
+ * @file sourcestream.cpp
+ */
+
+#include "sourcestream.h"
+
+#include <cerrno>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define SOLARA_STREAM_HOST 1
+#else
+#define SOLARA_STREAM_HOST 0
+#endif
+
+namespace solara {
+
+    bool is_stream_source(const std::filesystem::path& path) {
+        if (path == "-") {
+            return true;
+        }
+        std::error_code error;
+        const std::filesystem::file_status status = std::filesystem::status(path, error);
+        return !error && (status.type() == std::filesystem::file_type::fifo || status.type() == std::filesystem::file_type::character);
+    }
+
+    SourceStream::SourceStream(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        for (Chunk& chunk : chunks_) {
+            chunk.data_ = std::make_unique<char[]>(CHUNK_SIZE);
+        }
+    }
+
+    SourceStream::~SourceStream() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        released_.notify_all();
+        if (reader_.joinable()) {
+            reader_.join();
+        }
+#if SOLARA_STREAM_HOST
+        if (owns_fd_) {
+            close(fd_);
+        }
+#endif
+    }
+
+    bool SourceStream::open(const std::filesystem::path& path) {
+#if SOLARA_STREAM_HOST
+        if (path == "-") {
+            fd_ = STDIN_FILENO;
+        } else {
+            fd_ = ::open(path.c_str(), O_RDONLY);
+            owns_fd_ = fd_ >= 0;
+        }
+        if (fd_ < 0) {
+            ctx_->logger_.log(ERROR, "error: could not open source stream '" + path.string() + "'");
+            return false;
+        }
+        reader_ = std::thread(&SourceStream::read_chunks, this);
+        return true;
+#else
+        ctx_->logger_.log(ERROR, "error: reading a source from a stream needs POSIX file descriptors");
+        return false;
+#endif
+    }
+
+    std::string_view SourceStream::acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        filled_.wait(lock, [this] { return read_ < written_ || end_; });
+        if (read_ == written_) {
+            return std::string_view();
+        }
+        const Chunk& chunk = chunks_[read_ % CHUNK_COUNT];
+        return std::string_view(chunk.data_.get(), chunk.size_);
+    }
+
+    void SourceStream::release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            read_++;
+        }
+        released_.notify_one();
+    }
+
+    const std::string& SourceStream::get_error() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+    /**
+     * Fills free chunks until the end of the stream. A chunk is published as soon as a read returns, so the
+     * ring holds at most CHUNK_COUNT chunks whether the producer writes in large or small pieces.
+     */
+    void SourceStream::read_chunks() {
+#if SOLARA_STREAM_HOST
+        for (;;) {
+            Chunk* chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                released_.wait(lock, [this] { return written_ - read_ < CHUNK_COUNT || stop_; });
+                if (stop_) {
+                    break;
+                }
+                chunk = &chunks_[written_ % CHUNK_COUNT];
+            }
+
+            const ssize_t count = read(fd_, chunk->data_.get(), CHUNK_SIZE);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                const std::string reason = std::generic_category().message(errno);
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = "could not read the source stream: " + reason;
+            }
+            if (count <= 0) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                chunk->size_ = static_cast<u64>(count);
+                written_++;
+            }
+            filled_.notify_one();
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            end_ = true;
+        }
+        filled_.notify_one();
+    }
+
+} /* solara */
@@ -0,0 +1,83 @@
+/**
+ * @file sourcestream.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace solara {
+
+    /**
+     * @returns True if a source is read as a stream rather than loaded whole: '-' for the standard input,
+     * or a pipe, FIFO or character device such as '/dev/fd/3'.
+     */
+    bool is_stream_source(const std::filesystem::path& path);
+
+    /**
+     * Source read from a file descriptor into a fixed ring of chunks by a reader thread, so reading overlaps
+     * with lexing and the raw bytes held stay bounded however long the input is. The tokens and the tree built
+     * from them still grow with the input. The reader publishes whatever each read returns instead of waiting
+     * for full chunks, so a slow producer is lexed as it writes.
+     */
+    class SourceStream {
+    public:
+        static constexpr u64 CHUNK_SIZE = 64 * 1024;
+        static constexpr u32 CHUNK_COUNT = 4;
+
+        SourceStream(CompilerContext* ctx);
+        ~SourceStream();
+
+        SourceStream(const SourceStream&) = delete;
+        SourceStream& operator=(const SourceStream&) = delete;
+
+        /** Starts reading a stream source. @returns False if it could not be opened. */
+        bool open(const std::filesystem::path& path);
+
+        /**
+         * Waits for the next chunk, which stays valid until it is released.
+         * @returns An empty view at the end, or once a read failed, described by get_error.
+         */
+        std::string_view acquire();
+
+        /** Hands the last acquired chunk back to the reader. */
+        void release();
+
+        /** @returns Why the stream ended early, or an empty string if it was read to its end. */
+        const std::string& get_error();
+
+    protected:
+        void read_chunks();
+
+    private:
+        struct Chunk {
+            std::unique_ptr<char[]> data_;
+            u64 size_ = 0;
+        };
+
+        CompilerContext* ctx_;
+        int fd_ = -1;
+        bool owns_fd_ = false;
+        std::thread reader_;
+
+        std::mutex mutex_;
+        std::condition_variable filled_;
+        std::condition_variable released_;
+        Chunk chunks_[CHUNK_COUNT];
+        u64 read_ = 0;
+        u64 written_ = 0;
+        bool end_ = false;
+        bool stop_ = false;
+        std::string error_;
+    };
+
+} /* solara */
@@ -5,25 +5,52 @@
 #include "stringtable.h"
 #include "solara.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
 namespace solara {
 
-    StringTable::StringTable(CompilerContext* ctx) {
+    /** A map node holds the next pointer, the key and index, and the cached hash. */
+    static constexpr u64 TABLE_NODE_SIZE = sizeof(void*) + sizeof(std::pair<const std::string_view, u64>) + sizeof(size_t);
+
+    StringTable::StringTable(CompilerContext* ctx)
+        : arena_(ctx->memory_.get_resource(MemorySubsystem::Strings))
+        , nodes_(TABLE_NODE_SIZE, ctx->memory_.get_resource(MemorySubsystem::Strings))
+        , strings(ctx->memory_.get_resource(MemorySubsystem::Strings))
+        , table(&nodes_)
+    {
         assert(ctx != nullptr);
         ctx_ = ctx;
     }
 
     u64 StringTable::add(const std::string_view string) {
-        auto it = table.find(string);
-        if (it != table.end()) {
-            return it->second;
+        return add_prehashed(string, hash_string(string));
+    }
+
+    u64 StringTable::add_prehashed(const std::string_view string, const u64 hash) {
+        const PrehashedString key = { string, hash };
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = table.find(key);
+            if (it != table.end()) {
+                return it->second;
+            }
         }
 
-        u64 index = strings.size();
-        strings.emplace_back(string);
-        table.emplace(string, index);
+        u64 index;
+        {
+            // another thread may have added the string between the two locks
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto it = table.find(key);
+            if (it != table.end()) {
+                return it->second;
+            }
+            index = strings.size();
+            char* data = static_cast<char*>(arena_.allocate(string.size(), 1));
+            std::copy(string.begin(), string.end(), data);
+            table.emplace(strings.emplace_back(data, string.size()), index);
+        }
 
         std::ostringstream ss;
         ss << "Added new element to String Table at " << index << ": \"" << string << "\".";
@@ -36,6 +63,7 @@ namespace solara {
     }
 
     u64 StringTable::get_index(const std::string_view string) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
         auto it = table.find(string);
         if (it != table.end()) {
             return it->second;
@@ -44,18 +72,26 @@ namespace solara {
     }
 
     std::string_view StringTable::get_string(const u64 index) {
-        if (is_valid_index(index)) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (index < strings.size()) {
             return strings[index];
         }
         return "";
     }
 
     bool StringTable::is_valid_index(const u64 index) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
         return index < strings.size();
     }
 
     bool StringTable::is_valid_string(const std::string_view string) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
         return table.find(string) != table.end();
     }
 
+    u64 StringTable::get_size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return strings.size();
+    }
+
 }
\ No newline at end of file
@@ -4,32 +4,85 @@
 
 #pragma once
 
+#include <memory_resource>
+#include <shared_mutex>
 #include <string>
-#include <vector>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "common.h"
+#include "memory.h"
 
 namespace solara {
 
     // forward declarations
     struct CompilerContext;
+
+    static constexpr u64 STRING_HASH_SEED = 0xcbf29ce484222325ull;
+
+    /** Folds one more byte into a string hash, FNV-1a, so a scanner can hash a string as it reads it. */
+    constexpr u64 hash_string_step(const u64 hash, const char c) {
+        return (hash ^ static_cast<u08>(c)) * 0x100000001b3ull;
+    }
+
+    constexpr u64 hash_string(const std::string_view string) {
+        u64 hash = STRING_HASH_SEED;
+        for (const char c : string) {
+            hash = hash_string_step(hash, c);
+        }
+        return hash;
+    }
     
+    /**
+     * Interns strings for the lifetime of the compiler context. The characters are copied into an arena that
+     * never moves or frees them, so strings outlive the sources they were read from, and the map's nodes come
+     * from a pool. Both draw from the context's string memory.
+     */
     class StringTable {
     public:
         StringTable(CompilerContext* ctx);
 
         u64 add(const std::string_view string);
+
+        /**
+         * Adds a string whose hash_string the caller already has, so the lookup never hashes it again. The hash
+         * is trusted, not checked: a wrong one leaves the string unfound by add.
+         */
+        u64 add_prehashed(const std::string_view string, const u64 hash);
         u64 get_index(const std::string_view string);
         std::string_view get_string(const u64 index);
 
         bool is_valid_index(const u64 index);
         bool is_valid_string(const std::string_view string);
+        u64 get_size() const;
 
     private:
+        struct PrehashedString {
+            std::string_view string_;
+            u64 hash_;
+        };
+
+        /** Hashes keys with hash_string, and takes a prehashed string's hash as it is. */
+        struct StringHash {
+            using is_transparent = void;
+            size_t operator()(const std::string_view string) const { return hash_string(string); }
+            size_t operator()(const PrehashedString& string) const { return string.hash_; }
+        };
+
+        struct StringEqual {
+            using is_transparent = void;
+            bool operator()(const std::string_view a, const std::string_view b) const { return a == b; }
+            bool operator()(const PrehashedString& a, const std::string_view b) const { return a.string_ == b; }
+            bool operator()(const std::string_view a, const PrehashedString& b) const { return a == b.string_; }
+        };
+
         CompilerContext* ctx_;
-        std::vector<std::string> strings;
-        std::unordered_map<std::string_view, u64> table;
+        mutable std::shared_mutex mutex_;
+        ArenaAllocator arena_;
+        PoolAllocator nodes_;
+        std::pmr::vector<std::string_view> strings;
+        std::pmr::unordered_map<std::string_view, u64, StringHash, StringEqual> table;
     };
 
 }
\ No newline at end of file
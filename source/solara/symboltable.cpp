@@ -0,0 +1,89 @@
+/**
+ * @file symboltable.cpp
+ */
+
+#include "symboltable.h"
+
+namespace solara {
+
+    SymbolTable::SymbolTable() {
+        reserve(256, 64, 16);
+    }
+
+    SymbolTable::SymbolTable(const SymbolTable* parent)
+        : SymbolTable()
+    {
+        parent_ = parent;
+    }
+
+    void SymbolTable::reserve(const u64 name_count, const u32 symbol_count, const u32 scope_count) {
+        if (bindings_.size() < name_count) {
+            bindings_.resize(name_count, NO_SYMBOL);
+        }
+        symbols_.reserve(symbol_count);
+        scopes_.reserve(scope_count);
+    }
+
+    void SymbolTable::enter_scope() {
+        scopes_.push_back(static_cast<u32>(symbols_.size()));
+    }
+
+    void SymbolTable::leave_scope() {
+        assert(!scopes_.empty());
+        const u32 mark = scopes_.back();
+        scopes_.pop_back();
+
+        while (symbols_.size() > mark) {
+            const Symbol& symbol = symbols_.back();
+            bindings_[symbol.name_id] = symbol.shadowed;
+            symbols_.pop_back();
+        }
+    }
+
+    void SymbolTable::declare(const u64 name_id, const SymbolKind kind, SyntaxNodeHandle decl) {
+        assert(!scopes_.empty());
+        if (name_id >= bindings_.size()) {
+            // interned ids are dense, so the binding array grows geometrically with the string table
+            bindings_.resize((name_id + 1) * 2, NO_SYMBOL);
+        }
+
+        Symbol symbol;
+        symbol.name_id = name_id;
+        symbol.kind = kind;
+        symbol.decl = decl;
+        symbol.depth = get_depth();
+        symbol.shadowed = bindings_[name_id];
+
+        bindings_[name_id] = static_cast<u32>(symbols_.size());
+        symbols_.push_back(symbol);
+    }
+
+    const Symbol* SymbolTable::lookup(const u64 name_id) const {
+        if (name_id < bindings_.size()) {
+            const u32 index = bindings_[name_id];
+            if (index != NO_SYMBOL) {
+                return &symbols_[index];
+            }
+        }
+        if (parent_) {
+            return parent_->lookup(name_id);
+        }
+        return nullptr;
+    }
+
+    const Symbol* SymbolTable::lookup_local(const u64 name_id) const {
+        if (name_id >= bindings_.size()) {
+            return nullptr;
+        }
+        const u32 index = bindings_[name_id];
+        if (index != NO_SYMBOL && symbols_[index].depth == get_depth()) {
+            return &symbols_[index];
+        }
+        return nullptr;
+    }
+
+    u32 SymbolTable::get_depth() const {
+        return static_cast<u32>(scopes_.size());
+    }
+
+} /* solara */
@@ -0,0 +1,61 @@
+/**
+ * @file symboltable.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "ast.h"
+
+#include <vector>
+
+namespace solara {
+
+    enum class SymbolKind : u08 {
+        None = 0,
+        Module,
+        Function,
+        Parameter,
+        Variable,
+        Constant
+    };
+
+    struct Symbol {
+        u64 name_id;
+        SymbolKind kind;
+        SyntaxNodeHandle decl;
+        u32 depth;
+        u32 shadowed;
+    };
+
+    /**
+     * Scoped symbol table keyed by interned string ids.
+     * Every name id indexes directly into a flat binding array that holds its innermost live symbol, and each
+     * symbol remembers the binding it shadows. Leaving a scope unwinds the symbols declared since it was entered,
+     * so lookups are a single array access and scope changes do not allocate once the buffers have grown.
+     * A table may sit on top of a read-only parent table, which is consulted for names it does not bind itself;
+     * this lets several threads resolve function bodies against one shared module scope.
+     */
+    class SymbolTable {
+    public:
+        static constexpr u32 NO_SYMBOL = ~0u;
+
+        SymbolTable();
+        SymbolTable(const SymbolTable* parent);
+
+        void reserve(const u64 name_count, const u32 symbol_count, const u32 scope_count);
+        void enter_scope();
+        void leave_scope();
+        void declare(const u64 name_id, const SymbolKind kind, SyntaxNodeHandle decl);
+        const Symbol* lookup(const u64 name_id) const;
+        const Symbol* lookup_local(const u64 name_id) const;
+        u32 get_depth() const;
+
+    private:
+        const SymbolTable* parent_ = nullptr;
+        std::vector<u32> bindings_;
+        std::vector<Symbol> symbols_;
+        std::vector<u32> scopes_;
+    };
+
+} /* solara */
@@ -0,0 +1,260 @@
+/**
+ * @file syntaxwalk.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "ast.h"
+
+#include <tuple>
+
+namespace solara {
+
+    template<typename Pass, typename Node>
+    concept HasEnterHook = requires(Pass& pass, Node* node) { pass.enter(node); };
+
+    template<typename Pass, typename Node>
+    concept HasLeaveHook = requires(Pass& pass, Node* node) { pass.leave(node); };
+
+    template<typename Pass, typename Node>
+    concept HasChildHook = requires(Pass& pass, Node* node, SyntaxNodeHandle child) { pass.after_child(node, child); };
+
+    template<typename Pass, typename Node>
+    concept HasNodeHook = HasEnterHook<Pass, Node> || HasLeaveHook<Pass, Node> || HasChildHook<Pass, Node>;
+
+    constexpr u32 syntax_kind_bit(const SyntaxNodeType type) {
+        return 1u << static_cast<u32>(type);
+    }
+
+    template<typename... Nodes>
+    constexpr u32 syntax_kind_mask() {
+        return (syntax_kind_bit(Nodes::get_static_type()) | ... | 0u);
+    }
+
+    /** Kinds of node that can occur below a node of a kind, itself included. */
+    constexpr u32 syntax_subtree_kinds(const SyntaxNodeType type) {
+        constexpr u32 expressions = syntax_kind_mask<BinaryExprNode, UnaryExprNode, LiteralExprNode, IdentifierExprNode, CallExprNode>();
+        constexpr u32 statements = expressions | syntax_kind_mask<
+            VarDeclNode, CompoundStmtNode, ExprStmtNode, ReturnStmtNode, IfStmtNode, ForStmtNode, BreakStmtNode,
+            ContinueStmtNode, NamedTypeNode>();
+        switch (type) {
+            case SyntaxNodeType::ModuleDecl:
+                return ~0u;
+            case SyntaxNodeType::FunctionDecl:
+                return statements | syntax_kind_mask<FunctionDeclNode, ParamDeclNode>();
+            case SyntaxNodeType::ParamDecl:
+                return syntax_kind_mask<ParamDeclNode, NamedTypeNode>();
+            case SyntaxNodeType::VarDecl:
+            case SyntaxNodeType::CompoundStmt:
+            case SyntaxNodeType::ExprStmt:
+            case SyntaxNodeType::ReturnStmt:
+            case SyntaxNodeType::IfStmt:
+            case SyntaxNodeType::ForStmt:
+                return statements;
+            case SyntaxNodeType::BinaryExpr:
+            case SyntaxNodeType::UnaryExpr:
+            case SyntaxNodeType::CallExpr:
+                return expressions;
+            default:
+                return syntax_kind_bit(type);
+        }
+    }
+
+    template<typename Node, typename... Passes>
+    constexpr u32 hooked_syntax_kind() {
+        return (HasNodeHook<Passes, Node> || ...) ? syntax_kind_bit(Node::get_static_type()) : 0u;
+    }
+
+    template<typename... Passes>
+    constexpr u32 hooked_syntax_kinds() {
+        return hooked_syntax_kind<ModuleDeclNode, Passes...>() | hooked_syntax_kind<ImportDeclNode, Passes...>()
+            | hooked_syntax_kind<FunctionDeclNode, Passes...>() | hooked_syntax_kind<ParamDeclNode, Passes...>()
+            | hooked_syntax_kind<VarDeclNode, Passes...>() | hooked_syntax_kind<CompoundStmtNode, Passes...>()
+            | hooked_syntax_kind<ExprStmtNode, Passes...>() | hooked_syntax_kind<ReturnStmtNode, Passes...>()
+            | hooked_syntax_kind<IfStmtNode, Passes...>() | hooked_syntax_kind<ForStmtNode, Passes...>()
+            | hooked_syntax_kind<BreakStmtNode, Passes...>() | hooked_syntax_kind<ContinueStmtNode, Passes...>()
+            | hooked_syntax_kind<BinaryExprNode, Passes...>() | hooked_syntax_kind<UnaryExprNode, Passes...>()
+            | hooked_syntax_kind<LiteralExprNode, Passes...>() | hooked_syntax_kind<IdentifierExprNode, Passes...>()
+            | hooked_syntax_kind<CallExprNode, Passes...>() | hooked_syntax_kind<NamedTypeNode, Passes...>();
+    }
+
+    /**
+     * Calls a function on each child of a node in source order, as visit_children passes them but without
+     * a virtual call per node. Missing children are passed as null.
+     */
+    template<typename Function>
+    void for_each_syntax_child(ModuleDeclNode* node, Function&& function) {
+        for (ImportDeclNode* import : node->imports_) {
+            function(import);
+        }
+        for (SyntaxNodeHandle decl : node->decls_) {
+            function(decl);
+        }
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(FunctionDeclNode* node, Function&& function) {
+        for (ParamDeclNode* param : node->params_) {
+            function(param);
+        }
+        function(node->return_type_);
+        function(node->body_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(ParamDeclNode* node, Function&& function) {
+        function(node->type_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(VarDeclNode* node, Function&& function) {
+        function(node->type_);
+        function(node->init_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(CompoundStmtNode* node, Function&& function) {
+        for (SyntaxNodeHandle stmt : node->stmts_) {
+            function(stmt);
+        }
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(ExprStmtNode* node, Function&& function) {
+        function(node->expr_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(ReturnStmtNode* node, Function&& function) {
+        function(node->expr_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(IfStmtNode* node, Function&& function) {
+        function(node->cond_);
+        function(node->then_);
+        function(node->else_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(ForStmtNode* node, Function&& function) {
+        function(node->init_);
+        function(node->cond_);
+        function(node->post_);
+        function(node->body_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(BinaryExprNode* node, Function&& function) {
+        function(node->left_);
+        function(node->right_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(UnaryExprNode* node, Function&& function) {
+        function(node->expr_);
+    }
+
+    template<typename Function>
+    void for_each_syntax_child(CallExprNode* node, Function&& function) {
+        function(node->callee_);
+        for (SyntaxNodeHandle arg : node->args_) {
+            function(arg);
+        }
+    }
+
+    /** Leaves, such as literals and identifiers, have no children. */
+    template<typename Node, typename Function>
+    void for_each_syntax_child(Node*, Function&&) {}
+
+    /**
+     * Runs several passes over a tree in one walk. A pass declares hooks for the node kinds it cares about:
+     * enter(Node*) before the children of a node, after_child(Node*, SyntaxNodeHandle) after each of them,
+     * even a missing one, and leave(Node*) after all of them. The hooks of the passes are called in the
+     * order the passes are listed, and are bound when the walk is compiled, so a kind no pass hooks costs
+     * only its dispatch, and a subtree that holds no hooked kind at all is not entered.
+     * A later pass may rely on what earlier passes did in the same hook or in any hook that ran before.
+     */
+    template<typename... Passes>
+    class FusedSyntaxWalk {
+    public:
+        FusedSyntaxWalk(Passes&... passes)
+            : passes_(passes...)
+        {}
+
+        void walk(SyntaxNodeHandle node) {
+            if (!node) {
+                return;
+            }
+            switch (node->get_type()) {
+                case SyntaxNodeType::ModuleDecl: visit(static_cast<ModuleDeclNode*>(node)); break;
+                case SyntaxNodeType::ImportDecl: visit(static_cast<ImportDeclNode*>(node)); break;
+                case SyntaxNodeType::FunctionDecl: visit(static_cast<FunctionDeclNode*>(node)); break;
+                case SyntaxNodeType::ParamDecl: visit(static_cast<ParamDeclNode*>(node)); break;
+                case SyntaxNodeType::VarDecl: visit(static_cast<VarDeclNode*>(node)); break;
+                case SyntaxNodeType::CompoundStmt: visit(static_cast<CompoundStmtNode*>(node)); break;
+                case SyntaxNodeType::ExprStmt: visit(static_cast<ExprStmtNode*>(node)); break;
+                case SyntaxNodeType::ReturnStmt: visit(static_cast<ReturnStmtNode*>(node)); break;
+                case SyntaxNodeType::IfStmt: visit(static_cast<IfStmtNode*>(node)); break;
+                case SyntaxNodeType::ForStmt: visit(static_cast<ForStmtNode*>(node)); break;
+                case SyntaxNodeType::BreakStmt: visit(static_cast<BreakStmtNode*>(node)); break;
+                case SyntaxNodeType::ContinueStmt: visit(static_cast<ContinueStmtNode*>(node)); break;
+                case SyntaxNodeType::BinaryExpr: visit(static_cast<BinaryExprNode*>(node)); break;
+                case SyntaxNodeType::UnaryExpr: visit(static_cast<UnaryExprNode*>(node)); break;
+                case SyntaxNodeType::LiteralExpr: visit(static_cast<LiteralExprNode*>(node)); break;
+                case SyntaxNodeType::IdentifierExpr: visit(static_cast<IdentifierExprNode*>(node)); break;
+                case SyntaxNodeType::CallExpr: visit(static_cast<CallExprNode*>(node)); break;
+                case SyntaxNodeType::NamedType: visit(static_cast<NamedTypeNode*>(node)); break;
+                default: break;
+            }
+        }
+
+        /** Walks the children of a node without calling the hooks of the node itself. */
+        template<typename Node>
+        void walk_children(Node* node) {
+            for_each_syntax_child(node, [this](SyntaxNodeHandle child) { walk(child); });
+        }
+
+        /** Kinds of node at least one of the passes has a hook for. */
+        static constexpr u32 HOOKED_KINDS = hooked_syntax_kinds<Passes...>();
+
+    protected:
+        template<typename Node>
+        void visit(Node* node) {
+            if constexpr ((HOOKED_KINDS & syntax_subtree_kinds(Node::get_static_type())) != 0) {
+                std::apply([node](Passes&... passes) { (enter(passes, node), ...); }, passes_);
+                for_each_syntax_child(node, [this, node](SyntaxNodeHandle child) {
+                    walk(child);
+                    std::apply([node, child](Passes&... passes) { (after_child(passes, node, child), ...); }, passes_);
+                });
+                std::apply([node](Passes&... passes) { (leave(passes, node), ...); }, passes_);
+            }
+        }
+
+        template<typename Pass, typename Node>
+        static void enter(Pass& pass, Node* node) {
+            if constexpr (HasEnterHook<Pass, Node>) {
+                pass.enter(node);
+            }
+        }
+
+        template<typename Pass, typename Node>
+        static void after_child(Pass& pass, Node* node, SyntaxNodeHandle child) {
+            if constexpr (HasChildHook<Pass, Node>) {
+                pass.after_child(node, child);
+            }
+        }
+
+        template<typename Pass, typename Node>
+        static void leave(Pass& pass, Node* node) {
+            if constexpr (HasLeaveHook<Pass, Node>) {
+                pass.leave(node);
+            }
+        }
+
+    private:
+        std::tuple<Passes&...> passes_;
+    };
+
+} /* solara */
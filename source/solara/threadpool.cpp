@@ -0,0 +1,96 @@
+/**
+ * @file threadpool.cpp
+ */
+
+#include "threadpool.h"
+
+namespace solara {
+
+    ThreadPool::ThreadPool(const u32 thread_count) {
+        const u32 count = thread_count > 0 ? thread_count : 1;
+        workers_.reserve(count - 1);
+        for (u32 i = 1; i < count; i++) {
+            workers_.emplace_back(&ThreadPool::worker_main, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallel_for(const u64 count, const Task& task) {
+        if (count == 0) {
+            return;
+        }
+
+        if (workers_.empty() || count == 1 || busy_.exchange(true, std::memory_order_acquire)) {
+            for (u64 i = 0; i < count; i++) {
+                task(i, 0);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            count_ = count;
+            next_.store(0, std::memory_order_relaxed);
+            active_ = static_cast<u32>(workers_.size());
+            generation_++;
+        }
+        wake_.notify_all();
+
+        run_tasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        task_ = nullptr;
+        busy_.store(false, std::memory_order_release);
+    }
+
+    u32 ThreadPool::get_thread_count() const {
+        return static_cast<u32>(workers_.size()) + 1;
+    }
+
+    void ThreadPool::worker_main(const u32 worker) {
+        u64 generation = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+                if (stop_) {
+                    return;
+                }
+                generation = generation_;
+            }
+
+            run_tasks(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                active_--;
+                if (active_ == 0) {
+                    done_.notify_one();
+                }
+            }
+        }
+    }
+
+    void ThreadPool::run_tasks(const u32 worker) {
+        for (;;) {
+            const u64 index = next_.fetch_add(1, std::memory_order_relaxed);
+            if (index >= count_) {
+                break;
+            }
+            (*task_)(index, worker);
+        }
+    }
+
+} /* solara */
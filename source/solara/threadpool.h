@@ -0,0 +1,59 @@
+/**
+ * @file threadpool.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Fixed set of worker threads that cooperatively run indexed tasks.
+     * The calling thread always takes part as worker 0, so a pool of one thread runs everything inline.
+     * A loop started while another one is running, from one of its tasks or from another thread, also runs
+     * inline on its calling thread.
+     */
+    class ThreadPool {
+    public:
+        using Task = std::function<void(const u64 index, const u32 worker)>;
+
+        ThreadPool(const u32 thread_count);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Runs the task once for every index in [0, count) and waits for all of them to finish.
+         * Indices are handed out dynamically, so the worker that runs a given index is unspecified.
+         */
+        void parallel_for(const u64 count, const Task& task);
+        u32 get_thread_count() const;
+
+    protected:
+        void worker_main(const u32 worker);
+        void run_tasks(const u32 worker);
+
+    private:
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        const Task* task_ = nullptr;
+        u64 count_ = 0;
+        u64 generation_ = 0;
+        u32 active_ = 0;
+        bool stop_ = false;
+        std::atomic<u64> next_ = 0;
+        std::atomic<bool> busy_ = false;
+    };
+
+} /* solara */
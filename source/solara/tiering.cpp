@@ -0,0 +1,87 @@
+/**
+ * @file tiering.cpp
+ */
+
+#include "tiering.h"
+#include "codegen.h"
+
+namespace solara {
+
+    TieredCompiler::TieredCompiler(CompilerContext* ctx, const IrModule* module) {
+        assert(ctx != nullptr);
+        assert(module != nullptr);
+        ctx_ = ctx;
+        module_ = module;
+
+        const u64 count = module->functions_.size();
+        dispatch_ = std::make_unique<std::atomic<NativeAdapter>[]>(count);
+        for (u64 i = 0; i < count; i++) {
+            dispatch_[i].store(nullptr, std::memory_order_relaxed);
+        }
+        requested_.assign(count, false);
+        worker_ = std::thread(&TieredCompiler::worker_main, this);
+    }
+
+    TieredCompiler::~TieredCompiler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        worker_.join();
+    }
+
+    void TieredCompiler::request(const u32 function) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (requested_[function]) {
+                return;
+            }
+            requested_[function] = true;
+            queue_.push_back(function);
+        }
+        wake_.notify_one();
+    }
+
+    const std::atomic<NativeAdapter>* TieredCompiler::get_dispatch_table() const {
+        return dispatch_.get();
+    }
+
+    u32 TieredCompiler::get_promoted_count() const {
+        return promoted_.load(std::memory_order_relaxed);
+    }
+
+    void TieredCompiler::worker_main() {
+        NativeCodeGenerator codegen(ctx_);
+        for (;;) {
+            u32 function = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (stop_) {
+                    return;
+                }
+                function = queue_.front();
+                queue_.pop_front();
+            }
+
+            // functions that cannot be compiled simply stay in the interpreter
+            NativeModule native;
+            auto traps = std::make_unique<NativeTrapState>();
+            if (!codegen.generate_unit(*module_, function, traps.get(), native)) {
+                continue;
+            }
+            auto unit = std::make_unique<JitModule>(ctx_);
+            if (!unit->load(native)) {
+                continue;
+            }
+            const void* entry = unit->get_address(native.functions_[function].adapter_);
+            const NativeAdapter adapter = reinterpret_cast<NativeAdapter>(const_cast<void*>(entry));
+            units_.push_back(std::move(unit));
+            traps_.push_back(std::move(traps));
+            dispatch_[function].store(adapter, std::memory_order_release);
+            promoted_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+} /* solara */
@@ -0,0 +1,68 @@
+/**
+ * @file tiering.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ir.h"
+#include "bytecode.h"
+#include "jit.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Native entry called from the interpreter with the callee's frame as arguments.
+     * @returns A NativeTrap status, for the interpreter to report as it would its own runtime error.
+     */
+    using NativeAdapter = u32 (*)(const VmValue* args, VmValue* result);
+
+    /**
+     * Background compiler promoting hot functions to native code.
+     * The interpreter requests a function once its counters cross a threshold; a worker thread compiles the
+     * function together with everything it calls into its own executable unit and then publishes the unit's
+     * adapter in the dispatch table. Entries only ever go from null to an adapter, so the interpreter reads the
+     * table with a single acquire load and never waits for the compiler.
+     */
+    class TieredCompiler {
+    public:
+        TieredCompiler(CompilerContext* ctx, const IrModule* module);
+        ~TieredCompiler();
+
+        TieredCompiler(const TieredCompiler&) = delete;
+        TieredCompiler& operator=(const TieredCompiler&) = delete;
+
+        /** Queues a function for compilation, ignoring repeated requests. */
+        void request(const u32 function);
+        const std::atomic<NativeAdapter>* get_dispatch_table() const;
+        u32 get_promoted_count() const;
+
+    protected:
+        void worker_main();
+
+    private:
+        CompilerContext* ctx_;
+        const IrModule* module_;
+        std::unique_ptr<std::atomic<NativeAdapter>[]> dispatch_;
+        std::vector<bool> requested_;
+        std::vector<std::unique_ptr<JitModule>> units_;
+        std::vector<std::unique_ptr<NativeTrapState>> traps_;
+        std::atomic<u32> promoted_ = 0;
+
+        std::thread worker_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<u32> queue_;
+        bool stop_ = false;
+    };
+
+} /* solara */
@@ -5,8 +5,8 @@
 #include "token.h"
 #include "stringtable.h"
 
-#include <iostream>
 #include <array>
+#include <charconv>
 //#include <format>
 
 namespace solara {
@@ -26,6 +26,7 @@ namespace solara {
         { TokenType::KW_CONTINUE, "CONTINUE", "continue" },
         { TokenType::KW_DEFAULT, "DEFAULT", "default" },
         { TokenType::KW_ELSE, "ELSE", "else" },
+        { TokenType::KW_FN, "FN", "fn" },
         { TokenType::KW_FOR, "FOR", "for" },
         { TokenType::KW_IF, "IF", "if" },
         { TokenType::KW_RETURN, "RETURN", "return" },
@@ -33,6 +34,7 @@ namespace solara {
         { TokenType::KW_SWITCH, "SWITCH", "switch" },
         { TokenType::KW_PUB, "PUB", "pub" },
         { TokenType::KW_MODULE, "MODULE", "module" },
+        { TokenType::KW_IMPORT, "IMPORT", "import" },
 
         // literals
         { TokenType::LIT_INT, "LIT_INT", "" },
@@ -98,8 +100,10 @@ namespace solara {
             case TokenType::KW_CONTINUE:
             case TokenType::KW_DEFAULT:
             case TokenType::KW_ELSE:
+            case TokenType::KW_FN:
             case TokenType::KW_FOR:
             case TokenType::KW_IF:
+            case TokenType::KW_IMPORT:
             case TokenType::KW_MODULE:
             case TokenType::KW_PUB:
             case TokenType::KW_RETURN:
@@ -164,42 +168,100 @@ namespace solara {
         }
     }
 
-    TokenType identify_keyword(const std::string_view string) {
-        if (string == "break") return TokenType::KW_BREAK;
-        if (string == "const") return TokenType::KW_CONST;
-        if (string == "continue") return TokenType::KW_CONTINUE;
-        if (string == "default") return TokenType::KW_DEFAULT;
-        if (string == "else") return TokenType::KW_ELSE;
-        if (string == "for") return TokenType::KW_FOR;
-        if (string == "if") return TokenType::KW_IF;
-        if (string == "module") return TokenType::KW_MODULE;
-        if (string == "pub") return TokenType::KW_PUB;
-        if (string == "return") return TokenType::KW_RETURN;
-        if (string == "struct") return TokenType::KW_STRUCT;
-        if (string == "switch") return TokenType::KW_SWITCH;
-        return TokenType::IDENTIFIER;
+    std::string_view token_name(const TokenType type) {
+        return get_token_metadata(type).name_;
     }
 
-    static void print_value_token(CompilerContext* ctx, const TokenLexeme& token) {
-        TokenMetadata meta = get_token_metadata(token.type);
-        std::cout << meta.name_ << "(" << ctx->string_table_.get_string(token.literal_id) << ")" << std::endl;
+    struct KeywordEntry {
+        std::string_view name_;
+        TokenType type_;
+    };
+
+    static constexpr KeywordEntry keywords[] = {
+        { "break", TokenType::KW_BREAK },
+        { "const", TokenType::KW_CONST },
+        { "continue", TokenType::KW_CONTINUE },
+        { "default", TokenType::KW_DEFAULT },
+        { "else", TokenType::KW_ELSE },
+        { "fn", TokenType::KW_FN },
+        { "for", TokenType::KW_FOR },
+        { "if", TokenType::KW_IF },
+        { "import", TokenType::KW_IMPORT },
+        { "module", TokenType::KW_MODULE },
+        { "pub", TokenType::KW_PUB },
+        { "return", TokenType::KW_RETURN },
+        { "struct", TokenType::KW_STRUCT },
+        { "switch", TokenType::KW_SWITCH }
+    };
+
+    static constexpr u64 KEYWORD_SLOTS = 64;
+
+    /** @returns The first shift of the string hash that gives every keyword a slot of its own, or 64 if none does. */
+    static constexpr u32 find_keyword_shift() {
+        for (u32 shift = 0; shift < 64; shift++) {
+            bool used[KEYWORD_SLOTS] = {};
+            bool unique = true;
+            for (const KeywordEntry& keyword : keywords) {
+                const u64 slot = (hash_string(keyword.name_) >> shift) & (KEYWORD_SLOTS - 1);
+                unique = unique && !used[slot];
+                used[slot] = true;
+            }
+            if (unique) {
+                return shift;
+            }
+        }
+        return 64;
     }
 
-    static void print_nonvalue_token(CompilerContext* ctx, const TokenLexeme& token) {
-        TokenMetadata meta = get_token_metadata(token.type);
-        std::cout << meta.name_ << std::endl;
+    static constexpr u32 KEYWORD_SHIFT = find_keyword_shift();
+    static_assert(KEYWORD_SHIFT < 64, "the keywords need a larger slot table");
+
+    /** Perfect hash of the keywords: each slot holds the index and full hash of at most one keyword. */
+    struct KeywordSlot {
+        u64 hash_ = 0;
+        i32 index_ = -1;
+    };
+
+    static constexpr std::array<KeywordSlot, KEYWORD_SLOTS> keyword_slots = [] {
+        std::array<KeywordSlot, KEYWORD_SLOTS> slots = {};
+        for (u64 i = 0; i < std::size(keywords); i++) {
+            const u64 hash = hash_string(keywords[i].name_);
+            slots[(hash >> KEYWORD_SHIFT) & (KEYWORD_SLOTS - 1)] = { hash, static_cast<i32>(i) };
+        }
+        return slots;
+    }();
+
+    TokenType identify_keyword(const std::string_view string) {
+        return identify_keyword(string, hash_string(string));
     }
 
-    void print_token(CompilerContext* ctx, const TokenLexeme& token) {
-        assert(ctx != nullptr);
-        if (!token.is_valid()) {
-            return;
+    TokenType identify_keyword(const std::string_view string, const u64 hash) {
+        const KeywordSlot& slot = keyword_slots[(hash >> KEYWORD_SHIFT) & (KEYWORD_SLOTS - 1)];
+        if (slot.index_ >= 0 && slot.hash_ == hash && keywords[slot.index_].name_ == string) {
+            return keywords[slot.index_].type_;
         }
-        if (token_has_value(token.type)) {
-            print_value_token(ctx, token);
+        return TokenType::IDENTIFIER;
+    }
+
+    u64 parse_integer_literal(const std::string_view text) {
+        u64 value = 0;
+        if (text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+            std::from_chars(text.data() + 2, text.data() + text.size(), value, 16);
+        } else if (text.size() > 1 && text[0] == '0') {
+            std::from_chars(text.data() + 1, text.data() + text.size(), value, 8);
         } else {
-            print_nonvalue_token(ctx, token);
+            std::from_chars(text.data(), text.data() + text.size(), value, 10);
+        }
+        return value;
+    }
+
+    f64 parse_float_literal(const TokenType type, const std::string_view text) {
+        if (type == TokenType::LIT_INT) {
+            return static_cast<f64>(parse_integer_literal(text));
         }
+        f64 value = 0.0;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
     }
 
 #if 0
@@ -209,8 +271,10 @@ namespace solara {
         { "continue" , TokenType::KW_CONTINUE },
         { "default"  , TokenType::KW_DEFAULT },
         { "else"     , TokenType::KW_ELSE },
+        { "fn"       , TokenType::KW_FN },
         { "for"      , TokenType::KW_FOR },
         { "if"       , TokenType::KW_IF },
+        { "import"   , TokenType::KW_IMPORT },
         { "module"   , TokenType::KW_MODULE },
         { "pub"      , TokenType::KW_PUB },
         { "return"   , TokenType::KW_RETURN },
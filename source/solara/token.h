@@ -23,6 +23,7 @@ namespace solara {
         KW_CONTINUE,
         KW_DEFAULT,
         KW_ELSE,
+        KW_FN,
         KW_FOR,
         KW_IF,
         KW_RETURN,
@@ -30,6 +31,7 @@ namespace solara {
         KW_SWITCH,
         KW_PUB,
         KW_MODULE,
+        KW_IMPORT,
 
         // literals
         LIT_INT,
@@ -99,9 +101,17 @@ namespace solara {
     bool token_is_literal(const TokenType type);
     bool token_is_operator(const TokenType type);
     bool token_has_value(const TokenType type);
+    std::string_view token_name(const TokenType type);
     TokenType identify_keyword(const std::string_view string);
 
-    void print_token(CompilerContext* ctx, const TokenLexeme& token);
+    /** Classifies a word by its hash_string, so only a word whose hash matches a keyword's is compared. */
+    TokenType identify_keyword(const std::string_view string, const u64 hash);
+
+    /** @returns The value of an integer literal: hexadecimal after "0x", octal after a leading '0', else decimal. */
+    u64 parse_integer_literal(const std::string_view text);
+
+    /** @returns The value of a number literal typed as a float, reading an integer literal in its own base. */
+    f64 parse_float_literal(const TokenType type, const std::string_view text);
 
 #if 0
     extern std::unordered_map<std::string, TokenType> keyword_table;
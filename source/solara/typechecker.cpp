@@ -0,0 +1,461 @@
+/**
+ * @file typechecker.cpp
+ */
+
+#include "typechecker.h"
+#include "syntaxwalk.h"
+
+#include <sstream>
+#include <vector>
+
+namespace solara {
+
+    static bool is_assignment(const BinaryOperation op) {
+        switch (op) {
+            case BinaryOperation::ASSIGN:
+            case BinaryOperation::ADD_ASSIGN:
+            case BinaryOperation::SUB_ASSIGN:
+            case BinaryOperation::MUL_ASSIGN:
+            case BinaryOperation::DIV_ASSIGN:
+            case BinaryOperation::MOD_ASSIGN:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool is_arithmetic(const BinaryOperation op) {
+        switch (op) {
+            case BinaryOperation::ADD:
+            case BinaryOperation::SUB:
+            case BinaryOperation::MUL:
+            case BinaryOperation::DIV:
+            case BinaryOperation::MOD:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool is_comparison(const BinaryOperation op) {
+        switch (op) {
+            case BinaryOperation::EQ:
+            case BinaryOperation::NEQ:
+            case BinaryOperation::LT:
+            case BinaryOperation::GT:
+            case BinaryOperation::LE:
+            case BinaryOperation::GE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Checks if an expression is built only from literals, so it can take any numeric type it is used as.
+     */
+    static bool is_literal_tree(SyntaxNodeHandle expr, const TypeKind target) {
+        if (!expr) {
+            return false;
+        }
+        switch (expr->get_type()) {
+            case SyntaxNodeType::LiteralExpr: {
+                auto node = static_cast<LiteralExprNode*>(expr);
+                if (node->literal_type_ == TokenType::LIT_INT) {
+                    return target == TypeKind::Int || target == TypeKind::Float;
+                }
+                return node->literal_type_ == TokenType::LIT_FLOAT && target == TypeKind::Float;
+            }
+            case SyntaxNodeType::UnaryExpr: {
+                auto node = static_cast<UnaryExprNode*>(expr);
+                return node->op_ == UnaryOperation::NEG && is_literal_tree(node->expr_, target);
+            }
+            case SyntaxNodeType::BinaryExpr: {
+                auto node = static_cast<BinaryExprNode*>(expr);
+                return is_arithmetic(node->op_)
+                    && is_literal_tree(node->left_, target)
+                    && is_literal_tree(node->right_, target);
+            }
+            default:
+                return false;
+        }
+    }
+
+    /** @returns The type of an expression the walk has left, or INVALID for a missing one. */
+    static TypeId type_of(SyntaxNodeHandle expr) {
+        return expr ? expr->type_id_ : TypeTable::INVALID;
+    }
+
+    static void retype_literal_tree(SyntaxNodeHandle expr, const TypeId target) {
+        expr->type_id_ = target;
+        if (auto node = syntax_node_cast<UnaryExprNode>(expr)) {
+            retype_literal_tree(node->expr_, target);
+        } else if (auto node = syntax_node_cast<BinaryExprNode>(expr)) {
+            retype_literal_tree(node->left_, target);
+            retype_literal_tree(node->right_, target);
+        }
+    }
+
+    TypeChecker::TypeChecker(CompilerContext* ctx, DiagnosticList* diagnostics) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+        diagnostics_ = diagnostics;
+        types_ = &ctx->type_table_;
+
+        // cached up front so checking a body never has to intern
+        void_type_ = types_->get_void_type();
+        bool_type_ = types_->get_bool_type();
+        int_type_ = types_->get_int_type(32, true);
+        float_type_ = types_->get_float_type(32);
+    }
+
+    void TypeChecker::check(ModuleDeclNode* module) {
+        if (!module) {
+            return;
+        }
+
+        check_signatures(module);
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                check_function(function);
+            } else if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                check_constant(constant);
+            }
+        }
+    }
+
+    /**
+     * Types every module-level declaration, so calls can reference functions declared later in the module.
+     * A constant takes its declared type here; its initializer is checked with the bodies.
+     */
+    void TypeChecker::check_signatures(ModuleDeclNode* module) {
+        for (SyntaxNodeHandle decl : module->decls_) {
+            if (auto function = syntax_node_cast<FunctionDeclNode>(decl)) {
+                check_signature(function);
+            } else if (auto constant = syntax_node_cast<VarDeclNode>(decl)) {
+                constant->type_id_ = check_type(constant->type_);
+            }
+        }
+    }
+
+    void TypeChecker::set_diagnostics(DiagnosticList* diagnostics) {
+        diagnostics_ = diagnostics;
+    }
+
+    void TypeChecker::check_signature(FunctionDeclNode* function) {
+        std::vector<TypeId> params;
+        params.reserve(function->params_.size());
+        for (ParamDeclNode* param : function->params_) {
+            param->type_id_ = check_type(param->type_);
+            params.push_back(param->type_id_);
+        }
+
+        TypeId return_type = void_type_;
+        if (function->return_type_) {
+            return_type = check_type(function->return_type_);
+        }
+        function->type_id_ = types_->get_function_type(return_type, params);
+    }
+
+    void TypeChecker::check_function(FunctionDeclNode* function) {
+        begin_function(function);
+        if (function->body_) {
+            FusedSyntaxWalk<TypeChecker> walk(*this);
+            walk.walk_children(function->body_);
+        }
+        end_function();
+    }
+
+    /** Checks the initializer of a module-level constant whose signature was checked. */
+    void TypeChecker::check_constant(VarDeclNode* decl) {
+        if (decl->init_) {
+            FusedSyntaxWalk<TypeChecker> walk(*this);
+            walk.walk(decl->init_);
+        }
+        check_initializer(decl);
+    }
+
+    void TypeChecker::begin_function(FunctionDeclNode* function) {
+        function_ = function;
+    }
+
+    void TypeChecker::end_function() {
+        function_ = nullptr;
+    }
+
+    void TypeChecker::leave(VarDeclNode* node) {
+        node->type_id_ = type_of(node->type_);
+        check_initializer(node);
+    }
+
+    void TypeChecker::check_initializer(VarDeclNode* decl) {
+        if (decl->const_ && decl->type_id_ != TypeTable::INVALID && !types_->is_numeric(decl->type_id_)
+            && types_->get_info(decl->type_id_).kind != TypeKind::Bool) {
+            std::ostringstream ss;
+            ss << "a constant cannot be of type '" << types_->get_name(decl->type_id_) << "'";
+            error(decl, ss.str());
+            return;
+        }
+        if (decl->init_ && !coerce(decl->init_, decl->type_id_)) {
+            std::ostringstream ss;
+            ss << "cannot initialize a " << (decl->const_ ? "constant" : "variable") << " of type '"
+               << types_->get_name(decl->type_id_) << "' with a value of type '"
+               << types_->get_name(decl->init_->type_id_) << "'";
+            error(decl->init_, ss.str());
+        }
+    }
+
+    void TypeChecker::leave(ReturnStmtNode* node) {
+        const TypeId expected = types_->get_info(function_->type_id_).return_type;
+        const bool is_void = types_->get_info(expected).kind == TypeKind::Void;
+        if (node->expr_) {
+            const TypeId actual = node->expr_->type_id_;
+            if (is_void) {
+                error(node, "void function should not return a value");
+            } else if (!coerce(node->expr_, expected)) {
+                std::ostringstream ss;
+                ss << "cannot return a value of type '" << types_->get_name(actual)
+                   << "' from a function returning '" << types_->get_name(expected) << "'";
+                error(node->expr_, ss.str());
+            }
+        } else if (!is_void && expected != TypeTable::INVALID) {
+            error(node, "non-void function should return a value");
+        }
+    }
+
+    /** A condition is checked as soon as it is typed, before the statements it guards. */
+    void TypeChecker::after_child(IfStmtNode* node, SyntaxNodeHandle child) {
+        if (child && child == node->cond_) {
+            check_condition(child);
+        }
+    }
+
+    void TypeChecker::after_child(ForStmtNode* node, SyntaxNodeHandle child) {
+        if (child && child == node->cond_) {
+            check_condition(child);
+        }
+    }
+
+    void TypeChecker::leave(LiteralExprNode* node) {
+        if (node->literal_type_ == TokenType::LIT_INT) {
+            node->type_id_ = int_type_;
+        } else if (node->literal_type_ == TokenType::LIT_FLOAT) {
+            node->type_id_ = float_type_;
+        } else {
+            error(node, "string literals are not supported");
+        }
+    }
+
+    void TypeChecker::leave(IdentifierExprNode* node) {
+        node->type_id_ = node->decl_ ? node->decl_->type_id_ : TypeTable::INVALID;
+    }
+
+    void TypeChecker::leave(BinaryExprNode* node) {
+        node->type_id_ = check_binary(node);
+    }
+
+    void TypeChecker::leave(UnaryExprNode* node) {
+        node->type_id_ = check_unary(node);
+    }
+
+    void TypeChecker::leave(CallExprNode* node) {
+        node->type_id_ = check_call(node);
+    }
+
+    void TypeChecker::leave(NamedTypeNode* node) {
+        check_type(node);
+    }
+
+    TypeId TypeChecker::check_binary(BinaryExprNode* expr) {
+        const TypeId left = type_of(expr->left_);
+        const TypeId right = type_of(expr->right_);
+        if (left == TypeTable::INVALID || right == TypeTable::INVALID) {
+            return TypeTable::INVALID;
+        }
+
+        if (is_assignment(expr->op_)) {
+            if (!is_assignable(expr->left_)) {
+                error(expr->left_, "expression is not assignable");
+                return TypeTable::INVALID;
+            }
+            if (expr->op_ != BinaryOperation::ASSIGN && !types_->is_numeric(left)) {
+                error(expr, "compound assignment requires a numeric operand");
+                return TypeTable::INVALID;
+            }
+            if (!coerce(expr->right_, left)) {
+                std::ostringstream ss;
+                ss << "cannot assign a value of type '" << types_->get_name(right)
+                   << "' to a variable of type '" << types_->get_name(left) << "'";
+                error(expr->right_, ss.str());
+                return TypeTable::INVALID;
+            }
+            return left;
+        }
+
+        // unify the operand types, letting a literal side adopt the type of the other
+        if (left != right && !coerce(expr->right_, left) && !coerce(expr->left_, right)) {
+            std::ostringstream ss;
+            ss << "invalid operands to binary '" << binary_operation_name(expr->op_) << "' ('"
+               << types_->get_name(left) << "' and '" << types_->get_name(right) << "')";
+            error(expr, ss.str());
+            return TypeTable::INVALID;
+        }
+
+        const TypeId operand = expr->left_->type_id_;
+        const TypeKind kind = types_->get_info(operand).kind;
+
+        if (is_arithmetic(expr->op_)) {
+            if (!types_->is_numeric(operand) || (expr->op_ == BinaryOperation::MOD && kind != TypeKind::Int)) {
+                std::ostringstream ss;
+                ss << "invalid operand type '" << types_->get_name(operand) << "' to binary '"
+                   << binary_operation_name(expr->op_) << "'";
+                error(expr, ss.str());
+                return TypeTable::INVALID;
+            }
+            return operand;
+        }
+
+        if (is_comparison(expr->op_)) {
+            const bool equality = expr->op_ == BinaryOperation::EQ || expr->op_ == BinaryOperation::NEQ;
+            if (!types_->is_numeric(operand) && !(equality && kind == TypeKind::Bool)) {
+                std::ostringstream ss;
+                ss << "cannot compare values of type '" << types_->get_name(operand) << "'";
+                error(expr, ss.str());
+                return TypeTable::INVALID;
+            }
+            return bool_type_;
+        }
+
+        // logical operators
+        if (kind != TypeKind::Bool) {
+            std::ostringstream ss;
+            ss << "operands of '" << binary_operation_name(expr->op_) << "' must be of type 'bool'";
+            error(expr, ss.str());
+            return TypeTable::INVALID;
+        }
+        return operand;
+    }
+
+    TypeId TypeChecker::check_unary(UnaryExprNode* expr) {
+        const TypeId operand = type_of(expr->expr_);
+        if (operand == TypeTable::INVALID) {
+            return TypeTable::INVALID;
+        }
+
+        switch (expr->op_) {
+            case UnaryOperation::NOT:
+                if (types_->get_info(operand).kind != TypeKind::Bool) {
+                    error(expr, "operand of '!' must be of type 'bool'");
+                    return TypeTable::INVALID;
+                }
+                return operand;
+            case UnaryOperation::INC:
+            case UnaryOperation::DEC:
+                if (!is_assignable(expr->expr_)) {
+                    error(expr->expr_, "expression is not assignable");
+                    return TypeTable::INVALID;
+                }
+                [[fallthrough]];
+            default:
+                if (!types_->is_numeric(operand)) {
+                    std::ostringstream ss;
+                    ss << "invalid operand type '" << types_->get_name(operand) << "' to unary '"
+                       << unary_operation_name(expr->op_) << "'";
+                    error(expr, ss.str());
+                    return TypeTable::INVALID;
+                }
+                return operand;
+        }
+    }
+
+    TypeId TypeChecker::check_call(CallExprNode* expr) {
+        const TypeId callee = type_of(expr->callee_);
+        if (callee == TypeTable::INVALID) {
+            return TypeTable::INVALID;
+        }
+
+        const TypeInfo& info = types_->get_info(callee);
+        if (info.kind != TypeKind::Function) {
+            error(expr, "called object is not a function");
+            return TypeTable::INVALID;
+        }
+
+        const auto params = types_->get_params(callee);
+        if (params.size() != expr->args_.size()) {
+            std::ostringstream ss;
+            ss << "expected " << params.size() << " arguments but " << expr->args_.size() << " were given";
+            error(expr, ss.str());
+            return info.return_type;
+        }
+
+        for (u64 i = 0; i < params.size(); i++) {
+            SyntaxNodeHandle arg = expr->args_[i];
+            if (!coerce(arg, params[i])) {
+                std::ostringstream ss;
+                ss << "cannot pass a value of type '" << types_->get_name(arg->type_id_)
+                   << "' to a parameter of type '" << types_->get_name(params[i]) << "'";
+                error(arg, ss.str());
+            }
+        }
+        return info.return_type;
+    }
+
+    TypeId TypeChecker::check_type(SyntaxNodeHandle type) {
+        auto node = syntax_node_cast<NamedTypeNode>(type);
+        if (!node) {
+            return TypeTable::INVALID;
+        }
+
+        node->type_id_ = types_->lookup_name(node->name_id_);
+        if (node->type_id_ == TypeTable::INVALID) {
+            std::ostringstream ss;
+            ss << "unknown type '" << ctx_->string_table_.get_string(node->name_id_) << "'";
+            error(node, ss.str());
+        }
+        return node->type_id_;
+    }
+
+    void TypeChecker::check_condition(SyntaxNodeHandle cond) {
+        const TypeId type = type_of(cond);
+        if (type != TypeTable::INVALID && types_->get_info(type).kind != TypeKind::Bool) {
+            std::ostringstream ss;
+            ss << "condition must be of type 'bool', found '" << types_->get_name(type) << "'";
+            error(cond, ss.str());
+        }
+    }
+
+    /**
+     * Converts an expression to the target type where the language allows it implicitly.
+     * @returns False if the expression cannot be used as a value of the target type.
+     */
+    bool TypeChecker::coerce(SyntaxNodeHandle expr, const TypeId target) {
+        if (!expr || target == TypeTable::INVALID || expr->type_id_ == TypeTable::INVALID) {
+            // the error has already been reported
+            return true;
+        }
+        if (expr->type_id_ == target) {
+            return true;
+        }
+        if (is_literal_tree(expr, types_->get_info(target).kind)) {
+            retype_literal_tree(expr, target);
+            return true;
+        }
+        return false;
+    }
+
+    bool TypeChecker::is_assignable(SyntaxNodeHandle expr) const {
+        auto node = syntax_node_cast<IdentifierExprNode>(expr);
+        if (!node || !node->decl_) {
+            return false;
+        }
+        if (auto var = syntax_node_cast<VarDeclNode>(node->decl_)) {
+            return !var->const_;
+        }
+        return node->decl_->get_type() == SyntaxNodeType::ParamDecl;
+    }
+
+    void TypeChecker::error(SyntaxNodeHandle node, const std::string& message) {
+        diagnostics_->report(ERROR, node->span_, message);
+    }
+
+} /* solara */
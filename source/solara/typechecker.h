@@ -0,0 +1,74 @@
+/**
+ * @file typechecker.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "ast.h"
+#include "types.h"
+#include "diagnostics.h"
+
+#include <string>
+
+namespace solara {
+
+    /**
+     * Assigns a canonical type to every expression and declaration of a resolved module.
+     * Expressions are typed bottom-up as a post-order walk leaves them; integer literals adopt the type
+     * their context expects so that `x : f32 = 10;` needs no explicit conversion.
+     * Once the signatures are checked, function bodies only read the type table and may be checked concurrently.
+     */
+    class TypeChecker {
+    public:
+        TypeChecker(CompilerContext* ctx, DiagnosticList* diagnostics);
+
+        void check(ModuleDeclNode* module);
+        void check_signatures(ModuleDeclNode* module);
+        void check_function(FunctionDeclNode* function);
+        void check_constant(VarDeclNode* decl);
+        void set_diagnostics(DiagnosticList* diagnostics);
+
+        /**
+         * Hooks for a fused walk over a resolved function body, which check_function runs on its own. Every
+         * expression is typed as it is left, once its operands are. The body is walked between begin_function
+         * and end_function, and may be resolved in the same walk by hooks that run first.
+         */
+        void begin_function(FunctionDeclNode* function);
+        void end_function();
+        void leave(VarDeclNode* node);
+        void leave(ReturnStmtNode* node);
+        void after_child(IfStmtNode* node, SyntaxNodeHandle child);
+        void after_child(ForStmtNode* node, SyntaxNodeHandle child);
+        void leave(LiteralExprNode* node);
+        void leave(IdentifierExprNode* node);
+        void leave(BinaryExprNode* node);
+        void leave(UnaryExprNode* node);
+        void leave(CallExprNode* node);
+        void leave(NamedTypeNode* node);
+
+    protected:
+        void check_signature(FunctionDeclNode* function);
+        void check_initializer(VarDeclNode* decl);
+        TypeId check_binary(BinaryExprNode* expr);
+        TypeId check_unary(UnaryExprNode* expr);
+        TypeId check_call(CallExprNode* expr);
+        TypeId check_type(SyntaxNodeHandle type);
+        void check_condition(SyntaxNodeHandle cond);
+        bool coerce(SyntaxNodeHandle expr, const TypeId target);
+        bool is_assignable(SyntaxNodeHandle expr) const;
+        void error(SyntaxNodeHandle node, const std::string& message);
+
+    private:
+        CompilerContext* ctx_;
+        DiagnosticList* diagnostics_;
+        TypeTable* types_;
+        FunctionDeclNode* function_ = nullptr;
+        TypeId void_type_;
+        TypeId bool_type_;
+        TypeId int_type_;
+        TypeId float_type_;
+    };
+
+} /* solara */
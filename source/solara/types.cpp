@@ -0,0 +1,207 @@
+/**
+ * @file types.cpp
+ */
+
+#include "types.h"
+#include "solara.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace solara {
+
+    static u64 hash_type(const TypeInfo& info, std::span<const TypeId> params) {
+        u64 hash = 14695981039346656037ull;
+        auto mix = [&hash](const u64 value) {
+            hash ^= value;
+            hash *= 1099511628211ull;
+        };
+        mix(static_cast<u64>(info.kind));
+        mix(info.bits);
+        mix(info.is_signed);
+        mix(info.return_type);
+        mix(params.size());
+        for (TypeId param : params) {
+            mix(param);
+        }
+        return hash;
+    }
+
+    TypeTable::TypeTable(CompilerContext* ctx) {
+        assert(ctx != nullptr);
+        ctx_ = ctx;
+
+        // the invalid type is never hashed, so its id doubles as the empty slot marker
+        types_.push_back(Entry{ TypeInfo{ TypeKind::Invalid, 0, false, INVALID, 0 }, {} });
+        slots_.resize(64, INVALID);
+
+        register_name("void", get_void_type());
+        register_name("bool", get_bool_type());
+        register_name("i08", get_int_type(8, true));
+        register_name("i16", get_int_type(16, true));
+        register_name("i32", get_int_type(32, true));
+        register_name("i64", get_int_type(64, true));
+        register_name("u08", get_int_type(8, false));
+        register_name("u16", get_int_type(16, false));
+        register_name("u32", get_int_type(32, false));
+        register_name("u64", get_int_type(64, false));
+        register_name("f32", get_float_type(32));
+        register_name("f64", get_float_type(64));
+    }
+
+    TypeId TypeTable::get_void_type() {
+        return intern(TypeInfo{ TypeKind::Void, 0, false, INVALID, 0 }, {});
+    }
+
+    TypeId TypeTable::get_bool_type() {
+        return intern(TypeInfo{ TypeKind::Bool, 8, false, INVALID, 0 }, {});
+    }
+
+    TypeId TypeTable::get_int_type(const u08 bits, const bool is_signed) {
+        return intern(TypeInfo{ TypeKind::Int, bits, is_signed, INVALID, 0 }, {});
+    }
+
+    TypeId TypeTable::get_float_type(const u08 bits) {
+        return intern(TypeInfo{ TypeKind::Float, bits, true, INVALID, 0 }, {});
+    }
+
+    TypeId TypeTable::get_function_type(const TypeId return_type, std::span<const TypeId> params) {
+        return intern(TypeInfo{ TypeKind::Function, 0, false, return_type, 0 }, params);
+    }
+
+    TypeId TypeTable::lookup_name(const u64 name_id) const {
+        auto it = names_.find(name_id);
+        if (it != names_.end()) {
+            return it->second;
+        }
+        return INVALID;
+    }
+
+    const TypeInfo& TypeTable::get_info(const TypeId type) const {
+        assert(type < types_.size());
+        return types_[type].info_;
+    }
+
+    std::span<const TypeId> TypeTable::get_params(const TypeId type) const {
+        assert(type < types_.size());
+        return types_[type].params_;
+    }
+
+    bool TypeTable::is_numeric(const TypeId type) const {
+        const TypeKind kind = get_info(type).kind;
+        return kind == TypeKind::Int || kind == TypeKind::Float;
+    }
+
+    std::string TypeTable::get_name(const TypeId type) const {
+        const TypeInfo& info = get_info(type);
+        std::ostringstream ss;
+        switch (info.kind) {
+            case TypeKind::Void:
+                ss << "void";
+                break;
+            case TypeKind::Bool:
+                ss << "bool";
+                break;
+            case TypeKind::Int:
+                ss << (info.is_signed ? "i" : "u") << (info.bits < 10 ? "0" : "") << static_cast<u32>(info.bits);
+                break;
+            case TypeKind::Float:
+                ss << "f" << static_cast<u32>(info.bits);
+                break;
+            case TypeKind::Function: {
+                ss << "fn(";
+                const auto params = get_params(type);
+                for (u64 i = 0; i < params.size(); i++) {
+                    ss << (i > 0 ? ", " : "") << get_name(params[i]);
+                }
+                ss << ") : " << get_name(info.return_type);
+                break;
+            }
+            default:
+                ss << "<invalid>";
+                break;
+        }
+        return ss.str();
+    }
+
+    u32 TypeTable::get_size() const {
+        return types_.size();
+    }
+
+    /**
+     * Returns the canonical id of a type, adding it to the table if it is new.
+     * Finding an existing type only takes a shared lock; the table is never resized on lookup.
+     */
+    TypeId TypeTable::intern(const TypeInfo& info, std::span<const TypeId> params) {
+        const u64 hash = hash_type(info, params);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            const TypeId found = find(info, params, hash);
+            if (found != INVALID) {
+                return found;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        const TypeId found = find(info, params, hash);
+        if (found != INVALID) {
+            return found;
+        }
+        if ((types_.size() + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        const u64 mask = slots_.size() - 1;
+        u64 slot = hash & mask;
+        while (slots_[slot] != INVALID) {
+            slot = (slot + 1) & mask;
+        }
+
+        TypeInfo canonical = info;
+        canonical.params_count = static_cast<u32>(params.size());
+        const TypeId id = types_.push_back(Entry{ canonical, std::vector<TypeId>(params.begin(), params.end()) });
+        slots_[slot] = id;
+        return id;
+    }
+
+    /**
+     * Probes the slots for an existing type. The caller holds the lock.
+     * @returns The id of the type, or INVALID if it is not in the table.
+     */
+    TypeId TypeTable::find(const TypeInfo& info, std::span<const TypeId> params, const u64 hash) const {
+        const u64 mask = slots_.size() - 1;
+        u64 slot = hash & mask;
+        while (slots_[slot] != INVALID) {
+            const TypeId candidate = slots_[slot];
+            const Entry& other = types_[candidate];
+            if (other.info_.kind == info.kind
+                && other.info_.bits == info.bits
+                && other.info_.is_signed == info.is_signed
+                && other.info_.return_type == info.return_type
+                && other.params_.size() == params.size()
+                && std::equal(params.begin(), params.end(), other.params_.begin())) {
+                return candidate;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return INVALID;
+    }
+
+    void TypeTable::register_name(const std::string_view name, const TypeId type) {
+        names_[ctx_->string_table_.add(name)] = type;
+    }
+
+    void TypeTable::grow() {
+        std::vector<TypeId> slots(slots_.size() * 2, INVALID);
+        const u64 mask = slots.size() - 1;
+        for (TypeId id = 1; id < types_.size(); id++) {
+            const Entry& entry = types_[id];
+            u64 slot = hash_type(entry.info_, entry.params_) & mask;
+            while (slots[slot] != INVALID) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = id;
+        }
+        slots_.swap(slots);
+    }
+
+} /* solara */
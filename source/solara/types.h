@@ -0,0 +1,131 @@
+/**
+ * @file types.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <span>
+
+namespace solara {
+
+    // forward declarations
+    struct CompilerContext;
+
+    /**
+     * Handle to a canonical type of the Type Table.
+     * Types are hash-consed, so two handles are equal if and only if they denote the same type.
+     */
+    using TypeId = u32;
+
+    enum class TypeKind : u08 {
+        Invalid = 0,
+        Void,
+        Bool,
+        Int,
+        Float,
+        Function
+    };
+
+    struct TypeInfo {
+        TypeKind kind;
+        u08 bits;
+        bool is_signed;
+        TypeId return_type;
+        u32 params_count;
+    };
+
+    /**
+     * Append-only array whose elements never move. Elements live in segments of doubling size, so one writer
+     * may append while other threads read the elements they already know of without taking a lock.
+     */
+    template <typename T>
+    class SegmentedArray {
+    public:
+        T& operator[](const u32 index) const {
+            const u32 segment = get_segment(index);
+            return segments_[segment][index - get_segment_begin(segment)];
+        }
+
+        u32 push_back(T value) {
+            const u32 index = size_.load(std::memory_order_relaxed);
+            const u32 segment = get_segment(index);
+            if (!segments_[segment]) {
+                segments_[segment] = std::make_unique<T[]>(static_cast<u64>(FIRST_SIZE) << segment);
+            }
+            segments_[segment][index - get_segment_begin(segment)] = std::move(value);
+            size_.store(index + 1, std::memory_order_release);
+            return index;
+        }
+
+        u32 size() const {
+            return size_.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr u32 FIRST_SIZE = 64;
+
+        static u32 get_segment(const u32 index) {
+            return static_cast<u32>(std::bit_width(index / FIRST_SIZE + 1)) - 1;
+        }
+
+        static u32 get_segment_begin(const u32 segment) {
+            return FIRST_SIZE * ((1u << segment) - 1);
+        }
+
+        std::array<std::unique_ptr<T[]>, 27> segments_;
+        std::atomic<u32> size_ = 0;
+    };
+
+    /**
+     * Hash-consed table of every type of the compilation. Types can be added from several threads at once;
+     * the infos and parameter lists of existing types never move, so they are read without locking.
+     */
+    class TypeTable {
+    public:
+        static constexpr TypeId INVALID = 0;
+
+        TypeTable(CompilerContext* ctx);
+
+        TypeId get_void_type();
+        TypeId get_bool_type();
+        TypeId get_int_type(const u08 bits, const bool is_signed);
+        TypeId get_float_type(const u08 bits);
+        TypeId get_function_type(const TypeId return_type, std::span<const TypeId> params);
+        TypeId lookup_name(const u64 name_id) const;
+
+        const TypeInfo& get_info(const TypeId type) const;
+        std::span<const TypeId> get_params(const TypeId type) const;
+        bool is_numeric(const TypeId type) const;
+        std::string get_name(const TypeId type) const;
+        u32 get_size() const;
+
+    protected:
+        TypeId intern(const TypeInfo& info, std::span<const TypeId> params);
+        TypeId find(const TypeInfo& info, std::span<const TypeId> params, const u64 hash) const;
+        void register_name(const std::string_view name, const TypeId type);
+        void grow();
+
+    private:
+        struct Entry {
+            TypeInfo info_;
+            std::vector<TypeId> params_;
+        };
+
+        CompilerContext* ctx_;
+        SegmentedArray<Entry> types_;
+        std::shared_mutex mutex_;
+        std::vector<TypeId> slots_;
+        std::unordered_map<u64, TypeId> names_;
+    };
+
+} /* solara */
@@ -0,0 +1,42 @@
+/**
+ * @file utf8.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <string>
+#include <string_view>
+
+namespace solara {
+
+    /**
+     * @returns The offset of the first byte that does not begin a well-formed UTF-8 sequence (overlong forms,
+     * surrogates and code points past U+10FFFF included), or npos if the whole text is valid. Runs of ASCII
+     * are checked 16 bytes at a time where SSE2 is available, so pure ASCII text costs about one pass of loads.
+     */
+    u64 find_invalid_utf8(const std::string_view text);
+
+    /**
+     * @returns How many bytes at the end of a text begin a sequence the text cuts short, which a stream
+     * validates again once the rest has arrived.
+     */
+    u32 get_incomplete_utf8_tail(const std::string_view text);
+
+    /**
+     * Decodes the sequence starting at an offset of validated text.
+     * @returns The code point, with its encoded length in out_length.
+     */
+    u32 decode_utf8(const std::string_view text, const u64 offset, u32& out_length);
+
+    /** Appends the UTF-8 encoding of a code point. */
+    void append_utf8(std::string& out, const u32 code_point);
+
+    /** Non-ASCII code points that can start an identifier, per the Unicode XID_Start property. */
+    bool is_xid_start(const u32 code_point);
+
+    /** Non-ASCII code points that can continue an identifier, per the Unicode XID_Continue property. */
+    bool is_xid_continue(const u32 code_point);
+
+} /* solara */
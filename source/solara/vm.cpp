@@ -0,0 +1,284 @@
+/**
+ * @file vm.cpp
+ */
+
+#include "vm.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SOLARA_COMPUTED_GOTO 1
+#else
+#define SOLARA_COMPUTED_GOTO 0
+#endif
+
+namespace solara {
+
+    static inline i64 wrap32(const u64 value) {
+        return static_cast<i64>(static_cast<i32>(static_cast<u32>(value)));
+    }
+
+    VirtualMachine::VirtualMachine(CompilerContext* ctx, const BcModule* module) {
+        assert(ctx != nullptr);
+        assert(module != nullptr);
+        ctx_ = ctx;
+        module_ = module;
+        stack_.resize(STACK_SIZE);
+        frames_.reserve(1024);
+    }
+
+    bool VirtualMachine::call(const u32 function, std::span<const VmValue> args, VmValue& out_result) {
+        error_.clear();
+        out_result.int_ = 0;
+
+        if (function >= module_->functions_.size() || !module_->functions_[function].defined_) {
+            error_ = "call to a function without a body";
+            return false;
+        }
+        const BcFunction* entry = &module_->functions_[function];
+        if (args.size() != entry->param_count_ || entry->frame_size_ > stack_.size()) {
+            error_ = "invalid call to '" + std::string(ctx_->string_table_.get_string(entry->name_id_)) + "'";
+            return false;
+        }
+
+        for (u64 i = 0; i < args.size(); i++) {
+            stack_[i] = args[i];
+        }
+        return execute(entry, out_result);
+    }
+
+    const std::string& VirtualMachine::get_error() const {
+        return error_;
+    }
+
+    void VirtualMachine::set_tiering(TieredCompiler* tiers) {
+        tiers_ = tiers;
+        call_counts_.assign(tiers != nullptr ? module_->functions_.size() : 0, 0);
+        loop_counts_.assign(tiers != nullptr ? module_->functions_.size() : 0, 0);
+    }
+
+    void VirtualMachine::count_loop(const BcFunction* function) {
+        const u64 index = static_cast<u64>(function - module_->functions_.data());
+        if (++loop_counts_[index] == LOOP_THRESHOLD) {
+            tiers_->request(static_cast<u32>(index));
+        }
+    }
+
+    /**
+     * The interpreter loop. The current function, its code, constants and frame base are kept in locals and only
+     * reloaded on calls and returns.
+     */
+    bool VirtualMachine::execute(const BcFunction* entry, VmValue& out_result) {
+        const BcFunction* function = entry;
+        const BcInst* code = function->code_.data();
+        const BcInst* pc = code;
+        const VmValue* k = function->constants_.data();
+        VmValue* r = stack_.data();
+        VmValue* const stack_end = stack_.data() + stack_.size();
+        BcInst inst;
+        frames_.clear();
+        const std::atomic<NativeAdapter>* const native = tiers_ != nullptr ? tiers_->get_dispatch_table() : nullptr;
+
+#define A r[inst.a_]
+#define VM_JUMP(target) \
+        do { \
+            const BcInst* const to = (target); \
+            if (native != nullptr && to < pc) count_loop(function); \
+            pc = to; \
+        } while (false)
+#define B r[inst.b_]
+#define C r[inst.c_]
+
+#if SOLARA_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define SOLARA_VM_LABEL(name) &&op_##name,
+        static void* const dispatch[] = { SOLARA_BYTECODE_OPS(SOLARA_VM_LABEL) };
+#undef SOLARA_VM_LABEL
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { inst = *pc++; goto *dispatch[static_cast<u08>(inst.op_)]; } while (false)
+        VM_NEXT();
+#else
+#define VM_CASE(name) case BcOp::name:
+#define VM_NEXT() continue
+        for (;;) {
+            inst = *pc++;
+            switch (inst.op_) {
+#endif
+
+        VM_CASE(MOV) A = B; VM_NEXT();
+        VM_CASE(LOADK) A = k[inst.get_wide()]; VM_NEXT();
+
+        VM_CASE(ADD_I32) A.int_ = wrap32(static_cast<u64>(B.int_) + static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(SUB_I32) A.int_ = wrap32(static_cast<u64>(B.int_) - static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(MUL_I32) A.int_ = wrap32(static_cast<u64>(B.int_) * static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(DIV_I32)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = wrap32(static_cast<u64>(B.int_ / C.int_));
+            VM_NEXT();
+        VM_CASE(REM_I32)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = wrap32(static_cast<u64>(B.int_ % C.int_));
+            VM_NEXT();
+
+        VM_CASE(ADD_I64) A.int_ = static_cast<i64>(static_cast<u64>(B.int_) + static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(SUB_I64) A.int_ = static_cast<i64>(static_cast<u64>(B.int_) - static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(MUL_I64) A.int_ = static_cast<i64>(static_cast<u64>(B.int_) * static_cast<u64>(C.int_)); VM_NEXT();
+        VM_CASE(DIV_S64)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = C.int_ == -1 ? static_cast<i64>(0 - static_cast<u64>(B.int_)) : B.int_ / C.int_;
+            VM_NEXT();
+        VM_CASE(REM_S64)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = C.int_ == -1 ? 0 : B.int_ % C.int_;
+            VM_NEXT();
+        VM_CASE(DIV_U64)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = static_cast<i64>(static_cast<u64>(B.int_) / static_cast<u64>(C.int_));
+            VM_NEXT();
+        VM_CASE(REM_U64)
+            if (C.int_ == 0) goto division_by_zero;
+            A.int_ = static_cast<i64>(static_cast<u64>(B.int_) % static_cast<u64>(C.int_));
+            VM_NEXT();
+
+        VM_CASE(NEG_I32) A.int_ = wrap32(0 - static_cast<u64>(B.int_)); VM_NEXT();
+        VM_CASE(NEG_I64) A.int_ = static_cast<i64>(0 - static_cast<u64>(B.int_)); VM_NEXT();
+        VM_CASE(SEXT) A.int_ = static_cast<i64>(static_cast<u64>(A.int_) << (64 - inst.b_)) >> (64 - inst.b_); VM_NEXT();
+        VM_CASE(ZEXT) A.int_ = static_cast<i64>(static_cast<u64>(A.int_) & ((1ull << inst.b_) - 1)); VM_NEXT();
+        VM_CASE(NOT) A.int_ = B.int_ == 0; VM_NEXT();
+
+        VM_CASE(EQ_I) A.int_ = B.int_ == C.int_; VM_NEXT();
+        VM_CASE(NE_I) A.int_ = B.int_ != C.int_; VM_NEXT();
+        VM_CASE(LT_S) A.int_ = B.int_ < C.int_; VM_NEXT();
+        VM_CASE(LE_S) A.int_ = B.int_ <= C.int_; VM_NEXT();
+        VM_CASE(GT_S) A.int_ = B.int_ > C.int_; VM_NEXT();
+        VM_CASE(GE_S) A.int_ = B.int_ >= C.int_; VM_NEXT();
+        VM_CASE(LT_U) A.int_ = static_cast<u64>(B.int_) < static_cast<u64>(C.int_); VM_NEXT();
+        VM_CASE(LE_U) A.int_ = static_cast<u64>(B.int_) <= static_cast<u64>(C.int_); VM_NEXT();
+        VM_CASE(GT_U) A.int_ = static_cast<u64>(B.int_) > static_cast<u64>(C.int_); VM_NEXT();
+        VM_CASE(GE_U) A.int_ = static_cast<u64>(B.int_) >= static_cast<u64>(C.int_); VM_NEXT();
+
+        VM_CASE(ADD_F32) A.float32_ = B.float32_ + C.float32_; VM_NEXT();
+        VM_CASE(SUB_F32) A.float32_ = B.float32_ - C.float32_; VM_NEXT();
+        VM_CASE(MUL_F32) A.float32_ = B.float32_ * C.float32_; VM_NEXT();
+        VM_CASE(DIV_F32) A.float32_ = B.float32_ / C.float32_; VM_NEXT();
+        VM_CASE(NEG_F32) A.float32_ = -B.float32_; VM_NEXT();
+        VM_CASE(EQ_F32) A.int_ = B.float32_ == C.float32_; VM_NEXT();
+        VM_CASE(NE_F32) A.int_ = B.float32_ != C.float32_; VM_NEXT();
+        VM_CASE(LT_F32) A.int_ = B.float32_ < C.float32_; VM_NEXT();
+        VM_CASE(LE_F32) A.int_ = B.float32_ <= C.float32_; VM_NEXT();
+        VM_CASE(GT_F32) A.int_ = B.float32_ > C.float32_; VM_NEXT();
+        VM_CASE(GE_F32) A.int_ = B.float32_ >= C.float32_; VM_NEXT();
+
+        VM_CASE(ADD_F64) A.float_ = B.float_ + C.float_; VM_NEXT();
+        VM_CASE(SUB_F64) A.float_ = B.float_ - C.float_; VM_NEXT();
+        VM_CASE(MUL_F64) A.float_ = B.float_ * C.float_; VM_NEXT();
+        VM_CASE(DIV_F64) A.float_ = B.float_ / C.float_; VM_NEXT();
+        VM_CASE(NEG_F64) A.float_ = -B.float_; VM_NEXT();
+        VM_CASE(EQ_F64) A.int_ = B.float_ == C.float_; VM_NEXT();
+        VM_CASE(NE_F64) A.int_ = B.float_ != C.float_; VM_NEXT();
+        VM_CASE(LT_F64) A.int_ = B.float_ < C.float_; VM_NEXT();
+        VM_CASE(LE_F64) A.int_ = B.float_ <= C.float_; VM_NEXT();
+        VM_CASE(GT_F64) A.int_ = B.float_ > C.float_; VM_NEXT();
+        VM_CASE(GE_F64) A.int_ = B.float_ >= C.float_; VM_NEXT();
+
+        VM_CASE(JMP) VM_JUMP(code + inst.get_wide()); VM_NEXT();
+        VM_CASE(JMPF) if (A.int_ == 0) VM_JUMP(code + inst.get_wide()); VM_NEXT();
+        VM_CASE(JMPT) if (A.int_ != 0) VM_JUMP(code + inst.get_wide()); VM_NEXT();
+
+        VM_CASE(CALL) {
+            const BcFunction* callee = &module_->functions_[inst.b_];
+            VmValue* base = r + inst.c_;
+            if (native != nullptr) {
+                const NativeAdapter adapter = native[inst.b_].load(std::memory_order_acquire);
+                if (adapter != nullptr) {
+                    const u32 status = adapter(base, &A);
+                    if (status != static_cast<u32>(NativeTrap::None)) {
+                        function = &module_->functions_[status >> NATIVE_TRAP_SHIFT];
+                        const auto trap = static_cast<NativeTrap>(status & ((1u << NATIVE_TRAP_SHIFT) - 1));
+                        if (trap == NativeTrap::DivisionByZero) {
+                            goto division_by_zero;
+                        }
+                        goto stack_overflow;
+                    }
+                    VM_NEXT();
+                }
+                if (++call_counts_[inst.b_] == CALL_THRESHOLD) {
+                    tiers_->request(inst.b_);
+                }
+            }
+            if (!callee->defined_) {
+                function = callee;
+                goto undefined_function;
+            }
+            if (base + callee->frame_size_ > stack_end || frames_.size() >= MAX_CALL_DEPTH) {
+                goto stack_overflow;
+            }
+            frames_.push_back({ function, pc, r, inst.a_ });
+            function = callee;
+            code = callee->code_.data();
+            pc = code;
+            k = callee->constants_.data();
+            r = base;
+            VM_NEXT();
+        }
+
+        VM_CASE(RET) {
+            const VmValue value = A;
+            if (frames_.empty()) {
+                out_result = value;
+                return true;
+            }
+            const Frame& frame = frames_.back();
+            function = frame.function_;
+            code = function->code_.data();
+            k = function->constants_.data();
+            pc = frame.return_pc_;
+            r = frame.base_;
+            r[frame.result_] = value;
+            frames_.pop_back();
+            VM_NEXT();
+        }
+
+        VM_CASE(RETV) {
+            if (frames_.empty()) {
+                return true;
+            }
+            const Frame& frame = frames_.back();
+            function = frame.function_;
+            code = function->code_.data();
+            k = function->constants_.data();
+            pc = frame.return_pc_;
+            r = frame.base_;
+            frames_.pop_back();
+            VM_NEXT();
+        }
+
+#if SOLARA_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#else
+                default:
+                    break;
+            }
+        }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+#undef A
+#undef B
+#undef C
+
+    division_by_zero:
+        error_ = "division by zero in '" + std::string(ctx_->string_table_.get_string(function->name_id_)) + "'";
+        return false;
+
+    stack_overflow:
+        error_ = "stack overflow in '" + std::string(ctx_->string_table_.get_string(function->name_id_)) + "'";
+        return false;
+
+    undefined_function:
+        error_ = "call to '" + std::string(ctx_->string_table_.get_string(function->name_id_)) + "' which has no body";
+        return false;
+    }
+
+} /* solara */
@@ -0,0 +1,64 @@
+/**
+ * @file vm.h
+ */
+
+#pragma once
+
+#include "common.h"
+#include "solara.h"
+#include "bytecode.h"
+#include "tiering.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace solara {
+
+    /**
+     * Register machine running a bytecode module.
+     * All frames live in one register stack; a callee's frame starts at the caller's outgoing argument area, so
+     * arguments are never copied on a call. Dispatch uses computed gotos when the compiler supports them.
+     * With tiering enabled, calls and backward jumps are counted per function and hot functions are handed to the
+     * tiered compiler; calls to a function that has been promoted go straight to its native code.
+     */
+    class VirtualMachine {
+    public:
+        static constexpr u32 STACK_SIZE = 1u << 22;
+        static constexpr u32 MAX_CALL_DEPTH = 1u << 16;
+        static constexpr u32 CALL_THRESHOLD = 1000;
+        static constexpr u32 LOOP_THRESHOLD = 10000;
+
+        VirtualMachine(CompilerContext* ctx, const BcModule* module);
+
+        /**
+         * Calls a function with the given arguments.
+         * @returns False on a runtime error, described by get_error.
+         */
+        bool call(const u32 function, std::span<const VmValue> args, VmValue& out_result);
+        const std::string& get_error() const;
+        void set_tiering(TieredCompiler* tiers);
+
+    protected:
+        bool execute(const BcFunction* entry, VmValue& out_result);
+        void count_loop(const BcFunction* function);
+
+    private:
+        struct Frame {
+            const BcFunction* function_;
+            const BcInst* return_pc_;
+            VmValue* base_;
+            u16 result_;
+        };
+
+        CompilerContext* ctx_;
+        const BcModule* module_;
+        std::vector<VmValue> stack_;
+        std::vector<Frame> frames_;
+        std::string error_;
+        TieredCompiler* tiers_ = nullptr;
+        std::vector<u32> call_counts_;
+        std::vector<u32> loop_counts_;
+    };
+
+} /* solara */
@@ -0,0 +1,270 @@
+/**
+ * @file x86.cpp
+ */
+
+#include "x86.h"
+
+namespace solara {
+
+    using namespace x86;
+
+    static constexpr u08 NO_OPCODE = 0;
+
+    X86Assembler::X86Assembler(std::vector<u08>* code) {
+        assert(code != nullptr);
+        code_ = code;
+    }
+
+    u32 X86Assembler::get_offset() const {
+        return static_cast<u32>(code_->size());
+    }
+
+    void X86Assembler::mov(const Gpr dst, const Operand& src) {
+        if (src.kind_ == Operand::Kind::Register && src.reg_ == dst) {
+            return;
+        }
+        encode(0, true, 0x8B, NO_OPCODE, dst, src);
+    }
+
+    void X86Assembler::mov(const Operand& dst, const Gpr src) {
+        if (dst.kind_ == Operand::Kind::Register) {
+            mov(static_cast<Gpr>(dst.reg_), Operand::reg(src));
+            return;
+        }
+        encode(0, true, 0x89, NO_OPCODE, src, dst);
+    }
+
+    void X86Assembler::mov_imm(const Gpr dst, const i64 imm) {
+        if (imm == 0) {
+            // xor r32, r32 clears the whole register
+            encode(0, false, 0x33, NO_OPCODE, dst, Operand::reg(dst));
+        } else if (imm > 0 && imm <= 0xFFFFFFFFll) {
+            if (dst >= R8) {
+                emit8(0x41);
+            }
+            emit8(static_cast<u08>(0xB8 + (dst & 7)));
+            emit32(static_cast<u32>(imm));
+        } else if (imm >= INT32_MIN && imm < 0) {
+            encode(0, true, 0xC7, NO_OPCODE, 0, Operand::reg(dst));
+            emit32(static_cast<u32>(imm));
+        } else {
+            emit8(static_cast<u08>(0x48 | (dst >> 3)));
+            emit8(static_cast<u08>(0xB8 + (dst & 7)));
+            emit64(static_cast<u64>(imm));
+        }
+    }
+
+    void X86Assembler::mov32(const Gpr dst, const Operand& src) {
+        encode(0, false, 0x8B, NO_OPCODE, dst, src);
+    }
+
+    void X86Assembler::movsx(const Gpr dst, const Gpr src, const u32 bits) {
+        if (bits == 32) {
+            encode(0, true, 0x63, NO_OPCODE, dst, Operand::reg(src));
+        } else {
+            encode(0, true, 0x0F, bits == 8 ? 0xBE : 0xBF, dst, Operand::reg(src));
+        }
+    }
+
+    void X86Assembler::movzx(const Gpr dst, const Gpr src, const u32 bits) {
+        if (bits == 32) {
+            mov32(dst, Operand::reg(src));
+        } else {
+            encode(0, false, 0x0F, bits == 8 ? 0xB6 : 0xB7, dst, Operand::reg(src), bits == 8);
+        }
+    }
+
+    void X86Assembler::lea(const Gpr dst, const Operand& src) {
+        encode(0, true, 0x8D, NO_OPCODE, dst, src);
+    }
+
+    void X86Assembler::alu(const Alu op, const Gpr dst, const Operand& src) {
+        encode(0, true, static_cast<u08>(op), NO_OPCODE, dst, src);
+    }
+
+    void X86Assembler::alu_imm(const Alu op, const Gpr dst, const i32 imm) {
+        // the /digit of the immediate group is the register form opcode shifted down
+        const u08 digit = static_cast<u08>(op) >> 3;
+        if (imm >= -128 && imm <= 127) {
+            encode(0, true, 0x83, NO_OPCODE, digit, Operand::reg(dst));
+            emit8(static_cast<u08>(imm));
+        } else {
+            encode(0, true, 0x81, NO_OPCODE, digit, Operand::reg(dst));
+            emit32(static_cast<u32>(imm));
+        }
+    }
+
+    void X86Assembler::imul(const Gpr dst, const Operand& src) {
+        encode(0, true, 0x0F, 0xAF, dst, src);
+    }
+
+    void X86Assembler::neg(const Gpr dst) {
+        encode(0, true, 0xF7, NO_OPCODE, 3, Operand::reg(dst));
+    }
+
+    void X86Assembler::idiv(const Operand& src) {
+        encode(0, true, 0xF7, NO_OPCODE, 7, src);
+    }
+
+    void X86Assembler::div(const Operand& src) {
+        encode(0, true, 0xF7, NO_OPCODE, 6, src);
+    }
+
+    void X86Assembler::cqo() {
+        emit8(0x48);
+        emit8(0x99);
+    }
+
+    void X86Assembler::test(const Gpr a, const Gpr b) {
+        encode(0, true, 0x85, NO_OPCODE, b, Operand::reg(a));
+    }
+
+    void X86Assembler::setcc(const Cond cond, const Gpr dst) {
+        encode(0, false, 0x0F, static_cast<u08>(0x90 + cond), 0, Operand::reg(dst), true);
+    }
+
+    void X86Assembler::sse(const Sse op, const bool single, const Xmm reg, const Operand& rm) {
+        u08 prefix = single ? 0xF3 : 0xF2;
+        if (op == Sse::Ucomi || op == Sse::Xor || op == Sse::Move) {
+            // packed forms take no prefix for single precision and 66 for double
+            prefix = single ? 0 : 0x66;
+        }
+        encode(prefix, false, 0x0F, static_cast<u08>(op), reg, rm);
+    }
+
+    void X86Assembler::sse_store(const bool single, const Operand& dst, const Xmm src) {
+        encode(single ? 0xF3 : 0xF2, false, 0x0F, static_cast<u08>(Sse::Store), src, dst);
+    }
+
+    void X86Assembler::movq(const Xmm dst, const Gpr src) {
+        encode(0x66, true, 0x0F, 0x6E, dst, Operand::reg(src));
+    }
+
+    void X86Assembler::movd(const Xmm dst, const Gpr src) {
+        encode(0x66, false, 0x0F, 0x6E, dst, Operand::reg(src));
+    }
+
+    void X86Assembler::movd(const Gpr dst, const Xmm src) {
+        encode(0x66, false, 0x0F, 0x7E, src, Operand::reg(dst));
+    }
+
+    void X86Assembler::simd(const Simd op, const Xmm dst, const Xmm src) {
+        encode(0x66, false, 0x0F, static_cast<u08>(op), dst, Operand::reg(src));
+    }
+
+    void X86Assembler::pshufd(const Xmm dst, const Xmm src, const u08 order) {
+        encode(0x66, false, 0x0F, 0x70, dst, Operand::reg(src));
+        emit8(order);
+    }
+
+    void X86Assembler::psrlq(const Xmm dst, const u08 shift) {
+        encode(0x66, false, 0x0F, 0x73, 2, Operand::reg(dst));
+        emit8(shift);
+    }
+
+    void X86Assembler::push(const Gpr reg) {
+        if (reg >= R8) {
+            emit8(0x41);
+        }
+        emit8(static_cast<u08>(0x50 + (reg & 7)));
+    }
+
+    void X86Assembler::pop(const Gpr reg) {
+        if (reg >= R8) {
+            emit8(0x41);
+        }
+        emit8(static_cast<u08>(0x58 + (reg & 7)));
+    }
+
+    void X86Assembler::ret() {
+        emit8(0xC3);
+    }
+
+    void X86Assembler::ud2() {
+        emit8(0x0F);
+        emit8(0x0B);
+    }
+
+    u32 X86Assembler::jmp() {
+        emit8(0xE9);
+        emit32(0);
+        return get_offset() - 4;
+    }
+
+    u32 X86Assembler::jcc(const Cond cond) {
+        emit8(0x0F);
+        emit8(static_cast<u08>(0x80 + cond));
+        emit32(0);
+        return get_offset() - 4;
+    }
+
+    u32 X86Assembler::call() {
+        emit8(0xE8);
+        emit32(0);
+        return get_offset() - 4;
+    }
+
+    void X86Assembler::patch(const u32 at, const u32 target) {
+        const u32 disp = target - (at + 4);
+        for (u32 i = 0; i < 4; i++) {
+            (*code_)[at + i] = static_cast<u08>(disp >> (i * 8));
+        }
+    }
+
+    void X86Assembler::align(const u32 alignment) {
+        while (code_->size() % alignment != 0) {
+            emit8(0xCC);
+        }
+    }
+
+    void X86Assembler::emit8(const u08 value) {
+        code_->push_back(value);
+    }
+
+    void X86Assembler::emit32(const u32 value) {
+        for (u32 i = 0; i < 4; i++) {
+            code_->push_back(static_cast<u08>(value >> (i * 8)));
+        }
+    }
+
+    void X86Assembler::emit64(const u64 value) {
+        emit32(static_cast<u32>(value));
+        emit32(static_cast<u32>(value >> 32));
+    }
+
+    /**
+     * Emits [prefix] [REX] opcode ModRM [disp32]. Memory operands always use a 32-bit displacement and never rsp
+     * or r12 as base, so no SIB byte is ever needed. Byte registers 4 to 7 need an empty REX to mean spl, bpl, sil
+     * and dil instead of ah, ch, dh and bh.
+     */
+    void X86Assembler::encode(const u08 prefix, const bool wide, const u08 opcode0, const u08 opcode1, const u08 reg, const Operand& rm, const bool byte_reg) {
+        if (prefix != 0) {
+            emit8(prefix);
+        }
+        const bool rm_is_reg = rm.kind_ == Operand::Kind::Register;
+        u08 rex = 0x40;
+        rex |= wide ? 0x08 : 0;
+        rex |= (reg & 8) ? 0x04 : 0;
+        rex |= (rm.reg_ & 8) ? 0x01 : 0;
+        if (rex != 0x40 || (byte_reg && rm_is_reg && rm.reg_ >= 4)) {
+            emit8(rex);
+        }
+        emit8(opcode0);
+        if (opcode1 != NO_OPCODE) {
+            emit8(opcode1);
+        }
+
+        switch (rm.kind_) {
+            case Operand::Kind::Register:
+                emit8(static_cast<u08>(0xC0 | ((reg & 7) << 3) | (rm.reg_ & 7)));
+                break;
+            case Operand::Kind::Memory:
+                // a base of rsp or r12 would need a SIB byte
+                assert((rm.reg_ & 7) != RSP);
+                emit8(static_cast<u08>(0x80 | ((reg & 7) << 3) | (rm.reg_ & 7)));
+                emit32(static_cast<u32>(rm.disp_));
+                break;
+        }
+    }
+
+} /* solara */
@@ -0,0 +1,141 @@
+/**
+ * @file x86.h
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <vector>
+
+namespace solara {
+
+    namespace x86 {
+
+        /** General purpose registers, numbered as in the instruction encoding. */
+        enum Gpr : u08 {
+            RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+            R8, R9, R10, R11, R12, R13, R14, R15
+        };
+
+        /** SSE registers, numbered as in the instruction encoding. */
+        enum Xmm : u08 {
+            XMM0 = 0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+            XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15
+        };
+
+        enum Cond : u08 {
+            O = 0, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G
+        };
+
+        enum class Alu : u08 {
+            Add = 0x03,
+            Or = 0x0B,
+            And = 0x23,
+            Sub = 0x2B,
+            Xor = 0x33,
+            Cmp = 0x3B
+        };
+
+        /** Scalar SSE operations, the second opcode byte after 0F. */
+        enum class Sse : u08 {
+            Load = 0x10,
+            Store = 0x11,
+            Move = 0x28,
+            Ucomi = 0x2E,
+            Xor = 0x57,
+            Add = 0x58,
+            Mul = 0x59,
+            Sub = 0x5C,
+            Div = 0x5E
+        };
+
+        /** Packed integer SSE2 operations, the second opcode byte after 66 0F. */
+        enum class Simd : u08 {
+            UnpackLow32 = 0x62,
+            UnpackLow64 = 0x6C,
+            Move = 0x6F,
+            Xor = 0xEF,
+            MulU32 = 0xF4,
+            Sub32 = 0xFA,
+            Add32 = 0xFE
+        };
+
+        /** Register or memory operand, memory being a base register plus a displacement. */
+        struct Operand {
+            enum class Kind : u08 {
+                Register = 0,
+                Memory
+            };
+
+            Kind kind_ = Kind::Register;
+            u08 reg_ = 0;
+            i32 disp_ = 0;
+
+            static Operand reg(const u08 reg) { return { Kind::Register, reg, 0 }; }
+            static Operand memory(const Gpr base, const i32 disp) { return { Kind::Memory, base, disp }; }
+            static Operand frame(const i32 disp) { return memory(RBP, disp); }
+        };
+
+    } /* x86 */
+
+    /**
+     * Encoder for the subset of x86-64 the code generator uses.
+     * Integer operations are 64-bit unless stated otherwise; jumps and calls always use 32-bit displacements and
+     * return the offset of the displacement so it can be patched.
+     */
+    class X86Assembler {
+    public:
+        X86Assembler(std::vector<u08>* code);
+
+        u32 get_offset() const;
+
+        void mov(const x86::Gpr dst, const x86::Operand& src);
+        void mov(const x86::Operand& dst, const x86::Gpr src);
+        void mov_imm(const x86::Gpr dst, const i64 imm);
+        void mov32(const x86::Gpr dst, const x86::Operand& src);
+        void movsx(const x86::Gpr dst, const x86::Gpr src, const u32 bits);
+        void movzx(const x86::Gpr dst, const x86::Gpr src, const u32 bits);
+        void lea(const x86::Gpr dst, const x86::Operand& src);
+        void alu(const x86::Alu op, const x86::Gpr dst, const x86::Operand& src);
+        void alu_imm(const x86::Alu op, const x86::Gpr dst, const i32 imm);
+        void imul(const x86::Gpr dst, const x86::Operand& src);
+        void neg(const x86::Gpr dst);
+        void idiv(const x86::Operand& src);
+        void div(const x86::Operand& src);
+        void cqo();
+        void test(const x86::Gpr a, const x86::Gpr b);
+        void setcc(const x86::Cond cond, const x86::Gpr dst);
+
+        void sse(const x86::Sse op, const bool single, const x86::Xmm reg, const x86::Operand& rm);
+        void sse_store(const bool single, const x86::Operand& dst, const x86::Xmm src);
+        void movq(const x86::Xmm dst, const x86::Gpr src);
+        void movd(const x86::Xmm dst, const x86::Gpr src);
+        void movd(const x86::Gpr dst, const x86::Xmm src);
+        void simd(const x86::Simd op, const x86::Xmm dst, const x86::Xmm src);
+        void pshufd(const x86::Xmm dst, const x86::Xmm src, const u08 order);
+        void psrlq(const x86::Xmm dst, const u08 shift);
+
+        void push(const x86::Gpr reg);
+        void pop(const x86::Gpr reg);
+        void ret();
+        void ud2();
+        u32 jmp();
+        u32 jcc(const x86::Cond cond);
+        u32 call();
+
+        /** Points a 32-bit displacement at a code offset. */
+        void patch(const u32 at, const u32 target);
+        void align(const u32 alignment);
+        void emit8(const u08 value);
+        void emit32(const u32 value);
+        void emit64(const u64 value);
+
+    protected:
+        void encode(const u08 prefix, const bool wide, const u08 opcode0, const u08 opcode1, const u08 reg, const x86::Operand& rm, const bool byte_reg = false);
+
+    private:
+        std::vector<u08>* code_;
+    };
+
+} /* solara */